@@ -0,0 +1,278 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+#pragma once
+
+#include "../PluginBase/ICustomPlugin.h"
+#include "../PluginBase/json.h"
+#include "../PluginBase/ImagePlane.h"
+#include "../PluginBase/ThreadPool.h"
+#include "../PluginBase/Blockiness.h"
+
+#include <memory>
+
+/*
+*	Blocking plugin
+*	No-reference blocking: ratio of differences across block boundaries to differences
+*	inside of blocks (1 - no blocking), horizontal and vertical parts, detected grid offsets
+*	and optional ringing near strong edges.
+*/
+class VQMTblockingPlugin : public ICustomPlugin
+{
+public:
+	enum FeatureID {
+		FEATURE_BLOCKINESS,
+		FEATURE_HORIZONTAL,
+		FEATURE_VERTICAL,
+		FEATURE_OFFSET_X,
+		FEATURE_OFFSET_Y,
+		FEATURE_RINGING,
+		FEATURE_COUNT
+	};
+
+	void Init(IMetricImage::ColorComponent colorComp, int width, int height, int start_id, IMetricValueSink* sink) override {
+		this->width = width;
+		this->height = height;
+		this->start_id = start_id;
+		this->colorComp = colorComp;
+		this->sink = sink;
+
+		pool = std::make_unique<CThreadPool>(threads);
+		for (double& s : sums) s = 0;
+		frames = 0;
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	Measure(std::vector<IMetricImage*> &images) override {
+		PlaneView plane = PlaneView::FromImage(images[0], colorComp, width, height);
+		return Result(blockiness.Compute(plane, params, GetPeak(images[0]), pool.get()));
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	MeasureAndVisualize(std::vector<IMetricImage*>&images, unsigned char *vis, int vis_pitch) override {
+		PlaneView plane = PlaneView::FromImage(images[0], colorComp, width, height);
+		const RangeSpecification* ranges = images[0]->GetRanges();
+		float min = ranges ? ranges[colorComp].min : 0.f;
+		float peak = GetPeak(images[0]);
+
+		BlockinessResult res = blockiness.Compute(plane, params, peak, pool.get());
+
+		// dimmed frame, detected block boundaries in red with brightness of the boundary step
+		for (int y = 0; y < plane.height; ++y) {
+			const float* row = plane.Row(y);
+			const float* up = plane.Row(std::max(0, y - 1));
+			bool boundaryRow = y > 0 && y % params.blockHeight == res.phaseY;
+			unsigned char* out = vis + (size_t)y * vis_pitch;
+			for (int x = 0; x < plane.width; ++x) {
+				float v = std::min(1.f, std::max(0.f, (row[x] - min) / peak));
+				unsigned char c = (unsigned char)(v * 128.f);
+				out[x * 3 + 0] = c;
+				out[x * 3 + 1] = c;
+				out[x * 3 + 2] = c;
+
+				float step = 0;
+				if (x > 0 && x % params.blockWidth == res.phaseX) step = std::fabs(row[x] - row[x - 1]);
+				if (boundaryRow) step = std::max(step, std::fabs(row[x] - up[x]));
+				if (step > 0) {
+					out[x * 3 + 0] = 0;
+					out[x * 3 + 1] = 0;
+					out[x * 3 + 2] = (unsigned char)(std::min(1.f, step * 8.f / peak) * 255.f);
+				}
+			}
+		}
+
+		return Result(res);
+	}
+
+	std::vector<IDinfo>	MapIDToFrame(bool visualize) override {
+		return {
+			{ start_id + FEATURE_BLOCKINESS, L"blockiness" },
+			{ start_id + FEATURE_HORIZONTAL, L"horizontal blockiness" },
+			{ start_id + FEATURE_VERTICAL, L"vertical blockiness" },
+			{ start_id + FEATURE_OFFSET_X, L"grid offset x" },
+			{ start_id + FEATURE_OFFSET_Y, L"grid offset y" },
+			{ start_id + FEATURE_RINGING, L"ringing" }
+		};
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> > CalculateAverage(bool visualize) override {
+		if (!frames) return {};
+		std::vector< std::pair <IMetricPlugin::ID, float> > res;
+		for (int f = 0; f < FEATURE_COUNT; ++f) {
+			res.push_back({ start_id + f, float(sums[f] / frames) });
+		}
+		return res;
+	}
+
+	int GetVideoNum(bool) override {
+		return 1;
+	}
+
+	std::vector <IMetricImage::ColorComponent> GetSupportedColorcomponents() override {
+		return { IMetricImage::YYUV, IMetricImage::LLUV };
+	}
+
+	std::wstring GetName() override {
+		return L"blocking_sdk";
+	}
+	std::wstring GetInterfaceName() override {
+		return L"Blocking (SDK)";
+	}
+	std::wstring GetLongName() override {
+		return L"No-reference blocking and ringing measure";
+	}
+
+	std::wstring GetMetrInfoURL() override {
+		return L"http://compression.ru/video/";
+	}
+	std::wstring GetUnit() override {
+		return L"";
+	}
+
+	bool GetMetrIncline() override {
+		return false;
+	}
+
+	const std::wstring& GetConfigJSON() override {
+		static const std::wstring obj =
+		{
+			L"	{																		"
+			L"		\"block_width\": {													"
+			L"			\"description\": \"Block width\",								"
+			L"			\"help\": \"Horizontal period of the block grid\",				"
+			L"			\"default_value\": 8,											"
+			L"			\"possible_values\": [[2,64]]									"
+			L"		},																	"
+			L"		\"block_height\": {													"
+			L"			\"description\": \"Block height\",								"
+			L"			\"help\": \"Vertical period of the block grid\",				"
+			L"			\"default_value\": 8,											"
+			L"			\"possible_values\": [[2,64]]									"
+			L"		},																	"
+			L"		\"offset_x\": {														"
+			L"			\"description\": \"Grid offset x\",								"
+			L"			\"help\": \"Column of the first vertical boundary, -1 - detect\",	"
+			L"			\"default_value\": -1,											"
+			L"			\"possible_values\": [[-1,63]]									"
+			L"		},																	"
+			L"		\"offset_y\": {														"
+			L"			\"description\": \"Grid offset y\",								"
+			L"			\"help\": \"Row of the first horizontal boundary, -1 - detect\",	"
+			L"			\"default_value\": -1,											"
+			L"			\"possible_values\": [[-1,63]]									"
+			L"		},																	"
+			L"		\"ringing\": {														"
+			L"			\"description\": \"Ringing\",									"
+			L"			\"help\": \"Measure ringing near strong edges\",				"
+			L"			\"default_value\": \"off\",										"
+			L"			\"possible_values\": [\"off\", \"on\"]							"
+			L"		},																	"
+			L"		\"threads\": {														"
+			L"			\"description\": \"Threads\",									"
+			L"			\"help\": \"Number of threads, 0 - number of cores\",			"
+			L"			\"default_value\": 0,											"
+			L"			\"possible_values\": [[0,64]]									"
+			L"		}																	"
+			L"	}																		"
+		};
+		return obj;
+	}
+
+	bool SetConfigParams(const std::wstring& json)  override {
+		try {
+			YUVsoft::JSON res = YUVsoft::ParseWrapper::parse(YUVsoft::utf16_to_utf8(json));
+			BlockinessParams p = params;
+			if (res.in("block_width")) {
+				p.blockWidth = (int)res["block_width"].asInteger();
+				if (p.blockWidth < 2 || p.blockWidth > 64) return false;
+			}
+			if (res.in("block_height")) {
+				p.blockHeight = (int)res["block_height"].asInteger();
+				if (p.blockHeight < 2 || p.blockHeight > 64) return false;
+			}
+			if (res.in("offset_x")) {
+				p.offsetX = (int)res["offset_x"].asInteger();
+				if (p.offsetX < -1 || p.offsetX > 63) return false;
+			}
+			if (res.in("offset_y")) {
+				p.offsetY = (int)res["offset_y"].asInteger();
+				if (p.offsetY < -1 || p.offsetY > 63) return false;
+			}
+			if (res.in("ringing")) {
+				std::string r = res["ringing"].asString();
+				if (r != "off" && r != "on") return false;
+				p.ringing = r == "on";
+			}
+			if (res.in("threads")) {
+				int t = (int)res["threads"].asInteger();
+				if (t < 0 || t > 64) return false;
+				if (t != threads && pool) pool = std::make_unique<CThreadPool>(t);
+				this->threads = t;
+			}
+			params = p;
+
+			return true;
+		}
+		catch (...) {}
+
+		return false;
+	}
+
+	std::wstring GetConfigSummary() override {
+		std::wstringstream out;
+		out << "Block: " << params.blockWidth << "x" << params.blockHeight << ", offset: ";
+		if (params.offsetX < 0) out << "auto";
+		else out << params.offsetX;
+		out << ",";
+		if (params.offsetY < 0) out << "auto";
+		else out << params.offsetY;
+		out << ", ringing: " << (params.ringing ? "on" : "off") << ", threads: " << threads;
+		return out.str();
+	}
+
+private:
+	std::vector< std::pair <IMetricPlugin::ID, float> > Result(const BlockinessResult& r) {
+		double values[FEATURE_COUNT] = { r.Blockiness(), r.horizontal, r.vertical, double(r.phaseX), double(r.phaseY), r.ringing };
+		std::vector< std::pair <IMetricPlugin::ID, float> > res;
+		for (int f = 0; f < FEATURE_COUNT; ++f) {
+			sums[f] += values[f];
+			res.push_back({ start_id + f, float(values[f]) });
+		}
+		++frames;
+		return res;
+	}
+
+	float GetPeak(const IMetricImage* image) const {
+		const RangeSpecification* ranges = image->GetRanges();
+		if (ranges && ranges[colorComp].max > ranges[colorComp].min) {
+			return ranges[colorComp].max - ranges[colorComp].min;
+		}
+		return 255.f;
+	}
+
+private:
+	BlockinessParams params;
+	int threads = 0;
+	CBlockiness blockiness;
+
+	std::unique_ptr<CThreadPool> pool;
+
+	int width = 0;
+	int height = 0;
+
+	int start_id = 0;
+
+	double sums[FEATURE_COUNT] = {};
+	int frames = 0;
+
+	IMetricValueSink* sink = nullptr;
+
+	IMetricImage::ColorComponent colorComp = IMetricImage::YYUV;
+};
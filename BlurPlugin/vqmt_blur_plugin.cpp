@@ -0,0 +1,45 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/  
+
+/*
+* vqmt_blur_plugin.cpp: exports of blur plugin.
+*/
+
+#include "../PluginBase/PluginAdapter.h"
+#include "vqmt_blur_plugin.h"
+
+#include <cstring>
+#include <algorithm>
+
+/*
+* DllMain
+*/
+
+VQMT_EXPORT void CreateMetric ( IMetricPlugin**metric )
+{
+	*metric = new CPluginAdapter ( std::make_unique<VQMTblurPlugin>() );
+}
+
+VQMT_EXPORT void ReleaseMetric ( IMetricPlugin* metric )
+{
+	delete metric;
+}
+
+VQMT_EXPORT int GetVQMTVersion()
+{
+	return CPluginAdapter::apiLevel;
+}
+
+VQMT_EXPORT int CompatibleWithVQMT(int vqmtVer)
+{
+	return vqmtVer >= CPluginAdapter::apiLevel ? 0 : -1;
+}
@@ -0,0 +1,229 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+#pragma once
+
+#include "../PluginBase/ICustomPlugin.h"
+#include "../PluginBase/json.h"
+#include "../PluginBase/ImagePlane.h"
+#include "../PluginBase/ThreadPool.h"
+#include "../PluginBase/EdgeWidth.h"
+
+#include <memory>
+
+/*
+*	Blur plugin
+*	No-reference blur: mean width of edges in pixels (the bigger the more blurred)
+*	and density of detected edges.
+*/
+class VQMTblurPlugin : public ICustomPlugin
+{
+public:
+	void Init(IMetricImage::ColorComponent colorComp, int width, int height, int start_id, IMetricValueSink* sink) override {
+		this->width = width;
+		this->height = height;
+		this->id_width = start_id;
+		this->id_density = start_id + 1;
+		this->colorComp = colorComp;
+		this->sink = sink;
+
+		pool = std::make_unique<CThreadPool>(threads);
+		sumWidth = sumDensity = 0;
+		frames = 0;
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	Measure(std::vector<IMetricImage*> &images) override {
+		PlaneView plane = PlaneView::FromImage(images[0], colorComp, width, height);
+		edges.SetThreshold(threshold * GetPeak(images[0]));
+		return Result(edges.Compute(plane, pool.get()));
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	MeasureAndVisualize(std::vector<IMetricImage*>&images, unsigned char *vis, int vis_pitch) override {
+		PlaneView plane = PlaneView::FromImage(images[0], colorComp, width, height);
+		const RangeSpecification* ranges = images[0]->GetRanges();
+		float min = ranges ? ranges[colorComp].min : 0.f;
+		float peak = GetPeak(images[0]);
+
+		// dimmed frame, edges from green (sharp) to red (4 pixels wide or more)
+		for (int y = 0; y < plane.height; ++y) {
+			const float* row = plane.Row(y);
+			unsigned char* out = vis + (size_t)y * vis_pitch;
+			for (int x = 0; x < plane.width; ++x) {
+				float v = std::min(1.f, std::max(0.f, (row[x] - min) / peak));
+				unsigned char c = (unsigned char)(v * 128.f);
+				out[x * 3 + 0] = c;
+				out[x * 3 + 1] = c;
+				out[x * 3 + 2] = c;
+			}
+		}
+
+		edges.SetThreshold(threshold * peak);
+		EdgeWidthStats stats = edges.Compute(plane, nullptr, [&](int x, int y, int w, bool) {
+			float red = std::min(1.f, std::max(0.f, (w - 1) / 3.f));
+			unsigned char* out = vis + (size_t)y * vis_pitch + x * 3;
+			out[0] = 0;
+			out[1] = (unsigned char)(255.f * (1.f - red));
+			out[2] = (unsigned char)(255.f * red);
+		});
+
+		return Result(stats);
+	}
+
+	std::vector<IDinfo>	MapIDToFrame(bool visualize) override {
+		return {
+			{ id_width, L"edge width" },
+			{ id_density, L"edge density" }
+		};
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> > CalculateAverage(bool visualize) override {
+		if (!frames) return {};
+		return {
+			{ id_width, float(sumWidth / frames) },
+			{ id_density, float(sumDensity / frames) }
+		};
+	}
+
+	int GetVideoNum(bool) override {
+		return 1;
+	}
+
+	std::vector <IMetricImage::ColorComponent> GetSupportedColorcomponents() override {
+		return { IMetricImage::YYUV, IMetricImage::LLUV };
+	}
+
+	std::wstring GetName() override {
+		return L"blur_sdk";
+	}
+	std::wstring GetInterfaceName() override {
+		return L"Blur (SDK)";
+	}
+	std::wstring GetLongName() override {
+		return L"No-reference blur measure by edge width";
+	}
+
+	std::wstring GetMetrInfoURL() override {
+		return L"http://compression.ru/video/";
+	}
+	std::wstring GetUnit() override {
+		return L"px";
+	}
+
+	bool GetMetrIncline() override {
+		return false;
+	}
+
+	const std::wstring& GetConfigJSON() override {
+		static const std::wstring obj =
+		{
+			L"	{																		"
+			L"		\"threshold\": {													"
+			L"			\"description\": \"Edge threshold\",							"
+			L"			\"help\": \"Minimal central difference of an edge, part of the range\","
+			L"			\"default_value\": 0.08,										"
+			L"			\"possible_values\": [[0.001,1.0]]								"
+			L"		},																	"
+			L"		\"step\": {															"
+			L"			\"description\": \"Scan step\",									"
+			L"			\"help\": \"Every step-th row and column is scanned for edges\",	"
+			L"			\"default_value\": 2,											"
+			L"			\"possible_values\": [[1,16]]									"
+			L"		},																	"
+			L"		\"threads\": {														"
+			L"			\"description\": \"Threads\",									"
+			L"			\"help\": \"Number of threads, 0 - number of cores\",			"
+			L"			\"default_value\": 0,											"
+			L"			\"possible_values\": [[0,64]]									"
+			L"		}																	"
+			L"	}																		"
+		};
+		return obj;
+	}
+
+	bool SetConfigParams(const std::wstring& json)  override {
+		try {
+			YUVsoft::JSON res = YUVsoft::ParseWrapper::parse(YUVsoft::utf16_to_utf8(json));
+			//all values are checked before any of them is applied
+			float th = threshold;
+			int s = step, t = threads;
+			if (res.in("threshold")) {
+				th = (float)res["threshold"].asFloat();
+				if (!(th > 0 && th <= 1)) return false;
+			}
+			if (res.in("step")) {
+				s = (int)res["step"].asInteger();
+				if (s < 1 || s > 16) return false;
+			}
+			if (res.in("threads")) {
+				t = (int)res["threads"].asInteger();
+				if (t < 0 || t > 64) return false;
+			}
+
+			this->threshold = th;
+			this->step = s;
+			edges.SetStep(s);
+			if (t != threads && pool) pool = std::make_unique<CThreadPool>(t);
+			this->threads = t;
+			return true;
+		}
+		catch (...) {}
+
+		return false;
+	}
+
+	std::wstring GetConfigSummary() override {
+		std::wstringstream out;
+		out << "Threshold: " << threshold << ", step: " << step << ", threads: " << threads;
+		return out.str();
+	}
+
+private:
+	std::vector< std::pair <IMetricPlugin::ID, float> > Result(const EdgeWidthStats& stats) {
+		sumWidth += stats.MeanWidth();
+		sumDensity += stats.EdgeDensity();
+		++frames;
+		return {
+			{ id_width, float(stats.MeanWidth()) },
+			{ id_density, float(stats.EdgeDensity()) }
+		};
+	}
+
+	float GetPeak(const IMetricImage* image) const {
+		const RangeSpecification* ranges = image->GetRanges();
+		if (ranges && ranges[colorComp].max > ranges[colorComp].min) {
+			return ranges[colorComp].max - ranges[colorComp].min;
+		}
+		return 255.f;
+	}
+
+private:
+	float threshold = 0.08f;
+	int step = 2;
+	int threads = 0;
+	CEdgeWidth edges{ 20.f, 32, 2 };
+
+	std::unique_ptr<CThreadPool> pool;
+
+	int width = 0;
+	int height = 0;
+
+	int id_width = 0;
+	int id_density = 1;
+
+	double sumWidth = 0;
+	double sumDensity = 0;
+	int frames = 0;
+
+	IMetricValueSink* sink = nullptr;
+
+	IMetricImage::ColorComponent colorComp = IMetricImage::YYUV;
+};
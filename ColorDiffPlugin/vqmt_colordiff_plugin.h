@@ -0,0 +1,332 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+#pragma once
+
+#include "../PluginBase/ICustomPlugin.h"
+#include "../PluginBase/json.h"
+#include "../PluginBase/ImagePlane.h"
+#include "../PluginBase/ThreadPool.h"
+#include "../PluginBase/ColorConversion.h"
+#include "../PluginBase/ColorDifference.h"
+#include "../PluginBase/Histogram.h"
+
+#include <memory>
+#include <cstring>
+
+/*
+*	Color difference plugin
+*	Perceptual color difference (CIEDE2000 or deltaE ITP) of two videos: mean, maximum and
+*	percentile of per-pixel difference. All three RGB planes are used (YUV ones if the
+*	image has no RGB), the selected component only chooses the color space VQMT provides.
+*/
+class VQMTcolorDiffPlugin : public ICustomPlugin
+{
+public:
+	void Init(IMetricImage::ColorComponent colorComp, int width, int height, int start_id, IMetricValueSink* sink) override {
+		this->width = width;
+		this->height = height;
+		this->id_mean = start_id;
+		this->id_max = start_id + 1;
+		this->id_percentile = start_id + 2;
+		this->colorComp = colorComp;
+		this->sink = sink;
+
+		pool = std::make_unique<CThreadPool>(threads);
+		sumMean = sumMax = sumPercentile = 0;
+		frames = 0;
+		rangesValid[0] = rangesValid[1] = false;
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	Measure(std::vector<IMetricImage*> &images) override {
+		return MeasureFrame(images);
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	MeasureAndVisualize(std::vector<IMetricImage*>&images, unsigned char *vis, int vis_pitch) override {
+		auto res = MeasureFrame(images);
+
+		// difference map, white is deltaE 10 or more; visible differences (above 2.3) are tinted red
+		for (int y = 0; y < map.Height(); ++y) {
+			const float* row = map.Row(y);
+			unsigned char* out = vis + (size_t)y * vis_pitch;
+			for (int x = 0; x < map.Width(); ++x) {
+				unsigned char c = (unsigned char)(std::min(1.f, row[x] / 10.f) * 255.f + 0.5f);
+				out[x * 3 + 0] = row[x] > jnd ? c / 2 : c;
+				out[x * 3 + 1] = row[x] > jnd ? c / 2 : c;
+				out[x * 3 + 2] = c;
+			}
+		}
+
+		return res;
+	}
+
+	std::vector<IDinfo>	MapIDToFrame(bool visualize) override {
+		return {
+			{ id_mean, L"mean" },
+			{ id_max, L"max" },
+			{ id_percentile, L"percentile" }
+		};
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> > CalculateAverage(bool visualize) override {
+		if (!frames) return {};
+		return {
+			{ id_mean, float(sumMean / frames) },
+			{ id_max, float(sumMax / frames) },
+			{ id_percentile, float(sumPercentile / frames) }
+		};
+	}
+
+	int GetVideoNum(bool) override {
+		return 2;
+	}
+
+	std::vector <IMetricImage::ColorComponent> GetSupportedColorcomponents() override {
+		return { IMetricImage::RRGB, IMetricImage::YYUV };
+	}
+
+	std::wstring GetName() override {
+		return L"colordiff_sdk";
+	}
+	std::wstring GetInterfaceName() override {
+		return L"Color difference (SDK)";
+	}
+	std::wstring GetLongName() override {
+		return L"Perceptual color difference, CIEDE2000 or deltaE ITP";
+	}
+
+	std::wstring GetMetrInfoURL() override {
+		return L"http://compression.ru/video/";
+	}
+	std::wstring GetUnit() override {
+		return L"dE";
+	}
+
+	bool GetMetrIncline() override {
+		return false;
+	}
+
+	const std::wstring& GetConfigJSON() override {
+		static const std::wstring obj =
+		{
+			L"	{																		"
+			L"		\"formula\": {														"
+			L"			\"description\": \"Formula\",									"
+			L"			\"help\": \"CIEDE2000 or deltaE ITP (BT.2124)\",				"
+			L"			\"default_value\": \"ciede2000\",								"
+			L"			\"possible_values\": [\"ciede2000\", \"itp\"]					"
+			L"		},																	"
+			L"		\"matrix\": {														"
+			L"			\"description\": \"Matrix\",									"
+			L"			\"help\": \"YUV matrix and RGB primaries\",						"
+			L"			\"default_value\": \"bt709\",									"
+			L"			\"possible_values\": [\"bt601\", \"bt709\", \"bt2020\"]			"
+			L"		},																	"
+			L"		\"percentile\": {													"
+			L"			\"description\": \"Percentile\",								"
+			L"			\"help\": \"Percentile of per-pixel difference\",				"
+			L"			\"default_value\": 95.0,										"
+			L"			\"possible_values\": [[0.0,100.0]]								"
+			L"		},																	"
+			L"		\"white_luminance\": {												"
+			L"			\"description\": \"White luminance\",							"
+			L"			\"help\": \"Luminance of white in cd/m2, used by deltaE ITP\",	"
+			L"			\"default_value\": 100.0,										"
+			L"			\"possible_values\": [[1.0,10000.0]]							"
+			L"		},																	"
+			L"		\"threads\": {														"
+			L"			\"description\": \"Threads\",									"
+			L"			\"help\": \"Number of threads, 0 - number of cores\",			"
+			L"			\"default_value\": 0,											"
+			L"			\"possible_values\": [[0,64]]									"
+			L"		}																	"
+			L"	}																		"
+		};
+		return obj;
+	}
+
+	bool SetConfigParams(const std::wstring& json)  override {
+		try {
+			YUVsoft::JSON res = YUVsoft::ParseWrapper::parse(YUVsoft::utf16_to_utf8(json));
+			//all values are checked before any of them is applied
+			DeltaEFormula formula = difference.GetFormula();
+			YUVMatrix mat = matrix;
+			double p = percentile;
+			float l = whiteLuminance;
+			int t = threads;
+			if (res.in("formula")) {
+				std::string f = res["formula"].asString();
+				if (f == "ciede2000") formula = DELTAE_CIEDE2000;
+				else if (f == "itp") formula = DELTAE_ITP;
+				else return false;
+			}
+			if (res.in("matrix")) {
+				std::string m = res["matrix"].asString();
+				if (m == "bt601") mat = YUV_BT601;
+				else if (m == "bt709") mat = YUV_BT709;
+				else if (m == "bt2020") mat = YUV_BT2020;
+				else return false;
+			}
+			if (res.in("percentile")) {
+				p = res["percentile"].asFloat();
+				if (!(p >= 0 && p <= 100)) return false;
+			}
+			if (res.in("white_luminance")) {
+				l = (float)res["white_luminance"].asFloat();
+				if (!(l >= 1 && l <= 10000)) return false;
+			}
+			if (res.in("threads")) {
+				t = (int)res["threads"].asInteger();
+				if (t < 0 || t > 64) return false;
+			}
+
+			difference.SetFormula(formula);
+			if (mat != matrix) {
+				this->matrix = mat;
+				rangesValid[0] = rangesValid[1] = false;
+			}
+			this->percentile = p;
+			difference.SetWhiteLuminance(l);
+			this->whiteLuminance = l;
+			if (t != threads && pool) pool = std::make_unique<CThreadPool>(t);
+			this->threads = t;
+			return true;
+		}
+		catch (...) {}
+
+		return false;
+	}
+
+	std::wstring GetConfigSummary() override {
+		static const wchar_t* matrices[] = { L"BT.601", L"BT.709", L"BT.2020" };
+		std::wstringstream out;
+		out << (difference.GetFormula() == DELTAE_ITP ? L"deltaE ITP" : L"CIEDE2000")
+			<< ", " << matrices[matrix] << ", percentile: " << percentile;
+		if (difference.GetFormula() == DELTAE_ITP) out << ", white: " << whiteLuminance << " cd/m2";
+		out << ", threads: " << threads;
+		return out.str();
+	}
+
+private:
+	std::vector< std::pair <IMetricPlugin::ID, float> > MeasureFrame(std::vector<IMetricImage*>& images) {
+		PlaneView planes[2][3];
+		bool yuv[2];
+		for (int i = 0; i < 2; ++i) {
+			UpdateConverter(i, images[i]);
+			if (!CColorConverter::GetLinearSource(images[i], width, height, planes[i], yuv[i])) return {};
+		}
+		difference.SetPrimaries(converter[0]);
+
+		int w = std::min(planes[0][0].width, planes[1][0].width);
+		int h = std::min(planes[0][0].height, planes[1][0].height);
+		map.Resize(w, h);
+
+		int stripes = std::max(1, std::min(h, stripeCount));
+		std::vector<double> sums(stripes, 0.);
+		std::vector<float> maxima(stripes, 0.f);
+		auto job = [&](int s) {
+			size_t rowSize = (size_t)planes[0][0].width * 3;
+			std::vector<float> linA(rowSize), linB((size_t)planes[1][0].width * 3);
+			std::vector<float> scratch(std::max(rowSize, linB.size())), diff((size_t)w * 6);
+			std::vector<float> a, b;
+			int y0 = h * s / stripes, y1 = h * (s + 1) / stripes;
+			for (int y = y0; y < y1; ++y) {
+				converter[0].LinearRow(planes[0], yuv[0], y, linA.data(), scratch.data());
+				converter[1].LinearRow(planes[1], yuv[1], y, linB.data(), scratch.data());
+				float* dE = map.Row(y);
+				difference.Row(CommonWidth(linA, planes[0][0].width, a, w), CommonWidth(linB, planes[1][0].width, b, w), w, dE, diff.data());
+				double sum = 0;
+				float mx = maxima[s];
+				for (int x = 0; x < w; ++x) {
+					sum += dE[x];
+					mx = std::max(mx, dE[x]);
+				}
+				sums[s] += sum;
+				maxima[s] = mx;
+			}
+		};
+		if (pool) pool->ParallelFor(stripes, job);
+		else for (int s = 0; s < stripes; ++s) job(s);
+
+		double sum = 0;
+		float mx = 0;
+		for (int s = 0; s < stripes; ++s) {
+			sum += sums[s];
+			mx = std::max(mx, maxima[s]);
+		}
+		double mean = w && h ? sum / (double(w) * h) : 0.;
+		float p = mx > 0 ? CHistogram::ExactQuantile(map.View(), percentile / 100., RangeSpecification(0.f, mx), pool.get()) : 0.f;
+
+		sumMean += mean;
+		sumMax += mx;
+		sumPercentile += p;
+		++frames;
+		return {
+			{ id_mean, float(mean) },
+			{ id_max, mx },
+			{ id_percentile, p }
+		};
+	}
+
+	//channels of a linear row are rowWidth apart, difference needs them w apart
+	static const float* CommonWidth(const std::vector<float>& lin, int rowWidth, std::vector<float>& buffer, int w) {
+		if (rowWidth == w) return lin.data();
+		buffer.resize((size_t)w * 3);
+		for (int c = 0; c < 3; ++c) std::memcpy(buffer.data() + (size_t)c * w, lin.data() + (size_t)c * rowWidth, w * sizeof(float));
+		return buffer.data();
+	}
+
+	//linearization table of the converter depends on ranges, it is rebuilt only when they change
+	void UpdateConverter(int i, const IMetricImage* image) {
+		const RangeSpecification* r = image->GetRanges();
+		RangeSpecification current[IMetricImage::CC_LAST];
+		for (int c = 0; c < IMetricImage::CC_LAST; ++c) current[c] = r ? r[c] : RangeSpecification(0.f, 255.f);
+		if (rangesValid[i] && !std::memcmp(current, ranges[i], sizeof(current))) return;
+		std::memcpy(ranges[i], current, sizeof(current));
+		converter[i].Init(matrix, current);
+		rangesValid[i] = true;
+	}
+
+private:
+	static constexpr int stripeCount = 32;
+	//just noticeable CIEDE2000 difference
+	static constexpr float jnd = 2.3f;
+
+	YUVMatrix matrix = YUV_BT709;
+	double percentile = 95;
+	float whiteLuminance = 100.f;
+	int threads = 0;
+
+	CColorConverter converter[2];
+	RangeSpecification ranges[2][IMetricImage::CC_LAST];
+	bool rangesValid[2] = { false, false };
+	CColorDifference difference;
+	CPlaneBuffer map;
+
+	std::unique_ptr<CThreadPool> pool;
+
+	int width = 0;
+	int height = 0;
+
+	int id_mean = 0;
+	int id_max = 1;
+	int id_percentile = 2;
+
+	double sumMean = 0;
+	double sumMax = 0;
+	double sumPercentile = 0;
+	int frames = 0;
+
+	IMetricValueSink* sink = nullptr;
+
+	IMetricImage::ColorComponent colorComp = IMetricImage::RRGB;
+};
@@ -0,0 +1,270 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+#pragma once
+
+#include "../PluginBase/ICustomPlugin.h"
+#include "../PluginBase/json.h"
+#include "../PluginBase/ImagePlane.h"
+#include "../PluginBase/ThreadPool.h"
+#include "../PluginBase/TransferFunction.h"
+#include "../PluginBase/Difference.h"
+
+#include <memory>
+
+/*
+*	HDR PSNR plugin
+*	PSNR, MSE and MAE of linear light: PQ or HLG coded samples of the selected component are
+*	converted by the EOTF to [0, 1] relative to the display peak, PSNR peak is 1.
+*/
+class VQMThdrPsnrPlugin : public ICustomPlugin
+{
+public:
+	void Init(IMetricImage::ColorComponent colorComp, int width, int height, int start_id, IMetricValueSink* sink) override {
+		this->width = width;
+		this->height = height;
+		this->id_psnr = start_id;
+		this->id_mse = start_id + 1;
+		this->id_mae = start_id + 2;
+		this->colorComp = colorComp;
+		this->sink = sink;
+
+		pool = std::make_unique<CThreadPool>(threads);
+		transfer.Init(curve, mode);
+		sumPSNR = sumMSE = sumMAE = 0;
+		frames = 0;
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	Measure(std::vector<IMetricImage*> &images) override {
+		PlaneView ref = Linearize(images[0], linear[0]);
+		PlaneView dist = Linearize(images[1], linear[1]);
+
+		DiffStats stats = CDifference::Compute(ref, dist, pool.get());
+		double psnr = stats.PSNR(1., maxPSNR);
+		double mse = stats.MSE();
+		double mae = stats.MAE();
+
+		sumPSNR += psnr;
+		sumMSE += mse;
+		sumMAE += mae;
+		++frames;
+
+		return {
+			{ id_psnr, float(psnr) },
+			{ id_mse, float(mse) },
+			{ id_mae, float(mae) }
+		};
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	MeasureAndVisualize(std::vector<IMetricImage*>&images, unsigned char *vis, int vis_pitch) override {
+		auto res = Measure(images);
+
+		// absolute difference of linear light, saturates at 1/8 of display peak
+		PlaneView ref = linear[0].View();
+		PlaneView dist = linear[1].View();
+		int w = std::min(ref.width, dist.width);
+		int h = std::min(ref.height, dist.height);
+		pool->ParallelFor(h, [&](int y) {
+			const float* a = ref.Row(y);
+			const float* b = dist.Row(y);
+			unsigned char* out = vis + (size_t)y * vis_pitch;
+			for (int x = 0; x < w; ++x) {
+				float d = std::min(255.f, std::fabs(a[x] - b[x]) * 255.f * 8.f);
+				unsigned char v = (unsigned char)(d + 0.5f);
+				out[x * 3 + 0] = v;
+				out[x * 3 + 1] = v;
+				out[x * 3 + 2] = v;
+			}
+		});
+
+		return res;
+	}
+
+	std::vector<IDinfo>	MapIDToFrame(bool visualize) override {
+		return {
+			{ id_psnr, L"PSNR" },
+			{ id_mse, L"MSE" },
+			{ id_mae, L"MAE" }
+		};
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> > CalculateAverage(bool visualize) override {
+		if (!frames) return {};
+		return {
+			{ id_psnr, float(sumPSNR / frames) },
+			{ id_mse, float(sumMSE / frames) },
+			{ id_mae, float(sumMAE / frames) }
+		};
+	}
+
+	int GetVideoNum(bool) override {
+		return 2;
+	}
+
+	std::vector <IMetricImage::ColorComponent> GetSupportedColorcomponents() override {
+		return {
+			IMetricImage::YYUV, IMetricImage::RRGB, IMetricImage::GRGB, IMetricImage::BRGB
+		};
+	}
+
+	std::wstring GetName() override {
+		return L"hdr_psnr_sdk";
+	}
+	std::wstring GetInterfaceName() override {
+		return L"HDR PSNR (SDK)";
+	}
+	std::wstring GetLongName() override {
+		return L"PSNR, MSE and MAE of linear light for PQ and HLG video";
+	}
+
+	std::wstring GetMetrInfoURL() override {
+		return L"http://compression.ru/video/";
+	}
+	std::wstring GetUnit() override {
+		return L"dB";
+	}
+
+	bool GetMetrIncline() override {
+		return true;
+	}
+
+	const std::wstring& GetConfigJSON() override {
+		static const std::wstring obj =
+		{
+			L"	{																		"
+			L"		\"transfer\": {														"
+			L"			\"description\": \"Transfer function\",							"
+			L"			\"help\": \"PQ (SMPTE ST 2084) or HLG (BT.2100)\",				"
+			L"			\"default_value\": \"pq\",										"
+			L"			\"possible_values\": [\"pq\", \"hlg\"]							"
+			L"		},																	"
+			L"		\"mode\": {															"
+			L"			\"description\": \"EOTF evaluation\",							"
+			L"			\"help\": \"Interpolated tables or polynomial approximation\",	"
+			L"			\"default_value\": \"lut\",										"
+			L"			\"possible_values\": [\"lut\", \"polynomial\"]					"
+			L"		},																	"
+			L"		\"peak_luminance\": {												"
+			L"			\"description\": \"Peak luminance\",							"
+			L"			\"help\": \"Display peak in cd/m2, brighter PQ light is clipped\",	"
+			L"			\"default_value\": 1000.0,									"
+			L"			\"possible_values\": [[1.0,10000.0]]							"
+			L"		},																	"
+			L"		\"max_psnr\": {														"
+			L"			\"description\": \"PSNR of identical frames\",					"
+			L"			\"help\": \"Value reported when MSE is zero, dB\",				"
+			L"			\"default_value\": 100.0										"
+			L"		},																	"
+			L"		\"threads\": {														"
+			L"			\"description\": \"Threads\",									"
+			L"			\"help\": \"Number of threads, 0 - number of cores\",			"
+			L"			\"default_value\": 0,											"
+			L"			\"possible_values\": [[0,64]]									"
+			L"		}																	"
+			L"	}																		"
+		};
+		return obj;
+	}
+
+	bool SetConfigParams(const std::wstring& json)  override {
+		try {
+			YUVsoft::JSON res = YUVsoft::ParseWrapper::parse(YUVsoft::utf16_to_utf8(json));
+			//all values are checked before any of them is applied
+			TransferCurve c = curve;
+			TransferMode m = mode;
+			float l = peakLuminance;
+			double maxValue = maxPSNR;
+			int t = threads;
+			if (res.in("transfer")) {
+				std::string name = res["transfer"].asString();
+				if (name == "pq") c = TRANSFER_PQ;
+				else if (name == "hlg") c = TRANSFER_HLG;
+				else return false;
+			}
+			if (res.in("mode")) {
+				std::string name = res["mode"].asString();
+				if (name == "lut") m = TRANSFER_LUT;
+				else if (name == "polynomial") m = TRANSFER_POLYNOMIAL;
+				else return false;
+			}
+			if (res.in("peak_luminance")) {
+				l = (float)res["peak_luminance"].asFloat();
+				if (!(l >= 1 && l <= 10000)) return false;
+			}
+			if (res.in("max_psnr")) {
+				maxValue = res["max_psnr"].asFloat();
+			}
+			if (res.in("threads")) {
+				t = (int)res["threads"].asInteger();
+				if (t < 0 || t > 64) return false;
+			}
+
+			this->curve = c;
+			this->mode = m;
+			this->peakLuminance = l;
+			this->maxPSNR = maxValue;
+			if (curve != transfer.GetCurve() || mode != transfer.GetMode()) transfer.Init(curve, mode);
+			if (t != threads && pool) pool = std::make_unique<CThreadPool>(t);
+			this->threads = t;
+			return true;
+		}
+		catch (...) {}
+
+		return false;
+	}
+
+	std::wstring GetConfigSummary() override {
+		std::wstringstream out;
+		out << (curve == TRANSFER_HLG ? L"HLG" : L"PQ") << (mode == TRANSFER_LUT ? L" (tables)" : L" (polynomial)");
+		if (curve == TRANSFER_PQ) out << L", peak: " << peakLuminance << L" cd/m2";
+		out << L", max PSNR: " << maxPSNR << L", threads: " << threads;
+		return out.str();
+	}
+
+private:
+	//linear light of the component relative to display peak
+	PlaneView Linearize(const IMetricImage* image, CPlaneBuffer& dst) const {
+		PlaneView plane = PlaneView::FromImage(image, colorComp, width, height);
+		const RangeSpecification* ranges = image->GetRanges();
+		RangeSpecification range = ranges ? ranges[colorComp] : RangeSpecification(0.f, 255.f);
+		float gain = curve == TRANSFER_PQ ? 10000.f / peakLuminance : 1.f;
+		return transfer.Linearize(plane, range, gain, dst, pool.get());
+	}
+
+private:
+	TransferCurve curve = TRANSFER_PQ;
+	TransferMode mode = TRANSFER_LUT;
+	float peakLuminance = 1000.f;
+	double maxPSNR = 100.;
+	int threads = 0;
+
+	CTransferFunction transfer;
+	CPlaneBuffer linear[2];
+
+	std::unique_ptr<CThreadPool> pool;
+
+	int width = 0;
+	int height = 0;
+
+	int id_psnr = 0;
+	int id_mse = 1;
+	int id_mae = 2;
+
+	double sumPSNR = 0;
+	double sumMSE = 0;
+	double sumMAE = 0;
+	int frames = 0;
+
+	IMetricValueSink* sink = nullptr;
+
+	IMetricImage::ColorComponent colorComp = IMetricImage::YYUV;
+};
@@ -0,0 +1,85 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/*
+* json_alias_test.cpp: members of an object inserted or assigned from other members of
+* the same object. Inserting a member must not invalidate the source, also when the
+* object grows past its first block and its index is rebuilt. Best run under AddressSanitizer.
+*/
+
+#include "../PluginBase/json.h"
+
+#include <cstdio>
+#include <string>
+
+using namespace YUVsoft;
+
+static int failures = 0;
+
+static void Check(bool ok, const char* what, int members) {
+	if (ok) return;
+	std::printf("failed: %s, %d members\n", what, members);
+	++failures;
+}
+
+static JSON Object(int members) {
+	JSON res = JSON::object();
+	for (int i = 0; i < members; ++i) {
+		JSON inner = JSON::object();
+		inner("value", JSON::value(std::string(40, char('a' + i % 26))));
+		res("k" + std::to_string(i), inner);
+	}
+	return res;
+}
+
+int main() {
+	for (int members : { 1, 7, 8, 9, 15, 16, 17, 31, 32, 33, 100 }) {
+		const std::string last = "k" + std::to_string(members - 1);
+
+		JSON o = Object(members);
+		JSON expected = o["k0"];
+		o("copy", o["k0"]);
+		Check(o["copy"] == expected, "insert of a member", members);
+
+		o = Object(members);
+		o["new"] = o[last];
+		Check(o["new"] == Object(members)[last], "assignment of a member to a new key", members);
+
+		o = Object(members);
+		o[last] = o["k0"];
+		Check(o[last] == Object(members)["k0"], "assignment of a member to an existing key", members);
+
+		o = Object(members);
+		o("k0", o["k0"]);
+		Check(o["k0"] == Object(members)["k0"] && o.length() == size_t(members), "insert of a member to itself", members);
+
+		o = Object(members);
+		o("k0", o["k0"]["value"]);
+		Check(o["k0"] == Object(members)["k0"]["value"], "insert of a part of the replaced member", members);
+
+		o = Object(members);
+		const JSON& c = o;
+		o("copy", c[last]);
+		o["more"] = c["k0"]["value"];
+		Check(o["copy"] == Object(members)[last] && o["more"] == Object(members)["k0"]["value"], "insert through const references", members);
+
+		//many members inserted from a growing object
+		o = Object(members);
+		for (int i = 0; i < 64; ++i) o("c" + std::to_string(i), o["k" + std::to_string(i % members)]);
+		bool same = true;
+		for (int i = 0; i < 64; ++i) same = same && o["c" + std::to_string(i)] == Object(members)["k" + std::to_string(i % members)];
+		Check(same, "inserts while the object grows", members);
+	}
+
+	std::printf(failures ? "%d failures\n" : "ok\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,116 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/*
+* json_arena_bench.cpp: time to build and to free JSON documents on the heap and in one
+* memory resource: parse of a large array by ParseWrapper::parse and by JSONDocument with its
+* JSONArena or a std::pmr::monotonic_buffer_resource, and building of a per-frame result
+* with arrays and objects on the heap and in a JSONArena.
+*/
+
+#include "../PluginBase/json.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <algorithm>
+
+using namespace YUVsoft;
+
+typedef std::chrono::steady_clock Clock;
+
+static double Seconds(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//best times of several runs, seconds
+struct Times {
+	double build = 1e30;
+	double free = 1e30;
+
+	void print(const char* name) const {
+		std::printf("%s: build %.1f ms, free %.1f ms, total %.1f ms\n", name, build * 1e3, free * 1e3, (build + free) * 1e3);
+	}
+};
+
+//build() makes the document, free() destroys it
+template<class Build, class Free>
+static Times Measure(Build build, Free free, int runs) {
+	Times res;
+	for (int i = 0; i < runs; ++i) {
+		Clock::time_point start = Clock::now();
+		build();
+		res.build = std::min(res.build, Seconds(start));
+		start = Clock::now();
+		free();
+		res.free = std::min(res.free, Seconds(start));
+	}
+	return res;
+}
+
+//per-frame values with arrays and objects in the given resource, on the heap without one
+static JSON Result(int frames, JSONMemoryResource* resource) {
+	JSON list = resource ? JSON::array(*resource) : JSON::array();
+	for (int i = 0; i < frames; ++i) {
+		JSON frame = resource ? JSON::object(*resource) : JSON::object();
+		JSON planes = resource ? JSON::array(*resource) : JSON::array();
+		planes(JSON::value(30 + i % 17 * 0.37))(JSON::value(40.125 + i % 5))(JSON::value(-1.5e-3 * i));
+		frame("frame", JSON::value(i))("planes", std::move(planes))("codec", JSON::value("x264"));
+		list(std::move(frame));
+	}
+	JSON res = resource ? JSON::object(*resource) : JSON::object();
+	res("metric", JSON::value("psnr"))("frames", std::move(list));
+	return res;
+}
+
+int main() {
+	std::string text = "[";
+	for (int i = 0; i < 100000; ++i) {
+		text += (i ? ",\n" : "") + std::string("{\"id\": ") + std::to_string(i) + ", \"name\": \"item " + std::to_string(i * 7) +
+			"\", \"description\": \"a longer text that does not fit in place\", \"score\": " + std::to_string(i * 0.37) +
+			", \"tags\": [\"a\", \"b\", true, null], \"nested\": {\"x\": 1.5e3, \"y\": -2}}";
+	}
+	text += "]";
+	std::printf("parse of %zu bytes\n", text.size());
+
+	size_t count = 0;
+	std::unique_ptr<JSON> heap;
+	Measure([&]() {
+		heap.reset(new JSON(ParseWrapper::parse(text)));
+		count += heap->length();
+	}, [&]() { heap.reset(); }, 5).print(" heap");
+
+	JSONDocument document;
+	Measure([&]() { count += document.parse(text).length(); }, [&]() { document.clear(); }, 5).print(" JSONDocument");
+
+#ifdef __cpp_lib_memory_resource
+	std::pmr::monotonic_buffer_resource monotonic;
+	JSONDocument pmrDocument(monotonic);
+	Measure([&]() { count += pmrDocument.parse(text).length(); }, [&]() {
+		pmrDocument.clear();
+		monotonic.release();
+	}, 5).print(" monotonic_buffer_resource");
+#endif
+
+	const int frames = 100000;
+	std::printf("result of %d frames\n", frames);
+	JSON result;
+	Measure([&]() { result = Result(frames, nullptr); }, [&]() { result = JSON(); }, 5).print(" heap");
+
+	JSONArena arena;
+	Measure([&]() { result = Result(frames, &arena); }, [&]() {
+		result = JSON();
+		arena.release();
+	}, 5).print(" JSONArena");
+
+	return count == 0;
+}
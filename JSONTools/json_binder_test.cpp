@@ -0,0 +1,155 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/*
+* json_binder_test.cpp: JSONBinder on valid, partial and invalid plugin configs. A document
+* that is cut, has a syntax error or a value of another type anywhere must throw and leave
+* every bound variable untouched; a valid one must assign what reading the tree by
+* ParseWrapper::parse and JSON::asT assigns. Prints "ok".
+*
+*	json_binder_test [count] [seed]
+*/
+
+#include "../PluginBase/json.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using namespace YUVsoft;
+
+static std::mt19937 rng;
+static int failures = 0;
+
+static int Random(int n) {
+	return std::uniform_int_distribution<int>(0, n - 1)(rng);
+}
+
+//bound variables with values that no document sets
+struct Config {
+	int threads = -77;
+	std::string mode = "untouched";
+	float threshold = -1.5f;
+	bool enabled = true;
+	long long frames = -5;
+
+	bool operator == (const Config& r) const {
+		return threads == r.threads && mode == r.mode && threshold == r.threshold && enabled == r.enabled && frames == r.frames;
+	}
+};
+
+static bool Bind(const std::string& text, Config& config) {
+	try {
+		JSONBinder()
+			.bind("threads", config.threads)
+			.bind("mode", config.mode)
+			.bind("threshold", config.threshold)
+			.bind("enabled", config.enabled)
+			.bind("frames", config.frames)
+			.parse(text);
+		return true;
+	}
+	catch (const JSONparser::Error&) {}
+	catch (const JSON::Error&) {}
+	return false;
+}
+
+//the same members read from the tree
+static bool Read(const std::string& text, Config& config) {
+	try {
+		JSON res = ParseWrapper::parse(text);
+		Config read = config;
+		if (res.in("threads")) read.threads = (int)res["threads"].asInteger();
+		if (res.in("mode")) read.mode = res["mode"].asString();
+		if (res.in("threshold")) read.threshold = (float)res["threshold"].asFloat();
+		if (res.in("enabled")) read.enabled = res["enabled"].asBoolean();
+		if (res.in("frames")) read.frames = res["frames"].asInteger();
+		config = read;
+		return true;
+	}
+	catch (const JSONparser::Error&) {}
+	catch (const JSON::Error&) {}
+	return false;
+}
+
+static void Check(bool ok, const char* what, const std::string& text) {
+	if (ok) return;
+	if (++failures <= 16) std::printf("failed: %s: %s\n", what, text.c_str());
+}
+
+int main(int argc, char** argv) {
+	int count = argc > 1 ? std::atoi(argv[1]) : 200000;
+	rng.seed(argc > 2 ? unsigned(std::atoi(argv[2])) : 12345u);
+
+	//cut, broken or of another type after valid members: nothing is assigned
+	const char* const invalid[] = {
+		"", " ", "{", "{\"threads\": 4", "{\"threads\": 4,", "{\"threads\": 4, \"mode\": \"fast\"",
+		"{\"threads\": 4, \"mode\": \"fa", "{\"threads\": 4, \"mode\": \"fast\"}x", "{\"threads\": 4}{}",
+		"{\"threads\": 4, \"mode\": \"fast\", \"other\": [}", "{\"threads\": 4, \"mode\" \"fast\"}",
+		"{\"threads\": 4, \"mode\": \"fast\", \"threshold\": 1.}", "{\"threads\": 4, \"mode\": tru}",
+		"{\"threads\": 4, \"mode\": null}", "{\"threads\": 4, \"mode\": 5}", "{\"threads\": 4, \"enabled\": 1}",
+		"{\"threads\": 4, \"threshold\": \"2.5\"}", "{\"threads\": 4, \"frames\": [1]}", "{\"threads\": 4, \"mode\": {}}",
+		"{\"threads\": 4.5}", "{\"threads\": 4, \"threads\": null}", "{\"mode\": \"fast\", \"threads\": 4, \"threads\": \"8\"}",
+		"[{\"threads\": 4}]", "4", "\"threads\"", "null"
+	};
+	for (const char* text : invalid) {
+		Config config;
+		Check(!Bind(text, config), "invalid document accepted", text);
+		Check(config == Config(), "variables changed by an invalid document", text);
+	}
+
+	//valid documents: other and nested members are skipped, the last of repeated members is taken
+	{
+		Config config;
+		Check(Bind("{\"other\": {\"threads\": 1, \"mode\": [\"x\"]}, \"threads\": 8, \"list\": [null, {}], \"mode\": \"fast\"}", config),
+			"valid document rejected", "nested members");
+		Config expected;
+		expected.threads = 8;
+		expected.mode = "fast";
+		Check(config == expected, "nested members", "");
+
+		config = Config();
+		Check(Bind("{\"threads\": null, \"threads\": 2, \"frames\": 3, \"frames\": 9000000000, \"enabled\": false}", config),
+			"valid document rejected", "repeated members");
+		expected = Config();
+		expected.threads = 2;
+		expected.frames = 9000000000ll;
+		expected.enabled = false;
+		Check(config == expected, "repeated members", "");
+
+		config = Config();
+		Check(Bind("{}", config) && config == Config(), "empty object", "{}");
+	}
+
+	//random configs, valid and cut: the same outcome and variables as reading the tree
+	static const char* const keys[] = { "threads", "mode", "threshold", "enabled", "frames", "other" };
+	static const char* const values[] = { "5", "-17", "2.5", "1e3", "\"fast\"", "\"\"", "true", "false", "null",
+		"[1, 2]", "{\"threads\": 3}", "{}", "[]", "9000000000" };
+	for (int i = 0; i < count; ++i) {
+		std::string text;
+		if (Random(8) == 0) text = values[Random(14)];
+		else {
+			text = "{";
+			for (int m = 0, n = Random(5); m < n; ++m) text += std::string(m ? ", \"" : "\"") + keys[Random(6)] + "\": " + values[Random(14)];
+			text += "}";
+		}
+		if (Random(4) == 0) text.resize(Random(int(text.size()) + 1));
+
+		Config bound, read;
+		bool bindOk = Bind(text, bound), readOk = Read(text, read);
+		Check(bindOk == readOk && bound == read, readOk ? "values of the tree" : "variables changed by a failed document", text);
+	}
+
+	if (!failures) std::printf("ok\n");
+	else std::printf("%d failures\n", failures);
+	return failures ? 1 : 0;
+}
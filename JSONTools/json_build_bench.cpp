@@ -0,0 +1,88 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/*
+* json_build_bench.cpp: cost of building, returning and copying JSON values: a nested
+* object tree returned by value through its levels, a copy of it, an array of arrays from
+* standard containers and a per-frame result parsed by both parsers. Build it with
+* YUVsoft_JSON_COPY_ON_WRITE (json_build_bench_cow) to measure shared copies.
+*/
+
+#include "../PluginBase/json.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+
+using namespace YUVsoft;
+
+//keeps results of the measured code alive
+static size_t sink = 0;
+
+//best time of several runs, seconds
+template<class Run>
+static double Best(Run run, int runs) {
+	double best = 1e30;
+	for (int i = 0; i < runs; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		run();
+		best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+//object of 4 members per level, leaves are arrays of width floats
+static JSON Level(int depth, int width) {
+	if (!depth) return JSON::value(std::vector<double>(width, 1.5));
+	JSON res = JSON::object();
+	for (int i = 0; i < 4; ++i) res("k" + std::to_string(i), Level(depth - 1, width));
+	return res;
+}
+
+//per-frame values of 100000 frames
+static std::string ResultDocument() {
+	std::string res = "{\"metric\":\"psnr\",\"frames\":[";
+	for (int i = 0; i < 100000; ++i) {
+		char frame[128];
+		std::snprintf(frame, sizeof(frame), "%s{\"frame\":%d,\"y\":%.6f,\"u\":%.6f,\"v\":%.6f}",
+			i ? "," : "", i, 30 + i % 17 * 0.37, 40.125 + i % 5, -1.5e-3 * i);
+		res += frame;
+	}
+	return res + "]}";
+}
+
+int main() {
+	JSON tree;
+	double build = Best([&]() { tree = Level(6, 64); }, 5);
+
+	JSON copy;
+	double copyTime = Best([&]() {
+		copy = tree;
+		sink += copy.length();
+	}, 5);
+
+	std::vector<std::vector<int>> rows(2000, std::vector<int>(50, 7));
+	double iterable = Best([&]() { sink += JSON::value(rows).length(); }, 5);
+
+	const std::string text = ResultDocument();
+	double table = Best([&]() { sink += ParseWrapper::parseTable(text.data(), text.data() + text.size()).length(); }, 3);
+	double fast = Best([&]() { sink += FastJSONparser::parse(text.data(), text.data() + text.size()).length(); }, 5);
+
+#ifdef YUVsoft_JSON_COPY_ON_WRITE
+	std::printf("copy-on-write\n");
+#endif
+	std::printf("nested build 4^6 x 64: %.2f ms, copy of it: %.1f us\n", build * 1e3, copyTime * 1e6);
+	std::printf("array from 2000 x 50 iterables: %.2f ms\n", iterable * 1e3);
+	std::printf("result of %zu bytes: state machine parse %.0f ms, fast parse %.0f ms\n", text.size(), table * 1e3, fast * 1e3);
+	return sink == 0;
+}
@@ -0,0 +1,85 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/*
+* json_load_bench.cpp: time from the start of the program to the first measurement of the
+* sample plugin, which parses its config first, and construction time of JSONparser.
+* json_load_bench_table is built with YUVsoft_JSON_TABLE_PARSER, so the config is parsed by
+* the state machine. Every run measures a cold start once, take the median of several runs.
+*/
+
+#include <chrono>
+
+//before anything of the plugin is initialized
+static const std::chrono::steady_clock::time_point programStart = std::chrono::steady_clock::now();
+
+#include "../SamplePlugin/vqmt_sample_plugin.h"
+
+#include <cstdio>
+#include <vector>
+
+//planes of one value, as large as the sample plugin reads
+class Image : public IMetricImage {
+public:
+	Image(int width, int height, float value) : width(width), height(height), plane(size_t(width) * height, value) {
+		for (RangeSpecification& range : ranges) range = RangeSpecification(0.f, 255.f);
+	}
+
+	const float* GetR() const override { return plane.data(); }
+	const float* GetG() const override { return plane.data(); }
+	const float* GetB() const override { return plane.data(); }
+	const float* GetY() const override { return plane.data(); }
+	const float* GetU() const override { return plane.data(); }
+	const float* GetV() const override { return plane.data(); }
+	const float* GetL() const override { return plane.data(); }
+	int GetWidth() const override { return width; }
+	int GetHeight() const override { return height; }
+	const RangeSpecification* GetRanges() const override { return ranges; }
+
+private:
+	int width, height;
+	std::vector<float> plane;
+	RangeSpecification ranges[IMetricImage::CC_LAST];
+};
+
+static double Microseconds(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+	Image reference(128, 128, 16.f), distorted(128, 128, 20.f);
+	std::vector<IMetricImage*> images = { &reference, &distorted };
+
+	VQMTsamplePlugin plugin;
+	bool configured = plugin.SetConfigParams(L"{\"param\": 3, \"param2\": \"val3\"}");
+	plugin.Init(IMetricImage::YYUV, 128, 128, 0, nullptr);
+	float value = plugin.Measure(images)[0].second;
+	double firstMeasure = Microseconds(programStart);
+
+	auto start = std::chrono::steady_clock::now();
+	{
+		YUVsoft::JSONparser parser;
+	}
+	double firstParser = Microseconds(start);
+	start = std::chrono::steady_clock::now();
+	{
+		YUVsoft::JSONparser parser;
+	}
+	double secondParser = Microseconds(start);
+
+#ifdef YUVsoft_JSON_TABLE_PARSER
+	std::printf("state machine parser\n");
+#endif
+	std::printf("start to first measurement %.1f us (config %s, value %g)\n", firstMeasure, configured ? "ok" : "rejected", value);
+	std::printf("JSONparser construction: first %.1f us, second %.1f us\n", firstParser, secondParser);
+	return configured ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/*
+* json_parse_bench.cpp: parse time of FastJSONparser and of the state machine of JSONparser
+* on a large plugin config document and a large per-frame result document.
+*/
+
+#include "../PluginBase/json.h"
+
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+
+using namespace YUVsoft;
+
+//config of 2000 parameters in the format of GetConfigJSON
+static std::string ConfigDocument() {
+	std::string res = "{";
+	for (int i = 0; i < 2000; ++i) {
+		if (i) res += ",\n";
+		res += "\"param_" + std::to_string(i) + "\": {\"description\": \"Some parameter description text\", "
+			"\"help\": \"Longer help string with \\\"escapes\\\" and unicode \\u00e9\", "
+			"\"default_value\": " + std::to_string(i * 0.25) + ", \"possible_values\": [[" + std::to_string(i) + ".0, 10000.0]]}";
+	}
+	return res + "}";
+}
+
+//per-frame values of 100000 frames
+static std::string ResultDocument() {
+	std::string res = "{\"metric\":\"psnr\",\"frames\":[";
+	for (int i = 0; i < 100000; ++i) {
+		char frame[128];
+		std::snprintf(frame, sizeof(frame), "%s{\"frame\":%d,\"y\":%.6f,\"u\":%.6f,\"v\":%.6f}",
+			i ? "," : "", i, 30 + i % 17 * 0.37, 40.125 + i % 5, -1.5e-3 * i);
+		res += frame;
+	}
+	return res + "]}";
+}
+
+//best time of several runs, seconds
+template<class Parse>
+static double Best(Parse parse, const std::string& text, int runs) {
+	double best = 1e30;
+	for (int i = 0; i < runs; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		JSON value = parse(text.data(), text.data() + text.size());
+		best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+int main() {
+	const struct {
+		const char* name;
+		std::string text;
+	} documents[] = {
+		{ "config", ConfigDocument() },
+		{ "result", ResultDocument() }
+	};
+
+	for (const auto& doc : documents) {
+		double fast = Best([](const char* start, const char* end) { return FastJSONparser::parse(start, end); }, doc.text, 5);
+		double table = Best([](const char* start, const char* end) { return ParseWrapper::parseTable(start, end); }, doc.text, 3);
+		std::printf("%s, %zu bytes: fast %.2f ms (%.0f MB/s), table %.2f ms (%.0f MB/s), x%.1f\n", doc.name, doc.text.size(),
+			fast * 1e3, doc.text.size() / fast / 1e6, table * 1e3, doc.text.size() / table / 1e6, table / fast);
+	}
+	return 0;
+}
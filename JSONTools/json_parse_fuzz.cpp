@@ -0,0 +1,228 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/*
+* json_parse_fuzz.cpp: differential fuzzer of FastJSONparser against the state machine of
+* JSONparser and against FastJSONparser::parseEvents. Random documents, with and without
+* mutations, must give the same value or the same error type, offset, line and offset in
+* line from both parsers; the tree rebuilt from events must be that of FastJSONparser.
+*
+*	json_parse_fuzz [count] [seed]
+*/
+
+#include "../PluginBase/json.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+using namespace YUVsoft;
+
+static std::mt19937 rng;
+
+static int Random(int n) {
+	return std::uniform_int_distribution<int>(0, n - 1)(rng);
+}
+
+//ASCII and Unicode spaces of the grammar
+static const char* const spaces[] = {
+	" ", "\t", "\n", "\r", "\r\n", "\n\r", "\x0b", "\x0c",
+	"\xc2\xa0", "\xe2\x80\x83", "\xe3\x80\x90", "\xe2\x80\xa8", "\xc2\x85", "\xe1\x9a\x80"
+};
+static const int spaceCount = int(sizeof(spaces) / sizeof(spaces[0]));
+
+static std::string Space() {
+	std::string res;
+	for (int n = Random(3); n > 0; --n) res += spaces[Random(spaceCount)];
+	return res;
+}
+
+static std::string Digits(int n) {
+	std::string res;
+	for (; n > 0; --n) res += char('0' + Random(10));
+	return res;
+}
+
+static std::string Number() {
+	std::string res = Random(2) ? "-" : "";
+	if (Random(4) == 0) res += '0';
+	else res += char('1' + Random(9)) + Digits(Random(18));
+	if (Random(2)) res += "." + Digits(1 + Random(17));
+	if (Random(3) == 0) {
+		res += "eE"[Random(2)];
+		int sign = Random(3);
+		if (sign) res += sign == 1 ? '+' : '-';
+		res += Digits(1 + Random(3));
+	}
+	return res;
+}
+
+static std::string String() {
+	static const char* const parts[] = { "\\n", "\\u00e9", "\\ud83d\\ude00", "\\ud83d", "\xc3\xa9", "\\\"", "\\/" };
+	std::string res = "\"";
+	for (int n = Random(8); n > 0; --n) {
+		int k = Random(12);
+		if (k < 5) res += char('a' + Random(26));
+		else res += parts[k - 5];
+	}
+	return res + "\"";
+}
+
+static std::string Value(int depth) {
+	std::string res = Space();
+	switch (Random(depth > 4 ? 4 : 7)) {
+	case 0:
+	case 3: res += Number(); break;
+	case 1: res += String(); break;
+	case 2: res += Random(3) == 0 ? "true" : Random(2) ? "false" : "null"; break;
+	case 4:
+	case 5:
+		res += '[';
+		for (int i = 0, n = Random(4); i < n; ++i) res += (i ? "," : "") + Value(depth + 1);
+		res += Space() + "]";
+		break;
+	default:
+		res += '{';
+		for (int i = 0, n = Random(4); i < n; ++i) res += (i ? "," : "") + Space() + String() + Space() + ":" + Value(depth + 1);
+		res += Space() + "}";
+	}
+	return res + Space();
+}
+
+//truncation, insertion, deletion or replacement by bytes that matter to the grammar
+static std::string Mutate(std::string text) {
+	static const char bytes[] = { '\0', '\x01', '"', '\\', '{', '}', '[', ']', ',', ':', '-', '.', 'e', '0', '5',
+		't', 'n', ' ', '\n', '\r', '\x7f', '\xc2', '\x85', '\x80', '\xe2', 'u', 'x' };
+	if (text.empty()) return text;
+	size_t at = Random(int(text.size()));
+	switch (Random(6)) {
+	case 0: text.resize(at); break;
+	case 1: text.insert(text.begin() + at, bytes[Random(sizeof(bytes))]); break;
+	case 2: text.erase(at, 1); break;
+	case 3: text[at] = bytes[Random(sizeof(bytes))]; break;
+	case 4: text.insert(at, spaces[Random(spaceCount)]); break;
+	default: text.insert(at, "\\u" + std::string(1, "0d8Fg"[Random(5)]) + "8");
+	}
+	return text;
+}
+
+struct Outcome {
+	bool ok = false;
+	std::string value;
+	JSONparser::Error error;
+
+	bool operator == (const Outcome& r) const {
+		if (ok != r.ok) return false;
+		if (ok) return value == r.value;
+		return error.type == r.error.type && error.offset == r.error.offset &&
+			error.line == r.error.line && error.offsetInLine == r.error.offsetInLine;
+	}
+};
+
+//rebuilds the tree from events, values are moved as JSON copies are deep
+struct TreeEvents : JSONEvents {
+	std::vector<JSON> containers;
+	std::vector<std::string> keys;
+	JSON result;
+
+	void add(JSON value) {
+		if (containers.empty()) result = std::move(value);
+		else if (containers.back().isArray()) containers.back()(std::move(value));
+		else {
+			containers.back()(keys.back(), std::move(value));
+			keys.pop_back();
+		}
+	}
+	void end() {
+		JSON value = std::move(containers.back());
+		containers.pop_back();
+		add(std::move(value));
+	}
+
+	void onNull() { add(JSON()); }
+	void onBoolean(bool val) { add(JSON::value(val)); }
+	void onInteger(int64_t val) { add(JSON::value((long long)val)); }
+	void onFloat(double val) { add(JSON::value(val)); }
+	void onString(const std::string& val) { add(JSON::value(val)); }
+	void onStartObject() { containers.push_back(JSON::object()); }
+	void onKey(const std::string& key) { keys.push_back(key); }
+	void onEndObject() { end(); }
+	void onStartArray() { containers.push_back(JSON::array()); }
+	void onEndArray() { end(); }
+};
+
+template<class Parse>
+static Outcome Run(Parse parse, const std::string& text) {
+	Outcome res;
+	try {
+		res.value = parse(text.data(), text.data() + text.size()).serialize();
+		res.ok = true;
+	}
+	catch (const JSONparser::Error& err) {
+		res.error = err;
+	}
+	return res;
+}
+
+static void Print(const char* name, const Outcome& r) {
+	std::printf(" %s: ", name);
+	if (r.ok) std::printf("%.80s\n", r.value.c_str());
+	else std::printf("error %d offset %lld line %lld in line %lld\n", int(r.error.type), r.error.offset, r.error.line, r.error.offsetInLine);
+}
+
+int main(int argc, char** argv) {
+	int count = argc > 1 ? std::atoi(argv[1]) : 100000;
+	rng.seed(argc > 2 ? unsigned(std::atoi(argv[2])) : 12345u);
+
+	int valid = 0, invalid = 0, mismatches = 0;
+	for (int i = 0; i < count; ++i) {
+		std::string text = Value(0);
+		//deeper than the recursion limit of FastJSONparser, which falls back to the state machine
+		if (Random(50) == 0) text = std::string(700, '[') + text + std::string(Random(2) ? 700 : 690, ']');
+		for (int n = Random(3); n > 0; --n) text = Mutate(text);
+
+		Outcome fast = Run([](const char* start, const char* end) { return FastJSONparser::parse(start, end); }, text);
+		Outcome table = Run([](const char* start, const char* end) { return ParseWrapper::parseTable(start, end); }, text);
+		Outcome events = Run([](const char* start, const char* end) {
+			TreeEvents tree;
+			FastJSONparser::parseEvents(start, end, tree);
+			return tree.result;
+		}, text);
+		(fast.ok ? valid : invalid)++;
+
+		if (!(fast == events) && ++mismatches <= 8) {
+			std::printf("events mismatch %d: [", i);
+			for (unsigned char c : text) std::printf(c < 32 || c > 126 ? "\\x%02x" : "%c", c);
+			std::printf("]\n");
+			Print("fast  ", fast);
+			Print("events", events);
+		}
+
+		//integers out of int64 are floats of FastJSONparser, the state machine wraps them around
+		int run = 0, longest = 0;
+		for (char c : text) longest = std::max(longest, run = std::isdigit((unsigned char)c) ? run + 1 : 0);
+		if (fast == table || (longest >= 19 && fast.ok && table.ok)) continue;
+
+		if (++mismatches <= 8) {
+			std::printf("mismatch %d: [", i);
+			for (unsigned char c : text) std::printf(c < 32 || c > 126 ? "\\x%02x" : "%c", c);
+			std::printf("]\n");
+			Print("fast  ", fast);
+			Print("table ", table);
+		}
+	}
+	std::printf("valid %d, invalid %d, mismatches %d\n", valid, invalid, mismatches);
+	return mismatches ? 1 : 0;
+}
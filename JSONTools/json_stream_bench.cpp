@@ -0,0 +1,80 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/*
+* json_stream_bench.cpp: parse time of a large document from a stream by blocks and by
+* characters, and of a stream of JSON lines by JSONStreamReader and by getline with a parse
+* of every line.
+*/
+
+#include "../PluginBase/json.h"
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <algorithm>
+
+using namespace YUVsoft;
+
+static std::string Item(int i) {
+	return "{\"id\": " + std::to_string(i) + ", \"name\": \"item " + std::to_string(i * 7) + "\", \"score\": " + std::to_string(i * 0.37) +
+		", \"tags\": [\"a\", \"b\", true, null], \"nested\": {\"x\": 1.5e3, \"y\": -2}}";
+}
+
+//best time of several runs, seconds
+template<class Run>
+static double Best(Run run, int runs) {
+	double best = 1e30;
+	for (int i = 0; i < runs; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		run();
+		best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+int main() {
+	std::string array = "[", lines;
+	for (int i = 0; i < 60000; ++i) {
+		array += (i ? ",\n" : "") + Item(i);
+		lines += Item(i) + "\n";
+	}
+	array += "]";
+
+	size_t count = 0;
+	double blocks = Best([&] {
+		std::istringstream input(array);
+		count += ParseWrapper::parse(input).isArray();
+	}, 5);
+	double chars = Best([&] {
+		std::istringstream input(array);
+		count += ParseWrapper::parseChars(input).isArray();
+	}, 3);
+	double memory = Best([&] { count += ParseWrapper::parse(array).isArray(); }, 5);
+	std::printf("array, %zu bytes: parse(istream) %.1f ms, parseChars %.1f ms, parse(string) %.1f ms\n",
+		array.size(), blocks * 1e3, chars * 1e3, memory * 1e3);
+
+	double reader = Best([&] {
+		std::istringstream input(lines);
+		JSONStreamReader documents(input);
+		JSON value;
+		while (documents.next(value)) count += value.isObject();
+	}, 5);
+	double getline = Best([&] {
+		std::istringstream input(lines);
+		std::string line;
+		while (std::getline(input, line)) count += ParseWrapper::parse(line).isObject();
+	}, 5);
+	std::printf("JSON lines, %zu bytes: JSONStreamReader %.1f ms, getline and parse %.1f ms (%zu)\n",
+		lines.size(), reader * 1e3, getline * 1e3, count);
+	return 0;
+}
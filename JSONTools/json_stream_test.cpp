@@ -0,0 +1,201 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/*
+* json_stream_test.cpp: JSONStreamReader and ParseWrapper::parse(std::istream&) against
+* FastJSONparser on the whole text. Sequences of random documents, with and without
+* mutations, must give the same values or the same error with any block size, a fixed
+* sequence is split at every byte, and documents read one by one by parse(std::istream&)
+* from string and file streams with CRLF lines must be those of the reader.
+*
+*	json_stream_test [count] [seed]
+*/
+
+#include "../PluginBase/json.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+using namespace YUVsoft;
+
+static std::mt19937 rng;
+static int failures = 0;
+
+static int Random(int n) {
+	return std::uniform_int_distribution<int>(0, n - 1)(rng);
+}
+
+static std::string Space() {
+	static const char* const spaces[] = { " ", "\t", "\n", "\r\n", "\xc2\xa0", "\xe2\x80\x83" };
+	std::string res;
+	for (int n = Random(3); n > 0; --n) res += spaces[Random(6)];
+	return res;
+}
+
+static std::string String() {
+	static const char* const parts[] = { "\\n", "\\r\\n", "\\u00e9", "\\ud83d\\ude00", "\xc3\xa9", "\\\"", "\\/" };
+	std::string res = "\"";
+	for (int n = Random(8); n > 0; --n) {
+		int k = Random(12);
+		if (k < 5) res += char('a' + Random(26));
+		else res += parts[k - 5];
+	}
+	return res + "\"";
+}
+
+static std::string Value(int depth) {
+	std::string res = Space();
+	switch (Random(depth > 3 ? 3 : 6)) {
+	case 0: res += std::to_string(Random(2000000) - 1000000) + (Random(2) ? ".25e1" : ""); break;
+	case 1: res += String(); break;
+	case 2: res += Random(3) == 0 ? "true" : Random(2) ? "false" : "null"; break;
+	case 3:
+	case 4:
+		res += '[';
+		for (int i = 0, n = Random(4); i < n; ++i) res += (i ? "," : "") + Value(depth + 1);
+		res += Space() + "]";
+		break;
+	default:
+		res += '{';
+		for (int i = 0, n = Random(4); i < n; ++i) res += (i ? "," : "") + Space() + String() + Space() + ":" + Value(depth + 1);
+		res += Space() + "}";
+	}
+	return res + Space();
+}
+
+static std::string Mutate(std::string text) {
+	static const char bytes[] = { '\0', '"', '\\', '{', '}', '[', ']', ',', ':', '-', '.', 'e', '0', 't', ' ', '\n', '\r', '\xc2' };
+	if (text.empty()) return text;
+	size_t at = Random(int(text.size()));
+	switch (Random(4)) {
+	case 0: text.resize(at); break;
+	case 1: text.insert(text.begin() + at, bytes[Random(sizeof(bytes))]); break;
+	case 2: text.erase(at, 1); break;
+	default: text[at] = bytes[Random(sizeof(bytes))];
+	}
+	return text;
+}
+
+//serialized documents and the error that stopped the reading
+struct Outcome {
+	std::vector<std::string> values;
+	bool failed = false;
+	JSONparser::Error error;
+
+	bool operator == (const Outcome& r) const {
+		if (values != r.values || failed != r.failed) return false;
+		return !failed || (error.type == r.error.type && error.offset == r.error.offset &&
+			error.line == r.error.line && error.offsetInLine == r.error.offsetInLine);
+	}
+};
+
+static Outcome Read(const std::string& text, size_t blockSize) {
+	Outcome res;
+	std::istringstream input(text);
+	JSONStreamReader reader(input, blockSize);
+	JSON value;
+	try {
+		while (reader.next(value)) res.values.push_back(value.serialize());
+	}
+	catch (const JSONparser::Error& err) {
+		res.failed = true;
+		res.error = err;
+	}
+	return res;
+}
+
+//count documents read one by one by parse(std::istream&)
+static Outcome ParseEach(std::istream& input, size_t count) {
+	Outcome res;
+	try {
+		while (res.values.size() < count) res.values.push_back(ParseWrapper::parse(input).serialize());
+	}
+	catch (const JSONparser::Error&) {
+		res.failed = true;
+	}
+	return res;
+}
+
+static void Check(bool ok, const char* what, const std::string& text) {
+	if (ok) return;
+	if (++failures <= 8) {
+		std::printf("failed: %s: [", what);
+		for (unsigned char c : text.substr(0, 300)) std::printf(c < 32 || c > 126 ? "\\x%02x" : "%c", c);
+		std::printf("]\n");
+	}
+}
+
+int main(int argc, char** argv) {
+	int count = argc > 1 ? std::atoi(argv[1]) : 20000;
+	rng.seed(argc > 2 ? unsigned(std::atoi(argv[2])) : 12345u);
+	static const char* const separators[] = { "\n", "\r\n", " ", "\r\n\r\n", "\t" };
+	const size_t blockSizes[] = { 1, 2, 3, 5, 7, 16, 64, 1 << 16 };
+
+	//random sequences: the reader gives the documents of FastJSONparser with any block size
+	for (int i = 0; i < count; ++i) {
+		Outcome expected;
+		std::string text;
+		for (int n = Random(5); n > 0; --n) {
+			std::string document = Value(0);
+			expected.values.push_back(FastJSONparser::parse(document.data(), document.data() + document.size()).serialize());
+			text += document + separators[Random(5)];
+		}
+		bool mutated = Random(4) == 0;
+		if (mutated) {
+			text = Mutate(text);
+			expected = Read(text, text.size() + 1);
+		}
+		for (size_t blockSize : blockSizes) Check(Read(text, blockSize) == expected, "reader and FastJSONparser", text);
+
+		//parse(std::istream&) reads the same documents and leaves the stream after each of them
+		if (!mutated) {
+			std::istringstream input(text);
+			Check(ParseEach(input, expected.values.size()) == expected, "parse(std::istream&) and the reader", text);
+		}
+	}
+
+	//a fixed sequence with CRLF lines, split at every byte
+	const std::string lines =
+		"{\"frame\": 0, \"y\": 31.25, \"name\": \"a\\r\\nb\"}\r\n"
+		"[1, -2.5e-3, true, null, \"\\ud83d\\ude00\"]\r\n"
+		"\r\n"
+		"  \"text \\u00e9\"\r\n"
+		"{\"nested\": {\"list\": [[], {}], \"empty\": \"\"}}\r\n"
+		"12345678901234\r\n";
+	Outcome expected = Read(lines, lines.size() + 1);
+	Check(!expected.failed && expected.values.size() == 5, "reader of CRLF lines", lines);
+	for (size_t blockSize = 1; blockSize <= lines.size(); ++blockSize) {
+		Check(Read(lines, blockSize) == expected, "split at every byte", lines);
+	}
+	std::istringstream stringInput(lines);
+	Check(ParseEach(stringInput, expected.values.size()) == expected, "parse(std::istream&) of a string stream with CRLF lines", lines);
+
+	//CRLF lines of a file, opened in binary and in text mode
+	const char* path = "json_stream_test.tmp";
+	{
+		std::ofstream file(path, std::ios::binary);
+		file << lines;
+	}
+	for (std::ios::openmode mode : { std::ios::in | std::ios::binary, std::ios::in }) {
+		std::ifstream file(path, mode);
+		Check(ParseEach(file, expected.values.size()) == expected, "parse(std::istream&) of a file with CRLF lines", lines);
+	}
+	std::remove(path);
+
+	if (!failures) std::printf("ok\n");
+	else std::printf("%d failures\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,47 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/*
+* json_table_gen.cpp: writes json_table.h, the compiled grammar of JSONparser, by
+* JSONparser::writeTable with CRLF line ends as the other sources. Run it after a change
+* of the grammar or of the user procs and commit the file to PluginBase if it differs:
+*
+*	json_table_gen [path, json_table.h by default]
+*/
+
+#include "../PluginBase/json.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+int main(int argc, char** argv) {
+	const char* path = argc > 1 ? argv[1] : "json_table.h";
+
+	std::ostringstream table;
+	YUVsoft::JSONparser::writeTable(table);
+	std::string text;
+	for (char c : table.str()) {
+		if (c == '\n') text += '\r';
+		text += c;
+	}
+
+	std::ofstream out(path, std::ios::binary);
+	out << text;
+	out.close();
+	if (!out) {
+		std::printf("cannot write %s\n", path);
+		return 1;
+	}
+	std::printf("%s: %zu bytes\n", path, text.size());
+	return 0;
+}
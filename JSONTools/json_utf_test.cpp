@@ -0,0 +1,175 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/*
+* json_utf_test.cpp: UTF-8 of wide strings by utf16_to_utf8 and utf8_to_utf16. Valid text
+* must convert as by std::wstring_convert, which they replaced, and back to itself. Lone and
+* reversed surrogates, overlong forms, encoded surrogates, values above U+10FFFF and truncated
+* sequences must throw std::range_error, also after a run of ASCII. Prints "ok".
+*
+*	json_utf_test [count] [seed]
+*/
+
+//the baseline converter is deprecated since C++17
+#define _SILENCE_CXX17_CODECVT_HEADER_DEPRECATION_WARNING
+
+#include "../PluginBase/json.h"
+
+#include <codecvt>
+#include <cstdio>
+#include <cstdlib>
+#include <locale>
+#include <random>
+#include <stdexcept>
+
+using namespace YUVsoft;
+
+static std::mt19937 rng;
+static int failures = 0;
+
+static unsigned long Random(unsigned long n) {
+	return std::uniform_int_distribution<unsigned long>(0, n - 1)(rng);
+}
+
+static void Check(bool ok, const char* what, const std::string& bytes) {
+	if (ok) return;
+	if (++failures <= 16) {
+		std::printf("failed: %s:", what);
+		for (unsigned char c : bytes.substr(0, 40)) std::printf(" %02x", c);
+		std::printf("\n");
+	}
+}
+
+//code points of all lengths, boundaries of the lengths and of the surrogate block
+static unsigned long CodePoint() {
+	static const unsigned long edges[] = { 0, 0x7F, 0x80, 0x7FF, 0x800, 0xD7FF, 0xE000, 0xFFFD, 0xFFFF, 0x10000, 0x10FFFF };
+	switch (Random(6)) {
+	case 0: return Random(0x80);
+	case 1: return 0x80 + Random(0x780);
+	case 2: {
+		unsigned long code = 0x800 + Random(0xF800 - 0x800);
+		return code >= 0xD800 ? code + 0x800 : code;
+	}
+	case 3: return 0x10000 + Random(0x100000);
+	case 4: return edges[Random(sizeof(edges) / sizeof(edges[0]))];
+	default: return 'a' + Random(26);
+	}
+}
+
+static void Append(std::wstring& text, unsigned long code) {
+	if (sizeof(wchar_t) == 2 && code >= 0x10000) {
+		code -= 0x10000;
+		text += wchar_t(0xD800 + (code >> 10));
+		text += wchar_t(0xDC00 + (code & 0x3FF));
+	}
+	else {
+		text += wchar_t(code);
+	}
+}
+
+template<class Convert>
+static bool Throws(Convert convert) {
+	try {
+		convert();
+	}
+	catch (const std::range_error&) {
+		return true;
+	}
+	return false;
+}
+
+static bool WideThrows(const std::wstring& text) {
+	return Throws([&] { utf16_to_utf8(text.data(), text.size()); });
+}
+
+static bool BytesThrow(const std::string& text) {
+	return Throws([&] { utf8_to_utf16(text.data(), text.size()); });
+}
+
+int main(int argc, char** argv) {
+	int count = argc > 1 ? std::atoi(argv[1]) : 20000;
+	rng.seed(argc > 2 ? unsigned(std::atoi(argv[2])) : 12345u);
+
+#if WCHAR_MAX > 0xFFFF
+	std::wstring_convert<std::codecvt_utf8<wchar_t>> baseline;
+#else
+	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> baseline;
+#endif
+
+	//valid text: the bytes of the baseline and back
+	for (int i = 0; i < count; ++i) {
+		std::wstring text;
+		for (int n = Random(4) == 0 ? int(Random(200)) : int(Random(12)); n > 0; --n) {
+			//runs of ASCII for the block path
+			if (Random(8) == 0) text += std::wstring(Random(20), L'x');
+			Append(text, CodePoint());
+		}
+		std::string bytes = utf16_to_utf8(text.data(), text.size());
+		Check(bytes == baseline.to_bytes(text), "to UTF-8 as the baseline", bytes);
+		Check(utf8_to_utf16(bytes) == baseline.from_bytes(bytes), "from UTF-8 as the baseline", bytes);
+		Check(utf8_to_utf16(bytes) == text, "round trip", bytes);
+	}
+
+	//wide text: lone, reversed and cut surrogate pairs
+	const std::wstring ascii = L"0123456789abcdef";
+	const wchar_t invalidWide[][3] = {
+		{ 0xD800, 0 }, { 0xDBFF, L'a', 0 }, { 0xDC00, 0 }, { 0xDFFF, L'a', 0 },
+		{ 0xDC00, 0xD800, 0 }, { 0xDE00, 0xD83D, 0 }, { 0xD83D, 0xD83D, 0 }
+	};
+	for (const wchar_t* units : invalidWide) {
+		std::wstring text(units);
+		std::string name(text.begin(), text.end());
+		Check(WideThrows(text), "invalid wide text", name);
+		Check(WideThrows(ascii + text), "invalid wide text after ASCII", name);
+		Check(WideThrows(text + ascii), "invalid wide text before ASCII", name);
+	}
+	//a pair is combined for any width of wchar_t
+	std::wstring pair;
+	pair += wchar_t(0xD83D);
+	pair += wchar_t(0xDE00);
+	Check(utf16_to_utf8(pair) == "\xF0\x9F\x98\x80", "surrogate pair", utf16_to_utf8(pair));
+#if WCHAR_MAX > 0xFFFF
+	Check(WideThrows(std::wstring(1, wchar_t(0x110000))), "wide code point above U+10FFFF", "");
+#endif
+
+	//UTF-8: overlong forms, encoded surrogates, out of range, stray and truncated sequences
+	const char* const invalidBytes[] = {
+		"\xC0\x80", "\xC1\xBF", "\xE0\x80\x80", "\xE0\x9F\xBF", "\xF0\x80\x80\x80", "\xF0\x8F\xBF\xBF",
+		"\xED\xA0\x80", "\xED\xBF\xBF", "\xED\xA0\xBD\xED\xB8\x80",
+		"\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xF8\x88\x80\x80\x80", "\xFE", "\xFF",
+		"\x80", "\xBF", "\xC3", "\xE2\x82", "\xF0\x9F\x98", "\xE2\x82\x41", "\xF0\x9F\x41\x80", "\xC3\xC3\xA9"
+	};
+	for (const char* sequence : invalidBytes) {
+		std::string text(sequence);
+		Check(BytesThrow(text), "invalid UTF-8", text);
+		Check(BytesThrow("0123456789abcdef" + text), "invalid UTF-8 after ASCII", text);
+		Check(BytesThrow(text + "0123456789abcdef"), "invalid UTF-8 before ASCII", text);
+	}
+	//boundaries that are valid
+	const char* const validBytes[] = { "\x7F", "\xC2\x80", "\xDF\xBF", "\xE0\xA0\x80", "\xED\x9F\xBF", "\xEE\x80\x80",
+		"\xEF\xBF\xBF", "\xF0\x90\x80\x80", "\xF4\x8F\xBF\xBF" };
+	for (const char* sequence : validBytes) {
+		std::string text = std::string("0123456789") + sequence;
+		Check(!BytesThrow(text) && utf16_to_utf8(utf8_to_utf16(text)) == text, "valid boundary", text);
+	}
+
+	//the std::wstring overload stops at the first null character, the one with a length does not
+	std::wstring withNull = L"ab";
+	withNull += wchar_t(0);
+	withNull += L"cd";
+	Check(utf16_to_utf8(withNull) == "ab", "std::wstring up to null", "");
+	Check(utf16_to_utf8(withNull.data(), withNull.size()) == std::string("ab\0cd", 5), "null character with a length", "");
+
+	if (!failures) std::printf("ok\n");
+	else std::printf("%d failures\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,117 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/*
+* json_value_bench.cpp: cost of config access and of result serialisation with JSON values:
+* parse of a plugin config with typed reads of its parameters, typed reads of a parsed config,
+* building a per-frame result document, its serialisation and parse back, insert and lookup
+* of every member of objects from 4 to 10000 members.
+*/
+
+#include "../PluginBase/json.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace YUVsoft;
+
+//keeps results of the measured code alive
+static double sink = 0;
+
+//best time of several runs, seconds
+template<class Run>
+static double Best(Run run, int runs) {
+	double best = 1e30;
+	for (int i = 0; i < runs; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		run();
+		best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+//reads parameters the way SetConfigParams of the plugins does
+static void ReadConfig(const JSON& config) {
+	if (config.in("transfer")) sink += config["transfer"].asString().size();
+	if (config.in("peak_luminance")) sink += config["peak_luminance"].asFloat();
+	if (config.in("threads")) sink += config["threads"].asInteger();
+	if (config.in("window")) sink += config["window"].asString().size();
+}
+
+//per-frame values of the given number of frames, as the plugins report them
+static JSON ResultDocument(int frames) {
+	JSON list = JSON::array();
+	for (int i = 0; i < frames; ++i) {
+		JSON frame = JSON::object();
+		frame("frame", JSON::value(i))("y", JSON::value(30 + i % 17 * 0.37))("u", JSON::value(40.125 + i % 5))
+			("v", JSON::value(-1.5e-3 * i))("codec", JSON::value("x264"));
+		list(std::move(frame));
+	}
+	JSON res = JSON::object();
+	res("metric", JSON::value("psnr"))("frames", std::move(list));
+	return res;
+}
+
+int main() {
+	const std::string config = "{\"transfer\":\"pq\",\"mode\":\"lut\",\"peak_luminance\":1000.0,"
+		"\"window\":\"gaussian\",\"threads\":4,\"max_psnr\":100.0}";
+	const int configRuns = 50000, frames = 20000;
+
+	double parse = Best([&]() {
+		for (int i = 0; i < configRuns; ++i) ReadConfig(ParseWrapper::parse(config));
+	}, 7);
+
+	const JSON parsed = ParseWrapper::parse(config);
+	double read = Best([&]() {
+		for (int i = 0; i < configRuns; ++i) ReadConfig(parsed);
+	}, 7);
+
+	JSON result;
+	double build = Best([&]() { result = ResultDocument(frames); }, 7);
+
+	std::string text;
+	double serialize = Best([&]() { text = result.serialize(); }, 7);
+
+	double parseBack = Best([&]() { sink += ParseWrapper::parse(text).length(); }, 7);
+
+	std::printf("config: parse and read %.2f us, read %.1f ns\n", parse * 1e6 / configRuns, read * 1e9 / configRuns);
+	std::printf("result of %d frames: build %.2f ms, serialize %.2f ms (%zu bytes, %.0f MB/s), parse %.2f ms\n", frames,
+		build * 1e3, serialize * 1e3, text.size(), text.size() / serialize / 1e6, parseBack * 1e3);
+
+	//about 200000 members in objects of each size, keys are looked up in another order
+	for (int members : { 4, 16, 100, 1000, 10000 }) {
+		std::vector<std::string> keys;
+		for (int i = 0; i < members; ++i) keys.push_back("member_" + std::to_string(i));
+		std::vector<std::string> order;
+		for (int i = 0; i < members; ++i) order.push_back(keys[size_t(i) * 7919 % members]);
+		const int objects = 200000 / members;
+
+		std::vector<JSON> built(objects);
+		double insert = Best([&]() {
+			for (JSON& object : built) {
+				object = JSON::object();
+				for (const std::string& key : keys) object(key, JSON::value(1));
+			}
+		}, 5);
+		double lookup = Best([&]() {
+			for (const JSON& object : built) {
+				for (const std::string& key : order) sink += object[key].asInteger();
+			}
+		}, 5);
+		std::printf("object of %d members, per member: insert %.1f ns, lookup %.1f ns\n", members,
+			insert * 1e9 / (double(objects) * members), lookup * 1e9 / (double(objects) * members));
+	}
+	return sink == 0;
+}
@@ -0,0 +1,178 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/*
+* json_writer_test.cpp: JSONWriter against writeToStream. Random trees and edge cases
+* (escapes, C1 controls, invalid UTF-8, non-finite and extreme floats, deep nesting,
+* documents bigger than the buffer of the writer) must give the same bytes from
+* JSON::serialize, a JSONWriter with a sink stream, writeToStream and operator <<.
+*
+*	json_writer_test [count] [seed]
+*/
+
+#include "../PluginBase/json.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <sstream>
+
+using namespace YUVsoft;
+
+static std::mt19937_64 rng;
+static int failures = 0;
+
+static int Random(int n) {
+	return int(rng() % unsigned(n));
+}
+
+static std::string String() {
+	static const char bytes[] = { '"', '\\', '/', '\n', '\r', '\t', '\b', '\f', '\0', '\x01', '\x1f', '\x7f', ' ', '\xff', '\xe9' };
+	std::string res;
+	for (int n = Random(4) == 0 ? Random(40) : Random(8); n > 0; --n) {
+		switch (Random(6)) {
+		case 0: res += bytes[Random(sizeof(bytes))]; break;
+		//C1 controls and other two-byte sequences starting with 0xc2
+		case 1: res += '\xc2'; res += char(0x70 + Random(0x40)); break;
+		case 2: res += char(rng()); break;
+		default: res += char('a' + Random(26));
+		}
+	}
+	//0xc2 at the end of the string
+	if (Random(16) == 0) res += '\xc2';
+	return res;
+}
+
+static double Float() {
+	switch (Random(8)) {
+	case 0: {
+		//any bits: NaN, infinities, denormals
+		uint64_t bits = rng();
+		double d;
+		std::memcpy(&d, &bits, sizeof(d));
+		return d;
+	}
+	case 1: return Random(1000) / 8.;
+	case 2: return (Random(2) ? -1 : 1) * std::ldexp(double(rng() >> 11), Random(200) - 100);
+	case 3: return 0.1 * Random(100);
+	case 4: return Random(2) ? -0. : std::numeric_limits<double>::denorm_min();
+	case 5: return Random(2) ? std::numeric_limits<double>::infinity() : -std::numeric_limits<double>::infinity();
+	case 6: return Random(2) ? std::numeric_limits<double>::quiet_NaN() : std::numeric_limits<double>::max();
+	default: return double(Random(100000)) / 7;
+	}
+}
+
+static JSON Value(int depth) {
+	switch (Random(depth > 3 ? 5 : 8)) {
+	case 0: return JSON::value(String());
+	case 1: return JSON::value((long long)rng());
+	case 2: return JSON::value(Float());
+	case 3: return JSON::value(Random(2) == 0);
+	case 4: return JSON();
+	case 5:
+	case 6: {
+		JSON res = JSON::array();
+		for (int n = Random(5); n > 0; --n) res(Value(depth + 1));
+		return res;
+	}
+	default: {
+		JSON res = JSON::object();
+		for (int n = Random(5); n > 0; --n) res(String(), Value(depth + 1));
+		return res;
+	}
+	}
+}
+
+//serialize, writer with a sink and writeToStream give the same text
+static void Compare(const JSON& value, int prettyDepth, int offset, const char* what) {
+	std::ostringstream stream;
+	value.writeToStream(stream, prettyDepth, offset);
+	std::string expected = stream.str();
+
+	std::ostringstream sink;
+	{
+		JSONWriter writer(sink);
+		writer.write(value, prettyDepth, offset);
+	}
+	std::string serialized = value.serialize(prettyDepth, offset);
+	if (serialized == expected && sink.str() == expected) return;
+
+	if (++failures <= 8) {
+		std::printf("mismatch: %s, pretty depth %d, offset %d\n", what, prettyDepth, offset);
+		std::printf(" stream: %.200s\n", expected.c_str());
+		std::printf(" writer: %.200s\n", (serialized != expected ? serialized : sink.str()).c_str());
+	}
+}
+
+static void CompareAll(const JSON& value, const char* what) {
+	for (int prettyDepth = -1; prettyDepth <= 3; ++prettyDepth) {
+		Compare(value, prettyDepth, 0, what);
+		Compare(value, prettyDepth, 3, what);
+	}
+	std::ostringstream stream;
+	stream << value;
+	if (stream.str() != value.serialize() && ++failures <= 8) std::printf("mismatch: %s, operator <<\n", what);
+}
+
+int main(int argc, char** argv) {
+	int count = argc > 1 ? std::atoi(argv[1]) : 20000;
+	rng.seed(argc > 2 ? unsigned(std::atoi(argv[2])) : 12345u);
+
+	//escapes: all bytes, alone and inside text
+	for (int c = 0; c < 256; ++c) {
+		std::string s(1, char(c));
+		CompareAll(JSON::value(s), "single byte");
+		CompareAll(JSON::value("a" + s + "b"), "byte inside text");
+		CompareAll(JSON::value("\xc2" + s), "byte after 0xc2");
+		JSON key = JSON::object();
+		key(s, JSON::value(c));
+		CompareAll(key, "byte in a key");
+	}
+
+	//non-finite and extreme floats, alone and in containers
+	const double floats[] = { std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::infinity(),
+		-std::numeric_limits<double>::infinity(), 0., -0., std::numeric_limits<double>::denorm_min(),
+		std::numeric_limits<double>::min(), std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(),
+		1e-300, 1e300, 0.1, 1. / 3, 123456789012345678. };
+	for (double d : floats) {
+		CompareAll(JSON::value(d), "float");
+		JSON array = JSON::array();
+		array(JSON::value(d))(JSON::value(-d));
+		CompareAll(array, "float in an array");
+	}
+
+	//empty containers and deep nesting
+	CompareAll(JSON::array(), "empty array");
+	CompareAll(JSON::object(), "empty object");
+	JSON deep = JSON::value(1);
+	for (int depth = 0; depth < 200; ++depth) {
+		JSON outer = depth % 2 ? JSON::array() : JSON::object();
+		if (depth % 2) outer(deep)(JSON::array());
+		else outer("level" + std::to_string(depth), deep)("empty", JSON::object());
+		deep = outer;
+	}
+	CompareAll(deep, "deep nesting");
+
+	//bigger than the buffer of the writer, which is flushed in blocks
+	JSON big = JSON::array();
+	for (int i = 0; i < 20000; ++i) big(Value(2));
+	CompareAll(big, "big document");
+
+	for (int i = 0; i < count; ++i) CompareAll(Value(0), "random tree");
+
+	if (!failures) std::printf("ok\n");
+	else std::printf("%d mismatches\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/*
+* color_roundtrip_test.cpp: RGB -> LUV -> RGB and YUV -> LUV -> YUV by CColorConverter
+* for all matrices and for 8-bit and 10-bit ranges. Rows are not a multiple of 4 samples,
+* so both SSE2 and scalar paths are checked. Prints the worst error and "ok".
+*/
+
+#include "../PluginBase/ColorConversion.h"
+
+#include <cstdio>
+#include <random>
+
+static int failures = 0;
+
+//worst |a - b| relative to the range of the component
+static double Compare(const CPlaneBuffer& a, const CPlaneBuffer& b, const RangeSpecification& range) {
+	double worst = 0;
+	for (int y = 0; y < a.Height(); ++y) {
+		for (int x = 0; x < a.Width(); ++x) {
+			worst = std::max(worst, std::fabs(double(a.Row(y)[x]) - b.Row(y)[x]) / (range.max - range.min));
+		}
+	}
+	return worst;
+}
+
+static void Check(double error, double limit, const char* what, int matrix, float max) {
+	std::printf("%s, matrix %d, max %g: %.2e\n", what, matrix, max, error);
+	if (error > limit) {
+		std::printf("failed: %s, limit %.2e\n", what, limit);
+		++failures;
+	}
+}
+
+int main() {
+	const int w = 67, h = 31;
+	std::mt19937 rng(5);
+
+	for (float max : { 255.f, 1023.f }) {
+		RangeSpecification ranges[IMetricImage::CC_LAST];
+		for (int i = 0; i < IMetricImage::CC_LAST; ++i) ranges[i] = RangeSpecification(0.f, max);
+		ranges[IMetricImage::LLUV] = RangeSpecification(0.f, 100.f);
+		std::uniform_real_distribution<float> value(0.f, max);
+
+		for (int m = YUV_BT601; m <= YUV_BT2020; ++m) {
+			CColorConverter converter(YUVMatrix(m), ranges);
+			CPlaneBuffer rgb[3], yuv[3], luv[3], back[3];
+			for (int c = 0; c < 3; ++c) {
+				rgb[c].Resize(w, h);
+				yuv[c].Resize(w, h);
+				luv[c].Resize(w, h);
+				back[c].Resize(w, h);
+			}
+			for (int y = 0; y < h; ++y) {
+				for (int x = 0; x < w; ++x) {
+					//corners of the gamut, grays and random colors
+					for (int c = 0; c < 3; ++c) {
+						float v = value(rng);
+						if (y == 0) v = (x >> c) & 1 ? max : 0.f;
+						if (y == 1) v = max * x / (w - 1);
+						rgb[c].Row(y)[x] = v;
+					}
+				}
+			}
+			int s = rgb[0].Stride();
+
+			converter.RGBtoLUV(rgb[0], rgb[1], rgb[2], luv[0].Row(0), luv[1].Row(0), luv[2].Row(0), s);
+			converter.LUVtoRGB(luv[0], luv[1], luv[2], back[0].Row(0), back[1].Row(0), back[2].Row(0), s);
+			double error = 0;
+			for (int c = 0; c < 3; ++c) error = std::max(error, Compare(rgb[c], back[c], ranges[IMetricImage::RRGB]));
+			Check(error, 1e-4, "RGB -> LUV -> RGB", m, max);
+
+			converter.RGBtoYUV(rgb[0], rgb[1], rgb[2], yuv[0].Row(0), yuv[1].Row(0), yuv[2].Row(0), s);
+			converter.YUVtoLUV(yuv[0], yuv[1], yuv[2], luv[0].Row(0), luv[1].Row(0), luv[2].Row(0), s);
+			converter.LUVtoYUV(luv[0], luv[1], luv[2], back[0].Row(0), back[1].Row(0), back[2].Row(0), s);
+			error = 0;
+			for (int c = 0; c < 3; ++c) error = std::max(error, Compare(yuv[c], back[c], ranges[IMetricImage::YYUV]));
+			Check(error, 1e-4, "YUV -> LUV -> YUV", m, max);
+		}
+	}
+
+	if (!failures) std::printf("ok\n");
+	return failures ? 1 : 0;
+}
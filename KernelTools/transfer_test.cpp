@@ -0,0 +1,73 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/*
+* transfer_test.cpp: EOTF, inverse EOTF and OETF of CTransferFunction against the exact
+* functions for PQ and HLG in both modes. The row is not a multiple of 4 samples, so both
+* SSE2 and scalar paths are checked. Prints the worst error and "ok".
+*/
+
+#include "../PluginBase/TransferFunction.h"
+
+#include <cstdio>
+#include <vector>
+
+static int failures = 0;
+
+static void Check(double error, double limit, const char* what, int curve, int mode) {
+	std::printf("%s, curve %d, mode %d: %.2e\n", what, curve, mode, error);
+	if (error > limit) {
+		std::printf("failed: %s, limit %.2e\n", what, limit);
+		++failures;
+	}
+}
+
+int main() {
+	const int n = 100003;
+	std::vector<float> signal(n), light(n), out(n);
+	for (int i = 0; i < n; ++i) {
+		signal[i] = float(i) / (n - 1);
+		//log-spaced light from 1e-7 to 1
+		light[i] = float(std::pow(10., -7. + 7. * i / (n - 1)));
+	}
+
+	for (int c = TRANSFER_PQ; c <= TRANSFER_HLG; ++c) {
+		for (int m = TRANSFER_LUT; m <= TRANSFER_POLYNOMIAL; ++m) {
+			TransferCurve curve = TransferCurve(c);
+			CTransferFunction transfer(curve, TransferMode(m));
+
+			transfer.ToLinear(signal.data(), out.data(), n);
+			double error = 0;
+			for (int i = 0; i < n; ++i) error = std::max(error, std::fabs(out[i] - CTransferFunction::EOTF(curve, signal[i])));
+			Check(error, 1e-4, "EOTF", c, m);
+
+			transfer.FromLinear(light.data(), out.data(), n);
+			error = 0;
+			for (int i = 0; i < n; ++i) error = std::max(error, std::fabs(out[i] - CTransferFunction::InverseEOTF(curve, light[i])));
+			Check(error, 1e-4, "inverse EOTF", c, m);
+
+			transfer.FromSceneLinear(light.data(), out.data(), n);
+			error = 0;
+			for (int i = 0; i < n; ++i) error = std::max(error, std::fabs(out[i] - CTransferFunction::OETF(curve, light[i])));
+			Check(error, 1e-4, "OETF", c, m);
+		}
+	}
+
+	//HLG OETF of the reference points of BT.2100
+	double points[][2] = { { 0., 0. }, { 1. / 12, 0.5 }, { 1., 1. } };
+	for (auto& p : points) {
+		Check(std::fabs(CTransferFunction::OETF(TRANSFER_HLG, p[0]) - p[1]), 1e-6, "HLG OETF point", TRANSFER_HLG, -1);
+	}
+
+	if (!failures) std::printf("ok\n");
+	return failures ? 1 : 0;
+}
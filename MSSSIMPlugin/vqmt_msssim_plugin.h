@@ -0,0 +1,231 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+#pragma once
+
+#include "../PluginBase/ICustomPlugin.h"
+#include "../PluginBase/json.h"
+#include "../PluginBase/ImagePlane.h"
+#include "../PluginBase/ThreadPool.h"
+#include "../PluginBase/Pyramid.h"
+#include "../PluginBase/SSIM.h"
+
+#include <memory>
+#include <cmath>
+#include <cstring>
+
+/*
+*	MS-SSIM plugin
+*	Multi-scale SSIM over 5 levels of 2:1 box-filtered pyramid (Wang, Simoncelli, Bovik 2003).
+*	Besides combined value, per-scale terms are reported: contrast-structure for scales 1-4
+*	and SSIM for scale 5.
+*/
+class VQMTmsssimPlugin : public ICustomPlugin
+{
+public:
+	static const int scales = 5;
+
+	void Init(IMetricImage::ColorComponent colorComp, int width, int height, int start_id, IMetricValueSink* sink) override {
+		this->width = width;
+		this->height = height;
+		this->output_id = start_id;
+		this->colorComp = colorComp;
+		this->sink = sink;
+
+		pool = std::make_unique<CThreadPool>(threads);
+		frames = 0;
+		sum = 0;
+		std::fill(sumScale, sumScale + scales, 0.);
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	Measure(std::vector<IMetricImage*> &images) override {
+		return MeasureFrame(images, nullptr);
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	MeasureAndVisualize(std::vector<IMetricImage*>&images, unsigned char *vis, int vis_pitch) override {
+		auto res = MeasureFrame(images, &map);
+
+		// SSIM map of the finest scale, black is 0 or less
+		int offset = (ssim.WindowSize() - 1) / 2;
+		int w = std::min(width, images[0]->GetWidth());
+		int h = std::min(height, images[0]->GetHeight());
+		for (int y = 0; y < h; ++y) {
+			unsigned char* out = vis + (size_t)y * vis_pitch;
+			if (map.Width() == 0) {
+				memset(out, (unsigned char)(std::min(1.f, std::max(0.f, res[0].second)) * 255.f + 0.5f), (size_t)w * 3);
+				continue;
+			}
+			const float* row = map.Row(std::min(map.Height() - 1, std::max(0, y - offset)));
+			for (int x = 0; x < w; ++x) {
+				float v = row[std::min(map.Width() - 1, std::max(0, x - offset))];
+				unsigned char c = (unsigned char)(std::min(1.f, std::max(0.f, v)) * 255.f + 0.5f);
+				out[x * 3 + 0] = c;
+				out[x * 3 + 1] = c;
+				out[x * 3 + 2] = c;
+			}
+		}
+
+		return res;
+	}
+
+	void Stop() override {
+		CPyramidCache::Clear();
+	}
+
+	std::vector<IDinfo>	MapIDToFrame(bool visualize) override {
+		std::vector<IDinfo> res = { { output_id, L"MS-SSIM" } };
+		for (int s = 0; s < scales; ++s) {
+			res.push_back({ output_id + 1 + s, L"scale " + std::to_wstring(s + 1) + (s + 1 < scales ? L" (cs)" : L" (ssim)") });
+		}
+		return res;
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> > CalculateAverage(bool visualize) override {
+		if (!frames) return {};
+		std::vector< std::pair <IMetricPlugin::ID, float> > res = { { output_id, float(sum / frames) } };
+		for (int s = 0; s < scales; ++s) {
+			res.push_back({ output_id + 1 + s, float(sumScale[s] / frames) });
+		}
+		return res;
+	}
+
+	int GetVideoNum(bool) override {
+		return 2;
+	}
+
+	std::vector <IMetricImage::ColorComponent> GetSupportedColorcomponents() override {
+		return {
+			IMetricImage::YYUV, IMetricImage::UYUV, IMetricImage::VYUV, IMetricImage::LLUV,
+			IMetricImage::RRGB, IMetricImage::GRGB, IMetricImage::BRGB
+		};
+	}
+
+	std::wstring GetName() override {
+		return L"msssim_sdk";
+	}
+	std::wstring GetInterfaceName() override {
+		return L"MS-SSIM (SDK)";
+	}
+	std::wstring GetLongName() override {
+		return L"Multi-scale structural similarity index";
+	}
+
+	std::wstring GetMetrInfoURL() override {
+		return L"http://compression.ru/video/";
+	}
+	std::wstring GetUnit() override {
+		return L"";
+	}
+
+	bool GetMetrIncline() override {
+		return true;
+	}
+
+	const std::wstring& GetConfigJSON() override {
+		static const std::wstring obj =
+		{
+			L"	{																		"
+			L"		\"threads\": {														"
+			L"			\"description\": \"Threads\",									"
+			L"			\"help\": \"Number of threads, 0 - number of cores\",			"
+			L"			\"default_value\": 0,											"
+			L"			\"possible_values\": [[0,64]]									"
+			L"		}																	"
+			L"	}																		"
+		};
+		return obj;
+	}
+
+	bool SetConfigParams(const std::wstring& json)  override {
+		try {
+			YUVsoft::JSON res = YUVsoft::ParseWrapper::parse(YUVsoft::utf16_to_utf8(json));
+			if (res.in("threads")) {
+				int t = (int)res["threads"].asInteger();
+				if (t < 0 || t > 64) return false;
+				if (t != threads && pool) pool = std::make_unique<CThreadPool>(t);
+				this->threads = t;
+			}
+
+			return true;
+		}
+		catch (...) {}
+
+		return false;
+	}
+
+	std::wstring GetConfigSummary() override {
+		std::wstringstream out;
+		out << "Threads: " << threads;
+		return out.str();
+	}
+
+private:
+	std::vector< std::pair <IMetricPlugin::ID, float> > MeasureFrame(std::vector<IMetricImage*>& images, CPlaneBuffer* outMap) {
+		static const double weights[scales] = { 0.0448, 0.2856, 0.3001, 0.2363, 0.1333 };
+
+		//pyramids are shared with other metrics of this module measuring the same frame
+		auto ref = CPyramidCache::Get(images[0], frames, colorComp, width, height, scales, PYR_BOX2);
+		auto dist = CPyramidCache::Get(images[1], frames, colorComp, width, height, scales, PYR_BOX2);
+		int levels = std::min(ref->Levels(), dist->Levels());
+		float peak = GetPeak(images[0]);
+
+		double values[scales];
+		double msssim = 1.;
+		for (int s = 0; s < scales; ++s) {
+			//too small image: missing scales are treated as identical
+			if (s >= levels) {
+				values[s] = 1.;
+				continue;
+			}
+			SSIMResult r = ssim.Compute(ref->Level(s), dist->Level(s), peak, pool.get(), s == 0 ? outMap : nullptr);
+			values[s] = s + 1 < scales ? r.cs : r.ssim;
+			msssim *= std::pow(std::max(0., values[s]), weights[s]);
+		}
+
+		sum += msssim;
+		for (int s = 0; s < scales; ++s) sumScale[s] += values[s];
+		++frames;
+
+		std::vector< std::pair <IMetricPlugin::ID, float> > res = { { output_id, float(msssim) } };
+		for (int s = 0; s < scales; ++s) {
+			res.push_back({ output_id + 1 + s, float(values[s]) });
+		}
+		return res;
+	}
+
+	float GetPeak(const IMetricImage* image) const {
+		const RangeSpecification* ranges = image->GetRanges();
+		if (ranges && ranges[colorComp].max > ranges[colorComp].min) {
+			return ranges[colorComp].max - ranges[colorComp].min;
+		}
+		return 255.f;
+	}
+
+private:
+	CSSIM ssim;
+	int threads = 0;
+
+	std::unique_ptr<CThreadPool> pool;
+	CPlaneBuffer map;
+
+	int width = 0;
+	int height = 0;
+	int output_id = 0;
+
+	double sum = 0;
+	double sumScale[scales] = {};
+	int frames = 0;
+
+	IMetricValueSink* sink = nullptr;
+
+	IMetricImage::ColorComponent colorComp = IMetricImage::YYUV;
+};
@@ -0,0 +1,224 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+#pragma once
+
+#include "../PluginBase/ICustomPlugin.h"
+#include "../PluginBase/json.h"
+#include "../PluginBase/ImagePlane.h"
+#include "../PluginBase/ThreadPool.h"
+#include "../PluginBase/Difference.h"
+
+#include <memory>
+
+/*
+*	PSNR plugin
+*	Full-reference PSNR, MSE and MAE of the selected color component.
+*	Only Init width x height area is measured, rows are processed by thread pool stripes.
+*/
+class VQMTpsnrPlugin : public ICustomPlugin
+{
+public:
+	void Init(IMetricImage::ColorComponent colorComp, int width, int height, int start_id, IMetricValueSink* sink) override {
+		this->width = width;
+		this->height = height;
+		this->id_psnr = start_id;
+		this->id_mse = start_id + 1;
+		this->id_mae = start_id + 2;
+		this->colorComp = colorComp;
+		this->sink = sink;
+
+		pool = std::make_unique<CThreadPool>(threads);
+		ResetStat();
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	Measure(std::vector<IMetricImage*> &images) override {
+		PlaneView ref = PlaneView::FromImage(images[0], colorComp, width, height);
+		PlaneView dist = PlaneView::FromImage(images[1], colorComp, width, height);
+
+		DiffStats stats = CDifference::Compute(ref, dist, pool.get());
+		double psnr = stats.PSNR(GetPeak(images[0]), maxPSNR);
+		double mse = stats.MSE();
+		double mae = stats.MAE();
+
+		sumPSNR += psnr;
+		sumMSE += mse;
+		sumMAE += mae;
+		++frames;
+
+		return {
+			{ id_psnr, float(psnr) },
+			{ id_mse, float(mse) },
+			{ id_mae, float(mae) }
+		};
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	MeasureAndVisualize(std::vector<IMetricImage*>&images, unsigned char *vis, int vis_pitch) override {
+		auto res = Measure(images);
+
+		// absolute difference, saturates at 1/8 of peak value
+		PlaneView ref = PlaneView::FromImage(images[0], colorComp, width, height);
+		PlaneView dist = PlaneView::FromImage(images[1], colorComp, width, height);
+		int w = std::min(ref.width, dist.width);
+		int h = std::min(ref.height, dist.height);
+		float scale = float(255. * 8. / GetPeak(images[0]));
+		pool->ParallelFor(h, [&](int y) {
+			const float* a = ref.Row(y);
+			const float* b = dist.Row(y);
+			unsigned char* out = vis + (size_t)y * vis_pitch;
+			for (int x = 0; x < w; ++x) {
+				float d = std::min(255.f, std::fabs(a[x] - b[x]) * scale);
+				unsigned char v = (unsigned char)(d + 0.5f);
+				out[x * 3 + 0] = v;
+				out[x * 3 + 1] = v;
+				out[x * 3 + 2] = v;
+			}
+		});
+
+		return res;
+	}
+
+	std::vector<IDinfo>	MapIDToFrame(bool visualize) override {
+		return {
+			{ id_psnr, L"PSNR" },
+			{ id_mse, L"MSE" },
+			{ id_mae, L"MAE" }
+		};
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> > CalculateAverage(bool visualize) override {
+		if (!frames) return {};
+		return {
+			{ id_psnr, float(sumPSNR / frames) },
+			{ id_mse, float(sumMSE / frames) },
+			{ id_mae, float(sumMAE / frames) }
+		};
+	}
+
+	int GetVideoNum(bool) override {
+		return 2;
+	}
+
+	std::vector <IMetricImage::ColorComponent> GetSupportedColorcomponents() override {
+		return {
+			IMetricImage::YYUV, IMetricImage::UYUV, IMetricImage::VYUV, IMetricImage::LLUV,
+			IMetricImage::RRGB, IMetricImage::GRGB, IMetricImage::BRGB
+		};
+	}
+
+	std::wstring GetName() override {
+		return L"psnr_sdk";
+	}
+	std::wstring GetInterfaceName() override {
+		return L"PSNR (SDK)";
+	}
+	std::wstring GetLongName() override {
+		return L"Peak signal-to-noise ratio, MSE and MAE";
+	}
+
+	std::wstring GetMetrInfoURL() override {
+		return L"http://compression.ru/video/";
+	}
+	std::wstring GetUnit() override {
+		return L"dB";
+	}
+
+	bool GetMetrIncline() override {
+		return true;
+	}
+
+	const std::wstring& GetConfigJSON() override {
+		static const std::wstring obj =
+		{
+			L"	{																		"
+			L"		\"threads\": {														"
+			L"			\"description\": \"Threads\",									"
+			L"			\"help\": \"Number of threads, 0 - number of cores\",			"
+			L"			\"default_value\": 0,											"
+			L"			\"possible_values\": [[0,64]]									"
+			L"		},																	"
+			L"		\"max_psnr\": {														"
+			L"			\"description\": \"PSNR of identical frames\",					"
+			L"			\"help\": \"Value reported when MSE is zero, dB\",				"
+			L"			\"default_value\": 100.0										"
+			L"		}																	"
+			L"	}																		"
+		};
+		return obj;
+	}
+
+	bool SetConfigParams(const std::wstring& json)  override {
+		try {
+			YUVsoft::JSON res = YUVsoft::ParseWrapper::parse(YUVsoft::utf16_to_utf8(json));
+			//all values are checked before any of them is applied
+			int t = threads;
+			double m = maxPSNR;
+			if (res.in("threads")) {
+				t = (int)res["threads"].asInteger();
+				if (t < 0 || t > 64) return false;
+			}
+			if (res.in("max_psnr")) {
+				m = res["max_psnr"].asFloat();
+			}
+
+			if (t != threads && pool) pool = std::make_unique<CThreadPool>(t);
+			this->threads = t;
+			this->maxPSNR = m;
+			return true;
+		}
+		catch (...) {}
+
+		return false;
+	}
+
+	std::wstring GetConfigSummary() override {
+		std::wstringstream out;
+		out << "Threads: " << threads << ", max PSNR: " << maxPSNR;
+		return out.str();
+	}
+
+private:
+	void ResetStat() {
+		sumPSNR = sumMSE = sumMAE = 0;
+		frames = 0;
+	}
+
+	double GetPeak(const IMetricImage* image) const {
+		const RangeSpecification* ranges = image->GetRanges();
+		if (ranges && ranges[colorComp].max > ranges[colorComp].min) {
+			return ranges[colorComp].max - ranges[colorComp].min;
+		}
+		return 255.;
+	}
+
+private:
+	int threads = 0;
+	double maxPSNR = 100.;
+
+	std::unique_ptr<CThreadPool> pool;
+
+	int width = 0;
+	int height = 0;
+
+	int id_psnr = 0;
+	int id_mse = 1;
+	int id_mae = 2;
+
+	double sumPSNR = 0;
+	double sumMSE = 0;
+	double sumMAE = 0;
+	int frames = 0;
+
+	IMetricValueSink* sink = nullptr;
+
+	IMetricImage::ColorComponent colorComp = IMetricImage::YYUV;
+};
@@ -0,0 +1,273 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file ADM.h
+*  \brief Detail loss measure (ADM, Li et al. 2011) in the form used by VMAF.
+*
+*	Every scale: one level of db2 wavelet transform of both planes, decoupling of
+*	distorted detail bands into restored (r = k * ref) and additive (t - r) parts,
+*	contrast sensitivity weighting by Watson's wavelet quantization model, contrast
+*	masking of restored part by additive part in 3x3 neighbourhood, and Minkowski
+*	(power 3) pooling over the frame without 10% border.
+*	Values are expected in [0, 255] range.
+*/
+
+#pragma once
+
+#include "Simd.h"
+#include "ImagePlane.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+struct ADMResult {
+	static const int maxScales = 4;
+
+	double num[maxScales] = {};
+	double den[maxScales] = {};
+	int scales = 0;
+
+	double Scale(int s) const { return den[s] > 0 ? num[s] / den[s] : 1.; }
+
+	double Score() const {
+		double n = 0, d = 0;
+		for (int s = 0; s < scales; ++s) {
+			n += num[s];
+			d += den[s];
+		}
+		return d > 0 ? n / d : 1.;
+	}
+};
+
+/*!\brief ADM of two planes
+*/
+class CADM {
+public:
+	/**
+	**************************************************************************
+	* \param viewDistance		[IN] - viewing distance in display heights
+	* \param displayHeight		[IN] - display height in pixels
+	*/
+	explicit CADM(double viewDistance = 3., double displayHeight = 1080.) {
+		for (int s = 0; s < ADMResult::maxScales; ++s) {
+			m_csf[s][0] = float(1. / QuantStep(s, 1, viewDistance, displayHeight));
+			m_csf[s][1] = float(1. / QuantStep(s, 3, viewDistance, displayHeight));
+			m_csf[s][2] = float(1. / QuantStep(s, 2, viewDistance, displayHeight));
+		}
+	}
+
+	ADMResult Compute(const PlaneView& ref, const PlaneView& dist, CThreadPool* pool = nullptr) {
+		ADMResult res;
+		PlaneView a = ref, b = dist;
+		for (int s = 0; s < ADMResult::maxScales; ++s) {
+			int width = std::min(a.width, b.width);
+			int height = std::min(a.height, b.height);
+			if (a.Empty() || b.Empty() || width < 4 || height < 4) break;
+
+			Scale& sc = m_scales[s];
+			Transform(a, width, height, sc.ref, pool);
+			Transform(b, width, height, sc.dist, pool);
+			Measure(s, sc, pool, res.num[s], res.den[s]);
+			res.scales = s + 1;
+
+			a = sc.ref[0];
+			b = sc.dist[0];
+		}
+		return res;
+	}
+
+private:
+	//fixed number of stripes keeps summation order (and result) independent of the pool size
+	static constexpr int stripeCount = 32;
+
+	//bands: approximation, horizontal, vertical, diagonal details
+	struct Scale {
+		CPlaneBuffer ref[4];
+		CPlaneBuffer dist[4];
+		CPlaneBuffer restored[3];
+		CPlaneBuffer additive;	//!< sum of absolute CSF-weighted additive impairments of 3 bands
+	};
+
+	//Watson et al., "Visibility of wavelet quantization noise", theta: 0 - LL, 1 - LH, 2 - HH, 3 - HL
+	static double QuantStep(int lambda, int theta, double viewDistance, double displayHeight) {
+		static const double amplitudes[6][4] = {
+			{ 0.62171,  0.67234,  0.72709,  0.67234  },
+			{ 0.34537,  0.41317,  0.49428,  0.41317  },
+			{ 0.18004,  0.22727,  0.28688,  0.22727  },
+			{ 0.091401, 0.11792,  0.15214,  0.11792  },
+			{ 0.045943, 0.059758, 0.077727, 0.059758 },
+			{ 0.023013, 0.030018, 0.039156, 0.030018 }
+		};
+		static const double g[4] = { 1.501, 1., 0.534, 1. };
+		const double a = 0.495, k = 0.466, f0 = 0.401;
+		double r = viewDistance * displayHeight * 3.14159265358979323846 / 180.;
+		double l = std::log10(std::pow(2., lambda + 1) * f0 * g[theta] / r);
+		return 2. * a * std::pow(10., k * l * l) / amplitudes[lambda][theta];
+	}
+
+	//whole-sample symmetric extension: -1 -> 1, n -> n - 2
+	static int Mirror(int i, int n) {
+		if (i < 0) return -i;
+		if (i >= n) return 2 * n - i - 2;
+		return i;
+	}
+
+	//one level of db2 transform, output bands are ((w + 1) / 2) x ((h + 1) / 2)
+	static void Transform(const PlaneView& src, int width, int height, CPlaneBuffer* bands, CThreadPool* pool) {
+		static const float lo[4] = { 0.482962913144690f, 0.836516303737469f, 0.224143868041857f, -0.129409522550921f };
+		static const float hi[4] = { -0.129409522550921f, -0.224143868041857f, 0.836516303737469f, -0.482962913144690f };
+
+		int bw = (width + 1) / 2, bh = (height + 1) / 2;
+		for (int i = 0; i < 4; ++i) bands[i].Resize(bw, bh);
+
+		int stripes = std::min(bh, stripeCount);
+		auto job = [&](int s) {
+			std::vector<float> tmp((size_t)2 * ((width + 3) & ~3));
+			float* tlo = tmp.data();
+			float* thi = tmp.data() + ((width + 3) & ~3);
+			int y0 = bh * s / stripes, y1 = bh * (s + 1) / stripes;
+			for (int y = y0; y < y1; ++y) {
+				const float* r[4];
+				for (int k = 0; k < 4; ++k) r[k] = src.Row(Mirror(2 * y - 1 + k, height));
+
+				int x = 0;
+#ifdef VQMT_SSE2
+				for (; x + 4 <= width; x += 4) {
+					__m128 s0 = _mm_loadu_ps(r[0] + x), s1 = _mm_loadu_ps(r[1] + x);
+					__m128 s2 = _mm_loadu_ps(r[2] + x), s3 = _mm_loadu_ps(r[3] + x);
+					__m128 l = _mm_add_ps(_mm_add_ps(_mm_mul_ps(s0, _mm_set1_ps(lo[0])), _mm_mul_ps(s1, _mm_set1_ps(lo[1]))),
+						_mm_add_ps(_mm_mul_ps(s2, _mm_set1_ps(lo[2])), _mm_mul_ps(s3, _mm_set1_ps(lo[3]))));
+					__m128 h = _mm_add_ps(_mm_add_ps(_mm_mul_ps(s0, _mm_set1_ps(hi[0])), _mm_mul_ps(s1, _mm_set1_ps(hi[1]))),
+						_mm_add_ps(_mm_mul_ps(s2, _mm_set1_ps(hi[2])), _mm_mul_ps(s3, _mm_set1_ps(hi[3]))));
+					_mm_storeu_ps(tlo + x, l);
+					_mm_storeu_ps(thi + x, h);
+				}
+#endif
+				for (; x < width; ++x) {
+					tlo[x] = lo[0] * r[0][x] + lo[1] * r[1][x] + lo[2] * r[2][x] + lo[3] * r[3][x];
+					thi[x] = hi[0] * r[0][x] + hi[1] * r[1][x] + hi[2] * r[2][x] + hi[3] * r[3][x];
+				}
+
+				float* ba = bands[0].Row(y);
+				float* bh_ = bands[1].Row(y);
+				float* bv = bands[2].Row(y);
+				float* bd = bands[3].Row(y);
+				for (int j = 0; j < bw; ++j) {
+					int i0 = Mirror(2 * j - 1, width), i1 = 2 * j, i2 = Mirror(2 * j + 1, width), i3 = Mirror(2 * j + 2, width);
+					ba[j] = lo[0] * tlo[i0] + lo[1] * tlo[i1] + lo[2] * tlo[i2] + lo[3] * tlo[i3];
+					bv[j] = hi[0] * tlo[i0] + hi[1] * tlo[i1] + hi[2] * tlo[i2] + hi[3] * tlo[i3];
+					bh_[j] = lo[0] * thi[i0] + lo[1] * thi[i1] + lo[2] * thi[i2] + lo[3] * thi[i3];
+					bd[j] = hi[0] * thi[i0] + hi[1] * thi[i1] + hi[2] * thi[i2] + hi[3] * thi[i3];
+				}
+			}
+		};
+		if (pool) pool->ParallelFor(stripes, job);
+		else for (int s = 0; s < stripes; ++s) job(s);
+	}
+
+	void Measure(int scale, Scale& sc, CThreadPool* pool, double& num, double& den) const {
+		int bw = sc.ref[0].Width(), bh = sc.ref[0].Height();
+		const float* csf = m_csf[scale];
+		for (int i = 0; i < 3; ++i) sc.restored[i].Resize(bw, bh);
+		sc.additive.Resize(bw, bh);
+
+		//decoupling and CSF weighting
+		const float cos1degSq = float(std::cos(3.14159265358979323846 / 180.) * std::cos(3.14159265358979323846 / 180.));
+		int stripes = std::min(bh, stripeCount);
+		auto decouple = [&](int s) {
+			int y0 = bh * s / stripes, y1 = bh * (s + 1) / stripes;
+			for (int y = y0; y < y1; ++y) {
+				const float* o[3] = { sc.ref[1].Row(y), sc.ref[2].Row(y), sc.ref[3].Row(y) };
+				const float* t[3] = { sc.dist[1].Row(y), sc.dist[2].Row(y), sc.dist[3].Row(y) };
+				float* r[3] = { sc.restored[0].Row(y), sc.restored[1].Row(y), sc.restored[2].Row(y) };
+				float* add = sc.additive.Row(y);
+				for (int x = 0; x < bw; ++x) {
+					float dot = o[0][x] * t[0][x] + o[1][x] * t[1][x];
+					float oMag = o[0][x] * o[0][x] + o[1][x] * o[1][x];
+					float tMag = t[0][x] * t[0][x] + t[1][x] * t[1][x];
+					//distorted detail has the same direction: it is treated as fully restored
+					bool sameAngle = dot >= 0 && dot * dot >= cos1degSq * oMag * tMag;
+					float sum = 0;
+					for (int b = 0; b < 3; ++b) {
+						float k = o[b][x] != 0 ? std::min(1.f, std::max(0.f, t[b][x] / o[b][x])) : 0.f;
+						float rst = sameAngle ? t[b][x] : k * o[b][x];
+						r[b][x] = rst * csf[b];
+						sum += std::fabs((t[b][x] - rst) * csf[b]);
+					}
+					add[x] = sum;
+				}
+			}
+		};
+		if (pool) pool->ParallelFor(stripes, decouple);
+		else for (int s = 0; s < stripes; ++s) decouple(s);
+
+		//contrast masking and pooling inside of the frame without border
+		int left = std::max(1, int(bw * borderFactor - 0.5));
+		int top = std::max(1, int(bh * borderFactor - 0.5));
+		int right = std::min(bw - 1, bw - left);
+		int bottom = std::min(bh - 1, bh - top);
+		if (right <= left || bottom <= top) {
+			num = den = 0;
+			return;
+		}
+
+		std::vector<double> numParts((size_t)stripes * 3, 0.), denParts((size_t)stripes * 3, 0.);
+		int rows = bottom - top;
+		int maskStripes = std::min(stripes, rows);
+		auto mask = [&](int s) {
+			int y0 = top + rows * s / maskStripes, y1 = top + rows * (s + 1) / maskStripes;
+			for (int y = y0; y < y1; ++y) {
+				const float* a0 = sc.additive.Row(y - 1);
+				const float* a1 = sc.additive.Row(y);
+				const float* a2 = sc.additive.Row(y + 1);
+				double n[3] = {}, d[3] = {};
+				for (int x = left; x < right; ++x) {
+					float thr = (a0[x - 1] + a0[x] + a0[x + 1] + a1[x - 1] + a1[x + 1] + a2[x - 1] + a2[x] + a2[x + 1]) * (1.f / 30) +
+						a1[x] * (1.f / 15);
+					for (int b = 0; b < 3; ++b) {
+						float v = std::max(0.f, std::fabs(sc.restored[b].Row(y)[x]) - thr);
+						n[b] += double(v) * v * v;
+						float o = std::fabs(sc.ref[b + 1].Row(y)[x] * csf[b]);
+						d[b] += double(o) * o * o;
+					}
+				}
+				for (int b = 0; b < 3; ++b) {
+					numParts[(size_t)s * 3 + b] += n[b];
+					denParts[(size_t)s * 3 + b] += d[b];
+				}
+			}
+		};
+		if (pool) pool->ParallelFor(maskStripes, mask);
+		else for (int s = 0; s < maskStripes; ++s) mask(s);
+
+		double area = std::cbrt(double(right - left) * (bottom - top) / 32.);
+		num = den = 0;
+		for (int b = 0; b < 3; ++b) {
+			double n = 0, d = 0;
+			for (int s = 0; s < maskStripes; ++s) {
+				n += numParts[(size_t)s * 3 + b];
+				d += denParts[(size_t)s * 3 + b];
+			}
+			num += std::cbrt(n) + area;
+			den += std::cbrt(d) + area;
+		}
+	}
+
+private:
+	static constexpr double borderFactor = 0.1;
+
+	float m_csf[ADMResult::maxScales][3];
+	Scale m_scales[ADMResult::maxScales];
+};
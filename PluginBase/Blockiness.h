@@ -0,0 +1,214 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file Blockiness.h
+*  \brief No-reference blocking and ringing measure for block-transform coded content.
+*
+*	One pass over the plane accumulates absolute differences of horizontal neighbours
+*	per column and of vertical neighbours per row. From these profiles the phase of the
+*	block grid is found (the phase with the biggest mean of boundary differences) and
+*	blockiness is the ratio of mean difference across block boundaries to mean
+*	difference inside of blocks (1 means no blocking).
+*	Ringing is optional: mean absolute second derivative of non-edge samples near
+*	strong edges, found along rows in the same pass.
+*/
+
+#pragma once
+
+#include "Simd.h"
+#include "ImagePlane.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+struct BlockinessParams {
+	int blockWidth = 8;
+	int blockHeight = 8;
+	int offsetX = -1;			//!< position of the first vertical boundary, -1 for detection
+	int offsetY = -1;			//!< position of the first horizontal boundary, -1 for detection
+	bool ringing = false;
+	float edgeThreshold = 0.2f;	//!< strong edge for ringing: central difference, part of peak
+	float flatThreshold = 0.05f;//!< samples with smaller central difference may contain ringing, part of peak
+	int ringingDistance = 4;	//!< ringing is searched within this distance from edges
+};
+
+struct BlockinessResult {
+	double horizontal = 1.;		//!< blockiness of vertical boundaries (along rows)
+	double vertical = 1.;		//!< blockiness of horizontal boundaries (along columns)
+	int phaseX = 0;
+	int phaseY = 0;
+	double ringing = 0.;		//!< mean |second derivative| near edges, in 8-bit units
+
+	double Blockiness() const { return (horizontal + vertical) * 0.5; }
+};
+
+/*!\brief Blocking and ringing of one plane
+*/
+class CBlockiness {
+public:
+	/**
+	**************************************************************************
+	* \param peak		[IN] - range of values, thresholds of params are relative to it
+	* \param pool		[IN] - optional pool, rows are split into stripes
+	*/
+	BlockinessResult Compute(const PlaneView& plane, const BlockinessParams& params, float peak, CThreadPool* pool = nullptr) {
+		BlockinessResult res;
+		if (plane.Empty() || plane.width < 2 || plane.height < 2) return res;
+
+		int w = plane.width, h = plane.height;
+		m_columns.assign(w, 0.);
+		m_rows.assign(h, 0.);
+
+		int stripes = std::min(h - 1, stripeCount);
+		std::vector<std::vector<float>> columnParts(stripes);
+		std::vector<double> ringSum(stripes, 0.);
+		std::vector<uint64_t> ringCount(stripes, 0);
+		auto job = [&](int s) {
+			std::vector<float>& cols = columnParts[s];
+			cols.assign((size_t)((w + 3) & ~3), 0.f);
+			std::vector<uint8_t> band(params.ringing ? w : 0);
+			int y0 = 1 + (h - 1) * s / stripes, y1 = 1 + (h - 1) * (s + 1) / stripes;
+			for (int y = y0; y < y1; ++y) {
+				m_rows[y] = Row(plane.Row(y), plane.Row(y - 1), w, cols.data());
+				if (params.ringing) Ringing(plane.Row(y), w, params, peak, band.data(), ringSum[s], ringCount[s]);
+			}
+		};
+		if (pool) pool->ParallelFor(stripes, job);
+		else for (int s = 0; s < stripes; ++s) job(s);
+
+		double ring = 0;
+		uint64_t ringN = 0;
+		for (int s = 0; s < stripes; ++s) {
+			for (int x = 0; x < w; ++x) m_columns[x] += columnParts[s][x];
+			ring += ringSum[s];
+			ringN += ringCount[s];
+		}
+
+		res.phaseX = params.offsetX >= 0 ? params.offsetX % params.blockWidth : DetectPhase(m_columns, params.blockWidth);
+		res.phaseY = params.offsetY >= 0 ? params.offsetY % params.blockHeight : DetectPhase(m_rows, params.blockHeight);
+		res.horizontal = Ratio(m_columns, params.blockWidth, res.phaseX);
+		res.vertical = Ratio(m_rows, params.blockHeight, res.phaseY);
+		res.ringing = ringN ? ring / double(ringN) * (255. / peak) : 0.;
+		return res;
+	}
+
+	//sum of |I(x) - I(x - 1)| over rows for every column x (0 for x = 0), valid after Compute()
+	const std::vector<double>& ColumnProfile() const { return m_columns; }
+	//sum of |I(y) - I(y - 1)| over columns for every row y, valid after Compute()
+	const std::vector<double>& RowProfile() const { return m_rows; }
+
+private:
+	static constexpr int stripeCount = 32;
+
+	//adds |row[x] - row[x - 1]| to cols[x], returns sum of |row[x] - up[x]|
+	static double Row(const float* row, const float* up, int w, float* cols) {
+		int x = 1;
+		double rowSum = 0;
+#ifdef VQMT_SSE2
+		__m128 acc = _mm_setzero_ps();
+		for (; x + 4 <= w; x += 4) {
+			__m128 cur = _mm_loadu_ps(row + x);
+			__m128 left = _mm_loadu_ps(row + x - 1);
+			_mm_storeu_ps(cols + x, _mm_add_ps(_mm_loadu_ps(cols + x), VQMTsimd::Abs(_mm_sub_ps(cur, left))));
+			acc = _mm_add_ps(acc, VQMTsimd::Abs(_mm_sub_ps(cur, _mm_loadu_ps(up + x))));
+		}
+		rowSum = VQMTsimd::HorizontalSum(acc);
+#endif
+		for (; x < w; ++x) {
+			cols[x] += std::fabs(row[x] - row[x - 1]);
+			rowSum += std::fabs(row[x] - up[x]);
+		}
+		return rowSum + std::fabs(row[0] - up[0]);
+	}
+
+	static void Ringing(const float* row, int w, const BlockinessParams& params, float peak, uint8_t* band, double& sum, uint64_t& count) {
+		float edge = params.edgeThreshold * peak;
+		float flat = params.flatThreshold * peak;
+		int r = params.ringingDistance;
+		bool any = false;
+
+		int x = 1;
+#ifdef VQMT_SSE2
+		const __m128 t = _mm_set1_ps(edge);
+		for (; x + 4 < w; x += 4) {
+			__m128 g = VQMTsimd::Abs(_mm_sub_ps(_mm_loadu_ps(row + x + 1), _mm_loadu_ps(row + x - 1)));
+			if (_mm_movemask_ps(_mm_cmpgt_ps(g, t))) {
+				if (!any) std::fill(band, band + w, 0);
+				any = true;
+				for (int k = 0; k < 4; ++k) {
+					if (std::fabs(row[x + k + 1] - row[x + k - 1]) > edge) {
+						std::fill(band + std::max(1, x + k - r), band + std::min(w - 1, x + k + r + 1), 1);
+					}
+				}
+			}
+		}
+#endif
+		for (; x < w - 1; ++x) {
+			if (std::fabs(row[x + 1] - row[x - 1]) > edge) {
+				if (!any) std::fill(band, band + w, 0);
+				any = true;
+				std::fill(band + std::max(1, x - r), band + std::min(w - 1, x + r + 1), 1);
+			}
+		}
+		if (!any) return;
+
+		for (x = 1; x < w - 1; ++x) {
+			if (!band[x] || std::fabs(row[x + 1] - row[x - 1]) > flat) continue;
+			sum += std::fabs(2 * row[x] - row[x - 1] - row[x + 1]);
+			count++;
+		}
+	}
+
+	static int DetectPhase(const std::vector<double>& profile, int block) {
+		if (block <= 1) return 0;
+		std::vector<double> means(block, 0.);
+		std::vector<int> counts(block, 0);
+		for (size_t i = 1; i < profile.size(); ++i) {
+			means[i % block] += profile[i];
+			counts[i % block]++;
+		}
+		//phase 0 has no boundary at i = 0, so phases are compared by means, not by sums
+		for (int p = 0; p < block; ++p) {
+			if (counts[p]) means[p] /= counts[p];
+		}
+		return int(std::max_element(means.begin(), means.end()) - means.begin());
+	}
+
+	static double Ratio(const std::vector<double>& profile, int block, int phase) {
+		if (block <= 1) return 1.;
+		double boundary = 0, inside = 0;
+		uint64_t nb = 0, ni = 0;
+		for (size_t i = 1; i < profile.size(); ++i) {
+			if (int(i % block) == phase) {
+				boundary += profile[i];
+				nb++;
+			}
+			else {
+				inside += profile[i];
+				ni++;
+			}
+		}
+		if (!nb || !ni) return 1.;
+		inside /= double(ni);
+		boundary /= double(nb);
+		if (inside <= 0) return boundary > 0 ? 100. : 1.;
+		return boundary / inside;
+	}
+
+private:
+	std::vector<double> m_columns;
+	std::vector<double> m_rows;
+};
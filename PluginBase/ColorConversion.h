@@ -0,0 +1,532 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file ColorConversion.h
+*  \brief Conversions between RGB, YUV (BT.601/709/2020) and LUV planes of IMetricImage.
+*
+*	Component ranges (IMetricImage::GetRanges()) are folded into the conversion
+*	matrices, so RGB <-> YUV is one 3x3 affine transform per pixel. When only one
+*	component is needed (ConvertComponent), only one row of the matrix is evaluated.
+*	LUV path linearizes RGB (sRGB curve) with an interpolated table and computes the
+*	cube root of L* with Newton iterations instead of pow(). The inverse LUV path cubes
+*	L* and encodes linear RGB with another interpolated table.
+*/
+
+#pragma once
+
+#include "Simd.h"
+#include "ImagePlane.h"
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+enum YUVMatrix {
+	YUV_BT601 = 0,
+	YUV_BT709 = 1,
+	YUV_BT2020 = 2
+};
+
+/*!\brief Converts between color spaces of IMetricImage
+*
+*	RGB, Y, U, V values are interpreted relatively to the ranges of the components:
+*	R, G, B, Y - [min, max] maps to [0, 1], U, V - center of the range is zero chroma.
+*	LUV is produced in CIE units (L* in [0, 100]) with D65 white point; ConvertComponent()
+*	maps L* to the range of LLUV component.
+*/
+class CColorConverter {
+public:
+	/**
+	**************************************************************************
+	* \param matrix		[IN] - YUV matrix, also selects RGB primaries for LUV (BT.709 for 601/709, BT.2020 for 2020)
+	* \param ranges		[IN] - IMetricImage::CC_LAST ranges as returned by GetRanges(), nullptr for 8-bit defaults
+	*/
+	CColorConverter(YUVMatrix matrix = YUV_BT709, const RangeSpecification* ranges = nullptr) {
+		Init(matrix, ranges);
+	}
+
+	void Init(YUVMatrix matrix, const RangeSpecification* ranges) {
+		m_matrix = matrix;
+		for (int i = 0; i < IMetricImage::CC_LAST; ++i) {
+			m_ranges[i] = ranges ? ranges[i] : RangeSpecification(0.f, 255.f);
+			if (!(m_ranges[i].max > m_ranges[i].min)) m_ranges[i] = RangeSpecification(0.f, 255.f);
+		}
+
+		double kr, kb;
+		switch (matrix) {
+		case YUV_BT601:  kr = 0.299;  kb = 0.114;  break;
+		case YUV_BT2020: kr = 0.2627; kb = 0.0593; break;
+		default:         kr = 0.2126; kb = 0.0722; break;
+		}
+		double kg = 1 - kr - kb;
+
+		//normalized: y = kr r + kg g + kb b, u = (b - y) / (2 (1 - kb)), v = (r - y) / (2 (1 - kr))
+		double toYUV[3][3] = {
+			{ kr, kg, kb },
+			{ -kr / (2 * (1 - kb)), -kg / (2 * (1 - kb)), 0.5 },
+			{ 0.5, -kg / (2 * (1 - kr)), -kb / (2 * (1 - kr)) }
+		};
+		double toRGB[3][3] = {
+			{ 1, 0, 2 * (1 - kr) },
+			{ 1, -2 * (1 - kb) * kb / kg, -2 * (1 - kr) * kr / kg },
+			{ 1, 2 * (1 - kb), 0 }
+		};
+
+		const IMetricImage::ColorComponent rgb[3] = { IMetricImage::RRGB, IMetricImage::GRGB, IMetricImage::BRGB };
+		const IMetricImage::ColorComponent yuv[3] = { IMetricImage::YYUV, IMetricImage::UYUV, IMetricImage::VYUV };
+		FoldRanges(toYUV, rgb, yuv, m_rgbToYuv);
+		FoldRanges(toRGB, yuv, rgb, m_yuvToRgb);
+
+		static const double xyz709[3][3] = {
+			{ 0.4123908, 0.3575843, 0.1804808 },
+			{ 0.2126390, 0.7151687, 0.0721923 },
+			{ 0.0193308, 0.1191948, 0.9505322 }
+		};
+		static const double xyz2020[3][3] = {
+			{ 0.6369580, 0.1446169, 0.1688810 },
+			{ 0.2627002, 0.6779981, 0.0593017 },
+			{ 0.0000000, 0.0280727, 1.0609851 }
+		};
+		const double (*xyz)[3] = matrix == YUV_BT2020 ? xyz2020 : xyz709;
+		for (int i = 0; i < 3; ++i) {
+			for (int j = 0; j < 3; ++j) m_rgbToXyz[i][j] = float(xyz[i][j]);
+		}
+		double det = xyz[0][0] * (xyz[1][1] * xyz[2][2] - xyz[1][2] * xyz[2][1])
+			- xyz[0][1] * (xyz[1][0] * xyz[2][2] - xyz[1][2] * xyz[2][0])
+			+ xyz[0][2] * (xyz[1][0] * xyz[2][1] - xyz[1][1] * xyz[2][0]);
+		for (int i = 0; i < 3; ++i) {
+			for (int j = 0; j < 3; ++j) {
+				//cofactor of (j, i)
+				int r0 = (j + 1) % 3, r1 = (j + 2) % 3, c0 = (i + 1) % 3, c1 = (i + 2) % 3;
+				m_xyzToRgb[i][j] = float((xyz[r0][c0] * xyz[r1][c1] - xyz[r0][c1] * xyz[r1][c0]) / det);
+			}
+		}
+
+		//linearization table over normalized [0, 1] and its inverse over linear [0, 1]
+		for (int i = 0; i <= lutSize; ++i) {
+			double c = double(i) / lutSize;
+			m_linearLut[i] = float(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+			m_encodeLut[i] = float(c <= 0.0031308 ? c * 12.92 : 1.055 * std::pow(c, 1 / 2.4) - 0.055);
+		}
+		for (int i = 0; i < 3; ++i) {
+			const RangeSpecification& r = m_ranges[rgb[i]];
+			m_rgbScale[i] = 1.f / (r.max - r.min);
+			m_rgbOffset[i] = -r.min / (r.max - r.min);
+		}
+	}
+
+	YUVMatrix GetMatrix() const { return m_matrix; }
+
+	//all planes have width x height samples, dst planes use dstStride
+	void RGBtoYUV(const PlaneView& r, const PlaneView& g, const PlaneView& b, float* y, float* u, float* v, int dstStride) const {
+		float* dst[3] = { y, u, v };
+		for (int row = 0; row < r.height; ++row) {
+			for (int c = 0; c < 3; ++c) {
+				if (dst[c]) Affine(m_rgbToYuv[c], r.Row(row), g.Row(row), b.Row(row), dst[c] + (size_t)row * dstStride, r.width);
+			}
+		}
+	}
+
+	void YUVtoRGB(const PlaneView& y, const PlaneView& u, const PlaneView& v, float* r, float* g, float* b, int dstStride) const {
+		float* dst[3] = { r, g, b };
+		for (int row = 0; row < y.height; ++row) {
+			for (int c = 0; c < 3; ++c) {
+				if (dst[c]) Affine(m_yuvToRgb[c], y.Row(row), u.Row(row), v.Row(row), dst[c] + (size_t)row * dstStride, y.width);
+			}
+		}
+	}
+
+	/**
+	**************************************************************************
+	* \brief RGB to CIE L*u*v*, any of l, u, v can be nullptr
+	*/
+	void RGBtoLUV(const PlaneView& r, const PlaneView& g, const PlaneView& b, float* l, float* u, float* v, int dstStride) const {
+		std::vector<float> tmp((size_t)r.width * 3);
+		for (int row = 0; row < r.height; ++row) {
+			LinearRGBRow(r.Row(row), g.Row(row), b.Row(row), tmp.data(), r.width);
+			LUVRow(tmp.data(), r.width,
+				l ? l + (size_t)row * dstStride : nullptr,
+				u ? u + (size_t)row * dstStride : nullptr,
+				v ? v + (size_t)row * dstStride : nullptr);
+		}
+	}
+
+	void YUVtoLUV(const PlaneView& y, const PlaneView& u, const PlaneView& v, float* l, float* lu, float* lv, int dstStride) const {
+		std::vector<float> rgb((size_t)y.width * 3), tmp((size_t)y.width * 3);
+		for (int row = 0; row < y.height; ++row) {
+			for (int c = 0; c < 3; ++c) {
+				Affine(m_yuvToRgb[c], y.Row(row), u.Row(row), v.Row(row), rgb.data() + (size_t)c * y.width, y.width);
+			}
+			LinearRGBRow(rgb.data(), rgb.data() + y.width, rgb.data() + 2 * y.width, tmp.data(), y.width);
+			LUVRow(tmp.data(), y.width,
+				l ? l + (size_t)row * dstStride : nullptr,
+				lu ? lu + (size_t)row * dstStride : nullptr,
+				lv ? lv + (size_t)row * dstStride : nullptr);
+		}
+	}
+
+	/**
+	**************************************************************************
+	* \brief CIE L*u*v* (as produced by RGBtoLUV) to RGB, any of r, g, b can be nullptr
+	*
+	*	Colors out of the RGB gamut are clipped to the range of the components.
+	*/
+	void LUVtoRGB(const PlaneView& l, const PlaneView& u, const PlaneView& v, float* r, float* g, float* b, int dstStride) const {
+		float* dst[3] = { r, g, b };
+		std::vector<float> lin((size_t)l.width * 3);
+		for (int row = 0; row < l.height; ++row) {
+			InverseLUVRow(l.Row(row), u.Row(row), v.Row(row), lin.data(), l.width);
+			for (int c = 0; c < 3; ++c) {
+				if (dst[c]) EncodeRow(lin.data() + (size_t)c * l.width, c, dst[c] + (size_t)row * dstStride, l.width);
+			}
+		}
+	}
+
+	void LUVtoYUV(const PlaneView& l, const PlaneView& lu, const PlaneView& lv, float* y, float* u, float* v, int dstStride) const {
+		float* dst[3] = { y, u, v };
+		std::vector<float> lin((size_t)l.width * 3), rgb((size_t)l.width * 3);
+		for (int row = 0; row < l.height; ++row) {
+			InverseLUVRow(l.Row(row), lu.Row(row), lv.Row(row), lin.data(), l.width);
+			for (int c = 0; c < 3; ++c) EncodeRow(lin.data() + (size_t)c * l.width, c, rgb.data() + (size_t)c * l.width, l.width);
+			for (int c = 0; c < 3; ++c) {
+				if (dst[c]) Affine(m_rgbToYuv[c], rgb.data(), rgb.data() + l.width, rgb.data() + 2 * l.width, dst[c] + (size_t)row * dstStride, l.width);
+			}
+		}
+	}
+
+	/**
+	**************************************************************************
+	* \brief Returns component cc of the image, converting it from other planes if it is absent
+	*
+	*	Only the requested component is computed. If the image has the plane, no copy is made.
+	*	U and V are treated as YUV chroma.
+	* \param scratch		[IN, OUT] - buffer for converted plane, returned view may point to it
+	* \return view of the component or empty view if it can't be produced
+	*/
+	PlaneView ConvertComponent(const IMetricImage* image, IMetricImage::ColorComponent cc, int width, int height, CPlaneBuffer& scratch) const {
+		PlaneView direct = PlaneView::FromImage(image, cc, width, height);
+		if (!direct.Empty()) return direct;
+		if (!image) return PlaneView();
+
+		PlaneView r = PlaneView::FromImage(image, IMetricImage::RRGB, width, height);
+		PlaneView g = PlaneView::FromImage(image, IMetricImage::GRGB, width, height);
+		PlaneView b = PlaneView::FromImage(image, IMetricImage::BRGB, width, height);
+		PlaneView y = PlaneView::FromImage(image, IMetricImage::YYUV, width, height);
+		PlaneView u = PlaneView::FromImage(image, IMetricImage::UYUV, width, height);
+		PlaneView v = PlaneView::FromImage(image, IMetricImage::VYUV, width, height);
+		bool hasRGB = !r.Empty() && !g.Empty() && !b.Empty();
+		bool hasYUV = !y.Empty() && !u.Empty() && !v.Empty();
+
+		int w = hasRGB ? r.width : y.width;
+		int h = hasRGB ? r.height : y.height;
+		switch (cc) {
+		case IMetricImage::YYUV:
+		case IMetricImage::UYUV:
+		case IMetricImage::VYUV:
+			if (!hasRGB) return PlaneView();
+			scratch.Resize(w, h);
+			for (int row = 0; row < h; ++row) {
+				Affine(m_rgbToYuv[cc - IMetricImage::YYUV], r.Row(row), g.Row(row), b.Row(row), scratch.Row(row), w);
+			}
+			return scratch.View();
+		case IMetricImage::RRGB:
+		case IMetricImage::GRGB:
+		case IMetricImage::BRGB:
+			if (!hasYUV) return PlaneView();
+			scratch.Resize(w, h);
+			for (int row = 0; row < h; ++row) {
+				Affine(m_yuvToRgb[cc - IMetricImage::RRGB], y.Row(row), u.Row(row), v.Row(row), scratch.Row(row), w);
+			}
+			return scratch.View();
+		case IMetricImage::LLUV: {
+			if (!hasRGB && !hasYUV) return PlaneView();
+			scratch.Resize(w, h);
+			std::vector<float> rgb(hasRGB ? 0 : (size_t)w * 3), lin((size_t)w * 3);
+			const RangeSpecification& lr = m_ranges[IMetricImage::LLUV];
+			for (int row = 0; row < h; ++row) {
+				if (hasRGB) {
+					LinearRGBRow(r.Row(row), g.Row(row), b.Row(row), lin.data(), w);
+				}
+				else {
+					for (int c = 0; c < 3; ++c) {
+						Affine(m_yuvToRgb[c], y.Row(row), u.Row(row), v.Row(row), rgb.data() + (size_t)c * w, w);
+					}
+					LinearRGBRow(rgb.data(), rgb.data() + w, rgb.data() + 2 * w, lin.data(), w);
+				}
+				float* dst = scratch.Row(row);
+				LUVRow(lin.data(), w, dst, nullptr, nullptr);
+				float scale = (lr.max - lr.min) / 100.f;
+				for (int x = 0; x < w; ++x) dst[x] = lr.min + dst[x] * scale;
+			}
+			return scratch.View();
+		}
+		default:
+			return PlaneView();
+		}
+	}
+
+	/**
+	**************************************************************************
+	* \brief Finds planes for LinearRow(): RGB planes of the image or, if they are absent, YUV ones
+	* \return false if the image has neither
+	*/
+	static bool GetLinearSource(const IMetricImage* image, int width, int height, PlaneView planes[3], bool& yuv) {
+		const IMetricImage::ColorComponent rgb[3] = { IMetricImage::RRGB, IMetricImage::GRGB, IMetricImage::BRGB };
+		const IMetricImage::ColorComponent yuvc[3] = { IMetricImage::YYUV, IMetricImage::UYUV, IMetricImage::VYUV };
+		for (int pass = 0; pass < 2; ++pass) {
+			bool ok = true;
+			for (int c = 0; c < 3; ++c) {
+				planes[c] = PlaneView::FromImage(image, pass ? yuvc[c] : rgb[c], width, height);
+				ok = ok && !planes[c].Empty();
+			}
+			if (ok) {
+				yuv = pass == 1;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+	**************************************************************************
+	* \brief Linear-light RGB of one row, dst = r[width] g[width] b[width]
+	* \param scratch		[IN, OUT] - 3 * width floats, used for YUV source
+	*/
+	void LinearRow(const PlaneView planes[3], bool yuv, int row, float* dst, float* scratch) const {
+		int w = planes[0].width;
+		if (!yuv) {
+			LinearRGBRow(planes[0].Row(row), planes[1].Row(row), planes[2].Row(row), dst, w);
+			return;
+		}
+		for (int c = 0; c < 3; ++c) {
+			Affine(m_yuvToRgb[c], planes[0].Row(row), planes[1].Row(row), planes[2].Row(row), scratch + (size_t)c * w, w);
+		}
+		LinearRGBRow(scratch, scratch + w, scratch + 2 * w, dst, w);
+	}
+
+	//linear RGB to CIE XYZ of the primaries of the matrix
+	float RGBtoXYZ(int i, int j) const { return m_rgbToXyz[i][j]; }
+
+private:
+	static const int lutSize = 4096;
+
+	struct AffineRow {
+		float m[3];
+		float offset;
+	};
+
+	//folds input normalization and output denormalization into normalized matrix
+	void FoldRanges(const double norm[3][3], const IMetricImage::ColorComponent* in, const IMetricImage::ColorComponent* out, AffineRow* res) const {
+		double inScale[3], inOffset[3];
+		for (int j = 0; j < 3; ++j) {
+			const RangeSpecification& r = m_ranges[in[j]];
+			bool chroma = in[j] == IMetricImage::UYUV || in[j] == IMetricImage::VYUV;
+			double zero = chroma ? (r.min + r.max) * 0.5 : r.min;
+			inScale[j] = 1. / (r.max - r.min);
+			inOffset[j] = -zero * inScale[j];
+		}
+		for (int i = 0; i < 3; ++i) {
+			const RangeSpecification& r = m_ranges[out[i]];
+			bool chroma = out[i] == IMetricImage::UYUV || out[i] == IMetricImage::VYUV;
+			double zero = chroma ? (r.min + r.max) * 0.5 : r.min;
+			double scale = r.max - r.min;
+			double offset = zero;
+			for (int j = 0; j < 3; ++j) {
+				res[i].m[j] = float(norm[i][j] * inScale[j] * scale);
+				offset += norm[i][j] * inOffset[j] * scale;
+			}
+			res[i].offset = float(offset);
+		}
+	}
+
+	static void Affine(const AffineRow& a, const float* p0, const float* p1, const float* p2, float* dst, int width) {
+		int x = 0;
+#ifdef VQMT_SSE2
+		const __m128 m0 = _mm_set1_ps(a.m[0]), m1 = _mm_set1_ps(a.m[1]), m2 = _mm_set1_ps(a.m[2]), o = _mm_set1_ps(a.offset);
+		for (; x + 4 <= width; x += 4) {
+			__m128 acc = _mm_add_ps(o, _mm_mul_ps(_mm_loadu_ps(p0 + x), m0));
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(p1 + x), m1));
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(p2 + x), m2));
+			_mm_storeu_ps(dst + x, acc);
+		}
+#endif
+		for (; x < width; ++x) dst[x] = a.offset + p0[x] * a.m[0] + p1[x] * a.m[1] + p2[x] * a.m[2];
+	}
+
+	//normalizes one channel and linearizes it with the table, result to dst
+	void LinearizeRow(const float* src, int channel, float* dst, int width) const {
+		Interpolate(m_linearLut, m_rgbScale[channel] * lutSize, m_rgbOffset[channel] * lutSize, 1.f, 0.f, src, dst, width);
+	}
+
+	//encodes one linear channel with the table and maps it to the range of the component
+	void EncodeRow(const float* src, int channel, float* dst, int width) const {
+		Interpolate(m_encodeLut, float(lutSize), 0.f, 1.f / m_rgbScale[channel], -m_rgbOffset[channel] / m_rgbScale[channel], src, dst, width);
+	}
+
+	//dst = lut(src * scale + offset) * outScale + outOffset, lut argument is clamped to [0, lutSize]
+	static void Interpolate(const float* lut, float scale, float offset, float outScale, float outOffset, const float* src, float* dst, int width) {
+		int x = 0;
+#ifdef VQMT_SSE2
+		const __m128 s = _mm_set1_ps(scale), o = _mm_set1_ps(offset);
+		const __m128 os = _mm_set1_ps(outScale), oo = _mm_set1_ps(outOffset);
+		const __m128 zero = _mm_setzero_ps(), top = _mm_set1_ps(float(lutSize) - 1e-3f);
+		for (; x + 4 <= width; x += 4) {
+			__m128 f = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + x), s), o);
+			f = _mm_min_ps(_mm_max_ps(f, zero), top);
+			__m128i i = _mm_cvttps_epi32(f);
+			__m128 res = VQMTsimd::Gather(lut, i, _mm_sub_ps(f, _mm_cvtepi32_ps(i)));
+			_mm_storeu_ps(dst + x, _mm_add_ps(_mm_mul_ps(res, os), oo));
+		}
+#endif
+		for (; x < width; ++x) {
+			float f = std::min(std::max(src[x] * scale + offset, 0.f), float(lutSize) - 1e-3f);
+			int i = int(f);
+			dst[x] = (lut[i] + (f - i) * (lut[i + 1] - lut[i])) * outScale + outOffset;
+		}
+	}
+
+	//dst = r[width] g[width] b[width] in linear light
+	void LinearRGBRow(const float* r, const float* g, const float* b, float* dst, int width) const {
+		LinearizeRow(r, 0, dst, width);
+		LinearizeRow(g, 1, dst + width, width);
+		LinearizeRow(b, 2, dst + 2 * width, width);
+	}
+
+	void LUVRow(const float* lin, int width, float* l, float* u, float* v) const {
+		const float* r = lin;
+		const float* g = lin + width;
+		const float* b = lin + 2 * width;
+		const float* mx = m_rgbToXyz[0];
+		const float* my = m_rgbToXyz[1];
+		const float* mz = m_rgbToXyz[2];
+
+		//D65
+		const float un = 0.19783000664283f, vn = 0.46831999493879f;
+		const float eps = 216.f / 24389.f, kappa = 24389.f / 27.f;
+
+		int x = 0;
+#ifdef VQMT_SSE2
+		const __m128 vEps = _mm_set1_ps(eps), vKappa = _mm_set1_ps(kappa);
+		for (; x + 4 <= width; x += 4) {
+			__m128 vr = _mm_loadu_ps(r + x), vg = _mm_loadu_ps(g + x), vb = _mm_loadu_ps(b + x);
+			__m128 Y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vr, _mm_set1_ps(my[0])), _mm_mul_ps(vg, _mm_set1_ps(my[1]))), _mm_mul_ps(vb, _mm_set1_ps(my[2])));
+
+			//Y is clamped to avoid division by zero
+			__m128 c = VQMTsimd::CubeRoot(_mm_max_ps(Y, vEps));
+
+			__m128 lCube = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(116.f), c), _mm_set1_ps(16.f));
+			__m128 lLin = _mm_mul_ps(vKappa, Y);
+			__m128 useCube = _mm_cmpgt_ps(Y, vEps);
+			__m128 L = _mm_or_ps(_mm_and_ps(useCube, lCube), _mm_andnot_ps(useCube, lLin));
+			if (l) _mm_storeu_ps(l + x, L);
+
+			if (u || v) {
+				__m128 X = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vr, _mm_set1_ps(mx[0])), _mm_mul_ps(vg, _mm_set1_ps(mx[1]))), _mm_mul_ps(vb, _mm_set1_ps(mx[2])));
+				__m128 Z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vr, _mm_set1_ps(mz[0])), _mm_mul_ps(vg, _mm_set1_ps(mz[1]))), _mm_mul_ps(vb, _mm_set1_ps(mz[2])));
+				__m128 den = _mm_add_ps(_mm_add_ps(X, _mm_mul_ps(_mm_set1_ps(15.f), Y)), _mm_mul_ps(_mm_set1_ps(3.f), Z));
+				__m128 valid = _mm_cmpgt_ps(den, _mm_set1_ps(1e-12f));
+				__m128 inv = _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.f), _mm_max_ps(den, _mm_set1_ps(1e-12f))));
+				__m128 l13 = _mm_mul_ps(_mm_set1_ps(13.f), L);
+				__m128 up = _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(4.f), X), inv)), _mm_andnot_ps(valid, _mm_set1_ps(un)));
+				__m128 vp = _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(9.f), Y), inv)), _mm_andnot_ps(valid, _mm_set1_ps(vn)));
+				if (u) _mm_storeu_ps(u + x, _mm_mul_ps(l13, _mm_sub_ps(up, _mm_set1_ps(un))));
+				if (v) _mm_storeu_ps(v + x, _mm_mul_ps(l13, _mm_sub_ps(vp, _mm_set1_ps(vn))));
+			}
+		}
+#endif
+		for (; x < width; ++x) {
+			float Y = my[0] * r[x] + my[1] * g[x] + my[2] * b[x];
+			float L = Y > eps ? 116.f * VQMTsimd::CubeRoot(Y) - 16.f : kappa * Y;
+			if (l) l[x] = L;
+			if (u || v) {
+				float X = mx[0] * r[x] + mx[1] * g[x] + mx[2] * b[x];
+				float Z = mz[0] * r[x] + mz[1] * g[x] + mz[2] * b[x];
+				float den = X + 15.f * Y + 3.f * Z;
+				float up = den > 1e-12f ? 4.f * X / den : un;
+				float vp = den > 1e-12f ? 9.f * Y / den : vn;
+				if (u) u[x] = 13.f * L * (up - un);
+				if (v) v[x] = 13.f * L * (vp - vn);
+			}
+		}
+	}
+
+	//lin = r[width] g[width] b[width] in linear light of CIE L*u*v*
+	void InverseLUVRow(const float* l, const float* u, const float* v, float* lin, int width) const {
+		float* r = lin;
+		float* g = lin + width;
+		float* b = lin + 2 * width;
+		const float* mr = m_xyzToRgb[0];
+		const float* mg = m_xyzToRgb[1];
+		const float* mb = m_xyzToRgb[2];
+
+		//D65
+		const float un = 0.19783000664283f, vn = 0.46831999493879f;
+		const float kappa = 24389.f / 27.f;
+
+		int x = 0;
+#ifdef VQMT_SSE2
+		const __m128 zero = _mm_setzero_ps(), tiny = _mm_set1_ps(1e-12f);
+		for (; x + 4 <= width; x += 4) {
+			__m128 L = _mm_max_ps(_mm_loadu_ps(l + x), zero);
+			__m128 c = _mm_mul_ps(_mm_add_ps(L, _mm_set1_ps(16.f)), _mm_set1_ps(1.f / 116.f));
+			__m128 yCube = _mm_mul_ps(_mm_mul_ps(c, c), c);
+			__m128 yLin = _mm_mul_ps(L, _mm_set1_ps(1.f / kappa));
+			__m128 useCube = _mm_cmpgt_ps(L, _mm_set1_ps(8.f));
+			__m128 Y = _mm_or_ps(_mm_and_ps(useCube, yCube), _mm_andnot_ps(useCube, yLin));
+
+			//u' and v' are not defined for black
+			__m128 l13 = _mm_mul_ps(_mm_set1_ps(13.f), L);
+			__m128 inv = _mm_and_ps(_mm_cmpgt_ps(l13, tiny), _mm_div_ps(_mm_set1_ps(1.f), _mm_max_ps(l13, tiny)));
+			__m128 up = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(u + x), inv), _mm_set1_ps(un));
+			__m128 vp = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(v + x), inv), _mm_set1_ps(vn));
+			__m128 valid = _mm_cmpgt_ps(vp, tiny);
+			__m128 q = _mm_and_ps(valid, _mm_div_ps(Y, _mm_mul_ps(_mm_set1_ps(4.f), _mm_max_ps(vp, tiny))));
+			__m128 X = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(9.f), up), q);
+			__m128 Z = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_set1_ps(12.f), _mm_mul_ps(_mm_set1_ps(3.f), up)), _mm_mul_ps(_mm_set1_ps(20.f), vp)), q);
+
+			_mm_storeu_ps(r + x, _mm_add_ps(_mm_add_ps(_mm_mul_ps(X, _mm_set1_ps(mr[0])), _mm_mul_ps(Y, _mm_set1_ps(mr[1]))), _mm_mul_ps(Z, _mm_set1_ps(mr[2]))));
+			_mm_storeu_ps(g + x, _mm_add_ps(_mm_add_ps(_mm_mul_ps(X, _mm_set1_ps(mg[0])), _mm_mul_ps(Y, _mm_set1_ps(mg[1]))), _mm_mul_ps(Z, _mm_set1_ps(mg[2]))));
+			_mm_storeu_ps(b + x, _mm_add_ps(_mm_add_ps(_mm_mul_ps(X, _mm_set1_ps(mb[0])), _mm_mul_ps(Y, _mm_set1_ps(mb[1]))), _mm_mul_ps(Z, _mm_set1_ps(mb[2]))));
+		}
+#endif
+		for (; x < width; ++x) {
+			float L = std::max(l[x], 0.f);
+			float c = (L + 16.f) * (1.f / 116.f);
+			float Y = L > 8.f ? c * c * c : L * (1.f / kappa);
+			float l13 = 13.f * L;
+			float up = l13 > 1e-12f ? u[x] / l13 + un : un;
+			float vp = l13 > 1e-12f ? v[x] / l13 + vn : vn;
+			float q = vp > 1e-12f ? Y / (4.f * vp) : 0.f;
+			float X = 9.f * up * q;
+			float Z = (12.f - 3.f * up - 20.f * vp) * q;
+			r[x] = mr[0] * X + mr[1] * Y + mr[2] * Z;
+			g[x] = mg[0] * X + mg[1] * Y + mg[2] * Z;
+			b[x] = mb[0] * X + mb[1] * Y + mb[2] * Z;
+		}
+	}
+
+private:
+	YUVMatrix m_matrix = YUV_BT709;
+	RangeSpecification m_ranges[IMetricImage::CC_LAST];
+
+	AffineRow m_rgbToYuv[3];
+	AffineRow m_yuvToRgb[3];
+
+	float m_rgbToXyz[3][3];
+	float m_xyzToRgb[3][3];
+	float m_rgbScale[3];
+	float m_rgbOffset[3];
+	float m_linearLut[lutSize + 1];
+	float m_encodeLut[lutSize + 1];		//!< inverse of m_linearLut, over linear [0, 1]
+};
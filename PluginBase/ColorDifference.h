@@ -0,0 +1,371 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file ColorDifference.h
+*  \brief Perceptual color difference of linear RGB rows: CIEDE2000 and deltaE ITP (BT.2124).
+*
+*	CIEDE2000 is evaluated without per-sample trigonometry and pow():
+*	* cube roots of Lab use bit trick and Newton steps;
+*	* dH' is taken from |da'|^2 + |db|^2 - dC'^2, its sign from the cross product of chroma vectors;
+*	* mean hue is the direction of the sum of unit chroma vectors (the bisector of the shorter arc),
+*	  one polynomial atan2 per sample;
+*	* T(h) and the hue part of R_T are tables over hue with 0.5 degree step and linear
+*	  interpolation (error < 1e-4).
+*	deltaE ITP takes PQ of LMS from the tables of CTransferFunction, absolute error < 1e-5.
+*/
+
+#pragma once
+
+#include "Simd.h"
+#include "ColorConversion.h"
+#include "TransferFunction.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+enum DeltaEFormula {
+	DELTAE_CIEDE2000 = 0,
+	DELTAE_ITP = 1
+};
+
+/*!\brief Color difference of two rows of linear RGB
+*/
+class CColorDifference {
+public:
+	/**
+	**************************************************************************
+	* \param whiteLuminance	[IN] - luminance of linear 1.0 in cd/m^2, used by deltaE ITP
+	*/
+	CColorDifference(DeltaEFormula formula = DELTAE_CIEDE2000, float whiteLuminance = 100.f)
+		: m_formula(formula), m_white(whiteLuminance), m_pq(TRANSFER_PQ, TRANSFER_LUT) {
+		const double pi = 3.14159265358979323846;
+		for (int i = 0; i <= hueLutSize; ++i) {
+			double h = 360. * i / hueLutSize;
+			double r = h * pi / 180.;
+			m_hueT[i] = float(1 - 0.17 * std::cos(r - pi / 6) + 0.24 * std::cos(2 * r)
+				+ 0.32 * std::cos(3 * r + pi / 30) - 0.20 * std::cos(4 * r - 63 * pi / 180));
+			double dTheta = 30. * std::exp(-((h - 275.) / 25.) * ((h - 275.) / 25.));
+			m_hueRT[i] = float(-std::sin(2 * dTheta * pi / 180.));
+		}
+		SetPrimaries(CColorConverter());
+	}
+
+	void SetFormula(DeltaEFormula formula) { m_formula = formula; }
+	DeltaEFormula GetFormula() const { return m_formula; }
+
+	void SetWhiteLuminance(float whiteLuminance) {
+		m_white = whiteLuminance;
+		UpdateLMS();
+	}
+
+	//takes primaries (RGB to XYZ) of the converter that produces linear rows
+	void SetPrimaries(const CColorConverter& converter) {
+		for (int i = 0; i < 3; ++i) {
+			for (int j = 0; j < 3; ++j) m_rgbToXyz[i][j] = converter.RGBtoXYZ(i, j);
+		}
+		m_bt2020 = converter.GetMatrix() == YUV_BT2020;
+		UpdateLMS();
+	}
+
+	/**
+	**************************************************************************
+	* \brief Difference of rows
+	* \param linA, linB		[IN] - linear RGB rows r[width] g[width] b[width], see CColorConverter::LinearRow()
+	* \param scratch		[IN, OUT] - 6 * width floats
+	*/
+	void Row(const float* linA, const float* linB, int width, float* dE, float* scratch) const {
+		float* a = scratch;
+		float* b = scratch + 3 * (size_t)width;
+		if (m_formula == DELTAE_ITP) {
+			ToITP(linA, width, a);
+			ToITP(linB, width, b);
+			ITPRow(a, b, width, dE);
+		}
+		else {
+			ToLab(linA, width, a);
+			ToLab(linB, width, b);
+			CIEDE2000Row(a, b, width, dE);
+		}
+	}
+
+private:
+	static const int hueLutSize = 720;
+
+	void UpdateLMS() {
+		//BT.2100 LMS of BT.2020 RGB, BT.709 RGB is converted to BT.2020 first (BT.2087)
+		static const double lms[3][3] = {
+			{ 1688. / 4096, 2146. / 4096, 262. / 4096 },
+			{ 683. / 4096, 2951. / 4096, 462. / 4096 },
+			{ 99. / 4096, 309. / 4096, 3688. / 4096 }
+		};
+		static const double to2020[3][3] = {
+			{ 0.6274040, 0.3292820, 0.0433136 },
+			{ 0.0690970, 0.9195400, 0.0113612 },
+			{ 0.0163916, 0.0880132, 0.8955950 }
+		};
+		double scale = m_white / 10000.;
+		for (int i = 0; i < 3; ++i) {
+			for (int j = 0; j < 3; ++j) {
+				double v = lms[i][j];
+				if (!m_bt2020) {
+					v = 0;
+					for (int k = 0; k < 3; ++k) v += lms[i][k] * to2020[k][j];
+				}
+				m_rgbToLms[i][j] = float(v * scale);
+			}
+		}
+	}
+
+	//out = L[width] a[width] b[width]
+	void ToLab(const float* lin, int width, float* out) const {
+		const float* r = lin;
+		const float* g = lin + width;
+		const float* b = lin + 2 * width;
+		float* L = out;
+		float* A = out + width;
+		float* B = out + 2 * width;
+		//D65
+		const float xn = 1.f / 0.95047f, zn = 1.f / 1.08883f;
+		const float eps = 216.f / 24389.f, kappa = 24389.f / 27.f;
+		float m[3][3];
+		for (int j = 0; j < 3; ++j) {
+			m[0][j] = m_rgbToXyz[0][j] * xn;
+			m[1][j] = m_rgbToXyz[1][j];
+			m[2][j] = m_rgbToXyz[2][j] * zn;
+		}
+
+		int x = 0;
+#ifdef VQMT_SSE2
+		const __m128 vEps = _mm_set1_ps(eps), vKappa = _mm_set1_ps(kappa / 116.f), v16 = _mm_set1_ps(16.f / 116.f);
+		for (; x + 4 <= width; x += 4) {
+			__m128 vr = _mm_loadu_ps(r + x), vg = _mm_loadu_ps(g + x), vb = _mm_loadu_ps(b + x);
+			__m128 f[3];
+			for (int c = 0; c < 3; ++c) {
+				__m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vr, _mm_set1_ps(m[c][0])), _mm_mul_ps(vg, _mm_set1_ps(m[c][1]))), _mm_mul_ps(vb, _mm_set1_ps(m[c][2])));
+				__m128 cube = VQMTsimd::CubeRoot(_mm_max_ps(t, vEps));
+				__m128 lin = _mm_add_ps(_mm_mul_ps(vKappa, t), v16);
+				__m128 useCube = _mm_cmpgt_ps(t, vEps);
+				f[c] = _mm_or_ps(_mm_and_ps(useCube, cube), _mm_andnot_ps(useCube, lin));
+			}
+			_mm_storeu_ps(L + x, _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(116.f), f[1]), _mm_set1_ps(16.f)));
+			_mm_storeu_ps(A + x, _mm_mul_ps(_mm_set1_ps(500.f), _mm_sub_ps(f[0], f[1])));
+			_mm_storeu_ps(B + x, _mm_mul_ps(_mm_set1_ps(200.f), _mm_sub_ps(f[1], f[2])));
+		}
+#endif
+		for (; x < width; ++x) {
+			float f[3];
+			for (int c = 0; c < 3; ++c) {
+				float t = m[c][0] * r[x] + m[c][1] * g[x] + m[c][2] * b[x];
+				f[c] = t > eps ? VQMTsimd::CubeRoot(t) : (kappa * t + 16.f) / 116.f;
+			}
+			L[x] = 116.f * f[1] - 16.f;
+			A[x] = 500.f * (f[0] - f[1]);
+			B[x] = 200.f * (f[1] - f[2]);
+		}
+	}
+
+	//out = I[width] T[width] P[width], T is already halved as in BT.2124
+	void ToITP(const float* lin, int width, float* out) const {
+		const float* r = lin;
+		const float* g = lin + width;
+		const float* b = lin + 2 * width;
+		float* I = out;
+		float* T = out + width;
+		float* P = out + 2 * width;
+		const float (*m)[3] = m_rgbToLms;
+
+		//linear LMS goes to the output rows, PQ is taken in place
+		int x = 0;
+#ifdef VQMT_SSE2
+		for (; x + 4 <= width; x += 4) {
+			__m128 vr = _mm_loadu_ps(r + x), vg = _mm_loadu_ps(g + x), vb = _mm_loadu_ps(b + x);
+			for (int c = 0; c < 3; ++c) {
+				__m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vr, _mm_set1_ps(m[c][0])), _mm_mul_ps(vg, _mm_set1_ps(m[c][1]))), _mm_mul_ps(vb, _mm_set1_ps(m[c][2])));
+				_mm_storeu_ps(out + (size_t)c * width + x, t);
+			}
+		}
+#endif
+		for (; x < width; ++x) {
+			for (int c = 0; c < 3; ++c) out[(size_t)c * width + x] = m[c][0] * r[x] + m[c][1] * g[x] + m[c][2] * b[x];
+		}
+		m_pq.FromLinear(out, out, 3 * width);
+
+		x = 0;
+#ifdef VQMT_SSE2
+		for (; x + 4 <= width; x += 4) {
+			__m128 l = _mm_loadu_ps(I + x), mm = _mm_loadu_ps(T + x), s = _mm_loadu_ps(P + x);
+			_mm_storeu_ps(I + x, _mm_mul_ps(_mm_set1_ps(0.5f), _mm_add_ps(l, mm)));
+			__m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(l, _mm_set1_ps(6610.f / 8192)), _mm_mul_ps(mm, _mm_set1_ps(-13613.f / 8192))), _mm_mul_ps(s, _mm_set1_ps(7003.f / 8192)));
+			__m128 p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(l, _mm_set1_ps(17933.f / 4096)), _mm_mul_ps(mm, _mm_set1_ps(-17390.f / 4096))), _mm_mul_ps(s, _mm_set1_ps(-543.f / 4096)));
+			_mm_storeu_ps(T + x, t);
+			_mm_storeu_ps(P + x, p);
+		}
+#endif
+		for (; x < width; ++x) {
+			float l = I[x], mm = T[x], s = P[x];
+			I[x] = 0.5f * (l + mm);
+			T[x] = (6610.f * l - 13613.f * mm + 7003.f * s) / 8192;
+			P[x] = (17933.f * l - 17390.f * mm - 543.f * s) / 4096;
+		}
+	}
+
+	static void ITPRow(const float* a, const float* b, int width, float* dE) {
+		int x = 0;
+#ifdef VQMT_SSE2
+		for (; x + 4 <= width; x += 4) {
+			__m128 acc = _mm_setzero_ps();
+			for (int c = 0; c < 3; ++c) {
+				__m128 d = _mm_sub_ps(_mm_loadu_ps(a + c * width + x), _mm_loadu_ps(b + c * width + x));
+				acc = _mm_add_ps(acc, _mm_mul_ps(d, d));
+			}
+			_mm_storeu_ps(dE + x, _mm_mul_ps(_mm_set1_ps(720.f), _mm_sqrt_ps(acc)));
+		}
+#endif
+		for (; x < width; ++x) {
+			float acc = 0;
+			for (int c = 0; c < 3; ++c) {
+				float d = a[c * width + x] - b[c * width + x];
+				acc += d * d;
+			}
+			dE[x] = 720.f * std::sqrt(acc);
+		}
+	}
+
+	float HueLookup(const float* table, float h) const {
+		float f = std::min(std::max(h * (hueLutSize / 360.f), 0.f), hueLutSize - 1e-3f);
+		int i = int(f);
+		return table[i] + (f - i) * (table[i + 1] - table[i]);
+	}
+
+	void CIEDE2000Row(const float* lab1, const float* lab2, int width, float* dE) const {
+		const float* L1 = lab1;
+		const float* A1 = lab1 + width;
+		const float* B1 = lab1 + 2 * width;
+		const float* L2 = lab2;
+		const float* A2 = lab2 + width;
+		const float* B2 = lab2 + 2 * width;
+		const float pow25_7 = 6103515625.f;
+		const float degrees = 57.2957795131f;
+
+		int x = 0;
+#ifdef VQMT_SSE2
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f), half = _mm_set1_ps(0.5f);
+		const __m128 v25_7 = _mm_set1_ps(pow25_7), tiny = _mm_set1_ps(1e-12f);
+		for (; x + 4 <= width; x += 4) {
+			__m128 l1 = _mm_loadu_ps(L1 + x), a1 = _mm_loadu_ps(A1 + x), b1 = _mm_loadu_ps(B1 + x);
+			__m128 l2 = _mm_loadu_ps(L2 + x), a2 = _mm_loadu_ps(A2 + x), b2 = _mm_loadu_ps(B2 + x);
+			__m128 c1 = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(a1, a1), _mm_mul_ps(b1, b1)));
+			__m128 c2 = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(a2, a2), _mm_mul_ps(b2, b2)));
+			__m128 g = Pow7Ratio(_mm_mul_ps(half, _mm_add_ps(c1, c2)), v25_7);
+			g = _mm_add_ps(one, _mm_mul_ps(half, _mm_sub_ps(one, _mm_sqrt_ps(g))));
+			a1 = _mm_mul_ps(a1, g);
+			a2 = _mm_mul_ps(a2, g);
+			c1 = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(a1, a1), _mm_mul_ps(b1, b1)));
+			c2 = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(a2, a2), _mm_mul_ps(b2, b2)));
+
+			__m128 dL = _mm_sub_ps(l2, l1);
+			__m128 dC = _mm_sub_ps(c2, c1);
+			__m128 da = _mm_sub_ps(a2, a1), db = _mm_sub_ps(b2, b1);
+			__m128 dH = _mm_sqrt_ps(_mm_max_ps(zero, _mm_sub_ps(_mm_add_ps(_mm_mul_ps(da, da), _mm_mul_ps(db, db)), _mm_mul_ps(dC, dC))));
+			__m128 cross = _mm_sub_ps(_mm_mul_ps(a1, b2), _mm_mul_ps(b1, a2));
+			dH = _mm_or_ps(dH, _mm_and_ps(cross, _mm_castsi128_ps(_mm_set1_epi32(int(0x80000000)))));
+
+			//mean hue: direction of the sum of unit chroma vectors
+			__m128 inv1 = _mm_and_ps(_mm_cmpgt_ps(c1, tiny), _mm_div_ps(one, _mm_max_ps(c1, tiny)));
+			__m128 inv2 = _mm_and_ps(_mm_cmpgt_ps(c2, tiny), _mm_div_ps(one, _mm_max_ps(c2, tiny)));
+			__m128 ux = _mm_add_ps(_mm_mul_ps(a1, inv1), _mm_mul_ps(a2, inv2));
+			__m128 uy = _mm_add_ps(_mm_mul_ps(b1, inv1), _mm_mul_ps(b2, inv2));
+			__m128 h = _mm_mul_ps(VQMTsimd::Atan2(uy, ux), _mm_set1_ps(degrees));
+			h = _mm_add_ps(h, _mm_and_ps(_mm_cmplt_ps(h, zero), _mm_set1_ps(360.f)));
+			__m128 hf = _mm_min_ps(_mm_max_ps(_mm_mul_ps(h, _mm_set1_ps(hueLutSize / 360.f)), zero), _mm_set1_ps(hueLutSize - 1e-3f));
+			__m128i hi = _mm_cvttps_epi32(hf);
+			__m128 hfrac = _mm_sub_ps(hf, _mm_cvtepi32_ps(hi));
+			__m128 T = VQMTsimd::Gather(m_hueT, hi, hfrac);
+			__m128 rt = VQMTsimd::Gather(m_hueRT, hi, hfrac);
+
+			__m128 lm = _mm_sub_ps(_mm_mul_ps(half, _mm_add_ps(l1, l2)), _mm_set1_ps(50.f));
+			lm = _mm_mul_ps(lm, lm);
+			__m128 sl = _mm_add_ps(one, _mm_div_ps(_mm_mul_ps(_mm_set1_ps(0.015f), lm), _mm_sqrt_ps(_mm_add_ps(_mm_set1_ps(20.f), lm))));
+			__m128 cm = _mm_mul_ps(half, _mm_add_ps(c1, c2));
+			__m128 sc = _mm_add_ps(one, _mm_mul_ps(_mm_set1_ps(0.045f), cm));
+			__m128 sh = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.015f), cm), T));
+			rt = _mm_mul_ps(rt, _mm_mul_ps(_mm_set1_ps(2.f), _mm_sqrt_ps(Pow7Ratio(cm, v25_7))));
+
+			__m128 tl = _mm_div_ps(dL, sl), tc = _mm_div_ps(dC, sc), th = _mm_div_ps(dH, sh);
+			__m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tl, tl), _mm_mul_ps(tc, tc)), _mm_mul_ps(th, th));
+			e = _mm_add_ps(e, _mm_mul_ps(rt, _mm_mul_ps(tc, th)));
+			_mm_storeu_ps(dE + x, _mm_sqrt_ps(_mm_max_ps(e, zero)));
+		}
+#endif
+		for (; x < width; ++x) {
+			float l1 = L1[x], a1 = A1[x], b1 = B1[x];
+			float l2 = L2[x], a2 = A2[x], b2 = B2[x];
+			float c1 = std::sqrt(a1 * a1 + b1 * b1), c2 = std::sqrt(a2 * a2 + b2 * b2);
+			float c7 = Pow7(0.5f * (c1 + c2));
+			float g = 1.f + 0.5f * (1.f - std::sqrt(c7 / (c7 + pow25_7)));
+			a1 *= g;
+			a2 *= g;
+			c1 = std::sqrt(a1 * a1 + b1 * b1);
+			c2 = std::sqrt(a2 * a2 + b2 * b2);
+
+			float dL = l2 - l1, dC = c2 - c1;
+			float da = a2 - a1, db = b2 - b1;
+			float dH = std::sqrt(std::max(0.f, da * da + db * db - dC * dC));
+			if (a1 * b2 - b1 * a2 < 0) dH = -dH;
+
+			float inv1 = c1 > 1e-12f ? 1.f / c1 : 0.f, inv2 = c2 > 1e-12f ? 1.f / c2 : 0.f;
+			float h = std::atan2(b1 * inv1 + b2 * inv2, a1 * inv1 + a2 * inv2) * degrees;
+			if (h < 0) h += 360.f;
+
+			float lm = 0.5f * (l1 + l2) - 50.f;
+			lm *= lm;
+			float sl = 1.f + 0.015f * lm / std::sqrt(20.f + lm);
+			float cm = 0.5f * (c1 + c2);
+			float sc = 1.f + 0.045f * cm;
+			float sh = 1.f + 0.015f * cm * HueLookup(m_hueT, h);
+			float cm7 = Pow7(cm);
+			float rt = HueLookup(m_hueRT, h) * 2.f * std::sqrt(cm7 / (cm7 + pow25_7));
+
+			float tl = dL / sl, tc = dC / sc, th = dH / sh;
+			dE[x] = std::sqrt(std::max(0.f, tl * tl + tc * tc + th * th + rt * tc * th));
+		}
+	}
+
+	static float Pow7(float c) {
+		float c2 = c * c;
+		return c2 * c2 * c2 * c;
+	}
+
+#ifdef VQMT_SSE2
+	//c^7 / (c^7 + 25^7)
+	static __m128 Pow7Ratio(__m128 c, __m128 v25_7) {
+		__m128 c2 = _mm_mul_ps(c, c);
+		__m128 c7 = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(c2, c2), c2), c);
+		return _mm_div_ps(c7, _mm_add_ps(c7, v25_7));
+	}
+#endif
+
+private:
+	DeltaEFormula m_formula;
+	float m_white;
+	bool m_bt2020 = false;
+	float m_rgbToXyz[3][3];
+	float m_rgbToLms[3][3];
+
+	float m_hueT[hueLutSize + 1];
+	float m_hueRT[hueLutSize + 1];
+	CTransferFunction m_pq;
+};
@@ -0,0 +1,147 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file Difference.h
+*  \brief Sum of squared and absolute differences of two planes (MSE, MAE, PSNR).
+*
+*	Samples are accumulated in float registers over short blocks and then flushed
+*	to double accumulators, so the kernel stays memory-bound and the sums do not
+*	loose precision on large frames.
+*/
+
+#pragma once
+
+#include "Simd.h"
+#include "ImagePlane.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+struct DiffStats {
+	double sumSq = 0;
+	double sumAbs = 0;
+	float maxAbs = 0;
+	uint64_t count = 0;
+
+	DiffStats& operator += (const DiffStats& other) {
+		sumSq += other.sumSq;
+		sumAbs += other.sumAbs;
+		maxAbs = std::max(maxAbs, other.maxAbs);
+		count += other.count;
+		return *this;
+	}
+
+	double MSE() const { return count ? sumSq / double(count) : 0.; }
+	double MAE() const { return count ? sumAbs / double(count) : 0.; }
+
+	/**
+	**************************************************************************
+	* \brief PSNR in dB
+	* \param peak		[IN] - peak signal value (max - min of component range)
+	* \param maxValue	[IN] - value for identical planes
+	*/
+	double PSNR(double peak, double maxValue = 100.) const {
+		double mse = MSE();
+		if (mse <= 0) return maxValue;
+		return std::min(maxValue, 10. * std::log10(peak * peak / mse));
+	}
+};
+
+/*!\brief Difference statistics of two planes
+*/
+class CDifference {
+public:
+	/**
+	**************************************************************************
+	* \brief Computes statistics over common area of planes
+	* \param pool		[IN] - optional pool, rows are split into stripes, result does not depend on number of threads
+	*/
+	static DiffStats Compute(const PlaneView& a, const PlaneView& b, CThreadPool* pool = nullptr) {
+		DiffStats res;
+		int width = std::min(a.width, b.width);
+		int height = std::min(a.height, b.height);
+		if (a.Empty() || b.Empty()) return res;
+
+		int stripes = std::min(height, stripeCount);
+		std::vector<DiffStats> parts(stripes);
+		auto job = [&](int s) {
+			int y0 = height * s / stripes, y1 = height * (s + 1) / stripes;
+			for (int y = y0; y < y1; ++y) Row(a.Row(y), b.Row(y), width, parts[s]);
+		};
+		if (pool) pool->ParallelFor(stripes, job);
+		else for (int s = 0; s < stripes; ++s) job(s);
+
+		for (const DiffStats& p : parts) res += p;
+		return res;
+	}
+
+	//adds one row to stats
+	static void Row(const float* a, const float* b, int width, DiffStats& stats) {
+		int x = 0;
+#ifdef VQMT_SSE2
+		__m128d sq = _mm_setzero_pd(), ab = _mm_setzero_pd();
+		__m128 mx = _mm_setzero_ps();
+		while (x + 4 <= width) {
+			int blockEnd = std::min(width & ~3, x + blockSize);
+			__m128 sq0 = _mm_setzero_ps(), sq1 = _mm_setzero_ps();
+			__m128 ab0 = _mm_setzero_ps(), ab1 = _mm_setzero_ps();
+			for (; x + 8 <= blockEnd; x += 8) {
+				__m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + x), _mm_loadu_ps(b + x));
+				__m128 d1 = _mm_sub_ps(_mm_loadu_ps(a + x + 4), _mm_loadu_ps(b + x + 4));
+				sq0 = _mm_add_ps(sq0, _mm_mul_ps(d0, d0));
+				sq1 = _mm_add_ps(sq1, _mm_mul_ps(d1, d1));
+				d0 = VQMTsimd::Abs(d0);
+				d1 = VQMTsimd::Abs(d1);
+				ab0 = _mm_add_ps(ab0, d0);
+				ab1 = _mm_add_ps(ab1, d1);
+				mx = _mm_max_ps(mx, _mm_max_ps(d0, d1));
+			}
+			for (; x + 4 <= blockEnd; x += 4) {
+				__m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + x), _mm_loadu_ps(b + x));
+				sq0 = _mm_add_ps(sq0, _mm_mul_ps(d0, d0));
+				d0 = VQMTsimd::Abs(d0);
+				ab0 = _mm_add_ps(ab0, d0);
+				mx = _mm_max_ps(mx, d0);
+			}
+			VQMTsimd::AccumulateDouble(sq, _mm_add_ps(sq0, sq1));
+			VQMTsimd::AccumulateDouble(ab, _mm_add_ps(ab0, ab1));
+		}
+		stats.sumSq += VQMTsimd::HorizontalSum(sq);
+		stats.sumAbs += VQMTsimd::HorizontalSum(ab);
+		alignas(16) float m[4];
+		_mm_store_ps(m, mx);
+		stats.maxAbs = std::max(stats.maxAbs, std::max(std::max(m[0], m[1]), std::max(m[2], m[3])));
+#endif
+		double sq1 = 0, ab1 = 0;
+		float mx1 = 0;
+		for (; x < width; ++x) {
+			float d = a[x] - b[x];
+			sq1 += double(d) * d;
+			ab1 += std::fabs(d);
+			mx1 = std::max(mx1, std::fabs(d));
+		}
+		stats.sumSq += sq1;
+		stats.sumAbs += ab1;
+		stats.maxAbs = std::max(stats.maxAbs, mx1);
+		stats.count += (uint64_t)width;
+	}
+
+private:
+	//floats accumulated before flush to double, sum of 256 squares of 16-bit range is still exact enough
+	static const int blockSize = 256;
+	//fixed number of stripes keeps summation order (and result) independent of the pool size
+	static constexpr int stripeCount = 32;
+};
@@ -0,0 +1,170 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file EdgeWidth.h
+*  \brief No-reference blur estimation by width of edges (Marziliano et al. 2002).
+*
+*	Horizontal and vertical central differences of a row are computed with SSE and
+*	compared with the threshold without storing them. Only samples that pass the
+*	threshold are checked for being local maxima of gradient, and only for these
+*	edges the width (distance between intensity extrema on both sides of the edge)
+*	is traced, so the rest of the frame is read once and never revisited.
+*/
+
+#pragma once
+
+#include "Simd.h"
+#include "ImagePlane.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+
+struct EdgeWidthStats {
+	double sumWidth = 0;
+	uint64_t edges = 0;		//!< number of measured edges
+	uint64_t scanned = 0;	//!< number of samples tested for edges
+
+	EdgeWidthStats& operator += (const EdgeWidthStats& other) {
+		sumWidth += other.sumWidth;
+		edges += other.edges;
+		scanned += other.scanned;
+		return *this;
+	}
+
+	double MeanWidth() const { return edges ? sumWidth / double(edges) : 0.; }
+	double EdgeDensity() const { return scanned ? double(edges) / double(scanned) : 0.; }
+};
+
+/*!\brief Mean width of vertical and horizontal edges
+*/
+class CEdgeWidth {
+public:
+	//called for every measured edge: x, y, width, true for vertical edge (found in a row)
+	typedef std::function<void(int, int, int, bool)> EdgeCallback;
+
+	/**
+	**************************************************************************
+	* \param threshold	[IN] - minimal central difference |I(x+1) - I(x-1)| of an edge
+	* \param maxWidth	[IN] - edges are not traced further than this distance
+	* \param step		[IN] - only every step-th row is scanned for vertical edges
+	*						   and every step-th column for horizontal ones
+	*/
+	CEdgeWidth(float threshold = 20.f, int maxWidth = 32, int step = 1)
+		: m_threshold(threshold), m_maxWidth(maxWidth), m_step(std::max(1, step)) {}
+
+	void SetThreshold(float threshold) { m_threshold = threshold; }
+	void SetStep(int step) { m_step = std::max(1, step); }
+
+	EdgeWidthStats Compute(const PlaneView& plane, CThreadPool* pool = nullptr, const EdgeCallback& onEdge = EdgeCallback()) const {
+		EdgeWidthStats res;
+		if (plane.Empty() || plane.width < 3 || plane.height < 3) return res;
+
+		int rows = (plane.height - 2 + m_step - 1) / m_step;
+		int stripes = std::min(rows, stripeCount);
+		std::vector<EdgeWidthStats> parts(stripes);
+		auto job = [&](int s) {
+			int r0 = rows * s / stripes, r1 = rows * (s + 1) / stripes;
+			for (int r = r0; r < r1; ++r) ScanRow(plane, 1 + r * m_step, parts[s], onEdge);
+		};
+		//callback is not synchronized, so it forces single thread
+		if (pool && !onEdge) pool->ParallelFor(stripes, job);
+		else for (int s = 0; s < stripes; ++s) job(s);
+
+		for (const EdgeWidthStats& p : parts) res += p;
+		return res;
+	}
+
+private:
+	static constexpr int stripeCount = 32;
+
+	//finds vertical and horizontal edges at row y, 0 < y < height - 1
+	void ScanRow(const PlaneView& plane, int y, EdgeWidthStats& stats, const EdgeCallback& onEdge) const {
+		const float* up = plane.Row(y - 1);
+		const float* row = plane.Row(y);
+		const float* down = plane.Row(y + 1);
+		int w = plane.width;
+		stats.scanned += (uint64_t)(w - 2) + (uint64_t)((w + m_step - 1) / m_step);
+
+		int x = 1;
+#ifdef VQMT_SSE2
+		const __m128 t = _mm_set1_ps(m_threshold);
+		for (; x + 4 < w; x += 4) {
+			__m128 gx = VQMTsimd::Abs(_mm_sub_ps(_mm_loadu_ps(row + x + 1), _mm_loadu_ps(row + x - 1)));
+			__m128 gy = VQMTsimd::Abs(_mm_sub_ps(_mm_loadu_ps(down + x), _mm_loadu_ps(up + x)));
+			int maskX = _mm_movemask_ps(_mm_cmpgt_ps(gx, t));
+			int maskY = _mm_movemask_ps(_mm_cmpgt_ps(gy, t));
+			for (; maskX; maskX &= maskX - 1) TraceRow(plane, LowestBit(maskX) + x, y, stats, onEdge);
+			for (; maskY; maskY &= maskY - 1) TraceColumn(plane, LowestBit(maskY) + x, y, stats, onEdge);
+		}
+#endif
+		for (; x < w - 1; ++x) {
+			if (std::fabs(row[x + 1] - row[x - 1]) > m_threshold) TraceRow(plane, x, y, stats, onEdge);
+			if (std::fabs(down[x] - up[x]) > m_threshold) TraceColumn(plane, x, y, stats, onEdge);
+		}
+		//columns 0 and w - 1 are tested only for horizontal edges
+		if (std::fabs(down[0] - up[0]) > m_threshold) TraceColumn(plane, 0, y, stats, onEdge);
+		if (std::fabs(down[w - 1] - up[w - 1]) > m_threshold) TraceColumn(plane, w - 1, y, stats, onEdge);
+	}
+
+	static int LowestBit(int mask) {
+		int bit = 0;
+		while (!(mask & (1 << bit))) ++bit;
+		return bit;
+	}
+
+	//vertical edge at (x, y) if horizontal gradient is local maximum along the row
+	void TraceRow(const PlaneView& plane, int x, int y, EdgeWidthStats& stats, const EdgeCallback& onEdge) const {
+		const float* row = plane.Row(y);
+		int w = plane.width;
+		float g = std::fabs(row[x + 1] - row[x - 1]);
+		if (x > 1 && std::fabs(row[x] - row[x - 2]) > g) return;
+		if (x + 2 < w && std::fabs(row[x + 2] - row[x]) >= g) return;
+
+		float sign = row[x + 1] > row[x - 1] ? 1.f : -1.f;
+		int end = x, begin = x;
+		while (end + 1 < w && end - x < m_maxWidth && sign * (row[end + 1] - row[end]) > 0) ++end;
+		while (begin > 0 && x - begin < m_maxWidth && sign * (row[begin] - row[begin - 1]) > 0) --begin;
+		int width = end - begin;
+		stats.sumWidth += width;
+		stats.edges++;
+		if (onEdge) onEdge(x, y, width, true);
+	}
+
+	//horizontal edge at (x, y) if vertical gradient is local maximum along the column
+	void TraceColumn(const PlaneView& plane, int x, int y, EdgeWidthStats& stats, const EdgeCallback& onEdge) const {
+		if (x % m_step) return;
+		int h = plane.height;
+		auto at = [&](int yy) { return plane.Row(yy)[x]; };
+		float g = std::fabs(at(y + 1) - at(y - 1));
+		if (y > 1 && std::fabs(at(y) - at(y - 2)) > g) return;
+		if (y + 2 < h && std::fabs(at(y + 2) - at(y)) >= g) return;
+
+		float sign = at(y + 1) > at(y - 1) ? 1.f : -1.f;
+		int end = y, begin = y;
+		while (end + 1 < h && end - y < m_maxWidth && sign * (at(end + 1) - at(end)) > 0) ++end;
+		while (begin > 0 && y - begin < m_maxWidth && sign * (at(begin) - at(begin - 1)) > 0) --begin;
+		int width = end - begin;
+		stats.sumWidth += width;
+		stats.edges++;
+		if (onEdge) onEdge(x, y, width, false);
+	}
+
+private:
+	float m_threshold;
+	int m_maxWidth;
+	int m_step;
+};
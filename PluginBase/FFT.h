@@ -0,0 +1,360 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file FFT.h
+*  \brief Self-contained 2D real FFT (power-of-two sizes) and phase correlation.
+*
+*	1D plans (bit reversal table and per-stage twiddles) are created once per size and
+*	shared by all transforms of this module.
+*/
+
+#pragma once
+
+#include "Simd.h"
+#include "ImagePlane.h"
+
+#include <vector>
+#include <complex>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <cmath>
+#include <algorithm>
+
+typedef std::complex<float> FFTComplex;
+
+/*!\brief Plan of in-place complex radix-2 FFT of size n (power of two)
+*/
+class CFFTPlan {
+public:
+	explicit CFFTPlan(int n) : m_size(n) {
+		int bits = 0;
+		while ((1 << bits) < n) ++bits;
+
+		m_reverse.resize(n);
+		for (int i = 0; i < n; ++i) {
+			int r = 0;
+			for (int b = 0; b < bits; ++b) r |= ((i >> b) & 1) << (bits - 1 - b);
+			m_reverse[i] = r;
+		}
+
+		//twiddles of the stage with half-size h are stored at offset h - 1
+		m_twiddles.resize(std::max(1, n - 1));
+		const double pi = 3.14159265358979323846;
+		for (int half = 1; half < n; half *= 2) {
+			for (int j = 0; j < half; ++j) {
+				double a = -pi * j / half;
+				m_twiddles[half - 1 + j] = FFTComplex(float(std::cos(a)), float(std::sin(a)));
+			}
+		}
+	}
+
+	/**
+	**************************************************************************
+	* \brief Returns shared plan for the size
+	*/
+	static std::shared_ptr<const CFFTPlan> Get(int n) {
+		static std::mutex lock;
+		static std::map<int, std::shared_ptr<const CFFTPlan>> plans;
+
+		std::lock_guard<std::mutex> guard(lock);
+		std::shared_ptr<const CFFTPlan>& plan = plans[n];
+		if (!plan) plan = std::make_shared<CFFTPlan>(n);
+		return plan;
+	}
+
+	static bool IsPowerOfTwo(int n) { return n > 0 && (n & (n - 1)) == 0; }
+
+	//largest power of two <= n
+	static int FloorPowerOfTwo(int n) {
+		int p = 1;
+		while (p * 2 <= n) p *= 2;
+		return p;
+	}
+
+	int Size() const { return m_size; }
+
+	//unnormalized forward (exp(-i...)) or inverse (exp(+i...)) transform
+	void Transform(FFTComplex* data, bool inverse) const {
+		int n = m_size;
+		for (int i = 0; i < n; ++i) {
+			if (i < m_reverse[i]) std::swap(data[i], data[m_reverse[i]]);
+		}
+		if (inverse) {
+			for (int i = 0; i < n; ++i) data[i] = std::conj(data[i]);
+		}
+
+		for (int half = 1; half < n; half *= 2) {
+			const FFTComplex* tw = &m_twiddles[half - 1];
+			for (int start = 0; start < n; start += 2 * half) {
+				FFTComplex* a = data + start;
+				FFTComplex* b = a + half;
+				int j = 0;
+#ifdef VQMT_SSE2
+				const __m128 sign = _mm_set_ps(0.f, -0.f, 0.f, -0.f);
+				for (; j + 2 <= half; j += 2) {
+					__m128 va = _mm_loadu_ps((const float*)(a + j));
+					__m128 vb = _mm_loadu_ps((const float*)(b + j));
+					__m128 vw = _mm_loadu_ps((const float*)(tw + j));
+
+					__m128 re = _mm_shuffle_ps(vb, vb, _MM_SHUFFLE(2, 2, 0, 0));
+					__m128 im = _mm_shuffle_ps(vb, vb, _MM_SHUFFLE(3, 3, 1, 1));
+					__m128 wSwap = _mm_shuffle_ps(vw, vw, _MM_SHUFFLE(2, 3, 0, 1));
+					__m128 prod = _mm_add_ps(_mm_mul_ps(re, vw), _mm_xor_ps(_mm_mul_ps(im, wSwap), sign));
+
+					_mm_storeu_ps((float*)(a + j), _mm_add_ps(va, prod));
+					_mm_storeu_ps((float*)(b + j), _mm_sub_ps(va, prod));
+				}
+#endif
+				for (; j < half; ++j) {
+					FFTComplex t = b[j] * tw[j];
+					b[j] = a[j] - t;
+					a[j] += t;
+				}
+			}
+		}
+
+		if (inverse) {
+			for (int i = 0; i < n; ++i) data[i] = std::conj(data[i]);
+		}
+	}
+
+private:
+	int m_size;
+	std::vector<int> m_reverse;
+	std::vector<FFTComplex> m_twiddles;
+};
+
+/*!\brief 2D real-to-complex FFT of width x height (both powers of two, >= 2)
+*
+*	Spectrum has (width / 2 + 1) x height complex values, row-major: non-negative
+*	horizontal frequencies only, the rest is the conjugate-symmetric part.
+*/
+class CFFT2D {
+public:
+	CFFT2D() {}
+	CFFT2D(int width, int height) { Init(width, height); }
+
+	void Init(int width, int height) {
+		m_width = width;
+		m_height = height;
+		m_rowPlan = CFFTPlan::Get(width / 2);
+		m_colPlan = CFFTPlan::Get(height);
+
+		int half = width / 2;
+		m_rowTwiddles.resize(half + 1);
+		const double pi = 3.14159265358979323846;
+		for (int k = 0; k <= half; ++k) {
+			double a = -2 * pi * k / width;
+			m_rowTwiddles[k] = FFTComplex(float(std::cos(a)), float(std::sin(a)));
+		}
+		m_rowBuffer.resize(half + 1);
+		m_colBuffer.resize(height);
+	}
+
+	int Width() const { return m_width; }
+	int Height() const { return m_height; }
+	int SpectrumWidth() const { return m_width / 2 + 1; }
+
+	/**
+	**************************************************************************
+	* \brief Forward transform
+	* \param src			[IN] - width x height real samples with row stride srcStride
+	* \param spectrum		[OUT] - SpectrumWidth() x Height() values
+	*/
+	void Forward(const float* src, int srcStride, FFTComplex* spectrum) {
+		int half = m_width / 2;
+		int sw = SpectrumWidth();
+		for (int y = 0; y < m_height; ++y) {
+			const float* row = src + (size_t)y * srcStride;
+			FFTComplex* z = m_rowBuffer.data();
+			for (int k = 0; k < half; ++k) z[k] = FFTComplex(row[2 * k], row[2 * k + 1]);
+			m_rowPlan->Transform(z, false);
+
+			FFTComplex* out = spectrum + (size_t)y * sw;
+			z[half] = z[0];
+			for (int k = 0; k <= half; ++k) {
+				FFTComplex zk = z[k], zc = std::conj(z[half - k]);
+				FFTComplex even = (zk + zc) * 0.5f;
+				FFTComplex odd = (zk - zc) * FFTComplex(0.f, -0.5f);
+				out[k] = even + m_rowTwiddles[k] * odd;
+			}
+		}
+		TransformColumns(spectrum, false);
+	}
+
+	/**
+	**************************************************************************
+	* \brief Inverse transform, normalized: Inverse(Forward(x)) == x
+	* \param spectrum		[IN, OUT] - spectrum, destroyed by the call
+	* \param dst			[OUT] - width x height real samples with row stride dstStride
+	*/
+	void Inverse(FFTComplex* spectrum, float* dst, int dstStride) {
+		TransformColumns(spectrum, true);
+
+		int half = m_width / 2;
+		int sw = SpectrumWidth();
+		float norm = 1.f / (float(m_width) * float(m_height));
+		for (int y = 0; y < m_height; ++y) {
+			const FFTComplex* in = spectrum + (size_t)y * sw;
+			FFTComplex* z = m_rowBuffer.data();
+			for (int k = 0; k < half; ++k) {
+				FFTComplex xk = in[k], xc = std::conj(in[half - k]);
+				FFTComplex even = (xk + xc) * 0.5f;
+				FFTComplex odd = (xk - xc) * 0.5f * std::conj(m_rowTwiddles[k]);
+				z[k] = even + FFTComplex(0.f, 1.f) * odd;
+			}
+			m_rowPlan->Transform(z, true);
+
+			float* row = dst + (size_t)y * dstStride;
+			for (int k = 0; k < half; ++k) {
+				row[2 * k] = z[k].real() * 2 * norm;
+				row[2 * k + 1] = z[k].imag() * 2 * norm;
+			}
+		}
+	}
+
+private:
+	void TransformColumns(FFTComplex* spectrum, bool inverse) {
+		int sw = SpectrumWidth();
+		FFTComplex* col = m_colBuffer.data();
+		for (int x = 0; x < sw; ++x) {
+			for (int y = 0; y < m_height; ++y) col[y] = spectrum[(size_t)y * sw + x];
+			m_colPlan->Transform(col, inverse);
+			for (int y = 0; y < m_height; ++y) spectrum[(size_t)y * sw + x] = col[y];
+		}
+	}
+
+private:
+	int m_width = 0;
+	int m_height = 0;
+	std::shared_ptr<const CFFTPlan> m_rowPlan;
+	std::shared_ptr<const CFFTPlan> m_colPlan;
+	std::vector<FFTComplex> m_rowTwiddles;
+	std::vector<FFTComplex> m_rowBuffer;
+	std::vector<FFTComplex> m_colBuffer;
+};
+
+struct ShiftEstimate {
+	float dx = 0;		//!< distorted(x + dx, y + dy) ~ reference(x, y)
+	float dy = 0;
+	float peak = 0;		//!< height of correlation peak in [0, 1], low values mean unreliable estimate
+};
+
+/*!\brief Estimates translation between two planes by phase correlation
+*
+*	Central power-of-two window (not larger than maxSize) of both planes is
+*	Hann-weighted and correlated; the peak is refined to sub-pixel precision from
+*	its bigger neighbour. Shifts up to a quarter of the window are reliable.
+*/
+class CPhaseCorrelator {
+public:
+	explicit CPhaseCorrelator(int maxSize = 512) : m_maxSize(std::max(2, maxSize)) {}
+
+	ShiftEstimate Estimate(const PlaneView& reference, const PlaneView& distorted) {
+		ShiftEstimate res;
+		int w = std::min(reference.width, distorted.width);
+		int h = std::min(reference.height, distorted.height);
+		if (w < 2 || h < 2 || !reference.data || !distorted.data) return res;
+
+		int fw = CFFTPlan::FloorPowerOfTwo(std::min(w, m_maxSize));
+		int fh = CFFTPlan::FloorPowerOfTwo(std::min(h, m_maxSize));
+		if (m_fft.Width() != fw || m_fft.Height() != fh) Prepare(fw, fh);
+
+		int x0 = (w - fw) / 2, y0 = (h - fh) / 2;
+		int sw = m_fft.SpectrumWidth();
+		LoadWindowed(reference, x0, y0);
+		m_fft.Forward(m_samples.data(), fw, m_specRef.data());
+		LoadWindowed(distorted, x0, y0);
+		m_fft.Forward(m_samples.data(), fw, m_specDist.data());
+
+		//normalized cross-power spectrum
+		for (size_t i = 0; i < (size_t)sw * fh; ++i) {
+			FFTComplex c = std::conj(m_specRef[i]) * m_specDist[i];
+			float mag = std::abs(c);
+			m_specRef[i] = mag > 1e-20f ? c / mag : FFTComplex(0.f, 0.f);
+		}
+		m_fft.Inverse(m_specRef.data(), m_samples.data(), fw);
+
+		int px = 0, py = 0;
+		float best = m_samples[0];
+		for (int y = 0; y < fh; ++y) {
+			for (int x = 0; x < fw; ++x) {
+				float v = m_samples[(size_t)y * fw + x];
+				if (v > best) { best = v; px = x; py = y; }
+			}
+		}
+
+		auto at = [&](int x, int y) { return m_samples[(size_t)((y + fh) % fh) * fw + (x + fw) % fw]; };
+		//peak of shifted impulse is a sinc: c(1) / (c(1) + c(0)) is the fractional offset towards the bigger neighbour
+		auto subPixel = [](float l, float c, float r) {
+			float side = std::max(l, r);
+			if (side <= 0 || c <= 0) return 0.f;
+			float d = side / (side + c);
+			return r >= l ? d : -d;
+		};
+
+		res.dx = float(px > fw / 2 ? px - fw : px) + subPixel(at(px - 1, py), best, at(px + 1, py));
+		res.dy = float(py > fh / 2 ? py - fh : py) + subPixel(at(px, py - 1), best, at(px, py + 1));
+		res.peak = best;
+		return res;
+	}
+
+	/**
+	**************************************************************************
+	* \brief Estimates shift between images[0] (reference) and images[1] (distorted) as passed to Measure
+	*/
+	ShiftEstimate Estimate(const std::vector<IMetricImage*>& images, IMetricImage::ColorComponent cc, int width, int height) {
+		if (images.size() < 2) return ShiftEstimate();
+		return Estimate(PlaneView::FromImage(images[0], cc, width, height), PlaneView::FromImage(images[1], cc, width, height));
+	}
+
+private:
+	void Prepare(int fw, int fh) {
+		m_fft.Init(fw, fh);
+		m_samples.resize((size_t)fw * fh);
+		m_specRef.resize((size_t)m_fft.SpectrumWidth() * fh);
+		m_specDist.resize(m_specRef.size());
+
+		const double pi = 3.14159265358979323846;
+		m_windowX.resize(fw);
+		m_windowY.resize(fh);
+		for (int i = 0; i < fw; ++i) m_windowX[i] = float(0.5 - 0.5 * std::cos(2 * pi * i / fw));
+		for (int i = 0; i < fh; ++i) m_windowY[i] = float(0.5 - 0.5 * std::cos(2 * pi * i / fh));
+	}
+
+	//copies window minus its mean (the DC term carries no shift information)
+	void LoadWindowed(const PlaneView& plane, int x0, int y0) {
+		int fw = m_fft.Width(), fh = m_fft.Height();
+		double sum = 0;
+		for (int y = 0; y < fh; ++y) {
+			const float* row = plane.Row(y0 + y) + x0;
+			for (int x = 0; x < fw; ++x) sum += row[x];
+		}
+		float mean = float(sum / (double(fw) * fh));
+		for (int y = 0; y < fh; ++y) {
+			const float* row = plane.Row(y0 + y) + x0;
+			float* dst = &m_samples[(size_t)y * fw];
+			for (int x = 0; x < fw; ++x) dst[x] = (row[x] - mean) * m_windowX[x] * m_windowY[y];
+		}
+	}
+
+private:
+	int m_maxSize;
+	CFFT2D m_fft;
+	std::vector<float> m_samples;
+	std::vector<FFTComplex> m_specRef;
+	std::vector<FFTComplex> m_specDist;
+	std::vector<float> m_windowX;
+	std::vector<float> m_windowY;
+};
@@ -0,0 +1,126 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file FrameSignature.h
+*  \brief Compact summary of a frame for temporal measurements.
+*
+*	The plane is split into grid x grid cells and the signature is the mean value of
+*	every cell (256 floats for the default 16x16 grid), so temporal metrics can compare
+*	a frame with its neighbours without keeping previous frames. Rows of a cell band are
+*	summed per column with SSE into one row buffer, which is then reduced to cells.
+*/
+
+#pragma once
+
+#include "Simd.h"
+#include "ImagePlane.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+//difference of two signatures
+struct SignatureDiff {
+	float mean = 0;		//!< mean absolute difference of cells
+	float max = 0;		//!< maximal absolute difference of cells
+};
+
+/*!\brief Grid of cell means of a plane
+*/
+class CFrameSignature {
+public:
+	explicit CFrameSignature(int grid = 16) : m_grid(std::max(1, grid)) {}
+
+	void SetGrid(int grid) { m_grid = std::max(1, grid); }
+	int Grid() const { return m_grid; }
+	int Size() const { return m_grid * m_grid; }
+
+	/**
+	**************************************************************************
+	* \brief Fills cells with Size() cell means, row by row
+	* \param pool		[IN] - optional pool, one job per band of cells
+	* \return mean value of the plane
+	*/
+	double Compute(const PlaneView& plane, std::vector<float>& cells, CThreadPool* pool = nullptr) const {
+		cells.assign(Size(), 0.f);
+		if (plane.Empty()) return 0.;
+
+		int w = plane.width, h = plane.height;
+		std::vector<double> bandSums(m_grid, 0.);
+		auto job = [&](int band) {
+			int y0 = h * band / m_grid, y1 = h * (band + 1) / m_grid;
+			if (y0 == y1) return;
+			std::vector<float> columns((size_t)((w + 3) & ~3), 0.f);
+			for (int y = y0; y < y1; ++y) AddRow(plane.Row(y), w, columns.data());
+
+			float* out = cells.data() + (size_t)band * m_grid;
+			for (int c = 0; c < m_grid; ++c) {
+				int x0 = w * c / m_grid, x1 = w * (c + 1) / m_grid;
+				if (x0 == x1) continue;
+				double sum = 0;
+				for (int x = x0; x < x1; ++x) sum += columns[x];
+				out[c] = float(sum / (double(x1 - x0) * (y1 - y0)));
+				bandSums[band] += sum;
+			}
+		};
+		if (pool) pool->ParallelFor(m_grid, job);
+		else for (int b = 0; b < m_grid; ++b) job(b);
+
+		double total = 0;
+		for (double s : bandSums) total += s;
+		return total / (double(w) * h);
+	}
+
+	static SignatureDiff Difference(const std::vector<float>& a, const std::vector<float>& b) {
+		SignatureDiff res;
+		int n = int(std::min(a.size(), b.size()));
+		if (!n) return res;
+
+		double sum = 0;
+		int i = 0;
+#ifdef VQMT_SSE2
+		__m128 acc = _mm_setzero_ps(), mx = _mm_setzero_ps();
+		for (; i + 4 <= n; i += 4) {
+			__m128 d = VQMTsimd::Abs(_mm_sub_ps(_mm_loadu_ps(a.data() + i), _mm_loadu_ps(b.data() + i)));
+			acc = _mm_add_ps(acc, d);
+			mx = _mm_max_ps(mx, d);
+		}
+		sum = VQMTsimd::HorizontalSum(acc);
+		float m[4];
+		_mm_storeu_ps(m, mx);
+		res.max = std::max(std::max(m[0], m[1]), std::max(m[2], m[3]));
+#endif
+		for (; i < n; ++i) {
+			float d = std::fabs(a[i] - b[i]);
+			sum += d;
+			res.max = std::max(res.max, d);
+		}
+		res.mean = float(sum / n);
+		return res;
+	}
+
+private:
+	static void AddRow(const float* row, int w, float* columns) {
+		int x = 0;
+#ifdef VQMT_SSE2
+		for (; x + 4 <= w; x += 4) {
+			_mm_storeu_ps(columns + x, _mm_add_ps(_mm_loadu_ps(columns + x), _mm_loadu_ps(row + x)));
+		}
+#endif
+		for (; x < w; ++x) columns[x] += row[x];
+	}
+
+private:
+	int m_grid;
+};
@@ -0,0 +1,244 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file Histogram.h
+*  \brief Histograms and quantiles of float planes.
+*
+*	Binning uses several private sub-histograms: neighbour samples are counted in
+*	different copies, so equal bins do not serialize on one memory location.
+*	Copies are merged once per Accumulate() call.
+*/
+
+#pragma once
+
+#include "Simd.h"
+#include "ImagePlane.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+/*!\brief Histogram with equal bins over [min, max]
+*
+*	Values outside of the range (and NaN) are counted in the first or the last bin.
+*/
+class CHistogram {
+public:
+	CHistogram() {}
+	CHistogram(int bins, float min, float max) { Reset(bins, min, max); }
+
+	/**
+	**************************************************************************
+	* \brief Creates histogram over the range of the component
+	* \param range		[IN] - range from IMetricImage::GetRanges()
+	* \param useReal	[IN] - use realMin/realMax instead of min/max
+	*/
+	CHistogram(int bins, const RangeSpecification& range, bool useReal = false) {
+		Reset(bins, useReal ? range.realMin : range.min, useReal ? range.realMax : range.max);
+	}
+
+	void Reset(int bins, float min, float max) {
+		m_bins.assign(std::max(1, bins), 0);
+		m_min = min;
+		m_max = max > min ? max : min + 1.f;
+		m_total = 0;
+	}
+
+	//clears counters, keeps bins
+	void Clear() {
+		std::fill(m_bins.begin(), m_bins.end(), 0);
+		m_total = 0;
+	}
+
+	/**
+	**************************************************************************
+	* \brief Adds all samples of the plane
+	* \param pool		[IN] - optional pool, rows are split into stripes
+	*/
+	void Accumulate(const PlaneView& plane, CThreadPool* pool = nullptr) {
+		if (plane.Empty()) return;
+		int bins = Bins();
+		int stripes = pool ? std::min(pool->Threads() * 2, plane.height) : 1;
+
+		if (stripes <= 1) {
+			std::vector<uint32_t> local((size_t)subHistograms * bins);
+			for (int y = 0; y < plane.height; ++y) BinRow(plane.Row(y), plane.width, local.data());
+			Merge(local);
+		}
+		else {
+			std::vector<std::vector<uint32_t>> locals(stripes);
+			pool->ParallelFor(stripes, [&](int s) {
+				locals[s].assign((size_t)subHistograms * bins, 0);
+				int y0 = plane.height * s / stripes, y1 = plane.height * (s + 1) / stripes;
+				for (int y = y0; y < y1; ++y) BinRow(plane.Row(y), plane.width, locals[s].data());
+			});
+			for (const auto& local : locals) Merge(local);
+		}
+	}
+
+	int Bins() const { return int(m_bins.size()); }
+	uint64_t Count(int bin) const { return m_bins[bin]; }
+	uint64_t Total() const { return m_total; }
+	const std::vector<uint64_t>& Counts() const { return m_bins; }
+
+	float BinWidth() const { return (m_max - m_min) / Bins(); }
+	float BinLow(int bin) const { return m_min + bin * BinWidth(); }
+	float BinCenter(int bin) const { return m_min + (bin + 0.5f) * BinWidth(); }
+
+	int BinOf(float v) const {
+		float f = (v - m_min) * (Bins() / (m_max - m_min));
+		if (!(f > 0)) return 0;
+		return f < Bins() ? int(f) : Bins() - 1;
+	}
+
+	/**
+	**************************************************************************
+	* \brief Approximate quantile, linear interpolation inside of the bin
+	* \param q		[IN] - quantile in [0, 1]
+	*/
+	float Quantile(double q) const {
+		if (m_total == 0) return m_min;
+		double rank = std::min(1., std::max(0., q)) * double(m_total);
+		uint64_t acc = 0;
+		for (int i = 0; i < Bins(); ++i) {
+			if (m_bins[i] && double(acc + m_bins[i]) >= rank) {
+				double inBin = (rank - double(acc)) / double(m_bins[i]);
+				return float(BinLow(i) + inBin * BinWidth());
+			}
+			acc += m_bins[i];
+		}
+		return m_max;
+	}
+
+	//Shannon entropy of the histogram in bits
+	double Entropy() const {
+		if (m_total == 0) return 0;
+		double res = 0, inv = 1. / double(m_total);
+		for (uint64_t c : m_bins) {
+			if (!c) continue;
+			double p = double(c) * inv;
+			res -= p * std::log2(p);
+		}
+		return res;
+	}
+
+	/**
+	**************************************************************************
+	* \brief Exact quantiles of the plane (order statistic floor(q * (N - 1)))
+	*
+	*	Instead of sorting all samples the plane is binned first, then only the samples
+	*	of the bins that contain requested ranks are collected and partially sorted.
+	*/
+	static std::vector<float> ExactQuantiles(const PlaneView& plane, const std::vector<double>& qs,
+		const RangeSpecification& range, CThreadPool* pool = nullptr) {
+		std::vector<float> res(qs.size(), 0.f);
+		if (plane.Empty() || qs.empty()) return res;
+
+		CHistogram hist(4096, range.min, range.max);
+		hist.Accumulate(plane, pool);
+
+		uint64_t n = hist.Total();
+		std::vector<uint64_t> ranks(qs.size());
+		std::vector<int> rankBins(qs.size());
+		std::vector<uint64_t> binStart(hist.Bins() + 1, 0);
+		for (int i = 0; i < hist.Bins(); ++i) binStart[i + 1] = binStart[i] + hist.Count(i);
+
+		std::vector<int> wanted(hist.Bins(), -1);
+		std::vector<std::vector<float>> values;
+		for (size_t i = 0; i < qs.size(); ++i) {
+			double q = std::min(1., std::max(0., qs[i]));
+			ranks[i] = std::min(n - 1, uint64_t(q * double(n - 1)));
+			int bin = int(std::upper_bound(binStart.begin(), binStart.end(), ranks[i]) - binStart.begin()) - 1;
+			rankBins[i] = bin;
+			if (wanted[bin] < 0) {
+				wanted[bin] = int(values.size());
+				values.emplace_back();
+				values.back().reserve((size_t)hist.Count(bin));
+			}
+		}
+
+		for (int y = 0; y < plane.height; ++y) {
+			const float* row = plane.Row(y);
+			for (int x = 0; x < plane.width; ++x) {
+				int w = wanted[hist.BinOf(row[x])];
+				if (w >= 0) values[w].push_back(row[x]);
+			}
+		}
+
+		for (size_t i = 0; i < qs.size(); ++i) {
+			std::vector<float>& v = values[wanted[rankBins[i]]];
+			size_t k = size_t(ranks[i] - binStart[rankBins[i]]);
+			std::nth_element(v.begin(), v.begin() + k, v.end());
+			res[i] = v[k];
+		}
+		return res;
+	}
+
+	static float ExactQuantile(const PlaneView& plane, double q, const RangeSpecification& range, CThreadPool* pool = nullptr) {
+		return ExactQuantiles(plane, { q }, range, pool)[0];
+	}
+
+private:
+	static const int subHistograms = 4;
+
+	void Merge(const std::vector<uint32_t>& local) {
+		int bins = Bins();
+		for (int s = 0; s < subHistograms; ++s) {
+			const uint32_t* sub = local.data() + (size_t)s * bins;
+			for (int i = 0; i < bins; ++i) {
+				m_bins[i] += sub[i];
+				m_total += sub[i];
+			}
+		}
+	}
+
+	//sample x goes to sub-histogram x % 4
+	void BinRow(const float* row, int width, uint32_t* sub) const {
+		int bins = Bins();
+		float scale = bins / (m_max - m_min);
+		uint32_t* h0 = sub;
+		uint32_t* h1 = sub + bins;
+		uint32_t* h2 = sub + 2 * bins;
+		uint32_t* h3 = sub + 3 * bins;
+		int x = 0;
+#ifdef VQMT_SSE2
+		const __m128 vmin = _mm_set1_ps(m_min), vscale = _mm_set1_ps(scale);
+		const __m128 zero = _mm_setzero_ps(), last = _mm_set1_ps(float(bins - 1));
+		alignas(16) int32_t idx[8];
+		for (; x + 8 <= width; x += 8) {
+			//max(NaN, 0) gives 0, so NaN goes to the first bin
+			__m128 f0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row + x), vmin), vscale);
+			__m128 f1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row + x + 4), vmin), vscale);
+			f0 = _mm_min_ps(_mm_max_ps(f0, zero), last);
+			f1 = _mm_min_ps(_mm_max_ps(f1, zero), last);
+			_mm_store_si128((__m128i*)idx, _mm_cvttps_epi32(f0));
+			_mm_store_si128((__m128i*)(idx + 4), _mm_cvttps_epi32(f1));
+			h0[idx[0]]++; h1[idx[1]]++; h2[idx[2]]++; h3[idx[3]]++;
+			h0[idx[4]]++; h1[idx[5]]++; h2[idx[6]]++; h3[idx[7]]++;
+		}
+#endif
+		for (; x < width; ++x) {
+			float f = (row[x] - m_min) * scale;
+			int i = f > 0 ? (f < bins ? int(f) : bins - 1) : 0;
+			sub[(size_t)(x & 3) * bins + i]++;
+		}
+	}
+
+private:
+	std::vector<uint64_t> m_bins;
+	float m_min = 0;
+	float m_max = 1;
+	uint64_t m_total = 0;
+};
@@ -0,0 +1,88 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file ImagePlane.h
+*  \brief Lightweight views and buffers for float planes used by PluginBase kernels.
+*/
+
+#pragma once
+
+#include <IMetricImage.h>
+
+#include <vector>
+#include <algorithm>
+
+/*!\brief Non-owning view of a float plane
+*
+*	width and height are the measured area (as given to ICustomPlugin::Init),
+*	stride is distance between rows in floats (IMetricImage::GetWidth()).
+*/
+struct PlaneView {
+	PlaneView() {}
+	PlaneView(const float* data, int width, int height, int stride)
+		: data(data), width(width), height(height), stride(stride) {}
+
+	/**
+	**************************************************************************
+	* \brief Creates view of component cc, cropped to width x height
+	* \return view with data == nullptr if plane is not present in the image
+	*/
+	static PlaneView FromImage(const IMetricImage* image, IMetricImage::ColorComponent cc, int width, int height) {
+		PlaneView res;
+		if (!image) return res;
+		res.data = image->GetComponent(cc);
+		res.stride = image->GetWidth();
+		res.width = std::min(width, image->GetWidth());
+		res.height = std::min(height, image->GetHeight());
+		return res;
+	}
+
+	const float* Row(int y) const { return data + (size_t)y * stride; }
+	bool Empty() const { return !data || width <= 0 || height <= 0; }
+
+	const float* data = nullptr;
+	int width = 0;
+	int height = 0;
+	int stride = 0;
+};
+
+/*!\brief Owning float plane, rows are padded to multiple of 4 floats
+*/
+class CPlaneBuffer {
+public:
+	CPlaneBuffer() {}
+	CPlaneBuffer(int width, int height) { Resize(width, height); }
+
+	void Resize(int width, int height) {
+		m_width = width;
+		m_height = height;
+		m_stride = (width + 3) & ~3;
+		m_data.resize((size_t)m_stride * height);
+	}
+
+	float* Row(int y) { return m_data.data() + (size_t)y * m_stride; }
+	const float* Row(int y) const { return m_data.data() + (size_t)y * m_stride; }
+
+	int Width() const { return m_width; }
+	int Height() const { return m_height; }
+	int Stride() const { return m_stride; }
+
+	PlaneView View() const { return PlaneView(m_data.data(), m_width, m_height, m_stride); }
+	operator PlaneView() const { return View(); }
+
+private:
+	std::vector<float> m_data;
+	int m_width = 0;
+	int m_height = 0;
+	int m_stride = 0;
+};
@@ -0,0 +1,330 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file MotionEstimation.h
+*  \brief Block-matching motion estimation between consecutive luma planes.
+*
+*	Planes are quantized to 8 bit using the range of the component, so SAD of a
+*	16-pixel row is one psadbw. Search is predictive: the best of zero, left,
+*	temporal (previous field) and coarse-level predictors is refined with a diamond or
+*	hexagon pattern. Block rows are processed in parallel on CThreadPool.
+*/
+
+#pragma once
+
+#include "Simd.h"
+#include "ImagePlane.h"
+#include "Pyramid.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+
+struct MotionVector {
+	int16_t x = 0;
+	int16_t y = 0;
+	uint32_t sad = 0;	//!< SAD of the block in 8-bit units
+};
+
+/*!\brief Motion vector field: one vector per block, row-major
+*
+*	Vector (x, y) of block at (bx, by) means that the block of the current frame
+*	at (OriginX(bx), OriginY(by)) matches previous frame at that position + (x, y).
+*	The origin is (bx * blockSize, by * blockSize), except for the last column and row
+*	of a frame that is not a multiple of blockSize: these blocks are shifted inward to
+*	end at the frame border (and overlap their neighbours), unless the frame is smaller
+*	than a block.
+*/
+struct MotionField {
+	int blocksX = 0;
+	int blocksY = 0;
+	int blockSize = 0;
+	int width = 0;		//!< size of the plane the field was estimated on
+	int height = 0;
+	std::vector<MotionVector> vectors;
+
+	const MotionVector& At(int bx, int by) const { return vectors[(size_t)by * blocksX + bx]; }
+	MotionVector& At(int bx, int by) { return vectors[(size_t)by * blocksX + bx]; }
+	bool Empty() const { return vectors.empty(); }
+
+	int OriginX(int bx) const { return std::max(0, std::min(bx * blockSize, width - blockSize)); }
+	int OriginY(int by) const { return std::max(0, std::min(by * blockSize, height - blockSize)); }
+};
+
+enum MotionSearchPattern {
+	ME_DIAMOND = 0,
+	ME_HEXAGON = 1
+};
+
+struct MotionEstimationParams {
+	int blockSize = 16;				//!< 8 or 16
+	int searchRange = 32;			//!< maximal |x| and |y| of vector, in pixels of full resolution
+	MotionSearchPattern pattern = ME_HEXAGON;
+	int pyramidLevels = 0;			//!< 0 - single level search, N - N additional 2:1 levels for coarse-to-fine
+};
+
+/*!\brief Estimates motion between consecutive frames
+*
+*	Usage: call Estimate() for each frame in display order. The first call returns
+*	empty field, every next call returns vectors of current frame relative to the previous one.
+*/
+class CMotionEstimator {
+public:
+	CMotionEstimator(const MotionEstimationParams& params = MotionEstimationParams(), CThreadPool* pool = nullptr)
+		: m_params(params), m_pool(pool)
+	{
+		m_params.blockSize = m_params.blockSize <= 8 ? 8 : 16;
+		m_params.searchRange = std::max(1, m_params.searchRange);
+		m_params.pyramidLevels = std::max(0, m_params.pyramidLevels);
+	}
+
+	/**
+	**************************************************************************
+	* \brief Processes next frame
+	* \param luma			[IN] - luma plane of current frame
+	* \param range			[IN] - range of the plane values (IMetricImage::GetRanges()[IMetricImage::YYUV])
+	* \return field of the current frame relative to the previous one, empty for the first frame
+	*/
+	const MotionField& Estimate(const PlaneView& luma, const RangeSpecification& range) {
+		int levels = m_params.pyramidLevels + 1;
+		CPyramid pyramid;
+		if (levels > 1) pyramid.Build(luma, levels, PYR_BINOMIAL5);
+		levels = levels > 1 ? pyramid.Levels() : 1;
+
+		std::swap(m_prev, m_cur);
+		m_cur.resize(levels);
+		for (int l = 0; l < levels; ++l) {
+			int range_l = std::max(1, m_params.searchRange >> l);
+			m_cur[l].Load(l == 0 ? luma : pyramid.Level(l), range, range_l + m_params.blockSize);
+		}
+
+		if (m_prev.size() != m_cur.size() || m_prev[0].width != m_cur[0].width || m_prev[0].height != m_cur[0].height) {
+			m_fields.clear();
+			m_result = MotionField();
+			return m_result;
+		}
+
+		std::vector<MotionField> fields(levels);
+		for (int l = levels - 1; l >= 0; --l) {
+			SearchLevel(l, fields[l], l + 1 < levels ? &fields[l + 1] : nullptr,
+				m_fields.size() == size_t(levels) ? &m_fields[l] : nullptr);
+		}
+		m_fields.swap(fields);
+		m_result = m_fields[0];
+		return m_result;
+	}
+
+	//forgets previous frame
+	void Reset() {
+		m_prev.clear();
+		m_cur.clear();
+		m_fields.clear();
+		m_result = MotionField();
+	}
+
+	const MotionEstimationParams& GetParams() const { return m_params; }
+
+	/**
+	**************************************************************************
+	* \brief SAD of square block of 8-bit samples
+	*/
+	static uint32_t BlockSAD(const uint8_t* a, int strideA, const uint8_t* b, int strideB, int blockSize) {
+#ifdef VQMT_SSE2
+		__m128i acc = _mm_setzero_si128();
+		if (blockSize == 16) {
+			for (int y = 0; y < 16; ++y) {
+				__m128i ra = _mm_loadu_si128((const __m128i*)(a + (size_t)y * strideA));
+				__m128i rb = _mm_loadu_si128((const __m128i*)(b + (size_t)y * strideB));
+				acc = _mm_add_epi64(acc, _mm_sad_epu8(ra, rb));
+			}
+			return uint32_t(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+		}
+		if (blockSize == 8) {
+			for (int y = 0; y < 8; y += 2) {
+				__m128i ra = _mm_unpacklo_epi64(
+					_mm_loadl_epi64((const __m128i*)(a + (size_t)y * strideA)),
+					_mm_loadl_epi64((const __m128i*)(a + (size_t)(y + 1) * strideA)));
+				__m128i rb = _mm_unpacklo_epi64(
+					_mm_loadl_epi64((const __m128i*)(b + (size_t)y * strideB)),
+					_mm_loadl_epi64((const __m128i*)(b + (size_t)(y + 1) * strideB)));
+				acc = _mm_add_epi64(acc, _mm_sad_epu8(ra, rb));
+			}
+			return uint32_t(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+		}
+#endif
+		uint32_t sad = 0;
+		for (int y = 0; y < blockSize; ++y) {
+			const uint8_t* ra = a + (size_t)y * strideA;
+			const uint8_t* rb = b + (size_t)y * strideB;
+			for (int x = 0; x < blockSize; ++x) sad += (uint32_t)std::abs(int(ra[x]) - int(rb[x]));
+		}
+		return sad;
+	}
+
+private:
+	//8-bit plane with replicated borders, so any vector inside search range can be read without checks
+	struct PaddedPlane {
+		std::vector<uint8_t> buffer;
+		int width = 0, height = 0, stride = 0, pad = 0;
+
+		const uint8_t* At(int x, int y) const {
+			return buffer.data() + (size_t)(y + pad) * stride + (x + pad);
+		}
+
+		void Load(const PlaneView& src, const RangeSpecification& range, int padding) {
+			width = src.width;
+			height = src.height;
+			pad = padding;
+			stride = (width + 2 * pad + 15) & ~15;
+			buffer.resize((size_t)stride * (height + 2 * pad));
+
+			float scale = range.max > range.min ? 255.f / (range.max - range.min) : 1.f;
+			float offset = -range.min * scale;
+			for (int y = 0; y < height; ++y) {
+				uint8_t* dst = buffer.data() + (size_t)(y + pad) * stride + pad;
+				Quantize(src.Row(y), dst, width, scale, offset);
+				std::fill(dst - pad, dst, dst[0]);
+				std::fill(dst + width, dst + width + pad, dst[width - 1]);
+			}
+			for (int y = 0; y < pad; ++y) {
+				std::copy_n(buffer.data() + (size_t)pad * stride, stride, buffer.data() + (size_t)y * stride);
+				std::copy_n(buffer.data() + (size_t)(pad + height - 1) * stride, stride,
+					buffer.data() + (size_t)(pad + height + y) * stride);
+			}
+		}
+
+		static void Quantize(const float* src, uint8_t* dst, int width, float scale, float offset) {
+			int x = 0;
+#ifdef VQMT_SSE2
+			const __m128 s = _mm_set1_ps(scale), o = _mm_set1_ps(offset);
+			for (; x + 16 <= width; x += 16) {
+				__m128i i0 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + x + 0), s), o));
+				__m128i i1 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + x + 4), s), o));
+				__m128i i2 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + x + 8), s), o));
+				__m128i i3 = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + x + 12), s), o));
+				__m128i p = _mm_packus_epi16(_mm_packs_epi32(i0, i1), _mm_packs_epi32(i2, i3));
+				_mm_storeu_si128((__m128i*)(dst + x), p);
+			}
+#endif
+			for (; x < width; ++x) {
+				float v = src[x] * scale + offset;
+				dst[x] = (uint8_t)std::min(255.f, std::max(0.f, v + 0.5f));
+			}
+		}
+	};
+
+	struct BlockSearch {
+		const PaddedPlane* cur;
+		const PaddedPlane* ref;
+		int x0, y0, blockSize, range;
+		MotionVector best;
+
+		//SAD of the vector, or UINT_MAX if out of range
+		uint32_t Cost(int vx, int vy) const {
+			if (std::abs(vx) > range || std::abs(vy) > range) return UINT_MAX;
+			return BlockSAD(cur->At(x0, y0), cur->stride, ref->At(x0 + vx, y0 + vy), ref->stride, blockSize);
+		}
+
+		bool Try(int vx, int vy) {
+			uint32_t sad = Cost(vx, vy);
+			if (sad >= best.sad) return false;
+			best.x = int16_t(vx);
+			best.y = int16_t(vy);
+			best.sad = sad;
+			return true;
+		}
+
+		void Refine(MotionSearchPattern pattern) {
+			static const int largeDiamond[8][2] = { {0,-2}, {1,-1}, {2,0}, {1,1}, {0,2}, {-1,1}, {-2,0}, {-1,-1} };
+			static const int hexagon[6][2] = { {-2,0}, {-1,-2}, {1,-2}, {2,0}, {1,2}, {-1,2} };
+			static const int smallDiamond[4][2] = { {0,-1}, {1,0}, {0,1}, {-1,0} };
+
+			const int (*points)[2] = pattern == ME_HEXAGON ? hexagon : largeDiamond;
+			int count = pattern == ME_HEXAGON ? 6 : 8;
+
+			//each step moves the center, so the loop is bounded by the search window
+			for (int steps = 0; steps < 4 * range + 4; ++steps) {
+				int cx = best.x, cy = best.y;
+				for (int i = 0; i < count; ++i) Try(cx + points[i][0], cy + points[i][1]);
+				if (best.x == cx && best.y == cy) break;
+			}
+			int cx = best.x, cy = best.y;
+			for (int i = 0; i < 4; ++i) Try(cx + smallDiamond[i][0], cy + smallDiamond[i][1]);
+		}
+	};
+
+	void SearchLevel(int level, MotionField& field, const MotionField* coarse, const MotionField* temporal) {
+		const PaddedPlane& cur = m_cur[level];
+		const PaddedPlane& ref = m_prev[level];
+		int bs = m_params.blockSize;
+		int range = std::max(1, m_params.searchRange >> level);
+
+		field.blockSize = bs;
+		field.width = cur.width;
+		field.height = cur.height;
+		field.blocksX = (cur.width + bs - 1) / bs;
+		field.blocksY = (cur.height + bs - 1) / bs;
+		field.vectors.assign((size_t)field.blocksX * field.blocksY, MotionVector());
+
+		auto searchRow = [&](int by) {
+			for (int bx = 0; bx < field.blocksX; ++bx) {
+				BlockSearch s;
+				s.cur = &cur;
+				s.ref = &ref;
+				//blocks on the right/bottom border are shifted inside the frame when it's possible
+				s.x0 = field.OriginX(bx);
+				s.y0 = field.OriginY(by);
+				s.blockSize = bs;
+				s.range = range;
+				s.best.sad = s.Cost(0, 0);
+
+				//zero vector of a static block is good enough
+				if (s.best.sad > uint32_t(bs * bs / 2)) {
+					if (bx > 0) {
+						const MotionVector& left = field.At(bx - 1, by);
+						s.Try(left.x, left.y);
+					}
+					if (temporal && temporal->blocksX == field.blocksX && temporal->blocksY == field.blocksY) {
+						const MotionVector& t = temporal->At(bx, by);
+						s.Try(t.x, t.y);
+					}
+					if (coarse && !coarse->Empty()) {
+						const MotionVector& c = coarse->At(std::min(bx / 2, coarse->blocksX - 1), std::min(by / 2, coarse->blocksY - 1));
+						s.Try(c.x * 2, c.y * 2);
+					}
+					s.Refine(m_params.pattern);
+				}
+				field.At(bx, by) = s.best;
+			}
+		};
+
+		if (m_pool) {
+			m_pool->ParallelFor(field.blocksY, searchRow);
+		}
+		else {
+			for (int by = 0; by < field.blocksY; ++by) searchRow(by);
+		}
+	}
+
+private:
+	MotionEstimationParams m_params;
+	CThreadPool* m_pool;
+
+	std::vector<PaddedPlane> m_prev;
+	std::vector<PaddedPlane> m_cur;
+	std::vector<MotionField> m_fields;
+	MotionField m_result;
+};
@@ -0,0 +1,322 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file Pyramid.h
+*  \brief Multi-resolution (2:1) pyramid of a float plane and per-frame pyramid cache.
+*
+*	All levels are produced in one pass over the source plane: every source row is
+*	low-passed and decimated horizontally once, kept in a small ring of rows, and each
+*	time the ring holds enough rows, a row of the next level is emitted and pushed
+*	to the next level in the same way. So the source is read exactly once and the
+*	working set is a few rows per level.
+*/
+
+#pragma once
+
+#include "Simd.h"
+#include "ImagePlane.h"
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <cstdint>
+#include <list>
+#include <algorithm>
+
+/*!\brief Anti-aliasing filter used before 2:1 decimation
+*/
+enum PyramidFilter {
+	PYR_BINOMIAL5 = 0,	//!< [1 4 6 4 1]/16 centered on even samples (Burt-Adelson)
+	PYR_BOX2 = 1		//!< [1 1]/2, the filter of the reference MS-SSIM implementation
+};
+
+/*!\brief 2:1 image pyramid. Level 0 is the source plane itself (not copied).
+*
+*	Level k+1 has size ((w_k + 1) / 2) x ((h_k + 1) / 2). Borders are extended with
+*	half-sample symmetry.
+*/
+class CPyramid {
+public:
+	CPyramid() {}
+	CPyramid(const PlaneView& src, int levels, PyramidFilter filter = PYR_BINOMIAL5) {
+		Build(src, levels, filter);
+	}
+
+	/**
+	**************************************************************************
+	* \brief Builds levels 1..levels-1 from src
+	*
+	*	Number of levels is reduced if the plane becomes smaller than 1x1.
+	*	Buffers are reused between calls with the same geometry.
+	*/
+	void Build(const PlaneView& src, int levels, PyramidFilter filter = PYR_BINOMIAL5) {
+		m_filter = filter;
+		m_source = src;
+
+		int maxLevels = 1;
+		for (int w = src.width, h = src.height; (w > 1 || h > 1) && maxLevels < levels; ++maxLevels) {
+			w = (w + 1) / 2;
+			h = (h + 1) / 2;
+		}
+		if (src.Empty()) maxLevels = 0;
+		m_levels.resize(std::max(0, maxLevels - 1));
+
+		int w = src.width, h = src.height;
+		for (CPlaneBuffer& level : m_levels) {
+			w = (w + 1) / 2;
+			h = (h + 1) / 2;
+			if (level.Width() != w || level.Height() != h) level.Resize(w, h);
+		}
+		if (m_levels.empty()) return;
+
+		const Filter& f = GetFilter();
+		m_rings.resize(m_levels.size());
+		m_nextRow.assign(m_levels.size(), 0);
+		for (size_t k = 0; k < m_levels.size(); ++k) {
+			m_rings[k].Resize(m_levels[k].Width(), f.taps);
+		}
+
+		for (int y = 0; y < src.height; ++y) {
+			PushRow(0, src.Row(y), src.width, src.height, y);
+		}
+		Finish(0, src.height);
+	}
+
+	int Levels() const { return m_source.Empty() ? 0 : int(m_levels.size()) + 1; }
+	PyramidFilter GetFilterType() const { return m_filter; }
+
+	PlaneView Level(int k) const {
+		if (k == 0) return m_source;
+		return m_levels[k - 1].View();
+	}
+
+private:
+	struct Filter {
+		int taps;
+		int offset;
+		float coef[5];
+	};
+
+	const Filter& GetFilter() const {
+		static const Filter binomial = { 5, -2, { 1.f / 16, 4.f / 16, 6.f / 16, 4.f / 16, 1.f / 16 } };
+		static const Filter box = { 2, 0, { 0.5f, 0.5f } };
+		return m_filter == PYR_BOX2 ? box : binomial;
+	}
+
+	//index of the last source row needed for output row yo
+	int LastNeeded(int yo) const {
+		const Filter& f = GetFilter();
+		return 2 * yo + f.offset + f.taps - 1;
+	}
+
+	void PushRow(size_t k, const float* row, int srcWidth, int srcHeight, int y) {
+		CPlaneBuffer& ring = m_rings[k];
+		DecimateRow(row, srcWidth, ring.Row(y % ring.Height()), ring.Width());
+
+		int outHeight = m_levels[k].Height();
+		while (m_nextRow[k] < outHeight && LastNeeded(m_nextRow[k]) <= y) {
+			EmitRow(k, m_nextRow[k]++, srcHeight);
+		}
+	}
+
+	void Finish(size_t k, int srcHeight) {
+		int outHeight = m_levels[k].Height();
+		while (m_nextRow[k] < outHeight) {
+			EmitRow(k, m_nextRow[k]++, srcHeight);
+		}
+		if (k + 1 < m_levels.size()) Finish(k + 1, outHeight);
+	}
+
+	void EmitRow(size_t k, int yo, int srcHeight) {
+		const Filter& f = GetFilter();
+		CPlaneBuffer& ring = m_rings[k];
+		CPlaneBuffer& out = m_levels[k];
+
+		const float* rows[5];
+		for (int t = 0; t < f.taps; ++t) {
+			int y = VQMTsimd::Reflect(2 * yo + f.offset + t, srcHeight);
+			rows[t] = ring.Row(y % ring.Height());
+		}
+		float* dst = out.Row(yo);
+		FilterColumns(rows, f, dst, out.Width());
+
+		if (k + 1 < m_levels.size()) PushRow(k + 1, dst, out.Width(), out.Height(), yo);
+	}
+
+	static void FilterColumns(const float* const* rows, const Filter& f, float* dst, int width) {
+		int x = 0;
+#ifdef VQMT_SSE2
+		for (; x + 4 <= width; x += 4) {
+			__m128 acc = _mm_mul_ps(_mm_loadu_ps(rows[0] + x), _mm_set1_ps(f.coef[0]));
+			for (int t = 1; t < f.taps; ++t) {
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(rows[t] + x), _mm_set1_ps(f.coef[t])));
+			}
+			_mm_storeu_ps(dst + x, acc);
+		}
+#endif
+		for (; x < width; ++x) {
+			float acc = 0;
+			for (int t = 0; t < f.taps; ++t) acc += rows[t][x] * f.coef[t];
+			dst[x] = acc;
+		}
+	}
+
+	float DecimateScalar(const float* src, int srcWidth, int xo) const {
+		const Filter& f = GetFilter();
+		float acc = 0;
+		for (int t = 0; t < f.taps; ++t) {
+			acc += src[VQMTsimd::Reflect(2 * xo + f.offset + t, srcWidth)] * f.coef[t];
+		}
+		return acc;
+	}
+
+	void DecimateRow(const float* src, int srcWidth, float* dst, int dstWidth) const {
+		int x = 0;
+#ifdef VQMT_SSE2
+		if (m_filter == PYR_BINOMIAL5) {
+			//first output needs src[-2..2]
+			for (; x < std::min(1, dstWidth); ++x) dst[x] = DecimateScalar(src, srcWidth, x);
+
+			const __m128 c0 = _mm_set1_ps(1.f / 16), c1 = _mm_set1_ps(4.f / 16), c2 = _mm_set1_ps(6.f / 16);
+			for (; 2 * x + 9 < srcWidth && x + 4 <= dstWidth; x += 4) {
+				const float* p = src + 2 * x - 2;
+				__m128 a = _mm_loadu_ps(p), b = _mm_loadu_ps(p + 4);
+				__m128 c = _mm_loadu_ps(p + 2), d = _mm_loadu_ps(p + 6);
+				__m128 e = _mm_loadu_ps(p + 8);
+
+				__m128 t0 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+				__m128 t1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+				__m128 t2 = _mm_shuffle_ps(c, d, _MM_SHUFFLE(2, 0, 2, 0));
+				__m128 t3 = _mm_shuffle_ps(c, d, _MM_SHUFFLE(3, 1, 3, 1));
+				__m128 t4 = _mm_shuffle_ps(b, e, _MM_SHUFFLE(2, 0, 2, 0));
+
+				__m128 acc = _mm_mul_ps(_mm_add_ps(t0, t4), c0);
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_add_ps(t1, t3), c1));
+				acc = _mm_add_ps(acc, _mm_mul_ps(t2, c2));
+				_mm_storeu_ps(dst + x, acc);
+			}
+		}
+		else {
+			const __m128 half = _mm_set1_ps(0.5f);
+			for (; 2 * x + 7 < srcWidth && x + 4 <= dstWidth; x += 4) {
+				__m128 a = _mm_loadu_ps(src + 2 * x), b = _mm_loadu_ps(src + 2 * x + 4);
+				__m128 even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+				__m128 odd = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+				_mm_storeu_ps(dst + x, _mm_mul_ps(_mm_add_ps(even, odd), half));
+			}
+		}
+#endif
+		for (; x < dstWidth; ++x) dst[x] = DecimateScalar(src, srcWidth, x);
+	}
+
+private:
+	PyramidFilter m_filter = PYR_BINOMIAL5;
+	PlaneView m_source;
+	std::vector<CPlaneBuffer> m_levels;
+
+	//horizontally decimated rows of the previous level, indexed by row % taps
+	std::vector<CPlaneBuffer> m_rings;
+	std::vector<int> m_nextRow;
+};
+
+/*!\brief Shares pyramids of the same frame between plugins of one plugin module
+*
+*	Pyramid is keyed by image, frame number, color component, measured size, filter and
+*	levels. The frame number is counted by the consumer from Init, so plugins measuring
+*	the same frame of the same image share one pyramid, and a consumer that is a frame
+*	behind the others never gets a pyramid of another frame from a reused image buffer.
+*	The cache lock is held only to find or claim an entry: the pyramid is built outside
+*	it, and other consumers of the same entry wait for that build only.
+*
+*	The cache is a static object, so it is shared only inside one .vmp module.
+*/
+class CPyramidCache {
+public:
+	static std::shared_ptr<const CPyramid> Get(const IMetricImage* image, int64_t frame, IMetricImage::ColorComponent cc,
+		int width, int height, int levels, PyramidFilter filter) {
+		CPyramidCache& cache = Instance();
+		PlaneView src = PlaneView::FromImage(image, cc, width, height);
+
+		std::promise<std::shared_ptr<const CPyramid>> build;
+		std::shared_future<std::shared_ptr<const CPyramid>> pyramid;
+		bool owner = false;
+		{
+			std::lock_guard<std::mutex> lock(cache.m_lock);
+			auto iter = std::find_if(cache.m_entries.begin(), cache.m_entries.end(), [&](const Entry& e) {
+				return e.image == image && e.frame == frame && e.cc == cc && e.data == src.data && e.width == src.width &&
+					e.height == src.height && e.levels == levels && e.filter == filter;
+			});
+			if (iter != cache.m_entries.end()) {
+				cache.m_entries.splice(cache.m_entries.begin(), cache.m_entries, iter);
+				pyramid = iter->pyramid;
+			}
+			else {
+				Entry entry;
+				entry.image = image;
+				entry.frame = frame;
+				entry.cc = cc;
+				entry.data = src.data;
+				entry.width = src.width;
+				entry.height = src.height;
+				entry.levels = levels;
+				entry.filter = filter;
+				entry.pyramid = build.get_future().share();
+				pyramid = entry.pyramid;
+				owner = true;
+
+				cache.m_entries.push_front(entry);
+				if (cache.m_entries.size() > maxEntries) cache.m_entries.pop_back();
+			}
+		}
+
+		//the consumer that claimed the entry builds, the others wait in get()
+		if (owner) {
+			try {
+				build.set_value(std::make_shared<CPyramid>(src, levels, filter));
+			}
+			catch (...) {
+				build.set_exception(std::current_exception());
+			}
+		}
+		return pyramid.get();
+	}
+
+	//drops all cached pyramids, call from ICustomPlugin::Stop()
+	static void Clear() {
+		CPyramidCache& cache = Instance();
+		std::lock_guard<std::mutex> lock(cache.m_lock);
+		cache.m_entries.clear();
+	}
+
+private:
+	static const size_t maxEntries = 16;
+
+	struct Entry {
+		const IMetricImage* image;
+		int64_t frame;
+		IMetricImage::ColorComponent cc;
+		const float* data;
+		int width, height, levels;
+		PyramidFilter filter;
+		std::shared_future<std::shared_ptr<const CPyramid>> pyramid;
+	};
+
+	static CPyramidCache& Instance() {
+		static CPyramidCache obj;
+		return obj;
+	}
+
+	std::mutex m_lock;
+	std::list<Entry> m_entries;
+};
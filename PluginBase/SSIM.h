@@ -0,0 +1,170 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file SSIM.h
+*  \brief Fused SSIM kernel (mean, variance and covariance in one pass).
+*
+*	Window moments come from CWindowStats row by row and the SSIM formula is applied
+*	to each row while it is in cache, no full-size temporaries are allocated.
+*	Only windows completely inside of the image are used ('valid' filtering as in
+*	the reference implementation by Z. Wang).
+*/
+
+#pragma once
+
+#include "Simd.h"
+#include "ImagePlane.h"
+#include "ThreadPool.h"
+#include "WindowStats.h"
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+enum SSIMWindow {
+	SSIM_GAUSSIAN11 = 0,	//!< 11x11 Gaussian, sigma 1.5
+	SSIM_BOX8 = 1			//!< 8x8 box
+};
+
+struct SSIMResult {
+	double ssim = 1.;	//!< mean SSIM
+	double cs = 1.;		//!< mean contrast-structure term (used by MS-SSIM)
+	uint64_t count = 0;	//!< number of windows
+};
+
+/*!\brief SSIM of two planes
+*/
+class CSSIM {
+public:
+	explicit CSSIM(SSIMWindow window = SSIM_GAUSSIAN11) { SetWindow(window); }
+
+	void SetWindow(SSIMWindow window) {
+		m_window = window;
+		m_stats.SetWeights(window == SSIM_BOX8 ? CWindowStats::Box(8) : CWindowStats::Gaussian(11, 1.5));
+	}
+
+	SSIMWindow GetWindow() const { return m_window; }
+	int WindowSize() const { return m_stats.Size(); }
+
+	/**
+	**************************************************************************
+	* \brief Computes SSIM over common area of planes
+	* \param peak		[IN] - dynamic range of values (L in SSIM constants)
+	* \param pool		[IN] - optional pool, output rows are split into stripes
+	* \param map		[OUT] - optional SSIM map of size (w - win + 1) x (h - win + 1)
+	*/
+	SSIMResult Compute(const PlaneView& a, const PlaneView& b, float peak, CThreadPool* pool = nullptr, CPlaneBuffer* map = nullptr) const {
+		SSIMResult res;
+		int width = std::min(a.width, b.width);
+		int height = std::min(a.height, b.height);
+		if (a.Empty() || b.Empty()) return res;
+
+		float c1 = (0.01f * peak) * (0.01f * peak);
+		float c2 = (0.03f * peak) * (0.03f * peak);
+
+		int win = WindowSize();
+		if (width < win || height < win) {
+			//image is smaller than window: one window over the whole image
+			if (map) map->Resize(0, 0);
+			return GlobalSSIM(a, b, width, height, c1, c2);
+		}
+
+		int outWidth = width - win + 1;
+		int outHeight = height - win + 1;
+		if (map) map->Resize(outWidth, outHeight);
+
+		std::vector<double> sumSSIM(stripeCount, 0.), sumCS(stripeCount, 0.);
+		m_stats.Run(a, b, stripeCount, pool, [&](int s, int y, const WindowMoments& m) {
+			Row(m, c1, c2, map ? map->Row(y) : nullptr, sumSSIM[s], sumCS[s]);
+		});
+
+		double ssim = 0, cs = 0;
+		for (int s = 0; s < stripeCount; ++s) {
+			ssim += sumSSIM[s];
+			cs += sumCS[s];
+		}
+		res.count = (uint64_t)outWidth * outHeight;
+		res.ssim = ssim / double(res.count);
+		res.cs = cs / double(res.count);
+		return res;
+	}
+
+private:
+	//fixed number of stripes keeps summation order (and result) independent of the pool size
+	static const int stripeCount = 32;
+
+	static void Row(const WindowMoments& m, float c1, float c2, float* map, double& sumSSIM, double& sumCS) {
+		int x = 0;
+#ifdef VQMT_SSE2
+		__m128d accSSIM = _mm_setzero_pd(), accCS = _mm_setzero_pd();
+		const __m128 vc1 = _mm_set1_ps(c1), vc2 = _mm_set1_ps(c2), two = _mm_set1_ps(2.f);
+		for (; x + 4 <= m.width; x += 4) {
+			__m128 ma = _mm_loadu_ps(m.meanA + x), mb = _mm_loadu_ps(m.meanB + x);
+			__m128 mab = _mm_mul_ps(ma, mb);
+			__m128 maa = _mm_mul_ps(ma, ma);
+			__m128 mbb = _mm_mul_ps(mb, mb);
+			__m128 varSum = _mm_sub_ps(_mm_add_ps(_mm_loadu_ps(m.sqA + x), _mm_loadu_ps(m.sqB + x)), _mm_add_ps(maa, mbb));
+			__m128 cov = _mm_sub_ps(_mm_loadu_ps(m.prod + x), mab);
+
+			__m128 l = _mm_div_ps(_mm_add_ps(_mm_mul_ps(two, mab), vc1), _mm_add_ps(_mm_add_ps(maa, mbb), vc1));
+			__m128 cs = _mm_div_ps(_mm_add_ps(_mm_mul_ps(two, cov), vc2), _mm_add_ps(varSum, vc2));
+			__m128 ssim = _mm_mul_ps(l, cs);
+			if (map) _mm_storeu_ps(map + x, ssim);
+			VQMTsimd::AccumulateDouble(accSSIM, ssim);
+			VQMTsimd::AccumulateDouble(accCS, cs);
+		}
+		sumSSIM += VQMTsimd::HorizontalSum(accSSIM);
+		sumCS += VQMTsimd::HorizontalSum(accCS);
+#endif
+		for (; x < m.width; ++x) {
+			float ma = m.meanA[x], mb = m.meanB[x];
+			float cov = m.prod[x] - ma * mb;
+			float varSum = m.sqA[x] + m.sqB[x] - ma * ma - mb * mb;
+			float l = (2 * ma * mb + c1) / (ma * ma + mb * mb + c1);
+			float cs = (2 * cov + c2) / (varSum + c2);
+			if (map) map[x] = l * cs;
+			sumSSIM += l * cs;
+			sumCS += cs;
+		}
+	}
+
+	static SSIMResult GlobalSSIM(const PlaneView& a, const PlaneView& b, int width, int height, float c1, float c2) {
+		SSIMResult res;
+		if (width <= 0 || height <= 0) return res;
+		double sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+		for (int y = 0; y < height; ++y) {
+			const float* ra = a.Row(y);
+			const float* rb = b.Row(y);
+			for (int x = 0; x < width; ++x) {
+				sa += ra[x];
+				sb += rb[x];
+				saa += double(ra[x]) * ra[x];
+				sbb += double(rb[x]) * rb[x];
+				sab += double(ra[x]) * rb[x];
+			}
+		}
+		double n = double(width) * height;
+		double ma = sa / n, mb = sb / n;
+		double cov = sab / n - ma * mb;
+		double varSum = saa / n + sbb / n - ma * ma - mb * mb;
+		res.cs = (2 * cov + c2) / (varSum + c2);
+		res.ssim = (2 * ma * mb + c1) / (ma * ma + mb * mb + c1) * res.cs;
+		res.count = 1;
+		return res;
+	}
+
+private:
+	SSIMWindow m_window = SSIM_GAUSSIAN11;
+	CWindowStats m_stats;
+};
@@ -0,0 +1,254 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file Simd.h
+*  \brief SSE2 detection and small helpers shared by PluginBase kernels.
+*
+*	Every kernel has a scalar path, SSE2 path is used when VQMT_SSE2 is defined.
+*	Define VQMT_NO_SIMD to force scalar code (useful to check results).
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if !defined(VQMT_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define VQMT_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#define VQMT_FORCEINLINE __forceinline
+#else
+#define VQMT_FORCEINLINE inline __attribute__((always_inline))
+#endif
+
+namespace VQMTsimd {
+#ifdef VQMT_SSE2
+	//sum of 4 floats of the register
+	VQMT_FORCEINLINE float HorizontalSum(__m128 v) {
+		__m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+		__m128 sums = _mm_add_ps(v, shuf);
+		shuf = _mm_movehl_ps(shuf, sums);
+		sums = _mm_add_ss(sums, shuf);
+		return _mm_cvtss_f32(sums);
+	}
+
+	//sum of 2 doubles of the register
+	VQMT_FORCEINLINE double HorizontalSum(__m128d v) {
+		return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+	}
+
+	//adds 4 floats to 2 double accumulators without loosing precision
+	VQMT_FORCEINLINE void AccumulateDouble(__m128d& acc, __m128 v) {
+		acc = _mm_add_pd(acc, _mm_cvtps_pd(v));
+		acc = _mm_add_pd(acc, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+	}
+
+	VQMT_FORCEINLINE __m128 Abs(__m128 v) {
+		return _mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+	}
+
+	//natural logarithm of positive normal numbers (Cephes polynomial, relative error ~1e-7)
+	VQMT_FORCEINLINE __m128 Log(__m128 x) {
+		const __m128 one = _mm_set1_ps(1.f);
+		x = _mm_max_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x00800000)));
+
+		__m128i emm0 = _mm_srli_epi32(_mm_castps_si128(x), 23);
+		x = _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(~0x7f800000)));
+		x = _mm_or_ps(x, _mm_set1_ps(0.5f));
+		__m128 e = _mm_add_ps(_mm_cvtepi32_ps(_mm_sub_epi32(emm0, _mm_set1_epi32(0x7f))), one);
+
+		//mantissa in [sqrt(0.5), sqrt(2)): x - 1 or 2x - 1
+		__m128 mask = _mm_cmplt_ps(x, _mm_set1_ps(0.707106781186547524f));
+		__m128 tmp = _mm_and_ps(x, mask);
+		x = _mm_sub_ps(x, one);
+		e = _mm_sub_ps(e, _mm_and_ps(one, mask));
+		x = _mm_add_ps(x, tmp);
+
+		__m128 z = _mm_mul_ps(x, x);
+		__m128 y = _mm_set1_ps(7.0376836292E-2f);
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.1514610310E-1f));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.1676998740E-1f));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.2420140846E-1f));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.4249322787E-1f));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.6668057665E-1f));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(2.0000714765E-1f));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-2.4999993993E-1f));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(3.3333331174E-1f));
+		y = _mm_mul_ps(_mm_mul_ps(y, x), z);
+
+		y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(-2.12194440e-4f)));
+		y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+		x = _mm_add_ps(x, y);
+		return _mm_add_ps(x, _mm_mul_ps(e, _mm_set1_ps(0.693359375f)));
+	}
+
+	//natural exponent (Cephes polynomial, relative error ~2e-7), argument is clamped to [-87, 88]
+	VQMT_FORCEINLINE __m128 Exp(__m128 x) {
+		const __m128 one = _mm_set1_ps(1.f);
+		x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-87.f)), _mm_set1_ps(88.f));
+
+		//x = n ln2 + r, |r| <= ln2 / 2
+		__m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f));
+		__m128 n = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+		n = _mm_sub_ps(n, _mm_and_ps(_mm_cmpgt_ps(n, fx), one));
+		x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(0.693359375f)));
+		x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(-2.12194440e-4f)));
+
+		__m128 y = _mm_set1_ps(1.9875691500E-4f);
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507E-3f));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073E-3f));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894E-2f));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459E-1f));
+		y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201E-1f));
+		y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, _mm_mul_ps(x, x)), x), one);
+
+		__m128i e = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(0x7f)), 23);
+		return _mm_mul_ps(y, _mm_castsi128_ps(e));
+	}
+
+	//x^p for x >= 0 (0 for x = 0)
+	VQMT_FORCEINLINE __m128 Pow(__m128 x, float p) {
+		__m128 positive = _mm_cmpgt_ps(x, _mm_setzero_ps());
+		return _mm_and_ps(positive, Exp(_mm_mul_ps(Log(x), _mm_set1_ps(p))));
+	}
+
+	//table[i] + frac * (table[i + 1] - table[i]) for 4 indices of a table
+	VQMT_FORCEINLINE __m128 Gather(const float* table, __m128i index, __m128 frac) {
+		alignas(16) int32_t idx[4];
+		alignas(16) float lo[4], hi[4];
+		_mm_store_si128((__m128i*)idx, index);
+		for (int k = 0; k < 4; ++k) {
+			lo[k] = table[idx[k]];
+			hi[k] = table[idx[k] + 1];
+		}
+		__m128 vlo = _mm_load_ps(lo);
+		return _mm_add_ps(vlo, _mm_mul_ps(frac, _mm_sub_ps(_mm_load_ps(hi), vlo)));
+	}
+
+	//cube root of positive numbers (bit trick and two Newton steps, relative error < 1e-6)
+	VQMT_FORCEINLINE __m128 CubeRoot(__m128 x) {
+		const __m128 third = _mm_set1_ps(1.f / 3), two = _mm_set1_ps(2.f);
+		//initial guess: bits / 3 + magic, bits of positive float fit into int32 and float division is exact enough
+		__m128i bits = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(x)), third));
+		__m128 c = _mm_castsi128_ps(_mm_add_epi32(bits, _mm_set1_epi32(709921077)));
+		c = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(two, c), _mm_div_ps(x, _mm_mul_ps(c, c))), third);
+		return _mm_mul_ps(_mm_add_ps(_mm_mul_ps(two, c), _mm_div_ps(x, _mm_mul_ps(c, c))), third);
+	}
+
+	//atan2(y, x) in radians, [-pi, pi] (minimax polynomial, absolute error < 1e-5)
+	VQMT_FORCEINLINE __m128 Atan2(__m128 y, __m128 x) {
+		__m128 ax = Abs(x), ay = Abs(y);
+		__m128 swap = _mm_cmpgt_ps(ay, ax);
+		__m128 num = _mm_min_ps(ax, ay), den = _mm_max_ps(_mm_max_ps(ax, ay), _mm_set1_ps(1e-30f));
+		__m128 t = _mm_div_ps(num, den);
+		__m128 t2 = _mm_mul_ps(t, t);
+		__m128 p = _mm_set1_ps(-0.0117212f);
+		p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(0.05265332f));
+		p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(-0.11643287f));
+		p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(0.19354346f));
+		p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(-0.33262347f));
+		p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(0.99997726f));
+		__m128 r = _mm_mul_ps(p, t);
+		const __m128 halfPi = _mm_set1_ps(1.57079632679f), pi = _mm_set1_ps(3.14159265359f);
+		r = _mm_or_ps(_mm_and_ps(swap, _mm_sub_ps(halfPi, r)), _mm_andnot_ps(swap, r));
+		__m128 negX = _mm_cmplt_ps(x, _mm_setzero_ps());
+		r = _mm_or_ps(_mm_and_ps(negX, _mm_sub_ps(pi, r)), _mm_andnot_ps(negX, r));
+		//sign of y goes to the result
+		return _mm_or_ps(r, _mm_and_ps(y, _mm_castsi128_ps(_mm_set1_epi32(int(0x80000000)))));
+	}
+#endif
+
+	//half-sample symmetric border extension: -1 -> 0, n -> n-1
+	inline int Reflect(int i, int n) {
+		if (n <= 1) return 0;
+		while (i < 0 || i >= n) {
+			if (i < 0) i = -i - 1;
+			if (i >= n) i = 2 * n - 1 - i;
+		}
+		return i;
+	}
+
+	//cube root for x > 0, scalar path of CubeRoot(__m128)
+	inline float CubeRoot(float x) {
+		union { float f; uint32_t i; } c;
+		c.f = x;
+		c.i = c.i / 3 + 709921077u;
+		float y = c.f;
+		y = (2 * y + x / (y * y)) * (1.f / 3);
+		y = (2 * y + x / (y * y)) * (1.f / 3);
+		return y;
+	}
+
+	//natural logarithm of positive normal numbers, scalar path of Log(__m128)
+	inline float Log(float x) {
+		union { float f; uint32_t i; } m;
+		m.f = x;
+		if (m.i < 0x00800000u) m.i = 0x00800000u;
+		float e = float(int(m.i >> 23) - 0x7f + 1);
+		m.i = (m.i & ~0x7f800000u) | 0x3f000000u;
+		x = m.f;
+		if (x < 0.707106781186547524f) {
+			e -= 1.f;
+			x = x + x - 1.f;
+		}
+		else x = x - 1.f;
+
+		float z = x * x;
+		float y = 7.0376836292E-2f;
+		y = y * x - 1.1514610310E-1f;
+		y = y * x + 1.1676998740E-1f;
+		y = y * x - 1.2420140846E-1f;
+		y = y * x + 1.4249322787E-1f;
+		y = y * x - 1.6668057665E-1f;
+		y = y * x + 2.0000714765E-1f;
+		y = y * x - 2.4999993993E-1f;
+		y = y * x + 3.3333331174E-1f;
+		y = y * x * z;
+
+		y += e * -2.12194440e-4f;
+		y -= z * 0.5f;
+		x += y;
+		return x + e * 0.693359375f;
+	}
+
+	//natural exponent, scalar path of Exp(__m128)
+	inline float Exp(float x) {
+		x = x < -87.f ? -87.f : (x > 88.f ? 88.f : x);
+
+		float fx = x * 1.44269504088896341f + 0.5f;
+		float n = float(int(fx));
+		if (n > fx) n -= 1.f;
+		x -= n * 0.693359375f;
+		x -= n * -2.12194440e-4f;
+
+		float y = 1.9875691500E-4f;
+		y = y * x + 1.3981999507E-3f;
+		y = y * x + 8.3334519073E-3f;
+		y = y * x + 4.1665795894E-2f;
+		y = y * x + 1.6666665459E-1f;
+		y = y * x + 5.0000001201E-1f;
+		y = y * (x * x) + x + 1.f;
+
+		union { float f; uint32_t i; } e;
+		e.i = uint32_t(int(n) + 0x7f) << 23;
+		return y * e.f;
+	}
+
+	//x^p for x >= 0 (0 for x = 0), scalar path of Pow(__m128, float)
+	inline float Pow(float x, float p) {
+		return x > 0 ? Exp(Log(x) * p) : 0.f;
+	}
+}
@@ -0,0 +1,150 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file ThreadPool.h
+*  \brief Small persistent thread pool for stripe-parallel kernels.
+*/
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+#include <exception>
+
+/*!\brief Persistent pool of worker threads
+*
+*	Threads are created once (usually in ICustomPlugin::Init) and reused for every frame,
+*	so the cost of ParallelFor is a wake-up, not a thread creation.
+*	The calling thread takes part in the work too.
+*/
+class CThreadPool {
+public:
+	/**
+	**************************************************************************
+	* \brief Creates pool
+	* \param threads		[IN] - total number of threads including the caller, 0 means hardware concurrency
+	*/
+	explicit CThreadPool(int threads = 0) {
+		if (threads <= 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+		for (int i = 1; i < threads; ++i) {
+			m_workers.emplace_back([this]() { WorkerLoop(); });
+		}
+	}
+
+	~CThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for (std::thread& t : m_workers) t.join();
+	}
+
+	CThreadPool(const CThreadPool&) = delete;
+	CThreadPool& operator = (const CThreadPool&) = delete;
+
+	int Threads() const { return int(m_workers.size()) + 1; }
+
+	/**
+	**************************************************************************
+	* \brief Calls func(i) for i in [0, count), returns when all calls finished
+	*
+	*	Calls may run concurrently in any order. ParallelFor is not reentrant:
+	*	do not call it from func.
+	*	If a call throws, calls not yet started are skipped, and the first exception
+	*	is rethrown on the calling thread after all threads left func.
+	*/
+	void ParallelFor(int count, const std::function<void(int)>& func) {
+		if (count <= 0) return;
+		if (m_workers.empty() || count == 1) {
+			for (int i = 0; i < count; ++i) func(i);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_func = &func;
+			m_count = count;
+			m_next = 0;
+			m_busy = (int)m_workers.size();
+			++m_generation;
+		}
+		m_wake.notify_all();
+
+		RunJobs(func, count);
+
+		std::exception_ptr error;
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			m_done.wait(lock, [this]() { return m_busy == 0; });
+			m_func = nullptr;
+			std::swap(error, m_error);
+		}
+		if (error) std::rethrow_exception(error);
+	}
+
+private:
+	void RunJobs(const std::function<void(int)>& func, int count) {
+		for (int i = m_next++; i < count; i = m_next++) {
+			try {
+				func(i);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(m_lock);
+				if (!m_error) m_error = std::current_exception();
+				m_next = count;
+			}
+		}
+	}
+
+	void WorkerLoop() {
+		unsigned seenGeneration = 0;
+		for (;;) {
+			const std::function<void(int)>* func;
+			int count;
+			{
+				std::unique_lock<std::mutex> lock(m_lock);
+				m_wake.wait(lock, [&]() { return m_stop || m_generation != seenGeneration; });
+				if (m_stop) return;
+				seenGeneration = m_generation;
+				func = m_func;
+				count = m_count;
+			}
+
+			RunJobs(*func, count);
+
+			std::lock_guard<std::mutex> lock(m_lock);
+			if (--m_busy == 0) m_done.notify_one();
+		}
+	}
+
+private:
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_lock;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+
+	const std::function<void(int)>* m_func = nullptr;
+	int m_count = 0;
+	std::atomic<int> m_next{ 0 };
+	int m_busy = 0;
+	std::exception_ptr m_error;		//first exception of the current ParallelFor
+	unsigned m_generation = 0;
+	bool m_stop = false;
+};
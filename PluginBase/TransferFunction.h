@@ -0,0 +1,322 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file TransferFunction.h
+*  \brief HDR transfer functions: PQ (SMPTE ST 2084) and HLG (BT.2100) EOTF, inverse EOTF and OETF.
+*
+*	Two evaluation modes, both vectorized:
+*	* TRANSFER_LUT - tables with linear interpolation. Signal to linear uses a uniform table
+*	  over the signal; linear to signal uses a table indexed by float bits (64 segments per
+*	  octave over [2^-32, 1]), so small luminances are as precise as big ones.
+*	* TRANSFER_POLYNOMIAL - pow() through polynomial VQMTsimd::Log and VQMTsimd::Exp, no
+*	  tables, about 10 times slower. The PQ EOTF raises to the power 6.27, so relative error
+*	  is up to 6e-5 here, while tables give 2e-6.
+*	HLG EOTF is the inverse OETF followed by the OOTF with system gamma 1.2, applied to each
+*	component (exact for achromatic samples). HLG OETF maps scene light to the signal without
+*	the OOTF; PQ is display-referred, so its OETF is the inverse EOTF.
+*/
+
+#pragma once
+
+#include "Simd.h"
+#include "ImagePlane.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+enum TransferCurve {
+	TRANSFER_PQ = 0,
+	TRANSFER_HLG = 1
+};
+
+enum TransferMode {
+	TRANSFER_LUT = 0,
+	TRANSFER_POLYNOMIAL = 1
+};
+
+/*!\brief Converts between non-linear signal [0, 1] and linear light [0, 1]
+*
+*	Linear 1.0 is 10000 cd/m^2 for PQ and the nominal peak of the display for HLG.
+*/
+class CTransferFunction {
+public:
+	CTransferFunction(TransferCurve curve = TRANSFER_PQ, TransferMode mode = TRANSFER_LUT) {
+		Init(curve, mode);
+	}
+
+	void Init(TransferCurve curve, TransferMode mode) {
+		m_curve = curve;
+		m_mode = mode;
+		if (mode != TRANSFER_LUT) return;
+
+		m_toLinear.resize(toLinearSize + 2);
+		for (int i = 0; i < toLinearSize + 2; ++i) {
+			m_toLinear[i] = float(EOTF(curve, std::min(1., double(i) / toLinearSize)));
+		}
+		m_fromLinear.resize(fromLinearSize + 2);
+		for (int i = 0; i < fromLinearSize + 2; ++i) {
+			int e = i / fromLinearSteps, k = i % fromLinearSteps;
+			m_fromLinear[i] = float(InverseEOTF(curve, std::ldexp(1. + double(k) / fromLinearSteps, e - fromLinearOctaves)));
+		}
+		//PQ uses m_fromLinear for scene light
+		m_fromScene.clear();
+		if (curve != TRANSFER_HLG) return;
+		m_fromScene.resize(fromLinearSize + 2);
+		for (int i = 0; i < fromLinearSize + 2; ++i) {
+			int e = i / fromLinearSteps, k = i % fromLinearSteps;
+			m_fromScene[i] = float(OETF(curve, std::ldexp(1. + double(k) / fromLinearSteps, e - fromLinearOctaves)));
+		}
+	}
+
+	TransferCurve GetCurve() const { return m_curve; }
+	TransferMode GetMode() const { return m_mode; }
+
+	/**
+	**************************************************************************
+	* \brief EOTF of n samples: dst = EOTF(clamp(src * scale + offset, 0, 1))
+	*
+	*	scale and offset map the range of the component to [0, 1]. src and dst may be the same.
+	*/
+	void ToLinear(const float* src, float* dst, int n, float scale = 1.f, float offset = 0.f) const {
+		int x = 0;
+#ifdef VQMT_SSE2
+		const __m128 s = _mm_set1_ps(scale), o = _mm_set1_ps(offset);
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f);
+		for (; x + 4 <= n; x += 4) {
+			__m128 e = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + x), s), o), zero), one);
+			_mm_storeu_ps(dst + x, m_mode == TRANSFER_LUT ? ToLinearLUT(e) : ToLinearPolynomial(e));
+		}
+#endif
+		for (; x < n; ++x) {
+			float e = std::min(std::max(src[x] * scale + offset, 0.f), 1.f);
+			if (m_mode == TRANSFER_LUT) {
+				float f = e * toLinearSize;
+				int i = int(f);
+				dst[x] = m_toLinear[i] + (f - i) * (m_toLinear[i + 1] - m_toLinear[i]);
+			}
+			else {
+				dst[x] = ToLinearPolynomial(e);
+			}
+		}
+	}
+
+	/**
+	**************************************************************************
+	* \brief Inverse EOTF of n samples, src is clamped to [0, 1]. src and dst may be the same.
+	*/
+	void FromLinear(const float* src, float* dst, int n) const {
+		FromLinearRow(src, dst, n, m_fromLinear.data(), true);
+	}
+
+	/**
+	**************************************************************************
+	* \brief OETF of n samples: scene light [0, 1] to signal, src is clamped to [0, 1]
+	*
+	*	Same as FromLinear() for PQ. src and dst may be the same.
+	*/
+	void FromSceneLinear(const float* src, float* dst, int n) const {
+		if (m_curve == TRANSFER_HLG) FromLinearRow(src, dst, n, m_fromScene.data(), false);
+		else FromLinearRow(src, dst, n, m_fromLinear.data(), true);
+	}
+
+	/**
+	**************************************************************************
+	* \brief Linear light of a plane: dst = min(gain * EOTF(normalized sample), 1)
+	*
+	*	Samples are normalized with [min, max] of the range. With gain = 10000 / peak for PQ
+	*	the result is relative to the peak luminance of a display, brighter samples are clipped.
+	* \return view of dst
+	*/
+	PlaneView Linearize(const PlaneView& plane, const RangeSpecification& range, float gain, CPlaneBuffer& dst, CThreadPool* pool = nullptr) const {
+		if (plane.Empty()) {
+			dst.Resize(0, 0);
+			return PlaneView();
+		}
+		dst.Resize(plane.width, plane.height);
+		float scale = range.max > range.min ? 1.f / (range.max - range.min) : 1.f / 255.f;
+		float offset = -range.min * scale;
+		int stripes = std::min(plane.height, stripeCount);
+		auto job = [&](int s) {
+			int y0 = plane.height * s / stripes, y1 = plane.height * (s + 1) / stripes;
+			for (int y = y0; y < y1; ++y) {
+				float* out = dst.Row(y);
+				ToLinear(plane.Row(y), out, plane.width, scale, offset);
+				if (gain != 1.f) Clip(out, plane.width, gain);
+			}
+		};
+		if (pool) pool->ParallelFor(stripes, job);
+		else for (int s = 0; s < stripes; ++s) job(s);
+		return dst.View();
+	}
+
+	//exact EOTF
+	static double EOTF(TransferCurve curve, double e) {
+		e = std::min(std::max(e, 0.), 1.);
+		if (curve == TRANSFER_HLG) {
+			double l = e <= 0.5 ? e * e / 3. : (std::exp((e - hlgC) / hlgA) + hlgB) / 12.;
+			return std::pow(l, hlgGamma);
+		}
+		double p = std::pow(e, 1. / pqM2);
+		return std::pow(std::max(p - pqC1, 0.) / (pqC2 - pqC3 * p), 1. / pqM1);
+	}
+
+	//exact inverse EOTF
+	static double InverseEOTF(TransferCurve curve, double y) {
+		y = std::min(std::max(y, 0.), 1.);
+		if (curve == TRANSFER_HLG) return OETF(curve, std::pow(y, 1. / hlgGamma));
+		double p = std::pow(y, pqM1);
+		return std::pow((pqC1 + pqC2 * p) / (1. + pqC3 * p), pqM2);
+	}
+
+	//exact OETF, scene light to signal; the inverse EOTF for PQ
+	static double OETF(TransferCurve curve, double l) {
+		l = std::min(std::max(l, 0.), 1.);
+		if (curve != TRANSFER_HLG) return InverseEOTF(curve, l);
+		return l <= 1. / 12. ? std::sqrt(3. * l) : hlgA * std::log(12. * l - hlgB) + hlgC;
+	}
+
+private:
+	static constexpr int stripeCount = 32;
+	static const int toLinearSize = 4096;
+	static const int fromLinearOctaves = 32;
+	static const int fromLinearSteps = 64;
+	static const int fromLinearSize = fromLinearOctaves * fromLinearSteps;
+	//float bits of 2^-fromLinearOctaves, the first node of the inverse table
+	static const int32_t fromLinearBase = (127 - fromLinearOctaves) << 23;
+	static const int fromLinearShift = 23 - 6;
+	static constexpr float minLinear = 1.f / 4294967296.f;
+
+	static constexpr double pqM1 = 2610. / 16384;
+	static constexpr double pqM2 = 2523. / 4096 * 128;
+	static constexpr double pqC1 = 3424. / 4096;
+	static constexpr double pqC2 = 2413. / 4096 * 32;
+	static constexpr double pqC3 = 2392. / 4096 * 32;
+	static constexpr double hlgA = 0.17883277;
+	static constexpr double hlgB = 0.28466892;
+	static constexpr double hlgC = 0.55991073;
+	static constexpr double hlgGamma = 1.2;
+
+	static void Clip(float* row, int n, float gain) {
+		int x = 0;
+#ifdef VQMT_SSE2
+		const __m128 g = _mm_set1_ps(gain), one = _mm_set1_ps(1.f);
+		for (; x + 4 <= n; x += 4) _mm_storeu_ps(row + x, _mm_min_ps(_mm_mul_ps(_mm_loadu_ps(row + x), g), one));
+#endif
+		for (; x < n; ++x) row[x] = std::min(row[x] * gain, 1.f);
+	}
+
+	//inverse EOTF (ootf = true) or HLG OETF (ootf = false) by the table or the polynomial
+	void FromLinearRow(const float* src, float* dst, int n, const float* table, bool ootf) const {
+		int x = 0;
+#ifdef VQMT_SSE2
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f);
+		for (; x + 4 <= n; x += 4) {
+			__m128 y = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + x), zero), one);
+			_mm_storeu_ps(dst + x, m_mode == TRANSFER_LUT ? FromLinearLUT(table, y) : FromLinearPolynomial(y, ootf));
+		}
+#endif
+		for (; x < n; ++x) {
+			float y = std::min(std::max(src[x], 0.f), 1.f);
+			if (m_mode == TRANSFER_LUT) {
+				y = std::max(y, minLinear);
+				int32_t bits;
+				std::memcpy(&bits, &y, sizeof(bits));
+				int32_t d = bits - fromLinearBase;
+				int i = d >> fromLinearShift;
+				float frac = float(d & ((1 << fromLinearShift) - 1)) * (1.f / (1 << fromLinearShift));
+				dst[x] = table[i] + frac * (table[i + 1] - table[i]);
+			}
+			else {
+				dst[x] = FromLinearPolynomial(y, ootf);
+			}
+		}
+	}
+
+#ifdef VQMT_SSE2
+	//e in [0, 1]
+	__m128 ToLinearLUT(__m128 e) const {
+		__m128 f = _mm_mul_ps(e, _mm_set1_ps(float(toLinearSize)));
+		__m128i i = _mm_cvttps_epi32(f);
+		return VQMTsimd::Gather(m_toLinear.data(), i, _mm_sub_ps(f, _mm_cvtepi32_ps(i)));
+	}
+
+	//y in [0, 1]
+	static __m128 FromLinearLUT(const float* table, __m128 y) {
+		y = _mm_max_ps(y, _mm_set1_ps(minLinear));
+		__m128i d = _mm_sub_epi32(_mm_castps_si128(y), _mm_set1_epi32(fromLinearBase));
+		__m128 frac = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(d, _mm_set1_epi32((1 << fromLinearShift) - 1))), _mm_set1_ps(1.f / (1 << fromLinearShift)));
+		return VQMTsimd::Gather(table, _mm_srli_epi32(d, fromLinearShift), frac);
+	}
+
+	__m128 ToLinearPolynomial(__m128 e) const {
+		if (m_curve == TRANSFER_HLG) {
+			__m128 low = _mm_mul_ps(_mm_mul_ps(e, e), _mm_set1_ps(1.f / 3));
+			__m128 high = VQMTsimd::Exp(_mm_mul_ps(_mm_sub_ps(e, _mm_set1_ps(float(hlgC))), _mm_set1_ps(float(1. / hlgA))));
+			high = _mm_mul_ps(_mm_add_ps(high, _mm_set1_ps(float(hlgB))), _mm_set1_ps(1.f / 12));
+			__m128 isLow = _mm_cmple_ps(e, _mm_set1_ps(0.5f));
+			return VQMTsimd::Pow(_mm_or_ps(_mm_and_ps(isLow, low), _mm_andnot_ps(isLow, high)), float(hlgGamma));
+		}
+		__m128 p = VQMTsimd::Pow(e, float(1. / pqM2));
+		__m128 num = _mm_max_ps(_mm_sub_ps(p, _mm_set1_ps(float(pqC1))), _mm_setzero_ps());
+		__m128 den = _mm_sub_ps(_mm_set1_ps(float(pqC2)), _mm_mul_ps(_mm_set1_ps(float(pqC3)), p));
+		return VQMTsimd::Pow(_mm_div_ps(num, den), float(1. / pqM1));
+	}
+
+	//ootf = false gives HLG OETF
+	__m128 FromLinearPolynomial(__m128 y, bool ootf) const {
+		if (m_curve == TRANSFER_HLG) {
+			__m128 l = ootf ? VQMTsimd::Pow(y, float(1. / hlgGamma)) : y;
+			__m128 low = _mm_sqrt_ps(_mm_mul_ps(l, _mm_set1_ps(3.f)));
+			//argument of log is negative for low samples, Log clamps it and the lane is not used
+			__m128 high = _mm_sub_ps(_mm_mul_ps(l, _mm_set1_ps(12.f)), _mm_set1_ps(float(hlgB)));
+			high = _mm_add_ps(_mm_mul_ps(VQMTsimd::Log(high), _mm_set1_ps(float(hlgA))), _mm_set1_ps(float(hlgC)));
+			__m128 isLow = _mm_cmple_ps(l, _mm_set1_ps(1.f / 12));
+			return _mm_or_ps(_mm_and_ps(isLow, low), _mm_andnot_ps(isLow, high));
+		}
+		__m128 p = VQMTsimd::Pow(y, float(pqM1));
+		__m128 r = _mm_div_ps(_mm_add_ps(_mm_set1_ps(float(pqC1)), _mm_mul_ps(_mm_set1_ps(float(pqC2)), p)),
+			_mm_add_ps(_mm_set1_ps(1.f), _mm_mul_ps(_mm_set1_ps(float(pqC3)), p)));
+		return VQMTsimd::Pow(r, float(pqM2));
+	}
+#endif
+
+	//scalar paths of the polynomial mode, the same approximation as the vector ones
+	float ToLinearPolynomial(float e) const {
+		if (m_curve == TRANSFER_HLG) {
+			float l = e <= 0.5f ? e * e * (1.f / 3) : (VQMTsimd::Exp((e - float(hlgC)) * float(1. / hlgA)) + float(hlgB)) * (1.f / 12);
+			return VQMTsimd::Pow(l, float(hlgGamma));
+		}
+		float p = VQMTsimd::Pow(e, float(1. / pqM2));
+		return VQMTsimd::Pow(std::max(p - float(pqC1), 0.f) / (float(pqC2) - float(pqC3) * p), float(1. / pqM1));
+	}
+
+	float FromLinearPolynomial(float y, bool ootf) const {
+		if (m_curve == TRANSFER_HLG) {
+			float l = ootf ? VQMTsimd::Pow(y, float(1. / hlgGamma)) : y;
+			return l <= 1.f / 12 ? std::sqrt(l * 3.f) : VQMTsimd::Log(l * 12.f - float(hlgB)) * float(hlgA) + float(hlgC);
+		}
+		float p = VQMTsimd::Pow(y, float(pqM1));
+		return VQMTsimd::Pow((float(pqC1) + float(pqC2) * p) / (1.f + float(pqC3) * p), float(pqM2));
+	}
+
+private:
+	TransferCurve m_curve = TRANSFER_PQ;
+	TransferMode m_mode = TRANSFER_LUT;
+	std::vector<float> m_toLinear;
+	std::vector<float> m_fromLinear;
+	std::vector<float> m_fromScene;
+};
@@ -0,0 +1,235 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file VIF.h
+*  \brief Pixel-domain visual information fidelity (VIFp, Sheikh and Bovik).
+*
+*	Four scales with Gaussian windows of 17, 9, 5 and 3 samples. Local means,
+*	variances and covariance of a scale are produced once by CWindowStats and used
+*	for both numerator and denominator terms. Between scales both planes are
+*	low-passed and decimated in one pass, only even samples are filtered.
+*/
+
+#pragma once
+
+#include "Simd.h"
+#include "ImagePlane.h"
+#include "ThreadPool.h"
+#include "WindowStats.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+struct VIFResult {
+	static const int maxScales = 4;
+
+	double num[maxScales] = {};
+	double den[maxScales] = {};
+	int scales = 0;
+
+	//VIF of one scale
+	double Scale(int s) const { return den[s] > 0 ? num[s] / den[s] : 1.; }
+
+	//combined VIF over all scales
+	double Score() const {
+		double n = 0, d = 0;
+		for (int s = 0; s < scales; ++s) {
+			n += num[s];
+			d += den[s];
+		}
+		return d > 0 ? n / d : 1.;
+	}
+};
+
+/*!\brief VIFp of two planes
+*/
+class CVIF {
+public:
+	CVIF() {
+		for (int s = 0; s < VIFResult::maxScales; ++s) {
+			int n = (1 << (VIFResult::maxScales - s)) + 1;
+			m_windows[s].SetWeights(CWindowStats::Gaussian(n, n / 5.));
+		}
+	}
+
+	/**
+	**************************************************************************
+	* \brief Computes per-scale VIF terms
+	* \param peak		[IN] - dynamic range of values, noise variance 2 is defined for range 255
+	* \param pool		[IN] - optional pool, output rows are split into stripes
+	*/
+	VIFResult Compute(const PlaneView& ref, const PlaneView& dist, float peak, CThreadPool* pool = nullptr) {
+		VIFResult res;
+		float sigmaNsq = float(2. * (peak / 255.) * (peak / 255.));
+
+		PlaneView a = ref, b = dist;
+		for (int s = 0; s < VIFResult::maxScales; ++s) {
+			if (s > 0) {
+				FilterDecimate(a, b, m_windows[s], m_scaled[s % 2][0], m_scaled[s % 2][1], pool);
+				a = m_scaled[s % 2][0];
+				b = m_scaled[s % 2][1];
+			}
+
+			std::vector<double> num(stripeCount, 0.), den(stripeCount, 0.);
+			bool ok = m_windows[s].Run(a, b, stripeCount, pool, [&](int stripe, int, const WindowMoments& m) {
+				Row(m, sigmaNsq, num[stripe], den[stripe]);
+			});
+			if (!ok) break;
+
+			for (int i = 0; i < stripeCount; ++i) {
+				res.num[s] += num[i];
+				res.den[s] += den[i];
+			}
+			res.scales = s + 1;
+		}
+		return res;
+	}
+
+private:
+	//fixed number of stripes keeps summation order (and result) independent of the pool size
+	static constexpr int stripeCount = 32;
+
+	static void Row(const WindowMoments& m, float sigmaNsq, double& num, double& den) {
+		const float eps = 1e-10f;
+		int x = 0;
+#ifdef VQMT_SSE2
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f), veps = _mm_set1_ps(eps);
+		const __m128 vsigma = _mm_set1_ps(sigmaNsq), invSigma = _mm_set1_ps(1.f / sigmaNsq);
+		__m128 accNum = zero, accDen = zero;
+		for (; x + 4 <= m.width; x += 4) {
+			__m128 ma = _mm_loadu_ps(m.meanA + x), mb = _mm_loadu_ps(m.meanB + x);
+			__m128 s1 = _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(m.sqA + x), _mm_mul_ps(ma, ma)), zero);
+			__m128 s2 = _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(m.sqB + x), _mm_mul_ps(mb, mb)), zero);
+			__m128 s12 = _mm_sub_ps(_mm_loadu_ps(m.prod + x), _mm_mul_ps(ma, mb));
+
+			__m128 g = _mm_div_ps(s12, _mm_add_ps(s1, veps));
+			__m128 sv = _mm_sub_ps(s2, _mm_mul_ps(g, s12));
+
+			//flat reference: no signal, all distortion is noise
+			__m128 flat1 = _mm_cmplt_ps(s1, veps);
+			g = _mm_andnot_ps(flat1, g);
+			sv = _mm_or_ps(_mm_and_ps(flat1, s2), _mm_andnot_ps(flat1, sv));
+			s1 = _mm_andnot_ps(flat1, s1);
+			//flat distorted: signal is lost
+			__m128 flat2 = _mm_cmplt_ps(s2, veps);
+			g = _mm_andnot_ps(flat2, g);
+			sv = _mm_andnot_ps(flat2, sv);
+			//negative gain
+			__m128 neg = _mm_cmplt_ps(g, zero);
+			sv = _mm_or_ps(_mm_and_ps(neg, s2), _mm_andnot_ps(neg, sv));
+			g = _mm_andnot_ps(neg, g);
+			sv = _mm_max_ps(sv, veps);
+
+			__m128 n = _mm_add_ps(one, _mm_div_ps(_mm_mul_ps(_mm_mul_ps(g, g), s1), _mm_add_ps(sv, vsigma)));
+			__m128 d = _mm_add_ps(one, _mm_mul_ps(s1, invSigma));
+			accNum = _mm_add_ps(accNum, VQMTsimd::Log(n));
+			accDen = _mm_add_ps(accDen, VQMTsimd::Log(d));
+		}
+		num += VQMTsimd::HorizontalSum(accNum) * log10e;
+		den += VQMTsimd::HorizontalSum(accDen) * log10e;
+#endif
+		double n1 = 0, d1 = 0;
+		for (; x < m.width; ++x) {
+			float ma = m.meanA[x], mb = m.meanB[x];
+			float s1 = std::max(0.f, m.sqA[x] - ma * ma);
+			float s2 = std::max(0.f, m.sqB[x] - mb * mb);
+			float s12 = m.prod[x] - ma * mb;
+
+			float g = s12 / (s1 + eps);
+			float sv = s2 - g * s12;
+			if (s1 < eps) {
+				g = 0;
+				sv = s2;
+				s1 = 0;
+			}
+			if (s2 < eps) {
+				g = 0;
+				sv = 0;
+			}
+			if (g < 0) {
+				sv = s2;
+				g = 0;
+			}
+			sv = std::max(sv, eps);
+
+			n1 += std::log10(1.f + g * g * s1 / (sv + sigmaNsq));
+			d1 += std::log10(1.f + s1 / sigmaNsq);
+		}
+		num += n1;
+		den += d1;
+	}
+
+	/**
+	**************************************************************************
+	* \brief 'valid' filtering of both planes with the window, then every second row and column
+	*/
+	static void FilterDecimate(const PlaneView& a, const PlaneView& b, const CWindowStats& window,
+		CPlaneBuffer& outA, CPlaneBuffer& outB, CThreadPool* pool) {
+		const std::vector<float>& w = window.Weights();
+		int win = int(w.size());
+		int width = std::min(a.width, b.width);
+		int height = std::min(a.height, b.height);
+		if (width < win || height < win) {
+			outA.Resize(0, 0);
+			outB.Resize(0, 0);
+			return;
+		}
+		int outWidth = (width - win + 2) / 2;
+		int outHeight = (height - win + 2) / 2;
+		outA.Resize(outWidth, outHeight);
+		outB.Resize(outWidth, outHeight);
+
+		int stripes = std::min(outHeight, stripeCount);
+		auto job = [&](int s) {
+			std::vector<float> tmp((size_t)((width + 3) & ~3));
+			int y0 = outHeight * s / stripes, y1 = outHeight * (s + 1) / stripes;
+			for (int y = y0; y < y1; ++y) {
+				for (int p = 0; p < 2; ++p) {
+					const PlaneView& src = p ? b : a;
+					float* dst = (p ? outB : outA).Row(y);
+					int x = 0;
+#ifdef VQMT_SSE2
+					for (; x + 4 <= width; x += 4) {
+						__m128 acc = _mm_setzero_ps();
+						for (int k = 0; k < win; ++k) {
+							acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(src.Row(2 * y + k) + x)));
+						}
+						_mm_storeu_ps(tmp.data() + x, acc);
+					}
+#endif
+					for (; x < width; ++x) {
+						float acc = 0;
+						for (int k = 0; k < win; ++k) acc += w[k] * src.Row(2 * y + k)[x];
+						tmp[x] = acc;
+					}
+					for (int ox = 0; ox < outWidth; ++ox) {
+						const float* t = tmp.data() + 2 * ox;
+						float acc = 0;
+						for (int k = 0; k < win; ++k) acc += w[k] * t[k];
+						dst[ox] = acc;
+					}
+				}
+			}
+		};
+		if (pool) pool->ParallelFor(stripes, job);
+		else for (int s = 0; s < stripes; ++s) job(s);
+	}
+
+private:
+	static constexpr double log10e = 0.43429448190325182765;
+
+	CWindowStats m_windows[VIFResult::maxScales];
+	//scales alternate between two pairs of buffers
+	CPlaneBuffer m_scaled[2][2];
+};
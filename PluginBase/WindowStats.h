@@ -0,0 +1,204 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+/**
+*  \file WindowStats.h
+*  \brief Local means, second moments and cross moment of two planes over a separable window.
+*
+*	This is the common part of SSIM-like metrics (SSIM, MS-SSIM, VIF). For every output row
+*	the window rows of both planes are filtered vertically into five row buffers
+*	(a, b, a*a, b*b, a*b) and then horizontally, and the metric consumes the five filtered
+*	rows while they are still in cache. Working memory is ten rows per stripe.
+*	Only windows completely inside of the image are used ('valid' filtering).
+*/
+
+#pragma once
+
+#include "Simd.h"
+#include "ImagePlane.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+//raw (not centered) moments of one output row
+struct WindowMoments {
+	const float* meanA;
+	const float* meanB;
+	const float* sqA;	//!< E[a*a]
+	const float* sqB;	//!< E[b*b]
+	const float* prod;	//!< E[a*b]
+	int width;
+};
+
+/*!\brief Separable symmetric window and its moments kernel
+*/
+class CWindowStats {
+public:
+	CWindowStats() {}
+	explicit CWindowStats(const std::vector<float>& weights) : m_weights(weights) {}
+
+	void SetWeights(const std::vector<float>& weights) { m_weights = weights; }
+	const std::vector<float>& Weights() const { return m_weights; }
+	int Size() const { return int(m_weights.size()); }
+
+	//normalized 1D Gaussian
+	static std::vector<float> Gaussian(int size, double sigma) {
+		std::vector<double> g(size);
+		double sum = 0;
+		for (int i = 0; i < size; ++i) {
+			double d = i - (size - 1) / 2.;
+			g[i] = std::exp(-d * d / (2 * sigma * sigma));
+			sum += g[i];
+		}
+		std::vector<float> res(size);
+		for (int i = 0; i < size; ++i) res[i] = float(g[i] / sum);
+		return res;
+	}
+
+	static std::vector<float> Box(int size) {
+		return std::vector<float>(size, 1.f / size);
+	}
+
+	/**
+	**************************************************************************
+	* \brief Calls op(stripe, y, const WindowMoments&) for every output row
+	*
+	*	Output has (w - size + 1) x (h - size + 1) samples, w and h are common size of planes.
+	*	Rows are split into stripes (fixed number, so results summed per stripe do not depend
+	*	on the pool), op is called for rows of one stripe sequentially.
+	* \return false if the planes are smaller than the window
+	*/
+	template<class RowOp>
+	bool Run(const PlaneView& a, const PlaneView& b, int stripes, CThreadPool* pool, RowOp op) const {
+		int width = std::min(a.width, b.width);
+		int height = std::min(a.height, b.height);
+		int win = Size();
+		if (a.Empty() || b.Empty() || width < win || height < win) return false;
+
+		int outWidth = width - win + 1;
+		int outHeight = height - win + 1;
+		stripes = std::max(1, std::min(stripes, outHeight));
+
+		auto job = [&](int s) {
+			int y0 = outHeight * s / stripes, y1 = outHeight * (s + 1) / stripes;
+			size_t step = (size_t)((width + 3) & ~3);
+			std::vector<float> rows(10 * step);
+			float* vert = rows.data();
+			float* hor = rows.data() + 5 * step;
+			WindowMoments m;
+			m.meanA = hor;
+			m.meanB = hor + step;
+			m.sqA = hor + 2 * step;
+			m.sqB = hor + 3 * step;
+			m.prod = hor + 4 * step;
+			m.width = outWidth;
+			for (int y = y0; y < y1; ++y) {
+				VerticalPass(a, b, y, width, step, vert);
+				for (int q = 0; q < 5; ++q) HorizontalPass(vert + q * step, outWidth, hor + q * step);
+				op(s, y, m);
+			}
+		};
+		if (pool) pool->ParallelFor(stripes, job);
+		else for (int s = 0; s < stripes; ++s) job(s);
+		return true;
+	}
+
+private:
+	void VerticalPass(const PlaneView& a, const PlaneView& b, int y, int width, size_t step, float* rows) const {
+		int win = Size();
+		int half = win / 2;
+		float* ma = rows;
+		float* mb = rows + step;
+		float* aa = rows + 2 * step;
+		float* bb = rows + 3 * step;
+		float* ab = rows + 4 * step;
+		const float* w = m_weights.data();
+
+		int x = 0;
+#ifdef VQMT_SSE2
+		for (; x + 4 <= width; x += 4) {
+			__m128 sa = _mm_setzero_ps(), sb = _mm_setzero_ps();
+			__m128 saa = _mm_setzero_ps(), sbb = _mm_setzero_ps(), sab = _mm_setzero_ps();
+			//symmetric taps share one weight multiplication
+			for (int k = 0; k < half; ++k) {
+				__m128 a0 = _mm_loadu_ps(a.Row(y + k) + x), a1 = _mm_loadu_ps(a.Row(y + win - 1 - k) + x);
+				__m128 b0 = _mm_loadu_ps(b.Row(y + k) + x), b1 = _mm_loadu_ps(b.Row(y + win - 1 - k) + x);
+				__m128 wk = _mm_set1_ps(w[k]);
+				sa = _mm_add_ps(sa, _mm_mul_ps(wk, _mm_add_ps(a0, a1)));
+				sb = _mm_add_ps(sb, _mm_mul_ps(wk, _mm_add_ps(b0, b1)));
+				saa = _mm_add_ps(saa, _mm_mul_ps(wk, _mm_add_ps(_mm_mul_ps(a0, a0), _mm_mul_ps(a1, a1))));
+				sbb = _mm_add_ps(sbb, _mm_mul_ps(wk, _mm_add_ps(_mm_mul_ps(b0, b0), _mm_mul_ps(b1, b1))));
+				sab = _mm_add_ps(sab, _mm_mul_ps(wk, _mm_add_ps(_mm_mul_ps(a0, b0), _mm_mul_ps(a1, b1))));
+			}
+			if (win & 1) {
+				__m128 a0 = _mm_loadu_ps(a.Row(y + half) + x), b0 = _mm_loadu_ps(b.Row(y + half) + x);
+				__m128 wk = _mm_set1_ps(w[half]);
+				sa = _mm_add_ps(sa, _mm_mul_ps(wk, a0));
+				sb = _mm_add_ps(sb, _mm_mul_ps(wk, b0));
+				saa = _mm_add_ps(saa, _mm_mul_ps(wk, _mm_mul_ps(a0, a0)));
+				sbb = _mm_add_ps(sbb, _mm_mul_ps(wk, _mm_mul_ps(b0, b0)));
+				sab = _mm_add_ps(sab, _mm_mul_ps(wk, _mm_mul_ps(a0, b0)));
+			}
+			_mm_storeu_ps(ma + x, sa);
+			_mm_storeu_ps(mb + x, sb);
+			_mm_storeu_ps(aa + x, saa);
+			_mm_storeu_ps(bb + x, sbb);
+			_mm_storeu_ps(ab + x, sab);
+		}
+#endif
+		for (; x < width; ++x) {
+			float sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+			for (int k = 0; k < win; ++k) {
+				float va = a.Row(y + k)[x], vb = b.Row(y + k)[x];
+				sa += w[k] * va;
+				sb += w[k] * vb;
+				saa += w[k] * va * va;
+				sbb += w[k] * vb * vb;
+				sab += w[k] * va * vb;
+			}
+			ma[x] = sa;
+			mb[x] = sb;
+			aa[x] = saa;
+			bb[x] = sbb;
+			ab[x] = sab;
+		}
+	}
+
+	void HorizontalPass(const float* src, int outWidth, float* dst) const {
+		int win = Size();
+		int half = win / 2;
+		const float* w = m_weights.data();
+
+		int x = 0;
+#ifdef VQMT_SSE2
+		for (; x + 4 <= outWidth; x += 4) {
+			const float* r = src + x;
+			__m128 s = _mm_setzero_ps();
+			for (int k = 0; k < half; ++k) {
+				s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_add_ps(_mm_loadu_ps(r + k), _mm_loadu_ps(r + win - 1 - k))));
+			}
+			if (win & 1) s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(w[half]), _mm_loadu_ps(r + half)));
+			_mm_storeu_ps(dst + x, s);
+		}
+#endif
+		for (; x < outWidth; ++x) {
+			float s = 0;
+			for (int k = 0; k < win; ++k) s += w[k] * src[x + k];
+			dst[x] = s;
+		}
+	}
+
+private:
+	std::vector<float> m_weights;
+};
@@ -17,6 +17,36 @@ Author: Georgy Osipov
 *     parsing JSON
 *     serializing JSON
 *     operations with JSON-data
+*
+*  Buffers are parsed by FastJSONparser, a recursive-descent parser. Define
+*  YUVsoft_JSON_TABLE_PARSER to parse them by the state machine of JSONparser,
+*  which reports the same values and errors. Seekable streams are read by blocks and
+*  parsed as buffers, other streams are parsed by JSONparser. JSONStreamReader reads
+*  a stream of JSON lines or concatenated documents by blocks.
+*
+*  ParseWrapper::parseEvents reports a document to a JSONEvents handler without building
+*  values; JSONBinder is such a handler that assigns object members to variables.
+*
+*  JSON::serialize writes by JSONWriter into a buffer, the same text as writeToStream.
+*  JSONWriter can also write to a stream by blocks and format floats as the shortest
+*  text that reads back to the same double.
+*
+*  The state machine of JSONparser is precompiled into json_table.h. After a change
+*  of its grammar regenerate the file by JSONparser::writeTable.
+*
+*  Numbers, booleans, strings and null are constructed inside the JSON value, only
+*  arrays and objects are allocated. Types are checked by the tag of an element.
+*
+*  JSON values are movable, copies are deep. Define YUVsoft_JSON_COPY_ON_WRITE to
+*  share copied subtrees until one of the copies is modified: then references and
+*  iterators taken from a JSON before it was copied still refer to the shared data.
+*
+*  Object members are kept in insertion order in blocks of 8 with a hash index.
+*  Inserting a member keeps references to the others valid, it invalidates iterators.
+*  Define YUVsoft_JSON_NODE_OBJECTS to keep them in list nodes instead.
+*
+*  JSONDocument parses into memory of one resource, a JSONArena or any resource of
+*  std::pmr where the library has it, and frees the arrays and objects together.
 */
 
 #pragma once
@@ -33,11 +63,30 @@ Author: Georgy Osipov
 #include <string>
 #include <assert.h>
 #include <cmath>
+#include <limits>
 #include <locale>
 #include <iomanip>
-#include <codecvt>
+#include <stdexcept>
+#include <cwchar>
 #include <stdint.h>
+#include <cstdlib>
+#include <cstring>
 #include <initializer_list>
+#include <type_traits>
+#include <cstdio>
+#include <cstddef>
+#if (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)) && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
+#endif
+#include <atomic>
+#include <new>
+
+#include "json_table.h"
 
 #ifdef min
 #undef min
@@ -50,15 +99,379 @@ Author: Georgy Osipov
 
 namespace YUVsoft {
     class JSON;
+    class FastJSONparser;
+    class JSONWriter;
+
+#ifdef __cpp_lib_memory_resource
+    //memory of JSON documents, resources of the standard library are used directly
+    typedef std::pmr::memory_resource JSONMemoryResource;
+
+    inline JSONMemoryResource* jsonDefaultResource() {
+        return std::pmr::get_default_resource();
+    }
+#else
+    //memory of JSON documents: the interface of std::pmr::memory_resource, which is
+    //used instead where the library has it. Alignment is at most that of std::max_align_t
+    class JSONMemoryResource {
+    public:
+        virtual ~JSONMemoryResource() {}
+
+        void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+            return do_allocate(bytes, alignment);
+        }
+        void deallocate(void* p, size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+            do_deallocate(p, bytes, alignment);
+        }
+        bool is_equal(const JSONMemoryResource& r) const noexcept {
+            return do_is_equal(r);
+        }
+
+    private:
+        virtual void* do_allocate(size_t bytes, size_t alignment) = 0;
+        virtual void do_deallocate(void* p, size_t bytes, size_t alignment) = 0;
+        virtual bool do_is_equal(const JSONMemoryResource& r) const noexcept = 0;
+    };
+
+    inline JSONMemoryResource* jsonDefaultResource() {
+        class NewDelete : public JSONMemoryResource {
+            void* do_allocate(size_t bytes, size_t) override { return ::operator new(bytes); }
+            void do_deallocate(void* p, size_t, size_t) override { ::operator delete(p); }
+            bool do_is_equal(const JSONMemoryResource& r) const noexcept override { return this == &r; }
+        };
+        static NewDelete resource;
+        return &resource;
+    }
+#endif
+
+    //allocator of JSON containers: memory of a resource, the heap without one.
+    //It moves with the memory on move assignment and swap, copies of containers are on the heap
+    template<class T>
+    class JSONAllocator {
+    public:
+        typedef T value_type;
+        typedef std::true_type propagate_on_container_move_assignment;
+        typedef std::true_type propagate_on_container_swap;
+
+        JSONAllocator(JSONMemoryResource* resource = NULL) noexcept : resource(resource) {}
+        template<class U>
+        JSONAllocator(const JSONAllocator<U>& r) noexcept : resource(r.resource) {}
+
+        T* allocate(size_t n) {
+            if( !resource ) return std::allocator<T>().allocate(n);
+            return static_cast<T*>(resource->allocate(n * sizeof(T), alignof(T)));
+        }
+        void deallocate(T* p, size_t n) noexcept {
+            if( !resource ) std::allocator<T>().deallocate(p, n);
+            else resource->deallocate(p, n * sizeof(T), alignof(T));
+        }
+
+        JSONAllocator select_on_container_copy_construction() const {
+            return JSONAllocator();
+        }
+
+        template<class U>
+        bool operator == (const JSONAllocator<U>& r) const noexcept { return resource == r.resource; }
+        template<class U>
+        bool operator != (const JSONAllocator<U>& r) const noexcept { return resource != r.resource; }
+
+        JSONMemoryResource* resource;
+    };
+
+    //monotonic memory: allocations follow each other in blocks taken from the upstream
+    //resource, deallocation does nothing and release() frees everything at once.
+    //The largest block is kept, so a document parsed after release() reuses it
+    class JSONArena : public JSONMemoryResource {
+        struct Block {
+            Block* prev;
+            size_t size;
+        };
+    public:
+        explicit JSONArena(size_t blockSize = 1 << 16, JSONMemoryResource* upstream = jsonDefaultResource())
+            : upstream(upstream), blocks(NULL), cur(NULL), end(NULL), blockSize(std::max<size_t>(blockSize, 256)), nextSize(this->blockSize) {}
+        JSONArena(const JSONArena&) = delete;
+        JSONArena& operator = (const JSONArena&) = delete;
+        ~JSONArena() {
+            release();
+            if( blocks ) upstream->deallocate(blocks, blocks->size, alignof(std::max_align_t));
+        }
+
+        void release() {
+            Block* kept = NULL;
+            for( Block* b = blocks; b; ) {
+                Block* prev = b->prev;
+                if( kept && kept->size >= b->size ) {
+                    upstream->deallocate(b, b->size, alignof(std::max_align_t));
+                }
+                else {
+                    if( kept ) upstream->deallocate(kept, kept->size, alignof(std::max_align_t));
+                    kept = b;
+                }
+                b = prev;
+            }
+            blocks = kept;
+            if( kept ) {
+                kept->prev = NULL;
+                cur = reinterpret_cast<char*>(kept) + sizeof(Block);
+                end = reinterpret_cast<char*>(kept) + kept->size;
+            }
+            nextSize = blockSize;
+        }
+
+        JSONMemoryResource* upstreamResource() const {
+            return upstream;
+        }
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            size_t skip = size_t(-reinterpret_cast<uintptr_t>(cur)) & (alignment - 1);
+            if( !cur || size_t(end - cur) < bytes + skip ) {
+                grow(bytes + alignment);
+                skip = size_t(-reinterpret_cast<uintptr_t>(cur)) & (alignment - 1);
+            }
+            void* p = cur + skip;
+            cur += skip + bytes;
+            return p;
+        }
+        void do_deallocate(void*, size_t, size_t) override {}
+        bool do_is_equal(const JSONMemoryResource& r) const noexcept override {
+            return this == &r;
+        }
+
+        //blocks grow twice up to 64 MB, a larger allocation gets a block of its size
+        void grow(size_t bytes) {
+            size_t size = std::max(nextSize, bytes + sizeof(Block));
+            Block* b = static_cast<Block*>(upstream->allocate(size, alignof(std::max_align_t)));
+            b->prev = blocks;
+            b->size = size;
+            blocks = b;
+            cur = reinterpret_cast<char*>(b) + sizeof(Block);
+            end = reinterpret_cast<char*>(b) + size;
+            nextSize = std::min<size_t>(nextSize * 2, size_t(1) << 26);
+        }
+
+        JSONMemoryResource* upstream;
+        Block* blocks;
+        char* cur;
+        char* end;
+        size_t blockSize;
+        size_t nextSize;
+    };
+
     namespace JSONElements {
+#ifndef YUVsoft_JSON_NODE_OBJECTS
+		//insertion-ordered map in blocks of 8 items: small maps are scanned, larger ones
+		//are looked up by an open-addressing index of item positions. Blocks never move, so
+		//insertion keeps references to other members valid, but it invalidates iterators
+		template<class K, class V>
+		class OrderedMap {
+			using Item = std::pair<K, V>;
+			static const size_t blockBits = 3;
+			static const size_t blockSize = size_t(1) << blockBits;
+			static const size_t scanLimit = blockSize;
+			using Blocks = std::vector<Item*, JSONAllocator<Item*>>;
+
+			template<class T>
+			class Iterator {
+				friend class OrderedMap;
+				template<class> friend class Iterator;
+				Item* const* blocks;
+				size_t i;
+
+				Iterator(Item* const* blocks, size_t i) : blocks(blocks), i(i) {}
+			public:
+				typedef std::bidirectional_iterator_tag iterator_category;
+				typedef T value_type;
+				typedef ptrdiff_t difference_type;
+				typedef T* pointer;
+				typedef T& reference;
+
+				Iterator() : blocks(NULL), i(0) {}
+				//iterator converts to const_iterator
+				template<class U, class = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+				Iterator(const Iterator<U>& r) : blocks(r.blocks), i(r.i) {}
+
+				T& operator * () const { return blocks[i >> blockBits][i & (blockSize - 1)]; }
+				T* operator -> () const { return &**this; }
+
+				Iterator& operator ++ () { ++i; return *this; }
+				Iterator& operator -- () { --i; return *this; }
+				Iterator operator ++ (int) { Iterator r(*this); ++i; return r; }
+				Iterator operator -- (int) { Iterator r(*this); --i; return r; }
+
+				template<class U>
+				bool operator == (const Iterator<U>& r) const { return i == r.i; }
+				template<class U>
+				bool operator != (const Iterator<U>& r) const { return i != r.i; }
+			};
+		public:
+			using iterator = Iterator<Item>;
+			using const_iterator = Iterator<const Item>;
+
+			//items and index are kept in memory of the resource, on the heap without it
+			explicit OrderedMap(JSONMemoryResource* resource = NULL) : blocks(resource), count(0), index(resource) {}
+			OrderedMap(OrderedMap&& r) noexcept : blocks(std::move(r.blocks)), count(r.count), index(std::move(r.index)) {
+				r.blocks.clear();
+				r.count = 0;
+				r.index.clear();
+			}
+			OrderedMap& operator = (OrderedMap&& r) noexcept {
+				if (&r == this) return *this;
+				release();
+				blocks = std::move(r.blocks);
+				count = r.count;
+				index = std::move(r.index);
+				r.blocks.clear();
+				r.count = 0;
+				r.index.clear();
+				return *this;
+			}
+			OrderedMap(const OrderedMap&) = delete;
+			OrderedMap& operator = (const OrderedMap&) = delete;
+			~OrderedMap() {
+				release();
+			}
+
+			iterator find(const K& k) {
+				return iterator(blocks.data(), position(k));
+			}
+
+			const_iterator find(const K& k) const {
+				return const_iterator(blocks.data(), position(k));
+			}
+
+			iterator begin() {
+				return iterator(blocks.data(), 0);
+			}
+
+			const_iterator begin() const {
+				return const_iterator(blocks.data(), 0);
+			}
+
+			iterator end() {
+				return iterator(blocks.data(), count);
+			}
+
+			const_iterator end() const {
+				return const_iterator(blocks.data(), count);
+			}
+
+			V& operator [] (const K& k) {
+				size_t i = position(k);
+				if (i == count)
+					_insert(k, V());
+
+				return item(i).second;
+			}
+
+			void assign(const K& k, V&& v) {
+				size_t i = position(k);
+				if (i == count)
+					_insert(k, std::move(v));
+				else
+					item(i).second = std::move(v);
+			}
+
+			size_t size() const {
+				return count;
+			}
+
+			void insert(const std::pair<K, V>& p) {
+				if (position(p.first) == count)
+					_insert(p.first, V(p.second));
+			}
+
+			void insert(std::pair<K, V>&& p) {
+				if (position(p.first) == count)
+					_insert(p.first, std::move(p.second));
+			}
+
+			bool empty() const {
+				return !count;
+			}
+
+		private:
+			Item& item(size_t i) {
+				return blocks[i >> blockBits][i & (blockSize - 1)];
+			}
+
+			const Item& item(size_t i) const {
+				return blocks[i >> blockBits][i & (blockSize - 1)];
+			}
+
+			//position of k, size() if there is no k
+			size_t position(const K& k) const {
+				if (index.empty()) {
+					for (size_t i = 0; i < count; ++i)
+						if (item(i).first == k) return i;
+					return count;
+				}
+				size_t mask = index.size() - 1;
+				for (size_t s = std::hash<K>()(k) & mask; index[s]; s = (s + 1) & mask)
+					if (item(index[s] - 1).first == k) return index[s] - 1;
+				return count;
+			}
+
+			void _insert(const K& k, V&& v) {
+				if (count == blocks.size() * blockSize) {
+					JSONAllocator<Item> allocator(blocks.get_allocator());
+					Item* block = allocator.allocate(blockSize);
+					try {
+						blocks.push_back(block);
+					}
+					catch (...) {
+						allocator.deallocate(block, blockSize);
+						throw;
+					}
+				}
+				new(&item(count)) Item(k, std::move(v));
+				++count;
+				if (count <= scanLimit) return;
+				if (count * 2 > index.size()) rehash();
+				else place(count - 1);
+			}
+
+			//index is kept at most half full
+			void rehash() {
+				size_t n = 32;
+				while (n < count * 4) n *= 2;
+				index.assign(n, 0);
+				for (size_t i = 0; i < count; ++i) place(i);
+			}
+
+			void place(size_t i) {
+				size_t mask = index.size() - 1;
+				size_t s = std::hash<K>()(item(i).first) & mask;
+				while (index[s]) s = (s + 1) & mask;
+				index[s] = uint32_t(i + 1);
+			}
+
+			void release() {
+				for (size_t i = 0; i < count; ++i) item(i).~Item();
+				JSONAllocator<Item> allocator(blocks.get_allocator());
+				for (Item* block : blocks) allocator.deallocate(block, blockSize);
+				blocks.clear();
+				count = 0;
+			}
+
+		private:
+			Blocks blocks;
+			size_t count;
+			//position + 1 of an item, 0 in free slots
+			std::vector<uint32_t, JSONAllocator<uint32_t>> index;
+		};
+#else
+		//references to members stay valid when other members are inserted
 		template<class K, class V>
 		class OrderedMap {
-			using Order = std::list<std::pair<K, V>>;
-			using Map = std::map<K, typename Order::iterator>;
+			using Order = std::list<std::pair<K, V>, JSONAllocator<std::pair<K, V>>>;
+			using Map = std::map<K, typename Order::iterator, std::less<K>, JSONAllocator<std::pair<const K, typename Order::iterator>>>;
 		public:
 			using iterator = typename Order::iterator;
 			using const_iterator = typename Order::const_iterator;
 
+			//nodes are allocated from the resource, from the heap without it
+			explicit OrderedMap(JSONMemoryResource* resource = NULL) : order(resource), map(resource) {}
+
 			iterator find(const K& k) {
 				auto iter = map.find(k);
 				if (iter == map.end()) return order.end();
@@ -95,12 +508,24 @@ namespace YUVsoft {
 				return iter->second->second;
 			}
 
+			void assign(const K& k, V&& v) {
+				auto iter = map.find(k);
+				if (iter == map.end())
+					_insert(k, std::move(v));
+				else
+					iter->second->second = std::move(v);
+			}
+
 			typename Order::size_type size() const {
 				return order.size();
 			}
 
 			void insert(const std::pair<K, V>& p) {
-				_insert(p.first, p.second);
+				_insert(p.first, V(p.second));
+			}
+
+			void insert(std::pair<K, V>&& p) {
+				_insert(p.first, std::move(p.second));
 			}
 
 			bool empty() const {
@@ -108,8 +533,8 @@ namespace YUVsoft {
 			}
 
 		private:
-			typename Map::iterator _insert(const K& k, const V& v) {
-				order.push_back({ k, v });
+			typename Map::iterator _insert(const K& k, V&& v) {
+				order.emplace_back(k, std::move(v));
 				return map.insert(map.end(), { k, --order.end() });
 			}
 
@@ -117,6 +542,7 @@ namespace YUVsoft {
 			Order order;
 			Map map;
 		};
+#endif
 
 		class ElemTypeId{};
 		
@@ -125,7 +551,7 @@ namespace YUVsoft {
 		protected:
             friend class YUVsoft::JSON;
 			using Map = OrderedMap<std::string, JSON>;
-			using Array = std::vector<JSON>;
+			using Array = std::vector<JSON, JSONAllocator<JSON>>;
 			
             virtual bool isArray () const { return false; }
             virtual bool isObject() const { return false; }
@@ -136,9 +562,12 @@ namespace YUVsoft {
             virtual const JSON* getByIndex( int i ) const { return NULL; }
             virtual const JSON* getByIndex( const std::string& i ) const  { return NULL; }
             virtual void insert(const std::string& key, const JSON&) {}
+            virtual void insert(const std::string& key, JSON&&) {}
             virtual void append(const JSON&) {}
+            virtual void append(JSON&&) {}
 			virtual size_t length() const { return size_t(-1); }
 			virtual ElemTypeId* elemTypeId() const = 0;
+			//r has the same type
 			virtual int compare(const Elem* r) const = 0;
 			virtual std::shared_ptr<Elem> convert(const JSONElements::ElemTypeId* tag) const { return{}; };
 
@@ -177,8 +606,29 @@ namespace YUVsoft {
 				if(digit>=10) return char('a' + (digit-10));
 				return char('0' + digit);
 			}
+		protected:
+			//the same as elemTypeId(), compared without a virtual call
+			const ElemTypeId* typeTag;
+#ifdef YUVsoft_JSON_COPY_ON_WRITE
+		private:
+			//number of JSON sharing the element
+			mutable std::atomic<long> refs;
+		protected:
+			explicit Elem(const ElemTypeId* tag) : typeTag(tag), refs(1) {}
+			Elem(const Elem& r) : typeTag(r.typeTag), refs(1) {}
+			Elem& operator = (const Elem&) { return *this; }
+#else
+		protected:
+			explicit Elem(const ElemTypeId* tag) : typeTag(tag) {}
+#endif
+			//copy constructed in place of a JSON, NULL for elements kept on the heap
+			virtual Elem* cloneInto(void* place) const { return NULL; }
         public:
             virtual ~Elem() {}
+            //destroys the element and frees its memory, of a resource or of the heap
+            virtual void dispose() { delete this; }
+            //resource of the element memory, NULL on the heap
+            virtual JSONMemoryResource* memoryResource() const { return NULL; }
             virtual void writeToStream(std::ostream&, int prettyDepth, int offset) const =0;
             virtual Elem* clone() const = 0;
 
@@ -211,10 +661,12 @@ namespace YUVsoft {
         };
 
         class String : public Elem {
+            friend class YUVsoft::FastJSONparser;
             std::string value;
         public:
-            String() {}
-			String(const std::string& val) : value(val) {}
+            String() : Elem(getElemTypeId()) {}
+			String(const std::string& val) : Elem(getElemTypeId()), value(val) {}
+			String(std::string&& val) : Elem(getElemTypeId()), value(std::move(val)) {}
 
 			static ElemTypeId* getElemTypeId() {
 				static ElemTypeId res;
@@ -224,8 +676,7 @@ namespace YUVsoft {
 				return getElemTypeId();
 			}
 			virtual int compare(const Elem* r) const override {
-				const String* pr = dynamic_cast<const String*>(r);
-				assert(pr);
+				const String* pr = static_cast<const String*>(r);
 
 				if( value > pr->value ) return  1;
 				if( value < pr->value ) return -1;
@@ -241,6 +692,9 @@ namespace YUVsoft {
             Elem* clone() const {
                 return new String(value);
             }
+            Elem* cloneInto(void* place) const override {
+                return new(place) String(*this);
+            }
 
             typedef std::string NativeType;
             typedef const std::string& NativeTypeRet;
@@ -251,8 +705,8 @@ namespace YUVsoft {
         class Boolean : public Elem {
             bool value;
         public:
-            Boolean() {}
-            Boolean(bool val) : value(val) {}
+            Boolean() : Elem(getElemTypeId()) {}
+            Boolean(bool val) : Elem(getElemTypeId()), value(val) {}
 
 			static ElemTypeId* getElemTypeId() {
 				static ElemTypeId res;
@@ -262,8 +716,7 @@ namespace YUVsoft {
 				return getElemTypeId();
 			}
 			virtual int compare(const Elem* r) const override {
-				const Boolean* pr = dynamic_cast<const Boolean*>(r);
-				assert(pr);
+				const Boolean* pr = static_cast<const Boolean*>(r);
 
 				if( value > pr->value ) return  1;
 				if( value < pr->value ) return -1;
@@ -279,6 +732,9 @@ namespace YUVsoft {
             Elem* clone() const {
                 return new Boolean(value);
             }
+            Elem* cloneInto(void* place) const override {
+                return new(place) Boolean(*this);
+            }
 
 
             typedef bool NativeType;
@@ -290,8 +746,8 @@ namespace YUVsoft {
         class Integer : public Elem {
             int64_t value;
         public:
-            Integer() {}
-			Integer(int64_t val) : value(val) {}
+            Integer() : Elem(getElemTypeId()) {}
+			Integer(int64_t val) : Elem(getElemTypeId()), value(val) {}
 
 			void writeToStream(std::ostream& stream, int prettyDepth, int offset) const override {
 				stream<<value;
@@ -305,8 +761,7 @@ namespace YUVsoft {
 				return getElemTypeId();
 			}
 			virtual int compare(const Elem* r) const override {
-				const Integer* pr = dynamic_cast<const Integer*>(r);
-				assert(pr);
+				const Integer* pr = static_cast<const Integer*>(r);
 
 				if( value > pr->value ) return  1;
 				if( value < pr->value ) return -1;
@@ -318,6 +773,9 @@ namespace YUVsoft {
 			Elem* clone() const {
                 return new Integer(value);
             }
+            Elem* cloneInto(void* place) const override {
+                return new(place) Integer(*this);
+            }
             
             typedef int64_t NativeType;
             typedef int64_t NativeTypeRet;
@@ -328,8 +786,8 @@ namespace YUVsoft {
         class Float : public Elem {
             double value;
         public:
-            Float() {}
-			Float(double val) : value(val) {}
+            Float() : Elem(getElemTypeId()) {}
+			Float(double val) : Elem(getElemTypeId()), value(val) {}
 			
 			static ElemTypeId* getElemTypeId() {
 				static ElemTypeId res;
@@ -339,8 +797,7 @@ namespace YUVsoft {
 				return getElemTypeId();
 			}
 			virtual int compare(const Elem* r) const override {
-				const Float* pr = dynamic_cast<const Float*>(r);
-				assert(pr);
+				const Float* pr = static_cast<const Float*>(r);
 
 				if( value > pr->value ) return  1;
 				if( value < pr->value ) return -1;
@@ -360,6 +817,9 @@ namespace YUVsoft {
             Elem* clone() const {
                 return new Float(value);
             }
+            Elem* cloneInto(void* place) const override {
+                return new(place) Float(*this);
+            }
 
             typedef double NativeType;
             typedef double NativeTypeRet;
@@ -369,7 +829,7 @@ namespace YUVsoft {
 
         class Null : public Elem {
         public:
-			Null() {}
+			Null() : Elem(getElemTypeId()) {}
 
 			void writeToStream(std::ostream& stream, int prettyDepth, int offset) const override {
 				stream<<"null";
@@ -383,76 +843,327 @@ namespace YUVsoft {
 				return getElemTypeId();
 			}
 			virtual int compare(const Elem* r) const override {
-				assert(dynamic_cast<const Null*>(r));
-
 				return 0;
 			}
 
             Null* clone() const {
                 return new Null;
             }
+            Elem* cloneInto(void* place) const override {
+                return new(place) Null;
+            }
         };
     } // namespace JSONElements
 
+	/*
+	*	UTF-8 of wide strings: UTF-16 for 16-bit wchar_t, code points for 32-bit one, where
+	*	surrogate pairs are also combined. Invalid text throws std::range_error, as
+	*	std::wstring_convert did. There is no shared state, so any thread may convert. The
+	*	result is allocated once, runs of ASCII are checked and copied by 8 bytes.
+	*/
+	class WideUTF8 {
+		typedef std::conditional<sizeof(wchar_t) == 2, uint16_t, uint32_t>::type Unit;
+		//bits above ASCII of every unit in 8 bytes
+		static const uint64_t wideHigh = sizeof(wchar_t) == 2 ? 0xFF80FF80FF80FF80ull : 0xFFFFFF80FFFFFF80ull;
+		static const size_t blockUnits = 8 / sizeof(wchar_t);
+	public:
+		static void toUTF8(const wchar_t* text, size_t length, std::string& out) {
+			const wchar_t* end = text + length;
+			size_t size = 0;
+			for (const wchar_t* cur = text; cur != end;) {
+				if (asciiBlock(cur, end)) {
+					cur += blockUnits;
+					size += blockUnits;
+					continue;
+				}
+				unsigned long code = decode(cur, end);
+				size += code < 0x80 ? 1 : code < 0x800 ? 2 : code < 0x10000 ? 3 : 4;
+			}
+
+			size_t at = out.size();
+			out.resize(at + size);
+			char* dst = &out[0] + at;
+			for (const wchar_t* cur = text; cur != end;) {
+				if (asciiBlock(cur, end)) {
+					for (size_t i = 0; i < blockUnits; ++i) dst[i] = char(cur[i]);
+					cur += blockUnits;
+					dst += blockUnits;
+					continue;
+				}
+				dst = encode(decode(cur, end), dst);
+			}
+		}
+
+		static void fromUTF8(const char* text, size_t length, std::wstring& out) {
+			const unsigned char* begin = reinterpret_cast<const unsigned char*>(text);
+			const unsigned char* end = begin + length;
+			//no more units than bytes: the result is cut to its length at the end
+			size_t at = out.size();
+			out.resize(at + length);
+			wchar_t* dst = &out[0] + at;
+			for (const unsigned char* cur = begin; cur != end;) {
+				if (end - cur >= 8 && !(load(cur) & 0x8080808080808080ull)) {
+					for (int i = 0; i < 8; ++i) dst[i] = wchar_t(cur[i]);
+					cur += 8;
+					dst += 8;
+					continue;
+				}
+				unsigned long code = decode(cur, end);
+				if (sizeof(wchar_t) == 2 && code >= 0x10000) {
+					code -= 0x10000;
+					*dst++ = wchar_t(0xD800 + (code >> 10));
+					*dst++ = wchar_t(0xDC00 + (code & 0x3FF));
+				}
+				else {
+					*dst++ = wchar_t(code);
+				}
+			}
+			out.resize(size_t(dst - out.data()));
+		}
+
+	private:
+		static uint64_t load(const void* p) {
+			uint64_t x;
+			std::memcpy(&x, p, 8);
+			return x;
+		}
+
+		static bool asciiBlock(const wchar_t* cur, const wchar_t* end) {
+			return size_t(end - cur) >= blockUnits && !(load(cur) & wideHigh);
+		}
+
+		static unsigned long decode(const wchar_t*& cur, const wchar_t* end) {
+			unsigned long code = Unit(*cur++);
+			if (code >= 0xD800 && code <= 0xDBFF) {
+				unsigned long low = cur != end ? Unit(*cur) : 0;
+				if (low < 0xDC00 || low > 0xDFFF) throw std::range_error("unpaired surrogate");
+				++cur;
+				return 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+			}
+			if ((code >= 0xDC00 && code <= 0xDFFF) || code > 0x10FFFF) throw std::range_error("invalid code point");
+			return code;
+		}
+
+		static char* encode(unsigned long code, char* dst) {
+			if (code < 0x80) {
+				*dst++ = char(code);
+			}
+			else if (code < 0x800) {
+				*dst++ = char(0xC0 | (code >> 6));
+				*dst++ = char(0x80 | (code & 0x3F));
+			}
+			else if (code < 0x10000) {
+				*dst++ = char(0xE0 | (code >> 12));
+				*dst++ = char(0x80 | ((code >> 6) & 0x3F));
+				*dst++ = char(0x80 | (code & 0x3F));
+			}
+			else {
+				*dst++ = char(0xF0 | (code >> 18));
+				*dst++ = char(0x80 | ((code >> 12) & 0x3F));
+				*dst++ = char(0x80 | ((code >> 6) & 0x3F));
+				*dst++ = char(0x80 | (code & 0x3F));
+			}
+			return dst;
+		}
+
+		//shortest forms only, without surrogates
+		static unsigned long decode(const unsigned char*& cur, const unsigned char* end) {
+			unsigned char c = *cur++;
+			if (c < 0x80) return c;
+			int extra;
+			unsigned long code;
+			unsigned char low = 0x80, high = 0xBF;
+			if (c >= 0xC2 && c <= 0xDF) { extra = 1; code = c & 0x1F; }
+			else if (c >= 0xE0 && c <= 0xEF) {
+				extra = 2;
+				code = c & 0x0F;
+				if (c == 0xE0) low = 0xA0;
+				if (c == 0xED) high = 0x9F;
+			}
+			else if (c >= 0xF0 && c <= 0xF4) {
+				extra = 3;
+				code = c & 0x07;
+				if (c == 0xF0) low = 0x90;
+				if (c == 0xF4) high = 0x8F;
+			}
+			else throw std::range_error("invalid UTF-8");
+
+			for (int i = 0; i < extra; ++i, low = 0x80, high = 0xBF) {
+				if (cur == end || *cur < low || *cur > high) throw std::range_error("invalid UTF-8");
+				code = (code << 6) | (*cur++ & 0x3F);
+			}
+			return code;
+		}
+	};
+
+	inline std::string utf16_to_utf8(const wchar_t* text, size_t length) {
+		std::string res;
+		WideUTF8::toUTF8(text, length, res);
+		return res;
+	}
+
+	//converts up to the first null character, as before
 	inline std::string utf16_to_utf8(const std::wstring& text_utf16) {
-		static std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-		return converter.to_bytes(text_utf16.c_str());
+		return utf16_to_utf8(text_utf16.c_str(), std::wcslen(text_utf16.c_str()));
+	}
+
+	inline std::wstring utf8_to_utf16(const char* text, size_t length) {
+		std::wstring res;
+		WideUTF8::fromUTF8(text, length, res);
+		return res;
 	}
 
 	inline std::wstring utf8_to_utf16(const std::string& text_utf8) {
-		static std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
-		return converter.from_bytes(text_utf8.c_str(), text_utf8.c_str() + text_utf8.size());
+		return utf8_to_utf16(text_utf8.c_str(), text_utf8.size());
 	}
 
     class JSON {
+        friend class FastJSONparser;
         JSONElements::Elem* elem;
+        //scalars are constructed here, containers are kept on the heap
+        static const size_t placeSize = std::max({ sizeof(JSONElements::String), sizeof(JSONElements::Integer),
+            sizeof(JSONElements::Float), sizeof(JSONElements::Boolean), sizeof(JSONElements::Null) });
+        alignas(JSONElements::String) alignas(JSONElements::Integer) alignas(JSONElements::Float)
+        unsigned char place[placeSize];
+
+        struct Adopt {};
+        //takes ownership of elem
+        JSON(JSONElements::Elem* owned, Adopt) : elem(owned) {}
+
+        template <class T, class... Args>
+        static JSON make(Args&&... args) {
+            static_assert(sizeof(T) <= placeSize, "element does not fit in place");
+            JSON res;
+            res.elem = new(res.place) T(std::forward<Args>(args)...);
+            return res;
+        }
+
+        bool inPlace() const {
+            return static_cast<const void*>(elem) == static_cast<const void*>(place);
+        }
+
+        //the string constructed in place; addressed by the buffer, not by elem, so that
+        //destruction is never attributed to the shared null element or to the heap
+        JSONElements::String* placeString() {
+            return reinterpret_cast<JSONElements::String*>(static_cast<void*>(place));
+        }
+
+        //element of all null values: default and moved-from JSON do not allocate
+        static JSONElements::Elem* nullElem() {
+            static JSONElements::Null null;
+            return &null;
+        }
+
+        //element for one more owner: shared with copy-on-write, cloned otherwise
+        static JSONElements::Elem* share(const JSONElements::Elem* e) {
+            if( e == nullElem() ) return nullElem();
+#ifdef YUVsoft_JSON_COPY_ON_WRITE
+            //elements of a resource are not shared: the copy may outlive the memory
+            if( e->memoryResource() ) return e->clone();
+            e->refs.fetch_add(1, std::memory_order_relaxed);
+            return const_cast<JSONElements::Elem*>(e);
+#else
+            return e->clone();
+#endif
+        }
+
+        //elem is set to a copy of e
+        void copyFrom(const JSONElements::Elem* e) {
+            elem = e == nullElem() ? nullElem() : e->cloneInto(place);
+            if( !elem ) elem = share(e);
+        }
+
+        //elem is set to the element of r, r becomes null.
+        //Elements in place are dispatched by type tag: only a string needs its destructor
+        void take(JSON& r) noexcept {
+            using namespace JSONElements;
+            if( !r.inPlace() ) elem = r.elem;
+            else if( r.elem->typeTag == String::getElemTypeId() ) {
+                String* from = r.placeString();
+                elem = new(place) String(std::move(*from));
+                from->String::~String();
+            }
+            else if( r.elem->typeTag == Integer::getElemTypeId() ) elem = new(place) Integer(*static_cast<Integer*>(r.elem));
+            else if( r.elem->typeTag == Float  ::getElemTypeId() ) elem = new(place) Float  (*static_cast<Float  *>(r.elem));
+            else if( r.elem->typeTag == Boolean::getElemTypeId() ) elem = new(place) Boolean(*static_cast<Boolean*>(r.elem));
+            else elem = new(place) Null;
+            r.elem = nullElem();
+        }
+
+        //elem is left dangling
+        void destroy() {
+            if( inPlace() ) destroyInPlace();
+            else release(elem);
+        }
+
+        void destroyInPlace() {
+            if( elem->typeTag == JSONElements::String::getElemTypeId() )
+                placeString()->String::~String();
+        }
+
+        static void release(JSONElements::Elem* e) {
+            if( e == nullElem() ) return;
+#ifdef YUVsoft_JSON_COPY_ON_WRITE
+            if( e->refs.fetch_sub(1, std::memory_order_acq_rel) != 1 ) return;
+#endif
+            e->dispose();
+        }
+
+        //the element becomes owned by this JSON only, before it is modified
+        void detach() {
+#ifdef YUVsoft_JSON_COPY_ON_WRITE
+            if( elem != nullElem() && !inPlace() && elem->refs.load(std::memory_order_acquire) != 1 ) {
+                JSONElements::Elem* copy = elem->clone();
+                release(elem);
+                elem = copy;
+            }
+#endif
+        }
 
         template <class T>
         bool isT () const {
-            return dynamic_cast<T*>(elem) != NULL;
+            return elem->typeTag == T::getElemTypeId();
         }
 
         template <class T>
         typename T::NativeTypeRet asT() const {
-            T* t = dynamic_cast<T*>(elem);
-            if(!t ) throw InvalidType();
+            if(!isT<T>() ) throw InvalidType();
 
-            return t->getVal();
+            return static_cast<const T*>(elem)->getVal();
         }
 
         template <class T>
         typename T::NativeTypeRet asT(const typename T::NativeType& byDef) const {
-            T* t = dynamic_cast<T*>(elem);
-            if(!t ) return byDef;
+            if(!isT<T>() ) return byDef;
 
-            return t->getVal();
+            return static_cast<const T*>(elem)->getVal();
         }
     public:
-        JSON() : elem(new JSONElements::Null) {}
-        ~JSON() { delete elem; }
+        JSON() : elem(nullElem()) {}
+        ~JSON() { destroy(); }
 
 		static JSON value (JSON val) { return val; }
 
-        static JSON value (bool val) { return JSON(JSONElements::Boolean(val)); }
+        static JSON value (bool val) { return make<JSONElements::Boolean>(val); }
 
-        static JSON value (char val) { return JSON(JSONElements::Integer(val)); }
-        static JSON value (unsigned char val) { return JSON(JSONElements::Integer(val)); }
-        static JSON value (short val) { return JSON(JSONElements::Integer(val)); }
-        static JSON value (unsigned short val) { return JSON(JSONElements::Integer(val)); }
-        static JSON value (int val) { return JSON(JSONElements::Integer(val)); }
-        static JSON value (unsigned int val) { return JSON(JSONElements::Integer(val)); }
-        static JSON value (long val) { return JSON(JSONElements::Integer(val)); }
-        static JSON value (unsigned long val) { return JSON(JSONElements::Integer(val)); }
-        static JSON value (long long val) { return JSON(JSONElements::Integer(val)); }
-        static JSON value (unsigned long long val) { return JSON(JSONElements::Integer(val)); }
+        static JSON value (char val) { return make<JSONElements::Integer>(val); }
+        static JSON value (unsigned char val) { return make<JSONElements::Integer>(val); }
+        static JSON value (short val) { return make<JSONElements::Integer>(val); }
+        static JSON value (unsigned short val) { return make<JSONElements::Integer>(val); }
+        static JSON value (int val) { return make<JSONElements::Integer>(val); }
+        static JSON value (unsigned int val) { return make<JSONElements::Integer>(val); }
+        static JSON value (long val) { return make<JSONElements::Integer>(val); }
+        static JSON value (unsigned long val) { return make<JSONElements::Integer>(val); }
+        static JSON value (long long val) { return make<JSONElements::Integer>(val); }
+        static JSON value (unsigned long long val) { return make<JSONElements::Integer>(val); }
 
-        static JSON value (double val) { return JSON(JSONElements::Float  (val)); }
-        static JSON value (float  val) { return JSON(JSONElements::Float  (val)); }
+        static JSON value (double val) { return make<JSONElements::Float>(val); }
+        static JSON value (float  val) { return make<JSONElements::Float>(val); }
 
-        static JSON value (const std::string& val) { return JSON(JSONElements::String(val)); }
-		static JSON value (const std::wstring& val) { return JSON(JSONElements::String(utf16_to_utf8(val))); }
-		static JSON value (const char* val) { return JSON(JSONElements::String(val)); }
-		static JSON value (const wchar_t* val) { return JSON(JSONElements::String(utf16_to_utf8(val))); }
+        static JSON value (const std::string& val) { return make<JSONElements::String>(val); }
+		static JSON value (const std::wstring& val) { return make<JSONElements::String>(utf16_to_utf8(val)); }
+		static JSON value (const char* val) { return make<JSONElements::String>(val); }
+		static JSON value (const wchar_t* val) { return make<JSONElements::String>(utf16_to_utf8(val, std::wcslen(val))); }
 
 		template<class T>
 		static JSON value(const std::list<T>& list) { return arrayFromIterable(list); }
@@ -487,27 +1198,56 @@ namespace YUVsoft {
 
         static JSON object();
         static JSON array();
+        //containers in memory of the resource, see JSONDocument
+        static JSON object(JSONMemoryResource& resource);
+        static JSON array(JSONMemoryResource& resource);
 
-        JSON(const JSONElements::Elem& r) : elem(NULL) {
-            set(r);
+        JSON(const JSONElements::Elem& r) : elem(r.cloneInto(place)) {
+            if( !elem ) elem = r.clone();
         }
-        JSON(const JSON& r) : elem(NULL) {
-            set(*r.elem);
+        JSON(const JSON& r) {
+            copyFrom(r.elem);
+        }
+        JSON(JSON&& r) noexcept {
+            take(r);
         }
         JSON& operator = (const JSONElements::Elem& r) {
             set(r);
             return *this;
         }
         JSON& operator = (const JSON& r) {
-            set(*r.elem);
+            if( &r == this ) return *this;
+            //r may be a part of a container, it is copied before the container is released
+            JSONElements::Elem* old = inPlace() ? NULL : elem;
+            if( !old ) {
+                destroyInPlace();
+                elem = nullElem();
+            }
+            copyFrom(r.elem);
+            if( old ) release(old);
+            return *this;
+        }
+        JSON& operator = (JSON&& r) noexcept {
+            if( &r == this ) return *this;
+            JSONElements::Elem* old = inPlace() ? NULL : elem;
+            if( !old ) destroyInPlace();
+            take(r);
+            if( old ) release(old);
             return *this;
         }
+        void swap(JSON& r) noexcept {
+            JSON t(std::move(r));
+            r.take(*this);
+            take(t);
+        }
         void set(const JSONElements::Elem& r) {
-            if( &r==elem ) return;
-            delete elem;
-            elem = r.clone();
+            //r may be a part of this
+            JSON copy(r);
+            destroy();
+            take(copy);
         }
         JSONElements::Elem& get() {
+            detach();
             return *elem;
         }
         const JSONElements::Elem& get() const {
@@ -518,15 +1258,15 @@ namespace YUVsoft {
         class IndexOutRange : public Error {};
         class InvalidType   : public Error {};
 
-        bool isArray () const { return elem->isArray (); }
-        bool isObject() const { return elem->isObject(); }
+        bool isArray () const;
+        bool isObject() const;
 
-        bool isNull() const { return dynamic_cast<JSONElements::Null*>(elem) != NULL; }
+        bool isNull() const { return isT<JSONElements::Null>(); }
 
-        bool isString () const { return dynamic_cast<JSONElements::String *>(elem) != NULL; }
-        bool isInteger() const { return dynamic_cast<JSONElements::Integer*>(elem) != NULL; }
-        bool isBoolean() const { return dynamic_cast<JSONElements::Boolean*>(elem) != NULL; }
-        bool isFloat  () const { return dynamic_cast<JSONElements::Float  *>(elem) != NULL; }
+        bool isString () const { return isT<JSONElements::String >(); }
+        bool isInteger() const { return isT<JSONElements::Integer>(); }
+        bool isBoolean() const { return isT<JSONElements::Boolean>(); }
+        bool isFloat  () const { return isT<JSONElements::Float  >(); }
 
         const std::string& asString()                         const { return asT<JSONElements::String>(); }
         const std::string& asString(const std::string& byDef) const { return asT<JSONElements::String>(byDef); }
@@ -542,6 +1282,7 @@ namespace YUVsoft {
 
 		JSONElements::Elem::Map::iterator begin() {
 			if (!elem->isObject()) throw InvalidType();
+			detach();
 			return elem->begin();
 		}
 		JSONElements::Elem::Map::const_iterator begin() const {
@@ -550,6 +1291,7 @@ namespace YUVsoft {
 		}
 		JSONElements::Elem::Map::iterator end() {
 			if (!elem->isObject()) throw InvalidType();
+			detach();
 			return elem->end();
 		}
 		JSONElements::Elem::Map::const_iterator end() const {
@@ -564,10 +1306,12 @@ namespace YUVsoft {
 			
 			JSONElements::Elem::Array::iterator begin() {
 				if (!json.isArray()) throw InvalidType();
+				json.detach();
 				return json.elem->arrBegin();
 			}
 			JSONElements::Elem::Array::iterator end() {
 				if (!json.isArray()) throw InvalidType();
+				json.detach();
 				return json.elem->arrEnd();
 			}
 
@@ -605,6 +1349,7 @@ namespace YUVsoft {
 
         JSON& operator [] (const std::string& index) {
             if(!elem->isObject() ) throw InvalidType();
+            detach();
             JSON* res = elem->getByIndex(index);
             //if(!res ) throw IndexOutRange(); //never true only this case
 
@@ -612,6 +1357,7 @@ namespace YUVsoft {
         }
         JSON& operator [] (int index) {
             if(!elem->isArray() ) throw InvalidType();
+            detach();
             JSON* res = elem->getByIndex(index);
             if(!res ) throw IndexOutRange();
 
@@ -651,22 +1397,38 @@ namespace YUVsoft {
 
 		//same for elements of same types, different for different types
 		const JSONElements::ElemTypeId* getTypeTag() const {
-			return elem->elemTypeId();
+			return elem->typeTag;
 		}
 
         //insert into object
         JSON& operator () (const std::string& key, const JSON& value) {
             if(!elem->isObject() ) throw InvalidType();
+            detach();
             elem->insert(key,value);
 
             return *this;
         }
+        JSON& operator () (const std::string& key, JSON&& value) {
+            if(!elem->isObject() ) throw InvalidType();
+            detach();
+            elem->insert(key,std::move(value));
+
+            return *this;
+        }
 
         //append to array
         JSON& operator () (const JSON& value) {
             if(!elem->isArray() ) throw InvalidType();
+            detach();
             elem->append(value);
 
+            return *this;
+        }
+        JSON& operator () (JSON&& value) {
+            if(!elem->isArray() ) throw InvalidType();
+            detach();
+            elem->append(std::move(value));
+
             return *this;
         }
 
@@ -719,12 +1481,8 @@ namespace YUVsoft {
 			return res;
 		}
 
-		std::string serialize(int prettyDepth = -1, int offset = 0) const {
-			std::ostringstream s;
-			writeToStream(s, prettyDepth, offset);
-
-			return s.str();
-		}
+		//the same text as writeToStream, written by JSONWriter
+		std::string serialize(int prettyDepth = -1, int offset = 0) const;
 
 		//pretty depth == -1 means all pretty
 		void writeToStream(std::ostream& s, int prettyDepth, int offset = 0) const {
@@ -734,8 +1492,14 @@ namespace YUVsoft {
 
 	namespace JSONElements {
         class Array : public Elem {
-            typedef std::vector<JSON> List;
+            friend class YUVsoft::FastJSONparser;
+            friend class YUVsoft::JSONWriter;
+            typedef std::vector<JSON, JSONAllocator<JSON>> List;
             List elements;
+            //memory of the array, NULL on the heap
+            JSONMemoryResource* resource;
+
+            explicit Array(JSONMemoryResource* resource) : Elem(getElemTypeId()), elements(resource), resource(resource) {}
 
             bool isArray () const override { return true; }
             bool hasIndex( int i ) const override { return i>=0 && i < int(elements.size()); }
@@ -757,6 +1521,9 @@ namespace YUVsoft {
             virtual void append(const JSON& val) { 
                 elements.push_back(val);
             }
+            virtual void append(JSON&& val) { 
+                elements.push_back(std::move(val));
+            }
             virtual size_t length() const {
                 return elements.size();
             }
@@ -766,6 +1533,24 @@ namespace YUVsoft {
                 return new Array(*this);
             }
 
+            //empty array in memory of the resource, on the heap without it
+            static Array* create(JSONMemoryResource* resource) {
+                if( !resource ) return new Array;
+                return new(resource->allocate(sizeof(Array), alignof(Array))) Array(resource);
+            }
+            void dispose() override {
+                if( !resource ) {
+                    delete this;
+                    return;
+                }
+                JSONMemoryResource* from = resource;
+                this->~Array();
+                from->deallocate(this, sizeof(Array), alignof(Array));
+            }
+            JSONMemoryResource* memoryResource() const override {
+                return resource;
+            }
+
 			static ElemTypeId* getElemTypeId() {
 				static ElemTypeId res;
 				return &res;
@@ -774,8 +1559,7 @@ namespace YUVsoft {
 				return getElemTypeId();
 			}
 			virtual int compare(const Elem* r) const override {
-				const Array* pr = dynamic_cast<const Array*>(r);
-				assert(pr);
+				const Array* pr = static_cast<const Array*>(r);
 
 				for(int i=0;i<int(std::min(elements.size(), pr->elements.size()));++i) {
 					if(elements[i] < pr->elements[i]) return -1;
@@ -791,17 +1575,18 @@ namespace YUVsoft {
             }
 
             void push(const Elem& elem) {
-                elements.push_back(*elem.clone());
+                elements.push_back(JSON(elem));
             }
 
-            Array() {}
+            Array() : Elem(getElemTypeId()), resource(NULL) {}
 
             Array& operator () (const Elem& elem) {
                 push(elem);
                 return *this;
             }
 
-            Array(const Array& r) {
+            Array(const Array& r) : Elem(r), resource(NULL) {
+                elements.reserve(r.elements.size());
                 for(List::const_iterator iter = r.elements.begin(); iter!=r.elements.end(); ++iter) {
                     elements.push_back(*iter);
                 }
@@ -837,8 +1622,14 @@ namespace YUVsoft {
         };
 
         class Object : public Elem {
+            friend class YUVsoft::FastJSONparser;
+            friend class YUVsoft::JSONWriter;
 			//typedef OrderedMap<std::string, JSON> Map;
             Map elements;
+            //memory of the object, NULL on the heap
+            JSONMemoryResource* resource;
+
+            explicit Object(JSONMemoryResource* resource) : Elem(getElemTypeId()), elements(resource), resource(resource) {}
 
             virtual bool isObject() const { return true; }
             virtual bool hasIndex( int  ) const { 
@@ -865,7 +1656,12 @@ namespace YUVsoft {
                 return &iter->second;
             }
             virtual void insert(const std::string& key, const JSON& val) { 
-                elements[key] = val;
+                //val may be a member of this object
+                JSON copy(val);
+                elements.assign(key, std::move(copy));
+            }
+            virtual void insert(const std::string& key, JSON&& val) { 
+                elements.assign(key, std::move(val));
             }
             virtual size_t length() const {
                 return elements.size();
@@ -874,6 +1670,24 @@ namespace YUVsoft {
             Object* clone() const {
                 return new Object(*this);
             }
+
+            //empty object in memory of the resource, on the heap without it
+            static Object* create(JSONMemoryResource* resource) {
+                if( !resource ) return new Object;
+                return new(resource->allocate(sizeof(Object), alignof(Object))) Object(resource);
+            }
+            void dispose() override {
+                if( !resource ) {
+                    delete this;
+                    return;
+                }
+                JSONMemoryResource* from = resource;
+                this->~Object();
+                from->deallocate(this, sizeof(Object), alignof(Object));
+            }
+            JSONMemoryResource* memoryResource() const override {
+                return resource;
+            }
 			
 			static ElemTypeId* getElemTypeId() {
 				static ElemTypeId res;
@@ -883,8 +1697,7 @@ namespace YUVsoft {
 				return getElemTypeId();
 			}
 			virtual int compare(const Elem* r) const override {
-				const Object* pr = dynamic_cast<const Object*>(r);
-				assert(pr);
+				const Object* pr = static_cast<const Object*>(r);
 
 				auto il = elements.begin(), ir = pr->elements.begin();
 				for(;il!=elements.end() && ir != pr->elements.end(); ++il, ++ir) {
@@ -901,8 +1714,8 @@ namespace YUVsoft {
             }
 
             void set(const std::string key, const JSON& elem) {
-                //delete elements[key];
-                elements[key] = elem;
+                JSON copy(elem);
+                elements.assign(key, std::move(copy));
             }
 
             Object& operator () (const std::string key, const JSON& elem) {
@@ -910,9 +1723,9 @@ namespace YUVsoft {
                 return *this;
             }
 
-            Object() {}
+            Object() : Elem(getElemTypeId()), resource(NULL) {}
 
-            Object(const Object& r) {
+            Object(const Object& r) : Elem(r), resource(NULL) {
                 for(Map::const_iterator iter = r.elements.begin(); iter!=r.elements.end(); ++iter) {
 					elements.insert({ iter->first, iter->second });
                 }
@@ -1022,20 +1835,260 @@ namespace YUVsoft {
 		}
     }
 
-    inline JSON JSON::array () { return JSON(JSONElements::Array ()); }
-    inline JSON JSON::object() { return JSON(JSONElements::Object()); }
-
-    class GeneralParser {
-        struct CompiledState;
+    inline JSON JSON::array () { return JSON(new JSONElements::Array , Adopt()); }
+    inline JSON JSON::object() { return JSON(new JSONElements::Object, Adopt()); }
+    inline JSON JSON::array (JSONMemoryResource& resource) { return JSON(JSONElements::Array ::create(&resource), Adopt()); }
+    inline JSON JSON::object(JSONMemoryResource& resource) { return JSON(JSONElements::Object::create(&resource), Adopt()); }
+
+    inline bool JSON::isArray () const { return isT<JSONElements::Array >(); }
+    inline bool JSON::isObject() const { return isT<JSONElements::Object>(); }
+
+    /*
+    *   Serializer into a growable buffer or by blocks into a stream. With FLOAT_FIXED the
+    *   text is byte for byte that of JSON::writeToStream, without a stream and its locale:
+    *   strings are scanned by 8 bytes for characters to escape, numbers are formatted by
+    *   std::to_chars where the library has it.
+    */
+    class JSONWriter {
     public:
-        typedef unsigned int StateIdx;
-        class ParseTree;
-        class Unicode {
-            typedef unsigned long Int4bytes;
-            Int4bytes data;
-        public:
-            Unicode() {
-                clear();
+        enum FloatFormat {
+            FLOAT_FIXED,    //16 decimals, as writeToStream
+            FLOAT_SHORTEST  //shortest text read back to the same double
+        };
+
+        explicit JSONWriter(FloatFormat floatFormat = FLOAT_FIXED)
+            : sink(nullptr), floatFormat(floatFormat) {}
+        explicit JSONWriter(std::ostream& sink, FloatFormat floatFormat = FLOAT_FIXED)
+            : sink(&sink), floatFormat(floatFormat) {}
+        ~JSONWriter() { flush(); }
+
+        //pretty depth == -1 means all pretty, as in writeToStream
+        JSONWriter& write(const JSON& value, int prettyDepth = -1, int offset = 0) {
+            writeValue(value, prettyDepth, offset);
+            flush();
+            return *this;
+        }
+
+        //passes the buffered text to the sink stream
+        void flush() {
+            if (!sink || out.empty()) return;
+            sink->write(out.data(), std::streamsize(out.size()));
+            out.clear();
+        }
+
+        //text written without a sink
+        const std::string& str() const { return out; }
+        std::string take() {
+            std::string text;
+            text.swap(out);
+            return text;
+        }
+        void clear() { out.clear(); }
+
+    private:
+        static const size_t blockSize = 1 << 16;
+
+        void writeValue(const JSON& value, int prettyDepth, int offset) {
+            if (value.isString()) writeString(value.asString());
+            else if (value.isInteger()) writeInteger(value.asInteger());
+            else if (value.isFloat()) writeFloat(value.asFloat());
+            else if (value.isBoolean()) out += value.asBoolean() ? "true" : "false";
+            else if (value.isNull()) out += "null";
+            else if (value.isArray()) writeArray(static_cast<const JSONElements::Array&>(value.get()), prettyDepth, offset);
+            else if (value.isObject()) writeObject(static_cast<const JSONElements::Object&>(value.get()), prettyDepth, offset);
+            else {
+                std::ostringstream s;
+                value.get().writeToStream(s, prettyDepth, offset);
+                out += s.str();
+            }
+            if (sink && out.size() >= blockSize) flush();
+        }
+
+        void writeArray(const JSONElements::Array& array, int prettyDepth, int offset) {
+            if (array.elements.empty()) {
+                out += "[]";
+                return;
+            }
+            out += '[';
+            for (size_t i = 0; i < array.elements.size(); ++i) {
+                if (i) out += ',';
+                if (prettyDepth != 0) newLine(offset + 2);
+                writeValue(array.elements[i], prettyDepth > 0 ? prettyDepth - 1 : prettyDepth, offset + 2);
+            }
+            if (prettyDepth != 0) newLine(offset);
+            out += ']';
+        }
+
+        void writeObject(const JSONElements::Object& object, int prettyDepth, int offset) {
+            if (object.elements.empty()) {
+                out += "{}";
+                return;
+            }
+            //keys of the last pretty level are aligned
+            size_t maxKeyLength = 0;
+            if (prettyDepth == 1) {
+                std::string key;
+                for (auto iter = object.elements.begin(); iter != object.elements.end(); ++iter) {
+                    key.clear();
+                    escape(iter->first, key);
+                    maxKeyLength = std::max(maxKeyLength, key.size());
+                }
+            }
+
+            out += '{';
+            for (auto iter = object.elements.begin(); iter != object.elements.end(); ++iter) {
+                if (iter != object.elements.begin()) out += ',';
+                if (prettyDepth != 0) newLine(offset + 2);
+                size_t keyStart = out.size();
+                writeString(iter->first);
+                if (prettyDepth == 1) out.append(maxKeyLength + 2 - (out.size() - keyStart), ' ');
+                out += " : ";
+                writeValue(iter->second, prettyDepth > 0 ? prettyDepth - 1 : prettyDepth, offset + 2);
+            }
+            if (prettyDepth != 0) newLine(offset);
+            out += '}';
+        }
+
+        void newLine(int indent) {
+            out += '\n';
+            out.append(size_t(indent), ' ');
+        }
+
+        void writeString(const std::string& value) {
+            out += '"';
+            escape(value, out);
+            out += '"';
+        }
+
+        //escapes as JSONElements::Elem::escaped: a C1 control is written as \u00XX followed by
+        //its second byte
+        static void escape(const std::string& value, std::string& text) {
+            const unsigned char* classes = escapeClasses();
+            const char* cur = value.data();
+            const char* end = cur + value.size();
+            const char* run = cur;
+            for (;;) {
+                while (end - cur >= 8 && plainWord(cur)) cur += 8;
+                while (cur != end && !classes[(unsigned char)*cur]) ++cur;
+                if (cur == end) break;
+
+                unsigned char c = (unsigned char)*cur;
+                if (c == 0xc2 && (cur + 1 == end || (unsigned char)cur[1] < 0x80 || (unsigned char)cur[1] > 0x9f)) {
+                    ++cur;
+                    continue;
+                }
+                text.append(run, cur);
+                switch (c) {
+                case '\\': text += "\\\\"; break;
+                case '"': text += "\\\""; break;
+                case '\b': text += "\\b"; break;
+                case '\f': text += "\\f"; break;
+                case '\n': text += "\\n"; break;
+                case '\r': text += "\\r"; break;
+                case '\t': text += "\\t"; break;
+                default: {
+                    unsigned char code = c == 0xc2 ? (unsigned char)cur[1] : c;
+                    char hex[6] = { '\\', 'u', '0', '0', hexDigit(code >> 4), hexDigit(code & 15) };
+                    text.append(hex, 6);
+                }
+                }
+                run = ++cur;
+            }
+            text.append(run, end);
+        }
+
+        static char hexDigit(int digit) {
+            return char(digit >= 10 ? 'a' + (digit - 10) : '0' + digit);
+        }
+
+        //no byte below 0x20, quote, backslash, 0x7f or the first byte of a C1 control
+        static bool plainWord(const char* p) {
+            const uint64_t ones = 0x0101010101010101ull, high = 0x8080808080808080ull;
+            uint64_t x;
+            std::memcpy(&x, p, 8);
+            auto zero = [&](uint64_t v) { return (v - ones) & ~v & high; };
+            uint64_t special = ((x - ones * 0x20) & ~x & high)
+                | zero(x ^ (ones * '"')) | zero(x ^ (ones * '\\')) | zero(x ^ (ones * 0x7f)) | zero(x ^ (ones * 0xc2));
+            return !special;
+        }
+
+        static const unsigned char* escapeClasses() {
+            static const struct Table {
+                unsigned char c[256];
+                Table() {
+                    std::fill(c, c + 256, (unsigned char)0);
+                    std::fill(c, c + 0x20, (unsigned char)1);
+                    c[0x7f] = c[(unsigned char)'"'] = c[(unsigned char)'\\'] = c[0xc2] = 1;
+                }
+            } table;
+            return table.c;
+        }
+
+        void writeInteger(int64_t value) {
+            char digits[20];
+            char* p = digits + sizeof(digits);
+            uint64_t magnitude = value < 0 ? 0 - uint64_t(value) : uint64_t(value);
+            do {
+                *--p = char('0' + magnitude % 10);
+                magnitude /= 10;
+            } while (magnitude);
+            if (value < 0) out += '-';
+            out.append(p, digits + sizeof(digits));
+        }
+
+        void writeFloat(double value) {
+            //zero, subnormals, infinities and NaN are written as zero
+            if (!std::isnormal(value)) value = 0.;
+            //fixed notation of the largest double takes 309 digits
+            char text[352];
+            size_t length;
+            if (floatFormat == FLOAT_FIXED) {
+#ifdef __cpp_lib_to_chars
+                length = size_t(std::to_chars(text, text + sizeof(text), value, std::chars_format::fixed, 16).ptr - text);
+#else
+                length = size_t(std::snprintf(text, sizeof(text), "%.16f", value));
+#endif
+                out.append(text, length);
+                return;
+            }
+#ifdef __cpp_lib_to_chars
+            length = size_t(std::to_chars(text, text + sizeof(text), value).ptr - text);
+#else
+            length = size_t(std::snprintf(text, sizeof(text), "%.17g", value));
+#endif
+            out.append(text, length);
+            //still a float when read back
+            if (!std::memchr(text, '.', length) && !std::memchr(text, 'e', length)) out += ".0";
+        }
+
+        std::ostream* sink;
+        FloatFormat floatFormat;
+        std::string out;
+    };
+
+    inline std::string JSON::serialize(int prettyDepth, int offset) const {
+        JSONWriter writer;
+        writer.write(*this, prettyDepth, offset);
+        return writer.take();
+    }
+
+    class GeneralParser {
+        struct CompiledState;
+    public:
+        typedef unsigned int StateIdx;
+        class ParseTree;
+        struct Table;
+        //first state of a parse tree in a table
+        struct Entry {
+            const Table* table;
+            StateIdx first;
+        };
+        class Unicode {
+            typedef unsigned long Int4bytes;
+            Int4bytes data;
+        public:
+            Unicode() {
+                clear();
             }
             void clear() {
                 data = 0;
@@ -1119,6 +2172,29 @@ namespace YUVsoft {
                 return utf8data + size;
             }
         };
+        //writes UTF-8 of a code point (1-4 bytes), lone surrogates are written as 3-byte sequences
+        static int utf8Encode(unsigned long code, char* out) {
+            if (code < 0x80) {
+                out[0] = char(code);
+                return 1;
+            }
+            if (code < 0x800) {
+                out[0] = char(0xC0 | (code >> 6));
+                out[1] = char(0x80 | (code & 0x3F));
+                return 2;
+            }
+            if (code < 0x10000) {
+                out[0] = char(0xE0 | (code >> 12));
+                out[1] = char(0x80 | ((code >> 6) & 0x3F));
+                out[2] = char(0x80 | (code & 0x3F));
+                return 3;
+            }
+            out[0] = char(0xF0 | (code >> 18));
+            out[1] = char(0x80 | ((code >> 12) & 0x3F));
+            out[2] = char(0x80 | ((code >> 6) & 0x3F));
+            out[3] = char(0x80 | (code & 0x3F));
+            return 4;
+        }
         class Parsing {
         protected:
             template<class T>
@@ -1129,11 +2205,11 @@ namespace YUVsoft {
                 Stack() : pointer(0) {}
                 void push(T elem) {
                     if (pointer>=int(data.size())) data.resize(data.size()*2 + 1);
-                    data[pointer++] = elem;
+                    data[pointer++] = std::move(elem);
                 }
                 T pop() {
                     assert(pointer > 0);
-                    return data[--pointer];
+                    return std::move(data[--pointer]);
                 }
                 T& top() {
                     assert(pointer > 0);
@@ -1164,18 +2240,21 @@ namespace YUVsoft {
 
             long long lastInt;
             char lastChar;
+            //high surrogate of \u escape waiting for the low one
+            unsigned long pendingSurrogate;
 
-            GeneralParser* parser;
-            CompiledState* currentState;
+            const Table* table;
+            StateIdx currentState;
 
             bool errorParsing;
             bool finishedParsing;
 
             long long charsRead;
         public:
-            Parsing(ParseTree& tree) : lastInt(0), parser(tree.getParser()), charsRead(0),
-                currentState(tree.getCompiledFirst()), errorParsing(false), finishedParsing(false) {
+            Parsing(const Entry& entry) : lastInt(0), pendingSurrogate(0), table(entry.table), currentState(entry.first),
+                errorParsing(false), finishedParsing(false), charsRead(0) {
             }
+            Parsing(ParseTree& tree) : Parsing(tree.entry()) {}
             virtual ~Parsing() {}
 
             //return number of character parsed
@@ -1192,9 +2271,9 @@ namespace YUVsoft {
             //postcondition: ret = chars + len OR finishedParsing OR errorParsing
             const char* feedChars(const char* chars, size_t len) {
                 while(len>0 && !finishedParsing) {
-                    StateIdx nextIdx = currentState->charNextState[(unsigned char)(*chars)];
+                    StateIdx nextIdx = table->next(currentState, (unsigned char)(*chars));
                     if( nextIdx == StateIdx(-1) ) {
-                        nextIdx = currentState->implicitCome;
+                        nextIdx = table->implicit(currentState);
                     } else {
                         lastChar = *chars;
                         chars++;len--;
@@ -1205,8 +2284,8 @@ namespace YUVsoft {
                         errorParsing = true;
                         return chars;
                     }
-                    currentState = &parser->allStates[nextIdx];
-                    currentState->semantic.exec(this);
+                    currentState = nextIdx;
+                    table->exec(currentState, this);
                 }
 
                 return chars;
@@ -1221,6 +2300,7 @@ namespace YUVsoft {
                 return lastInt;
             }
             std::string popString() {
+                flushSurrogate();
                 std::string str(charBuffer.front(), charBuffer.size());
                 charBuffer.clear();
                 return str;
@@ -1231,31 +2311,55 @@ namespace YUVsoft {
             void feedEOF() {
                 if( errorParsing ) return;
                 while(!finishedParsing ) {
-                    if( currentState->implicitCome == StateIdx(-1) ) {
+                    StateIdx nextIdx = table->implicit(currentState);
+                    if( nextIdx == StateIdx(-1) ) {
                         errorParsing = true;
                         return;
                     }
-                    currentState =&parser->allStates[currentState->implicitCome];
-                    currentState->semantic.exec(this);
+                    currentState = nextIdx;
+                    table->exec(currentState, this);
                 };
             }
             void doReturn() {
                 //std::cout<<"RETURN"<<std::endl;
                 if( returnStack.empty() ) {
                     finishedParsing = true;
-                    currentState =&parser->allStates[0];
+                    currentState = 0;
                     return;
                 }
-                currentState =&parser->allStates[returnStack.pop()];
-                currentState->semantic.exec(this);
+                currentState = returnStack.pop();
+                table->exec(currentState, this);
             }
             void pushReturnState(StateIdx state) {
-                //std::cout<<"CALL "<<(currentState - &parser->allStates[0])<<std::endl;
+                //std::cout<<"CALL "<<currentState<<std::endl;
                 returnStack.push(state);
             }
             void pushChar(char c) {
+                flushSurrogate();
                 charBuffer.push(c);
             }
+            //UTF-8 of \u escape, surrogate pairs are combined
+            void pushUnicode(unsigned long code) {
+                if (pendingSurrogate && code >= 0xDC00 && code <= 0xDFFF) {
+                    code = 0x10000 + ((pendingSurrogate - 0xD800) << 10) + (code - 0xDC00);
+                    pendingSurrogate = 0;
+                }
+                flushSurrogate();
+                if (code >= 0xD800 && code <= 0xDBFF) {
+                    pendingSurrogate = code;
+                    return;
+                }
+                char utf8[4];
+                int n = utf8Encode(code, utf8);
+                for (int i = 0; i < n; ++i) charBuffer.push(utf8[i]);
+            }
+            void flushSurrogate() {
+                if (!pendingSurrogate) return;
+                char utf8[4];
+                int n = utf8Encode(pendingSurrogate, utf8);
+                pendingSurrogate = 0;
+                for (int i = 0; i < n; ++i) charBuffer.push(utf8[i]);
+            }
             void pushInt(long long c) {
                 intBuff.push(c);
             }
@@ -1280,7 +2384,7 @@ namespace YUVsoft {
         class ParseTree {
             State *firstState, *lastState;
             GeneralParser* parser;
-            CompiledState *compiledFirst, *compiledLast;
+            StateIdx firstIdx;
         public:
             ParseTree() : firstState(NULL), lastState(NULL) {}
 
@@ -1303,8 +2407,7 @@ namespace YUVsoft {
             }
 
             void compile() {
-                compiledFirst = firstState->compiledState();
-                compiledLast  =  lastState->compiledState();
+                firstIdx = firstState->getIdx();
             }
 
             State* getFirstState() const {
@@ -1313,8 +2416,9 @@ namespace YUVsoft {
             State* getLastState() const {
                 return firstState;
             }
-            CompiledState* getCompiledFirst() const {
-                return compiledFirst;
+            Entry entry() const {
+                Entry result = { &parser->table, firstIdx };
+                return result;
             }
 
 			AbsId absId;
@@ -1333,6 +2437,11 @@ namespace YUVsoft {
                 virtual ~Action() {}
             };
             typedef void (UserProc) (Parsing* parsing, ExtentionData*);
+            //user proc of a table with its data
+            struct Proc {
+                UserProc* proc;
+                ExtentionData* data;
+            };
         private:
             struct StringData : public ExtentionData {
                 StringData(const std::string& r) : data(r) {}
@@ -1401,8 +2510,9 @@ namespace YUVsoft {
 				return o;
 			}
 
-            void exec(Parsing* parsing) {
-                switch(semantic) {
+            //executes packed semantic of a table
+            static void exec(Parsing* parsing, unsigned char type, long long arg, const Table& table) {
+                switch(PreservedSemantics(type)) {
                 case S_RELAX: break;
                 case S_PUSH_LAST_CHAR:
                     parsing->pushChar(parsing->getLastCharacter());
@@ -1412,10 +2522,10 @@ namespace YUVsoft {
                     parsing->getLastInt() = 0;
                     break;
                 case S_PUSH_CHAR:
-                    parsing->pushChar(actionData.character);
+                    parsing->pushChar(char(arg));
                     break;
                 case S_PUSH_INT:
-                    parsing->pushInt(actionData.integer);
+                    parsing->pushInt(arg);
                     break;
                 case S_PUSH_DIGIT_IN_STACK:
                     {
@@ -1426,7 +2536,7 @@ namespace YUVsoft {
                     }
                     break;
                 case S_DEBUG:
-                    std::cout<<dynamic_cast<StringData*>(extention)->data<<std::endl;
+                    std::cout<<dynamic_cast<StringData*>(table.extentions[arg])->data<<std::endl;
                     break;
                 case S_PUSH_HEXDIGIT_IN_STACK: 
                     {
@@ -1444,11 +2554,7 @@ namespace YUVsoft {
                     break;
                 case S_PUSH_UNICODE:
                     {
-                        unsigned long i = (unsigned long)(parsing->getLastInt());
-                        parsing->pushChar((i>> 0) & 0xFF);
-                        parsing->pushChar((i>> 8) & 0xFF);
-                        parsing->pushChar((i>>16) & 0xFF);
-                        parsing->pushChar((i>>24) & 0xFF);
+                        parsing->pushUnicode((unsigned long)(parsing->getLastInt()));
                         parsing->getLastInt() = 0;
                     }
                     break;
@@ -1456,18 +2562,44 @@ namespace YUVsoft {
                     parsing->doReturn();
                     break;
                 case S_CALL:
-                    parsing->pushReturnState(actionData.state);
+                    parsing->pushReturnState(StateIdx(arg));
                     break;
                 case S_CALL_USER_PROC: 
-                    (*actionData.userProc)(parsing, extention);
+                    (*table.procs[arg].proc)(parsing, table.procs[arg].data);
                     break;
                 case S_DO_USER_ACTION:
-                    Action* act = dynamic_cast<Action*>(extention);
+                    Action* act = dynamic_cast<Action*>(table.extentions[arg]);
                     assert(act);
 					act->call(parsing);
 					break;
                 }
             }
+            //type and argument of the packed semantic, user procs and extention data are numbered by the callbacks
+            template<class ProcIndex, class ExtentionIndex>
+            void pack(unsigned char& type, long long& arg, ProcIndex procIndex, ExtentionIndex extentionIndex) const {
+                type = (unsigned char)semantic;
+                arg = 0;
+                switch(semantic) {
+                case S_PUSH_CHAR:
+                    arg = actionData.character;
+                    break;
+                case S_PUSH_INT:
+                    arg = actionData.integer;
+                    break;
+                case S_CALL:
+                    arg = actionData.state;
+                    break;
+                case S_CALL_USER_PROC:
+                    arg = procIndex(actionData.userProc, extention);
+                    break;
+                case S_DEBUG:
+                case S_DO_USER_ACTION:
+                    arg = extentionIndex(extention);
+                    break;
+                default:
+                    break;
+                }
+            }
             bool isRelax() const {
                 return semantic == S_RELAX;
             }
@@ -1550,13 +2682,8 @@ namespace YUVsoft {
                 }
                 return true;
             }
-            void exec(Parsing* parsing) {
-                if( vector.empty() ) return;
-
-                Semantic* data = &vector[0];
-                for(size_t i=0, end = vector.size();i<end;++i) {
-                    data[i].exec(parsing);
-                }
+            const std::vector<Semantic>& items() const {
+                return vector;
             }
             void insert(const Semantic& r) {
                 vector.push_back(r);
@@ -2019,8 +3146,24 @@ namespace YUVsoft {
 
 			//createVisualization("c:\\temp\\bbb.gml");
 
+            //extention data stays owned by allStates
+            procs.clear();
+            extentions.clear();
+            pack(packed,
+                [this](Semantic::UserProc* proc, Semantic::ExtentionData* data) {
+                    Semantic::Proc item = { proc, data };
+                    procs.push_back(item);
+                    return (long long)procs.size() - 1;
+                },
+                [this](Semantic::ExtentionData* data) {
+                    extentions.push_back(data);
+                    return (long long)extentions.size() - 1;
+                });
+            table = packed.table(procs.data(), extentions.data());
+
             statePointers.clear();
             tempStates.clear();
+            allTrees.clear();
         }
 
 		void createVisualization(const std::string& fileName) {
@@ -2137,18 +3280,171 @@ namespace YUVsoft {
         };
         static const StateIdx reservedStates = 2;
         std::vector<CompiledState> allStates;
+
+    public:
+        /*
+        *   Compiled states in compact form, used by Parsing. Bytes with the same transitions in
+        *   all states share a class, states with the same transitions share a row.
+        *   Arrays are owned by a PackedTable or are precompiled data (see JSONparser).
+        */
+        struct Table {
+            static const unsigned short none = 0xFFFF;
+
+            const unsigned char* charClass;
+            unsigned classCount;
+            const unsigned short* stateRow;
+            const unsigned short* rows;
+            const unsigned short* implicitCome;
+            //semantics of state i are [semanticBegin[i], semanticBegin[i + 1])
+            const unsigned short* semanticBegin;
+            const unsigned char* semanticType;
+            const long long* semanticArg;
+            const Semantic::Proc* procs;
+            Semantic::ExtentionData* const* extentions;
+
+            StateIdx next(StateIdx state, unsigned char c) const {
+                unsigned short idx = rows[stateRow[state] * classCount + charClass[c]];
+                return idx == none ? StateIdx(-1) : StateIdx(idx);
+            }
+            StateIdx implicit(StateIdx state) const {
+                return implicitCome[state] == none ? StateIdx(-1) : StateIdx(implicitCome[state]);
+            }
+            void exec(StateIdx state, Parsing* parsing) const {
+                for(unsigned i = semanticBegin[state], end = semanticBegin[state + 1]; i < end; ++i) {
+                    Semantic::exec(parsing, semanticType[i], semanticArg[i], *this);
+                }
+            }
+        };
+
+    protected:
+        class PackedTable {
+        public:
+            template<class ProcIndex, class ExtentionIndex>
+            void build(const std::vector<CompiledState>& states, ProcIndex procIndex, ExtentionIndex extentionIndex) {
+                assert(states.size() < Table::none);
+
+                //bytes with equal columns of transitions get one class
+                std::map<std::vector<unsigned short>, unsigned char> columns;
+                for(int c = 0; c < 256; ++c) {
+                    std::vector<unsigned short> column(states.size());
+                    for(size_t i = 0; i < states.size(); ++i) column[i] = packIdx(states[i].charNextState[c]);
+                    charClass[c] = columns.insert(std::make_pair(column, (unsigned char)columns.size())).first->second;
+                }
+                classCount = unsigned(columns.size());
+
+                std::map<std::vector<unsigned short>, unsigned short> rowIdx;
+                stateRow.clear();
+                rows.clear();
+                implicitCome.clear();
+                semanticBegin.clear();
+                semanticType.clear();
+                semanticArg.clear();
+                for(const CompiledState& state : states) {
+                    std::vector<unsigned short> row(classCount);
+                    for(int c = 0; c < 256; ++c) row[charClass[c]] = packIdx(state.charNextState[c]);
+                    auto found = rowIdx.insert(std::make_pair(row, (unsigned short)rowIdx.size()));
+                    if( found.second ) rows.insert(rows.end(), row.begin(), row.end());
+                    stateRow.push_back(found.first->second);
+                    implicitCome.push_back(packIdx(state.implicitCome));
+
+                    semanticBegin.push_back((unsigned short)semanticType.size());
+                    for(const Semantic& semantic : state.semantic.items()) {
+                        unsigned char type;
+                        long long arg;
+                        semantic.pack(type, arg, procIndex, extentionIndex);
+                        semanticType.push_back(type);
+                        semanticArg.push_back(arg);
+                    }
+                }
+                semanticBegin.push_back((unsigned short)semanticType.size());
+            }
+            Table table(const Semantic::Proc* procs, Semantic::ExtentionData* const* extentions) const {
+                Table result = {
+                    charClass, classCount, stateRow.data(), rows.data(), implicitCome.data(), semanticBegin.data(),
+                    semanticType.data(), semanticArg.data(), procs, extentions
+                };
+                return result;
+            }
+
+            unsigned char charClass[256];
+            unsigned classCount;
+            std::vector<unsigned short> stateRow;
+            std::vector<unsigned short> rows;
+            std::vector<unsigned short> implicitCome;
+            std::vector<unsigned short> semanticBegin;
+            std::vector<unsigned char> semanticType;
+            std::vector<long long> semanticArg;
+
+        private:
+            static unsigned short packIdx(StateIdx idx) {
+                return idx == StateIdx(-1) ? Table::none : (unsigned short)idx;
+            }
+        };
+
+        //packs the compiled states with own numbering of user procs and extention data
+        template<class ProcIndex, class ExtentionIndex>
+        void pack(PackedTable& out, ProcIndex procIndex, ExtentionIndex extentionIndex) const {
+            out.build(allStates, procIndex, extentionIndex);
+        }
+
+    private:
+        PackedTable packed;
+        std::vector<Semantic::Proc> procs;
+        std::vector<Semantic::ExtentionData*> extentions;
+        Table table;
+    };
+
+    //value of a decimal number, shared by both parsers so that they produce identical values
+    struct JSONnumber {
+        //sign * (whole.fraction) * 10^exponent, fraction has fractionDigits digits
+        static double make(bool negative, uint64_t whole, uint64_t fraction, long long fractionDigits, long long exponent) {
+            static const uint64_t maxMantissa = uint64_t(-1);
+            if (fractionDigits > 19) {
+                //fraction did not fit into an integer, its digits are lost anyway
+                double number = double(whole) + double(fraction) / std::pow(10., double(fractionDigits));
+                number *= std::pow(10., double(exponent));
+                return negative ? -number : number;
+            }
+            uint64_t scale = 1;
+            for (long long i = 0; i < fractionDigits; ++i) scale *= 10;
+            if (whole > (maxMantissa - fraction) / scale) {
+                std::string digits = std::to_string(whole);
+                std::string fractionText = std::to_string(fraction);
+                digits.append(size_t(fractionDigits) - fractionText.size(), '0');
+                digits += fractionText;
+                return fromDigits(negative, digits, exponent - fractionDigits);
+            }
+            return fromMantissa(negative, whole * scale + fraction, exponent - fractionDigits);
+        }
+
+        //sign * mantissa * 10^exponent, correctly rounded
+        static double fromMantissa(bool negative, uint64_t mantissa, long long exponent) {
+            static const double powers[] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+            };
+            //both operands are exact, so is the rounding of the product
+            if (mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+                double number = exponent >= 0 ? double(mantissa) * powers[exponent] : double(mantissa) / powers[-exponent];
+                return negative ? -number : number;
+            }
+            return fromDigits(negative, std::to_string(mantissa), exponent);
+        }
+
+        //digits without decimal point do not depend on the locale of strtod
+        static double fromDigits(bool negative, const std::string& digits, long long exponent) {
+            std::string text = digits + "e" + std::to_string(exponent);
+            double number = std::strtod(text.c_str(), nullptr);
+            return negative ? -number : number;
+        }
     };
 
     class ParseWrapper;
     class JSONparser : public GeneralParser {
         friend class ParseWrapper;
 
-        ParseTree string;
-        ParseTree number;
-        ParseTree value;
-        ParseTree array;
-        ParseTree object;
-        ParseTree ws;
+        Entry value;
+        Entry ws;
 
 	public:
         struct Error {
@@ -2225,10 +3521,14 @@ namespace YUVsoft {
             long long lineNum;
             long long lineOff;
         public:
-            Parsing(ParseTree& tree) : Base(tree), lineNum(0), lineOff(0) {}
+            Parsing(const Entry& entry) : Base(entry), errorType(Error::ERR_OK), lineNum(0), lineOff(0) {}
             const JSON& result() const {
                 return stackJSON.top();
             }
+            //moves the result out, the parsing keeps null
+            JSON takeResult() {
+                return std::move(stackJSON.top());
+            }
             bool hasResult() const {
                 return !stackJSON.empty();
             }
@@ -2246,6 +3546,11 @@ namespace YUVsoft {
                 assert(p);
                 p->numberParsing.hasMinus = true;
             }
+            static void numberExpMinus(Base* parsing, Semantic::ExtentionData*) {
+                Parsing* p = dynamic_cast<Parsing*>(parsing);
+                assert(p);
+                p->numberParsing.expMinus = true;
+            }
             static void numberDot(Base* parsing, Semantic::ExtentionData*) {
                 Parsing* p = dynamic_cast<Parsing*>(parsing);
                 assert(p);
@@ -2284,13 +3589,9 @@ namespace YUVsoft {
                 assert(p);
 
                 if( p->numberParsing.hasExp || p->numberParsing.hasDot ) {
-                    double number = (double)(p->numberParsing.hasMinus ?  -p->numberParsing.wholePart : p->numberParsing.wholePart);
-                    number += p->numberParsing.fraqPart / std::pow(10,p->numberParsing.fraqPartLength);
-                    if( p->numberParsing.hasExp ) {
-                        number *= std::pow(10,p->numberParsing.expMinus ? -p->numberParsing.expPart : p->numberParsing.expPart);
-                    }
+                    const NumberParsing& n = p->numberParsing;
                     p->stackJSON.push( JSON::value( 
-                        number
+                        JSONnumber::make(n.hasMinus, uint64_t(n.wholePart), uint64_t(n.fraqPart), n.fraqPartLength, n.expMinus ? -n.expPart : n.expPart)
                     ));
                 } else {
                     p->stackJSON.push( JSON::value( 
@@ -2332,7 +3633,7 @@ namespace YUVsoft {
                 assert(p);
                 JSON val = p->stackJSON.pop();
                 std::string key = p->stackJSON.pop().asString();
-                p->objectStack.top()(key, val);
+                p->objectStack.top()(key, std::move(val));
             }
             static void objectPop(Base* parsing, Semantic::ExtentionData*) {
                 Parsing* p = dynamic_cast<Parsing*>(parsing);
@@ -2370,7 +3671,10 @@ namespace YUVsoft {
         class SetError : public Semantic::Action {
             Error::ErrorType errorType;
         public:
-            SetError(Error::ErrorType type) : errorType(type) {
+            SetError(Error::ErrorType type = Error::ERR_OK) : errorType(type) {
+            }
+            Error::ErrorType type() const {
+                return errorType;
             }
             SetError* clone() const override {
                 return new SetError(errorType);
@@ -2381,7 +3685,58 @@ namespace YUVsoft {
             }
         };
 
+        //user procs of the grammar, precompiled table refers to them by index
+        static const Semantic::Proc* userProcs() {
+            static const Semantic::Proc procs[] = {
+                { Parsing::numberMinus, NULL }, { Parsing::numberExpMinus, NULL }, { Parsing::numberDot, NULL },
+                { Parsing::numberExp, NULL }, { Parsing::numberWholePart, NULL }, { Parsing::numberFraqPart, NULL },
+                { Parsing::numberFraqInc, NULL }, { Parsing::numberExtPart, NULL }, { Parsing::numberEnd, NULL },
+                { Parsing::stringEnd, NULL }, { Parsing::arrayPush, NULL }, { Parsing::arrayNext, NULL },
+                { Parsing::arrayPop, NULL }, { Parsing::objectPush, NULL }, { Parsing::objectNext, NULL },
+                { Parsing::objectPop, NULL }, { Parsing::valueTrue, NULL }, { Parsing::valueFalse, NULL },
+                { Parsing::valueNull, NULL }, { Parsing::incLine, NULL }, { Parsing::resetLineOff, NULL },
+                { NULL, NULL }
+            };
+            return procs;
+        }
+
+        //SetError actions indexed by error type
+        static Semantic::ExtentionData* const* errorActions() {
+            static struct Actions {
+                SetError errors[Error::ERR_UNKNOWN + 1];
+                Semantic::ExtentionData* pointers[Error::ERR_UNKNOWN + 1];
+                Actions() {
+                    for(int i = 0; i <= Error::ERR_UNKNOWN; ++i) {
+                        errors[i] = SetError(Error::ErrorType(i));
+                        pointers[i] = &errors[i];
+                    }
+                }
+            } actions;
+            return actions.pointers;
+        }
+
+        static const Table& precompiled() {
+            static const Table table = {
+                JSONtable::charClass(), JSONtable::classCount, JSONtable::stateRow(), JSONtable::rows(),
+                JSONtable::implicitCome(), JSONtable::semanticBegin(), JSONtable::semanticType(), JSONtable::semanticArg(),
+                userProcs(), errorActions()
+            };
+            return table;
+        }
+
+        struct CompileGrammar {};
+        explicit JSONparser(CompileGrammar) {
+            initializeParser();
+        }
+
         void initializeParser() {
+            ParseTree string;
+            ParseTree number;
+            ParseTree value;
+            ParseTree array;
+            ParseTree object;
+            ParseTree ws;
+
             State stringInit(this);
             State stringControlExpecting(this);
             State stringAfterStart(this);
@@ -2452,7 +3807,7 @@ namespace YUVsoft {
             numberBeforeExp >> numberEnd;
             numberAfterExp  >> Semantic::doAction(SetError(Error::ERR_EXPECTED_DIGIT_OR_SIGN_AFTER_EXP_IN_NUMBER));
             numberAfterExp  >> Step::character('+') >> numberAfterExpSign;
-            numberAfterExp  >> Step::character('-') >> Semantic::userProc(Parsing::numberMinus) >> numberAfterExpSign;
+            numberAfterExp  >> Step::character('-') >> Semantic::userProc(Parsing::numberExpMinus) >> numberAfterExpSign;
             numberAfterExp  >> numberAfterExpSign;
             numberAfterExpSign  >> Semantic::doAction(SetError(Error::ERR_EXPECTED_DIGIT_IN_NUMBER));
             numberAfterExpSign  >> Step::digit() >> Semantic::pushDigit() >> numberAfterExpDigit;
@@ -2534,11 +3889,90 @@ namespace YUVsoft {
             ws.setStates(wsInit,wsEnd);
 
             compile();
+            this->value = value.entry();
+            this->ws = ws.entry();
         }
     public:
+        //uses precompiled grammar from json_table.h, construction does not compile it
         JSONparser() {
-            initializeParser();
+            Entry valueEntry = { &precompiled(), JSONtable::valueFirst };
+            Entry wsEntry = { &precompiled(), JSONtable::wsFirst };
+            value = valueEntry;
+            ws = wsEntry;
+        }
+
+        /*
+        *   Writes json_table.h: the grammar of initializeParser compiled and packed.
+        *   The table has to be regenerated after any change of the grammar or of userProcs.
+        */
+        static void writeTable(std::ostream& out) {
+            JSONparser parser((CompileGrammar()));
+            PackedTable packed;
+            const Semantic::Proc* procs = userProcs();
+            parser.pack(packed,
+                [procs](Semantic::UserProc* proc, Semantic::ExtentionData*) {
+                    long long i = 0;
+                    while(procs[i].proc && procs[i].proc != proc) ++i;
+                    assert(procs[i].proc);
+                    return i;
+                },
+                [](Semantic::ExtentionData* data) {
+                    SetError* error = dynamic_cast<SetError*>(data);
+                    assert(error);
+                    return (long long)error->type();
+                });
+
+            out << "/*\n"
+                "********************************************************************\n"
+                "(c) MSU Video Group, http://compression.ru/video/\n"
+                "This source code is property of MSU Graphics and Media Lab\n"
+                "\n"
+                "This code may be distributed under LGPL\n"
+                "(see http://www.gnu.org/licenses/lgpl.html for more details).\n"
+                "\n"
+                "E-mail: video-measure@compression.ru\n"
+                "********************************************************************\n"
+                "*/\n"
+                "\n"
+                "/*\n"
+                "*   Compiled grammar of YUVsoft::JSONparser, see GeneralParser::Table.\n"
+                "*   Generated by JSONparser::writeTable, do not edit.\n"
+                "*/\n"
+                "\n"
+                "#pragma once\n"
+                "\n"
+                "namespace YUVsoft {\n"
+                "    struct JSONtable {\n"
+                "        enum {\n"
+                "            valueFirst = " << parser.value.first << ",\n"
+                "            wsFirst = " << parser.ws.first << ",\n"
+                "            classCount = " << packed.classCount << "\n"
+                "        };\n";
+            writeArray(out, "unsigned char", "charClass", std::vector<int>(packed.charClass, packed.charClass + 256));
+            writeArray(out, "unsigned short", "stateRow", packed.stateRow);
+            writeArray(out, "unsigned short", "rows", packed.rows);
+            writeArray(out, "unsigned short", "implicitCome", packed.implicitCome);
+            writeArray(out, "unsigned short", "semanticBegin", packed.semanticBegin);
+            writeArray(out, "unsigned char", "semanticType", packed.semanticType);
+            writeArray(out, "long long", "semanticArg", packed.semanticArg);
+            out << "    };\n"
+                "}\n";
         }
+    private:
+        template<class T>
+        static void writeArray(std::ostream& out, const char* type, const char* name, const std::vector<T>& data) {
+            out << "\n"
+                "        static const " << type << "* " << name << "() {\n"
+                "            static const " << type << " data[] = {";
+            for(size_t i = 0; i < data.size(); ++i) {
+                out << (i % 16 ? " " : "\n                ") << (long long)data[i] << (i + 1 < data.size() ? "," : "");
+            }
+            out << "\n"
+                "            };\n"
+                "            return data;\n"
+                "        }\n";
+        }
+    public:
         void parseInt() {
             Parsing parsing(value);
             parsing.parseString("[[\r\n[{\"a\\t\":-6-,\"\":true}],[]]]");
@@ -2546,12 +3980,544 @@ namespace YUVsoft {
         }
     };
 
+    /*
+    *   Events of a parsed document, in document order. A handler derives from JSONEvents and
+    *   hides the events it needs, the calls are resolved at compile time. Strings and keys
+    *   are passed in a buffer reused by the parser, values are not stored anywhere.
+    */
+    struct JSONEvents {
+        void onNull() {}
+        void onBoolean(bool) {}
+        void onInteger(int64_t) {}
+        void onFloat(double) {}
+        void onString(const std::string&) {}
+        void onStartObject() {}
+        void onKey(const std::string&) {}
+        void onEndObject() {}
+        void onStartArray() {}
+        void onEndArray() {}
+    };
+
+    /*
+    *   Recursive-descent parser of a buffer. It builds the same values and reports the same
+    *   errors (type, offset, line) as JSONparser, but reads every character once without the
+    *   state machine: runs of string characters are found by a table lookup, numbers are
+    *   accumulated in integers and values are built in place, without copies.
+    *   Documents nested deeper than maxDepth are passed to JSONparser instead of recursing.
+    */
+    class FastJSONparser {
+    public:
+        typedef JSONparser::Error Error;
+
+        //arrays and objects are allocated from the resource, from the heap without it
+        static JSON parse(const char* start, const char* end, JSONMemoryResource* resource = NULL) YUVsoft_THROW(Error);
+
+        //reports the document to the handler instead of building it, with the errors of parse.
+        //Nesting is kept by a stack of brackets, so any depth is parsed here
+        template<class Handler>
+        static void parseEvents(const char* start, const char* end, Handler& handler) YUVsoft_THROW(Error) {
+            FastJSONparser parser(start, end);
+            parser.events(handler);
+        }
+
+    private:
+        friend class ParseWrapper;
+        typedef JSONElements::Elem Elem;
+        struct TooDeep {};
+        static const int maxDepth = 512;
+
+        //frees an element being parsed on an error
+        struct Dispose {
+            void operator()(Elem* e) const { e->dispose(); }
+        };
+
+        enum CharClass {
+            C_PLAIN,
+            C_QUOTE,
+            C_SLASH,
+            C_CONTROL,
+            C_C2    //first byte of UTF-8 C1 control characters
+        };
+
+        FastJSONparser(const char* start, const char* end, JSONMemoryResource* resource = NULL)
+            : begin(start), cur(start), end(end), line(0), lineStart(0), depth(0), resource(resource) {
+            pending.reserve(64);
+        }
+
+        static const unsigned char* stringClasses() {
+            static const struct Table {
+                unsigned char c[256];
+                Table() {
+                    std::fill(c, c + 256, (unsigned char)C_PLAIN);
+                    std::fill(c, c + 0x20, (unsigned char)C_CONTROL);
+                    c[0x7f] = C_CONTROL;
+                    c[(unsigned char)'"'] = C_QUOTE;
+                    c[(unsigned char)'\\'] = C_SLASH;
+                    c[0xc2] = C_C2;
+                }
+            } table;
+            return table.c;
+        }
+
+        static bool isDigit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        [[noreturn]] void fail(Error::ErrorType type, const char* at) const {
+            throw Error(type, line, lineStart, at - begin);
+        }
+
+        JSON parseValue() {
+            skipWs(cur == begin ? Error::ERR_EXPECTED_VALUE : Error::ERR_EXPECTED_WHITESPACE);
+            if (cur == end) fail(Error::ERR_EXPECTED_VALUE, cur);
+            switch (*cur) {
+            case '"': {
+                JSON str = JSON::make<JSONElements::String>();
+                parseString(static_cast<JSONElements::String*>(str.elem)->value);
+                return str;
+            }
+            case '{': return JSON(parseObject(), JSON::Adopt());
+            case '[': return JSON(parseArray(), JSON::Adopt());
+            case 't': literal("true"); return JSON::make<JSONElements::Boolean>(true);
+            case 'f': literal("false"); return JSON::make<JSONElements::Boolean>(false);
+            case 'n': literal("null"); return JSON();
+            default:
+                if (*cur == '-' || isDigit(*cur)) return parseNumber();
+                fail(Error::ERR_EXPECTED_VALUE, cur);
+            }
+        }
+
+        template<class Handler>
+        void events(Handler& handler) {
+            std::vector<char> open;
+            std::string text;
+            for (;;) {
+                skipWs(cur == begin ? Error::ERR_EXPECTED_VALUE : Error::ERR_EXPECTED_WHITESPACE);
+                if (cur == end) fail(Error::ERR_EXPECTED_VALUE, cur);
+                switch (*cur) {
+                case '"':
+                    text.clear();
+                    parseString(text);
+                    handler.onString(text);
+                    break;
+                case '[':
+                    handler.onStartArray();
+                    ++cur;
+                    skipWs();
+                    if (cur != end && *cur == ']') {
+                        ++cur;
+                        handler.onEndArray();
+                        break;
+                    }
+                    open.push_back('[');
+                    continue;
+                case '{':
+                    handler.onStartObject();
+                    ++cur;
+                    skipWs();
+                    if (cur != end && *cur == '}') {
+                        ++cur;
+                        handler.onEndObject();
+                        break;
+                    }
+                    if (cur == end || *cur != '"') fail(Error::ERR_EXPECTED_END_OF_OBJECT_OR_OBJECT_ELEMENT, cur);
+                    open.push_back('{');
+                    eventKey(handler, text);
+                    continue;
+                case 't': literal("true"); handler.onBoolean(true); break;
+                case 'f': literal("false"); handler.onBoolean(false); break;
+                case 'n': literal("null"); handler.onNull(); break;
+                default: {
+                    if (*cur != '-' && !isDigit(*cur)) fail(Error::ERR_EXPECTED_VALUE, cur);
+                    JSON number = parseNumber();
+                    if (number.isInteger()) handler.onInteger(number.asInteger());
+                    else handler.onFloat(number.asFloat());
+                }
+                }
+
+                //the value is complete: close the containers it completes
+                for (;;) {
+                    if (open.empty()) {
+                        skipWs(Error::ERR_EXPECTED_END_OF_FILE);
+                        if (cur != end) fail(Error::ERR_EXPECTED_END_OF_FILE, cur);
+                        return;
+                    }
+                    skipWs();
+                    if (open.back() == '[') {
+                        if (cur != end && *cur == ',') {
+                            ++cur;
+                            break;
+                        }
+                        if (cur == end || *cur != ']') fail(Error::ERR_EXPECTED_COMMA_OR_END_OF_ARRAY, cur);
+                        ++cur;
+                        open.pop_back();
+                        handler.onEndArray();
+                    }
+                    else {
+                        if (cur != end && *cur == ',') {
+                            ++cur;
+                            skipWs();
+                            if (cur == end || *cur != '"') fail(Error::ERR_EXPECTED_OBJECT_ELEMENT, cur);
+                            eventKey(handler, text);
+                            break;
+                        }
+                        if (cur == end || *cur != '}') fail(Error::ERR_EXPECTED_COMMA_OR_END_OF_OBJECT, cur);
+                        ++cur;
+                        open.pop_back();
+                        handler.onEndObject();
+                    }
+                }
+            }
+        }
+
+        //cur points to the opening quote of a key
+        template<class Handler>
+        void eventKey(Handler& handler, std::string& text) {
+            text.clear();
+            parseString(text);
+            skipWs();
+            if (cur == end || *cur != ':') fail(Error::ERR_EXPECTED_COLON, cur);
+            ++cur;
+            handler.onKey(text);
+        }
+
+        Elem* parseArray() {
+            if (++depth > maxDepth) throw TooDeep();
+            std::unique_ptr<JSONElements::Array, Dispose> array(JSONElements::Array::create(resource));
+            ++cur;
+            skipWs();
+            size_t base = pending.size();
+            if (cur != end && *cur == ']') {
+                ++cur;
+            }
+            else for (;;) {
+                pending.push_back(parseValue());
+                skipWs();
+                if (cur != end && *cur == ',') {
+                    ++cur;
+                    continue;
+                }
+                if (cur != end && *cur == ']') {
+                    ++cur;
+                    break;
+                }
+                fail(Error::ERR_EXPECTED_COMMA_OR_END_OF_ARRAY, cur);
+            }
+
+            //elements are collected first, so the vector is allocated once
+            array->elements.assign(std::make_move_iterator(pending.begin() + base), std::make_move_iterator(pending.end()));
+            pending.erase(pending.begin() + base, pending.end());
+            --depth;
+            return array.release();
+        }
+
+        Elem* parseObject() {
+            if (++depth > maxDepth) throw TooDeep();
+            std::unique_ptr<JSONElements::Object, Dispose> object(JSONElements::Object::create(resource));
+            ++cur;
+            skipWs();
+            if (cur != end && *cur == '}') {
+                ++cur;
+                --depth;
+                return object.release();
+            }
+            if (cur == end || *cur != '"') fail(Error::ERR_EXPECTED_END_OF_OBJECT_OR_OBJECT_ELEMENT, cur);
+
+            std::string key;
+            for (;;) {
+                key.clear();
+                parseString(key);
+                skipWs();
+                if (cur == end || *cur != ':') fail(Error::ERR_EXPECTED_COLON, cur);
+                ++cur;
+                JSON value = parseValue();
+                //same key twice keeps the first position and the last value, as JSON::operator()
+                object->elements.assign(key, std::move(value));
+
+                skipWs();
+                if (cur != end && *cur == ',') {
+                    ++cur;
+                    skipWs();
+                    if (cur == end || *cur != '"') fail(Error::ERR_EXPECTED_OBJECT_ELEMENT, cur);
+                    continue;
+                }
+                if (cur != end && *cur == '}') {
+                    ++cur;
+                    break;
+                }
+                fail(Error::ERR_EXPECTED_COMMA_OR_END_OF_OBJECT, cur);
+            }
+            --depth;
+            return object.release();
+        }
+
+        //cur points to the opening quote
+        void parseString(std::string& out) {
+            const unsigned char* classes = stringClasses();
+            unsigned long surrogate = 0;
+            ++cur;
+            for (;;) {
+                const char* run = cur;
+                while (cur != end && classes[(unsigned char)*cur] == C_PLAIN) ++cur;
+                if (run != cur) {
+                    flushSurrogate(out, surrogate);
+                    out.append(run, cur);
+                }
+                if (cur == end) fail(Error::ERR_EXPECTED_NOT_CONTROL_CHARACTER_IN_STR, cur);
+
+                switch (classes[(unsigned char)*cur]) {
+                case C_QUOTE:
+                    flushSurrogate(out, surrogate);
+                    ++cur;
+                    return;
+                case C_CONTROL:
+                    fail(Error::ERR_CONTROL_CHAR_IN_STR, cur + 1);
+                case C_C2:
+                    if (cur + 1 != end && (unsigned char)cur[1] >= 0x80 && (unsigned char)cur[1] <= 0x9f) {
+                        fail(Error::ERR_CONTROL_CHAR_IN_STR, cur + 2);
+                    }
+                    flushSurrogate(out, surrogate);
+                    out += *cur++;
+                    break;
+                default:
+                    parseEscape(out, surrogate);
+                }
+            }
+        }
+
+        void parseEscape(std::string& out, unsigned long& surrogate) {
+            ++cur;
+            if (cur == end) fail(Error::ERR_EXPECTED_MODIFIER_AFTER_SLASH_IN_STR, cur);
+            char c;
+            switch (*cur) {
+            case '"':  c = '"';  break;
+            case '\\': c = '\\'; break;
+            case '/':  c = '/';  break;
+            case 'b':  c = '\b'; break;
+            case 'f':  c = '\f'; break;
+            case 'n':  c = '\n'; break;
+            case 'r':  c = '\r'; break;
+            case 't':  c = '\t'; break;
+            case 'u': {
+                ++cur;
+                unsigned long code = 0;
+                for (int i = 0; i < 4; ++i, ++cur) {
+                    if (cur == end) fail(Error::ERR_EXPECTED_FOUR_HEX_DIGITS_AFTER_SLASH_U_IN_STR, cur);
+                    char h = *cur;
+                    int digit;
+                    if (h >= '0' && h <= '9') digit = h - '0';
+                    else if (h >= 'a' && h <= 'f') digit = h - 'a' + 10;
+                    else if (h >= 'A' && h <= 'F') digit = h - 'A' + 10;
+                    else fail(Error::ERR_EXPECTED_FOUR_HEX_DIGITS_AFTER_SLASH_U_IN_STR, cur);
+                    code = code * 16 + digit;
+                }
+                if (surrogate && code >= 0xDC00 && code <= 0xDFFF) {
+                    code = 0x10000 + ((surrogate - 0xD800) << 10) + (code - 0xDC00);
+                    surrogate = 0;
+                }
+                flushSurrogate(out, surrogate);
+                if (code >= 0xD800 && code <= 0xDBFF) {
+                    surrogate = code;
+                    return;
+                }
+                char utf8[4];
+                out.append(utf8, GeneralParser::utf8Encode(code, utf8));
+                return;
+            }
+            default:
+                fail(Error::ERR_EXPECTED_MODIFIER_AFTER_SLASH_IN_STR, cur);
+            }
+            flushSurrogate(out, surrogate);
+            out += c;
+            ++cur;
+        }
+
+        static void flushSurrogate(std::string& out, unsigned long& surrogate) {
+            if (!surrogate) return;
+            char utf8[4];
+            out.append(utf8, GeneralParser::utf8Encode(surrogate, utf8));
+            surrogate = 0;
+        }
+
+        JSON parseNumber() {
+            bool negative = *cur == '-';
+            if (negative) ++cur;
+            if (cur == end || !isDigit(*cur)) fail(Error::ERR_EXPECTED_DIGIT_IN_NUMBER, cur);
+
+            const char* wholeStart = cur;
+            uint64_t whole = 0;
+            if (*cur == '0') ++cur;
+            else while (cur != end && isDigit(*cur)) whole = whole * 10 + uint64_t(*cur++ - '0');
+            size_t wholeDigits = size_t(cur - wholeStart);
+
+            bool isFloat = false;
+            const char* fractionStart = cur;
+            uint64_t fraction = 0;
+            size_t fractionDigits = 0;
+            if (cur != end && *cur == '.') {
+                isFloat = true;
+                ++cur;
+                if (cur == end || !isDigit(*cur)) fail(Error::ERR_EXPECTED_DIGIT_IN_NUMBER, cur);
+                fractionStart = cur;
+                while (cur != end && isDigit(*cur)) fraction = fraction * 10 + uint64_t(*cur++ - '0');
+                fractionDigits = size_t(cur - fractionStart);
+            }
+
+            long long exponent = 0;
+            if (cur != end && (*cur == 'e' || *cur == 'E')) {
+                isFloat = true;
+                ++cur;
+                bool expNegative = false;
+                if (cur != end && (*cur == '+' || *cur == '-')) expNegative = *cur++ == '-';
+                if (cur == end || !isDigit(*cur)) fail(Error::ERR_EXPECTED_DIGIT_IN_NUMBER, cur);
+                //saturates far beyond the range of double
+                for (; cur != end && isDigit(*cur); ++cur) {
+                    if (exponent < 100000000) exponent = exponent * 10 + (*cur - '0');
+                }
+                if (expNegative) exponent = -exponent;
+            }
+
+            if (!isFloat) {
+                //19 digits always fit into uint64_t
+                if (wholeDigits < 19 || (wholeDigits == 19 && whole <= uint64_t(INT64_MAX) + (negative ? 1 : 0))) {
+                    return JSON::make<JSONElements::Integer>(negative ? int64_t(0 - whole) : int64_t(whole));
+                }
+                //out of int64_t range
+                return JSON::make<JSONElements::Float>(JSONnumber::fromDigits(negative, std::string(wholeStart, wholeStart + wholeDigits), 0));
+            }
+            if (wholeDigits > 19 || fractionDigits > 19) {
+                std::string digits(wholeStart, wholeStart + wholeDigits);
+                digits.append(fractionStart, fractionStart + fractionDigits);
+                return JSON::make<JSONElements::Float>(JSONnumber::fromDigits(negative, digits, exponent - (long long)fractionDigits));
+            }
+            return JSON::make<JSONElements::Float>(JSONnumber::make(negative, whole, fraction, (long long)fractionDigits, exponent));
+        }
+
+        void literal(const char* word) {
+            for (; *word; ++word, ++cur) {
+                if (cur == end || *cur != *word) fail(Error::ERR_EXPECTED_VALUE, cur);
+            }
+        }
+
+        //partial space right at the start reports the error of what is expected there
+        void skipWs(Error::ErrorType expected = Error::ERR_EXPECTED_WHITESPACE) {
+            const char* start = cur;
+            while (cur != end) {
+                unsigned char c = (unsigned char)*cur;
+                if (c == ' ' || c == '\t' || c == 0x0B || c == 0x0C) {
+                    ++cur;
+                }
+                else if (c == '\n' || c == '\r') {
+                    //CR LF and LF CR are one line break
+                    ++cur;
+                    ++line;
+                    if (cur != end && (unsigned char)*cur == (c == '\n' ? '\r' : '\n')) ++cur;
+                    lineStart = cur - begin;
+                }
+                else if (c == 0xc2 || c == 0xe1 || c == 0xe2 || c == 0xe3) {
+                    skipUnicodeSpace(cur == start ? expected : Error::ERR_EXPECTED_WHITESPACE);
+                }
+                else {
+                    return;
+                }
+            }
+        }
+
+        //bytes are consumed while they are a prefix of some space, a partial match is an error
+        void skipUnicodeSpace(Error::ErrorType expected) {
+            static const char* const spaces[] = {
+                "\xc2\x85", "\xc2\xa0", "\xe1\x9a\x80",
+                "\xe2\x80\x80", "\xe2\x80\x81", "\xe2\x80\x82", "\xe2\x80\x83", "\xe2\x80\x84", "\xe2\x80\x85",
+                "\xe2\x80\x86", "\xe2\x80\x87", "\xe2\x80\x88", "\xe2\x80\x89", "\xe2\x80\x8a", "\xe2\x80\xa8",
+                "\xe2\x80\xa9", "\xe2\x80\xaf", "\xe2\x81\x9f", "\xe3\x80\x90"
+            };
+            for (size_t k = 0;; ++k) {
+                bool extends = false;
+                for (const char* space : spaces) {
+                    if (std::strlen(space) < k || std::memcmp(space, cur, k) != 0) continue;
+                    if (!space[k]) {
+                        cur += k;
+                        return;
+                    }
+                    if (cur + k != end && space[k] == cur[k]) extends = true;
+                }
+                if (!extends) fail(expected, cur + k);
+            }
+        }
+
+    private:
+        const char* begin;
+        const char* cur;
+        const char* end;
+        long long line;
+        long long lineStart;
+        int depth;
+        //memory of arrays and objects, NULL for the heap
+        JSONMemoryResource* resource;
+        //values of arrays being parsed
+        std::vector<JSON> pending;
+    };
+
     class ParseWrapper {
+        friend class JSONStreamReader;
         static JSONparser& getParser() {
             static JSONparser obj;
             return obj;
         }
         //JSONparser::Parsing parsing;
+
+        //result of parsing the first document of a block
+        enum Prefix {
+            PREFIX_VALUE,       //position is set after the value
+            PREFIX_EMPTY,       //there is only whitespace, position is set after it
+            PREFIX_INCOMPLETE   //the document may continue after the block
+        };
+
+        //parses the value at the start of [start, end). With more input after the block a value
+        //or an error that reaches its end may be cut by it: such documents are incomplete
+        static Prefix parsePrefix(const char* start, const char* end, bool more, JSON& value, JSONparser::Error& position) YUVsoft_THROW(Error) {
+            //partial spaces, literals and escapes fail at most this far before the cut
+            const long long cutMargin = 8;
+            long long size = end - start;
+
+            FastJSONparser parser(start, end);
+            try {
+                parser.skipWs(Error::ERR_EXPECTED_VALUE);
+                if( parser.cur == end ) {
+                    if( more ) return PREFIX_INCOMPLETE;
+                    position = Error(Error::ERR_OK, parser.line, parser.lineStart, parser.cur - start);
+                    return PREFIX_EMPTY;
+                }
+                value = parser.parseValue();
+                //a number may continue in the next block
+                if( parser.cur == end && more ) return PREFIX_INCOMPLETE;
+                position = Error(Error::ERR_OK, parser.line, parser.lineStart, parser.cur - start);
+                return PREFIX_VALUE;
+            }
+            catch (const Error& err) {
+                if( more && err.offset + cutMargin >= size ) return PREFIX_INCOMPLETE;
+                throw;
+            }
+            catch (const FastJSONparser::TooDeep&) {}
+
+            JSONparser::Parsing jsonParsing(getParser().value);
+            jsonParsing.setErrorType(Error::ERR_EXPECTED_VALUE);
+            const char* parseEnd = jsonParsing.feedChars(start, size);
+            if( !jsonParsing.inFinishedState() ) {
+                if( more && (!jsonParsing.inErrorState() || jsonParsing.getError().offset + cutMargin >= size) ) return PREFIX_INCOMPLETE;
+                if( !more ) jsonParsing.feedEOF();
+            }
+            jsonParsing.getError().raise();
+            if( !jsonParsing.inFinishedState() || !jsonParsing.hasResult() ) {
+                Error err = jsonParsing.getError();
+                err.type = Error::ERR_UNKNOWN;
+                err.raise();
+            }
+            position = jsonParsing.getError();
+            position.offset = parseEnd - start;
+            value = jsonParsing.takeResult();
+            return PREFIX_VALUE;
+        }
     public:
         typedef JSONparser::Error Error;
 		static JSON parse(const std::string& string) YUVsoft_THROW(Error) {
@@ -2561,9 +4527,39 @@ namespace YUVsoft {
             return parse(start,end);
         }
 
+        //reports the document to the handler, see JSONEvents
+        template<class Handler>
+		static void parseEvents(const std::string& string, Handler& handler) YUVsoft_THROW(Error) {
+            FastJSONparser::parseEvents(string.c_str(), string.c_str() + string.size(), handler);
+        }
+
 		static JSON parse(const char* start, const char* end) YUVsoft_THROW(Error) {
+#ifdef YUVsoft_JSON_TABLE_PARSER
+            return parseTable(start, end);
+#else
+            return FastJSONparser::parse(start, end);
+#endif
+        }
+
+        //arrays and objects are allocated from the resource, see JSONDocument. Documents
+        //nested too deep for FastJSONparser and those of the table parser are on the heap
+		static JSON parse(const std::string& string, JSONMemoryResource& resource) YUVsoft_THROW(Error) {
+            return parse(string.c_str(), string.c_str() + string.size(), resource);
+        }
+
+		static JSON parse(const char* start, const char* end, JSONMemoryResource& resource) YUVsoft_THROW(Error) {
+#ifdef YUVsoft_JSON_TABLE_PARSER
+            return parseTable(start, end);
+#else
+            return FastJSONparser::parse(start, end, &resource);
+#endif
+        }
+
+        //parsing by the state machine of JSONparser
+		static JSON parseTable(const char* start, const char* end) YUVsoft_THROW(Error) {
             //ParseWrapper wrapper;
             JSONparser::Parsing jsonParsing(getParser().value);
+            jsonParsing.setErrorType(Error::ERR_EXPECTED_VALUE);
 
             const char* parseEnd = jsonParsing.feedChars(start,end-start);
 
@@ -2573,30 +4569,50 @@ namespace YUVsoft {
 
             jsonParsing.getError().raise();
 
+            //offsets of trailing whitespace continue those of the value
+            Error valueEnd = jsonParsing.getError();
+            long long base = parseEnd - start;
+            auto absolute = [&](Error err) {
+                err.offset += base;
+                err.offsetInLine = err.line ? err.offsetInLine + base : valueEnd.offsetInLine;
+                err.line += valueEnd.line;
+                return err;
+            };
+
             JSONparser::Parsing wsParsing(getParser().ws);
             parseEnd = wsParsing.feedChars(parseEnd,end - parseEnd);
 
-            //TODO: wsParsing has wrong offsets
-            wsParsing.getError().raise();
+            //whitespace parser has no expectation of its own before the first space
+            auto trailing = [&](Error err) {
+                if( err.type == Error::ERR_UNKNOWN ) err.type = Error::ERR_EXPECTED_END_OF_FILE;
+                absolute(err).raise();
+            };
+            trailing(wsParsing.getError());
 
             if( parseEnd != end ) {
-                Error err = wsParsing.getError();
+                Error err = absolute(wsParsing.getError());
                 err.type = Error::ERR_EXPECTED_END_OF_FILE;
                 err.raise();
             }
 
             wsParsing.feedEOF();
+            trailing(wsParsing.getError());
             if(!jsonParsing.hasResult() ) {
-                Error err = wsParsing.getError();
+                Error err = absolute(wsParsing.getError());
                 err.type = Error::ERR_UNKNOWN;
                 err.raise();
             }
 
-            return jsonParsing.result();
+            return jsonParsing.takeResult();
         }
 
-		static JSON parse(std::istream& input) YUVsoft_THROW(Error) {
+        //the stream is left right after the value
+		static JSON parse(std::istream& input) YUVsoft_THROW(Error);
+
+        //parsing by characters, the stream is never read past the value
+		static JSON parseChars(std::istream& input) YUVsoft_THROW(Error) {
             JSONparser::Parsing jsonParsing(getParser().value);
+            jsonParsing.setErrorType(Error::ERR_EXPECTED_VALUE);
 
             char next;
             while(input.get(next)) {
@@ -2614,7 +4630,288 @@ namespace YUVsoft {
                 err.raise();
             }
             
-            return jsonParsing.result();
+            return jsonParsing.takeResult();
+        }
+    };
+
+    inline JSON FastJSONparser::parse(const char* start, const char* end, JSONMemoryResource* resource) YUVsoft_THROW(Error) {
+        FastJSONparser parser(start, end, resource);
+        try {
+            JSON value = parser.parseValue();
+            parser.skipWs(Error::ERR_EXPECTED_END_OF_FILE);
+            if (parser.cur != end) parser.fail(Error::ERR_EXPECTED_END_OF_FILE, parser.cur);
+            return value;
+        }
+        catch (const TooDeep&) {}
+        return ParseWrapper::parseTable(start, end);
+    }
+
+    //reader of a sequence of documents from a stream: JSON lines or documents separated
+    //by whitespace or by nothing at all. The stream is read ahead by blocks, a document is
+    //parsed from the buffer when it is complete, so the stream position after a document
+    //is not defined. Offsets and lines of errors are counted from the first document
+    class JSONStreamReader {
+        friend class ParseWrapper;
+    public:
+        typedef JSONparser::Error Error;
+
+        explicit JSONStreamReader(std::istream& input, size_t blockSize = 1 << 16)
+            : input(input), blockSize(std::max<size_t>(blockSize, 1)), begin(0), more(true), base(0), line(0), lineStart(0) {}
+
+        //reads the next document, returns false after the last one
+        bool next(JSON& value) YUVsoft_THROW(Error) {
+            for (;;) {
+                Error position;
+                ParseWrapper::Prefix prefix;
+                try {
+                    prefix = ParseWrapper::parsePrefix(buffer.data() + begin, buffer.data() + buffer.size(), more, value, position);
+                }
+                catch (const Error& err) {
+                    throw absolute(err);
+                }
+                if( prefix == ParseWrapper::PREFIX_INCOMPLETE ) {
+                    read();
+                    continue;
+                }
+
+                lineStart = position.line ? base + position.offsetInLine : lineStart;
+                line += position.line;
+                base += position.offset;
+                begin += (size_t)position.offset;
+                return prefix == ParseWrapper::PREFIX_VALUE;
+            }
+        }
+
+    private:
+        Error absolute(Error err) const {
+            err.offsetInLine = err.line ? err.offsetInLine + base : lineStart;
+            err.offset += base;
+            err.line += line;
+            return err;
+        }
+
+        //drops parsed documents and appends a block, at least as large as the unparsed rest
+        void read() {
+            buffer.erase(buffer.begin(), buffer.begin() + begin);
+            begin = 0;
+            size_t have = buffer.size();
+            size_t want = std::max(blockSize, have);
+            buffer.resize(have + want);
+            input.read(&buffer[have], (std::streamsize)want);
+            size_t got = (size_t)input.gcount();
+            buffer.resize(have + got);
+            if( got < want ) more = false;
+        }
+
+        std::istream& input;
+        size_t blockSize;
+        std::vector<char> buffer;
+        size_t begin;
+        bool more;
+
+        //position of buffer[begin] in the stream
+        long long base;
+        long long line;
+        long long lineStart;
+    };
+
+    //seekable streams are read by blocks and then positioned after the value. Positions of
+    //text streams are not byte offsets, so the stream is returned to the start and the value is skipped
+    inline JSON ParseWrapper::parse(std::istream& input) YUVsoft_THROW(Error) {
+        std::istream::pos_type start = input.tellg();
+        if( start == std::istream::pos_type(-1) ) return parseChars(input);
+
+        JSONStreamReader reader(input);
+        JSON value;
+        if( !reader.next(value) ) Error(Error::ERR_EXPECTED_VALUE, reader.line, reader.lineStart, reader.base).raise();
+        input.clear();
+        input.seekg(start);
+        input.ignore(std::streamsize(reader.base));
+        return value;
+    }
+
+    /*
+    *   Document in memory of one resource: arrays and objects with their vectors and
+    *   member maps are allocated there, so freeing the document does not free its nodes
+    *   one by one. Strings longer than the inline buffer of std::string are still on the heap.
+    *   By default the document has a JSONArena of its own, which is released and reused by
+    *   the next parse. A host that parses many documents may pass its resource instead,
+    *   e.g. std::pmr::monotonic_buffer_resource, and release it after clear().
+    *   Values of the document refer to its memory: copy them, do not move them out,
+    *   to keep them after the document is cleared.
+    */
+    class JSONDocument {
+    public:
+        typedef JSONparser::Error Error;
+
+        JSONDocument() : resource(&arena) {}
+        explicit JSONDocument(JSONMemoryResource& resource) : resource(&resource) {}
+        JSONDocument(const JSONDocument&) = delete;
+        JSONDocument& operator = (const JSONDocument&) = delete;
+        ~JSONDocument() {
+            clear();
         }
+
+        JSON& parse(const std::string& string) YUVsoft_THROW(Error) {
+            return parse(string.c_str(), string.c_str() + string.size());
+        }
+
+        //the previous document is cleared first
+        JSON& parse(const char* start, const char* end) YUVsoft_THROW(Error) {
+            clear();
+            value = ParseWrapper::parse(start, end, *resource);
+            return value;
+        }
+
+        JSON& root() {
+            return value;
+        }
+        const JSON& root() const {
+            return value;
+        }
+
+        JSONMemoryResource& memoryResource() const {
+            return *resource;
+        }
+
+        //the document becomes null, its own arena is released
+        void clear() {
+            value = JSON();
+            if( resource == &arena ) arena.release();
+        }
+
+    private:
+        JSONArena arena;
+        JSONMemoryResource* resource;
+        JSON value;
+    };
+
+    /*
+    *   Binds members of the top-level object to variables:
+    *       JSONBinder().bind("threads", threads).bind("mode", mode).parse(text);
+    *   Values are converted with the types of JSON::asT: integers to integral variables,
+    *   floats to floating-point ones, strings and booleans. Other members are skipped.
+    *   Values are kept in the binder and the variables are assigned only after the whole
+    *   document is parsed: a syntax error or a value of another type (JSON::InvalidType)
+    *   leaves all of them unchanged.
+    */
+    class JSONBinder : public JSONEvents {
+        //type of the last value of a member
+        enum Parsed { P_NONE, P_INTEGER, P_FLOAT, P_STRING, P_BOOLEAN, P_INVALID };
+
+        struct Field {
+            std::string name;
+            void* target;
+            void (*setInteger)(void*, int64_t);
+            void (*setFloat)(void*, double);
+            void (*setString)(void*, const std::string&);
+            void (*setBoolean)(void*, bool);
+            Parsed parsed;
+            int64_t integer;
+            double number;
+            std::string string;
+            bool boolean;
+        };
+
+        template<class T> static void assignInteger(void* target, int64_t val) { *static_cast<T*>(target) = static_cast<T>(val); }
+        template<class T> static void assignFloat(void* target, double val) { *static_cast<T*>(target) = static_cast<T>(val); }
+        static void assignString(void* target, const std::string& val) { *static_cast<std::string*>(target) = val; }
+        static void assignBoolean(void* target, bool val) { *static_cast<bool*>(target) = val; }
+
+        JSONBinder& add(const std::string& name, void* target, void (*setInteger)(void*, int64_t), void (*setFloat)(void*, double),
+                        void (*setString)(void*, const std::string&), void (*setBoolean)(void*, bool)) {
+            Field field = { name, target, setInteger, setFloat, setString, setBoolean, P_NONE, 0, 0., std::string(), false };
+            fields.push_back(field);
+            return *this;
+        }
+
+    public:
+        typedef JSONparser::Error Error;
+
+        template<class T>
+        typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, JSONBinder&>::type
+        bind(const std::string& name, T& target) {
+            return add(name, &target, &assignInteger<T>, nullptr, nullptr, nullptr);
+        }
+
+        template<class T>
+        typename std::enable_if<std::is_floating_point<T>::value, JSONBinder&>::type
+        bind(const std::string& name, T& target) {
+            return add(name, &target, nullptr, &assignFloat<T>, nullptr, nullptr);
+        }
+
+        JSONBinder& bind(const std::string& name, std::string& target) {
+            return add(name, &target, nullptr, nullptr, &assignString, nullptr);
+        }
+
+        JSONBinder& bind(const std::string& name, bool& target) {
+            return add(name, &target, nullptr, nullptr, nullptr, &assignBoolean);
+        }
+
+        void parse(const std::string& string) YUVsoft_THROW(Error) {
+            parse(string.c_str(), string.c_str() + string.size());
+        }
+
+        void parse(const char* start, const char* end) YUVsoft_THROW(Error) {
+            depth = 0;
+            current = nullptr;
+            for (Field& field : fields) field.parsed = P_NONE;
+            FastJSONparser::parseEvents(start, end, *this);
+            for (const Field& field : fields) {
+                if (field.parsed == P_INVALID) throw JSON::InvalidType();
+            }
+            for (const Field& field : fields) {
+                switch (field.parsed) {
+                case P_INTEGER: field.setInteger(field.target, field.integer); break;
+                case P_FLOAT: field.setFloat(field.target, field.number); break;
+                case P_STRING: field.setString(field.target, field.string); break;
+                case P_BOOLEAN: field.setBoolean(field.target, field.boolean); break;
+                default: break;
+                }
+            }
+        }
+
+        void onNull() { if (Field* f = value()) f->parsed = P_INVALID; }
+        void onBoolean(bool val) { if (Field* f = value()) keep(*f, f->setBoolean, P_BOOLEAN, f->boolean, val); }
+        void onInteger(int64_t val) { if (Field* f = value()) keep(*f, f->setInteger, P_INTEGER, f->integer, val); }
+        void onFloat(double val) { if (Field* f = value()) keep(*f, f->setFloat, P_FLOAT, f->number, val); }
+        void onString(const std::string& val) { if (Field* f = value()) keep(*f, f->setString, P_STRING, f->string, val); }
+
+        void onStartObject() { if (depth) onNull(); ++depth; }
+        void onStartArray() { onNull(); ++depth; }
+        void onEndObject() { --depth; }
+        void onEndArray() { --depth; }
+
+        void onKey(const std::string& key) {
+            if (depth != 1) return;
+            current = nullptr;
+            for (Field& field : fields) {
+                if (field.name == key) {
+                    current = &field;
+                    break;
+                }
+            }
+        }
+
+    private:
+        //bound field of a value, the top level must be an object
+        Field* value() {
+            if (!depth) throw JSON::InvalidType();
+            if (depth != 1 || !current) return nullptr;
+            Field* field = current;
+            current = nullptr;
+            return field;
+        }
+
+        //a repeated member is checked and assigned by its last value, as JSON keeps it
+        template<class Setter, class T>
+        static void keep(Field& field, Setter setter, Parsed type, T& slot, const T& val) {
+            field.parsed = setter ? type : P_INVALID;
+            if (setter) slot = val;
+        }
+
+        std::vector<Field> fields;
+        int depth = 0;
+        Field* current = nullptr;
     };
 }
@@ -0,0 +1,204 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+#pragma once
+
+#include "../PluginBase/ICustomPlugin.h"
+#include "../PluginBase/json.h"
+#include "../PluginBase/ImagePlane.h"
+#include "../PluginBase/ThreadPool.h"
+#include "../PluginBase/SSIM.h"
+
+#include <memory>
+#include <cstring>
+
+/*
+*	SSIM plugin
+*	Structural similarity with 11x11 Gaussian or 8x8 box window.
+*/
+class VQMTssimPlugin : public ICustomPlugin
+{
+public:
+	void Init(IMetricImage::ColorComponent colorComp, int width, int height, int start_id, IMetricValueSink* sink) override {
+		this->width = width;
+		this->height = height;
+		this->output_id = start_id;
+		this->colorComp = colorComp;
+		this->sink = sink;
+
+		pool = std::make_unique<CThreadPool>(threads);
+		sum = 0;
+		frames = 0;
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	Measure(std::vector<IMetricImage*> &images) override {
+		return { { output_id, float(MeasureFrame(images, nullptr)) } };
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	MeasureAndVisualize(std::vector<IMetricImage*>&images, unsigned char *vis, int vis_pitch) override {
+		float res = float(MeasureFrame(images, &map));
+
+		// SSIM map, black is 0 or less; map is smaller than frame by window size, borders are clamped
+		int offset = (ssim.WindowSize() - 1) / 2;
+		int w = std::min(width, images[0]->GetWidth());
+		int h = std::min(height, images[0]->GetHeight());
+		for (int y = 0; y < h; ++y) {
+			unsigned char* out = vis + (size_t)y * vis_pitch;
+			if (map.Width() == 0) {
+				memset(out, (unsigned char)(std::min(1.f, std::max(0.f, res)) * 255.f + 0.5f), (size_t)w * 3);
+				continue;
+			}
+			const float* row = map.Row(std::min(map.Height() - 1, std::max(0, y - offset)));
+			for (int x = 0; x < w; ++x) {
+				float v = row[std::min(map.Width() - 1, std::max(0, x - offset))];
+				unsigned char c = (unsigned char)(std::min(1.f, std::max(0.f, v)) * 255.f + 0.5f);
+				out[x * 3 + 0] = c;
+				out[x * 3 + 1] = c;
+				out[x * 3 + 2] = c;
+			}
+		}
+
+		return { { output_id, res } };
+	}
+
+	std::vector<IDinfo>	MapIDToFrame(bool visualize) override {
+		return { { output_id, L"" } };
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> > CalculateAverage(bool visualize) override {
+		if (!frames) return {};
+		return { { output_id, float(sum / frames) } };
+	}
+
+	int GetVideoNum(bool) override {
+		return 2;
+	}
+
+	std::vector <IMetricImage::ColorComponent> GetSupportedColorcomponents() override {
+		return {
+			IMetricImage::YYUV, IMetricImage::UYUV, IMetricImage::VYUV, IMetricImage::LLUV,
+			IMetricImage::RRGB, IMetricImage::GRGB, IMetricImage::BRGB
+		};
+	}
+
+	std::wstring GetName() override {
+		return L"ssim_sdk";
+	}
+	std::wstring GetInterfaceName() override {
+		return L"SSIM (SDK)";
+	}
+	std::wstring GetLongName() override {
+		return L"Structural similarity index";
+	}
+
+	std::wstring GetMetrInfoURL() override {
+		return L"http://compression.ru/video/";
+	}
+	std::wstring GetUnit() override {
+		return L"";
+	}
+
+	bool GetMetrIncline() override {
+		return true;
+	}
+
+	const std::wstring& GetConfigJSON() override {
+		static const std::wstring obj =
+		{
+			L"	{																		"
+			L"		\"window\": {														"
+			L"			\"description\": \"Window\",									"
+			L"			\"help\": \"11x11 Gaussian (sigma 1.5) or 8x8 box window\",	"
+			L"			\"default_value\": \"gaussian\",								"
+			L"			\"possible_values\": [\"gaussian\", \"box\"]					"
+			L"		},																	"
+			L"		\"threads\": {														"
+			L"			\"description\": \"Threads\",									"
+			L"			\"help\": \"Number of threads, 0 - number of cores\",			"
+			L"			\"default_value\": 0,											"
+			L"			\"possible_values\": [[0,64]]									"
+			L"		}																	"
+			L"	}																		"
+		};
+		return obj;
+	}
+
+	bool SetConfigParams(const std::wstring& json)  override {
+		try {
+			YUVsoft::JSON res = YUVsoft::ParseWrapper::parse(YUVsoft::utf16_to_utf8(json));
+			//all values are checked before any of them is applied
+			SSIMWindow w = ssim.GetWindow();
+			int t = threads;
+			if (res.in("window")) {
+				std::string window = res["window"].asString();
+				if (window == "gaussian") w = SSIM_GAUSSIAN11;
+				else if (window == "box") w = SSIM_BOX8;
+				else return false;
+			}
+			if (res.in("threads")) {
+				t = (int)res["threads"].asInteger();
+				if (t < 0 || t > 64) return false;
+			}
+
+			if (w != ssim.GetWindow()) ssim.SetWindow(w);
+			if (t != threads && pool) pool = std::make_unique<CThreadPool>(t);
+			this->threads = t;
+			return true;
+		}
+		catch (...) {}
+
+		return false;
+	}
+
+	std::wstring GetConfigSummary() override {
+		std::wstringstream out;
+		out << "Window: " << (ssim.GetWindow() == SSIM_BOX8 ? "box 8x8" : "Gaussian 11x11") << ", threads: " << threads;
+		return out.str();
+	}
+
+private:
+	double MeasureFrame(std::vector<IMetricImage*>& images, CPlaneBuffer* outMap) {
+		PlaneView ref = PlaneView::FromImage(images[0], colorComp, width, height);
+		PlaneView dist = PlaneView::FromImage(images[1], colorComp, width, height);
+
+		SSIMResult res = ssim.Compute(ref, dist, GetPeak(images[0]), pool.get(), outMap);
+		sum += res.ssim;
+		++frames;
+		return res.ssim;
+	}
+
+	float GetPeak(const IMetricImage* image) const {
+		const RangeSpecification* ranges = image->GetRanges();
+		if (ranges && ranges[colorComp].max > ranges[colorComp].min) {
+			return ranges[colorComp].max - ranges[colorComp].min;
+		}
+		return 255.f;
+	}
+
+private:
+	CSSIM ssim;
+	int threads = 0;
+
+	std::unique_ptr<CThreadPool> pool;
+	CPlaneBuffer map;
+
+	int width = 0;
+	int height = 0;
+	int output_id = 0;
+
+	double sum = 0;
+	int frames = 0;
+
+	IMetricValueSink* sink = nullptr;
+
+	IMetricImage::ColorComponent colorComp = IMetricImage::YYUV;
+};
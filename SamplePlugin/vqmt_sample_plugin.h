@@ -152,19 +152,13 @@ public:
 
 	bool SetConfigParams(const std::wstring& json)  override { 
 		try {
-			YUVsoft::JSON res = YUVsoft::ParseWrapper::parse(YUVsoft::utf16_to_utf8(json));
-			if (res.in("param")) {
-				this->param = res["param"].asInteger();
-			}
-			if (res.in("param2")) {
-				this->param2 = res["param2"].asString();
-			}
-			if (res.in("param3")) {
-				this->param3 = res["param3"].asFloat();
-			}
-			if (res.in("param4")) {
-				this->param4 = res["param4"].asString();
-			}
+			// members are assigned once the whole config is parsed, no JSON tree is built
+			YUVsoft::JSONBinder()
+				.bind("param", param)
+				.bind("param2", param2)
+				.bind("param3", param3)
+				.bind("param4", param4)
+				.parse(YUVsoft::utf16_to_utf8(json));
 
 			return true;
 		}
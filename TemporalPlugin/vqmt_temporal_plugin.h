@@ -0,0 +1,358 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+#pragma once
+
+#include "../PluginBase/ICustomPlugin.h"
+#include "../PluginBase/json.h"
+#include "../PluginBase/ImagePlane.h"
+#include "../PluginBase/ThreadPool.h"
+#include "../PluginBase/FrameSignature.h"
+
+#include <memory>
+
+/*
+*	Temporal plugin
+*	Temporal stability of one video: mean luma delta, activity (mean change of cell means),
+*	frozen frames, flicker energy and dropped frames. Only cell signatures of the previous and
+*	current frames and scalars of three last frames are kept, so memory does not grow with
+*	the stream.
+*	Flicker and drop of frame N need frame N + 1, they are sent through IMetricValueSink when
+*	the next frame (or Stop()) comes; without a sink they are only averaged.
+*/
+class VQMTtemporalPlugin : public ICustomPlugin
+{
+public:
+	enum FeatureID {
+		FEATURE_LUMA_DELTA,
+		FEATURE_ACTIVITY,
+		FEATURE_FROZEN,
+		FEATURE_FLICKER,
+		FEATURE_DROPPED,
+		FEATURE_COUNT
+	};
+
+	void Init(IMetricImage::ColorComponent colorComp, int width, int height, int start_id, IMetricValueSink* sink) override {
+		this->width = width;
+		this->height = height;
+		this->start_id = start_id;
+		this->colorComp = colorComp;
+		this->sink = sink;
+
+		pool = std::make_unique<CThreadPool>(threads);
+		Reset();
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	Measure(std::vector<IMetricImage*> &images) override {
+		return Process(images[0]);
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	MeasureAndVisualize(std::vector<IMetricImage*>&images, unsigned char *vis, int vis_pitch) override {
+		auto res = Process(images[0]);
+
+		PlaneView plane = PlaneView::FromImage(images[0], colorComp, width, height);
+		const RangeSpecification* ranges = images[0]->GetRanges();
+		float min = ranges ? ranges[colorComp].min : 0.f;
+		float peak = GetPeak(images[0]);
+		const std::vector<float>& cur = cells[current];
+		const std::vector<float>& prev = cells[current ^ 1];
+		int grid = signature.Grid();
+
+		// dimmed frame, red - change of the cell mean since the previous frame
+		for (int y = 0; y < plane.height; ++y) {
+			const float* row = plane.Row(y);
+			int cy = std::min(grid - 1, y * grid / plane.height);
+			unsigned char* out = vis + (size_t)y * vis_pitch;
+			for (int x = 0; x < plane.width; ++x) {
+				int cx = std::min(grid - 1, x * grid / plane.width);
+				float change = frame > 1 ? std::fabs(cur[cy * grid + cx] - prev[cy * grid + cx]) / peak : 0.f;
+				float v = std::min(1.f, std::max(0.f, (row[x] - min) / peak));
+				unsigned char c = (unsigned char)(v * 128.f);
+				out[x * 3 + 0] = c;
+				out[x * 3 + 1] = c;
+				out[x * 3 + 2] = (unsigned char)std::min(255.f, c + change * 16.f * 255.f);
+			}
+		}
+
+		return res;
+	}
+
+	void Stop() override {
+		if (decided < frame) Decide(frame - 1, false);
+	}
+
+	std::vector<IDinfo>	MapIDToFrame(bool visualize) override {
+		return {
+			{ start_id + FEATURE_LUMA_DELTA, L"luma delta" },
+			{ start_id + FEATURE_ACTIVITY, L"activity" },
+			{ start_id + FEATURE_FROZEN, L"frozen" },
+			{ start_id + FEATURE_FLICKER, L"flicker" },
+			{ start_id + FEATURE_DROPPED, L"dropped" }
+		};
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> > CalculateAverage(bool visualize) override {
+		if (!frame) return {};
+		std::vector< std::pair <IMetricPlugin::ID, float> > res;
+		for (int f = 0; f < FEATURE_COUNT; ++f) {
+			// flicker and dropped are known only for decided frames
+			int n = f < FEATURE_FLICKER ? frame : decided;
+			if (n) res.push_back({ start_id + f, float(sums[f] / n) });
+		}
+		return res;
+	}
+
+	int GetVideoNum(bool) override {
+		return 1;
+	}
+
+	std::vector <IMetricImage::ColorComponent> GetSupportedColorcomponents() override {
+		return { IMetricImage::YYUV, IMetricImage::LLUV };
+	}
+
+	std::wstring GetName() override {
+		return L"temporal_sdk";
+	}
+	std::wstring GetInterfaceName() override {
+		return L"Temporal stability (SDK)";
+	}
+	std::wstring GetLongName() override {
+		return L"Flicker, frozen and dropped frames detection";
+	}
+
+	std::wstring GetMetrInfoURL() override {
+		return L"http://compression.ru/video/";
+	}
+	std::wstring GetUnit() override {
+		return L"";
+	}
+
+	bool GetMetrIncline() override {
+		return false;
+	}
+
+	const std::wstring& GetConfigJSON() override {
+		static const std::wstring obj =
+		{
+			L"	{																		"
+			L"		\"grid\": {															"
+			L"			\"description\": \"Grid\",										"
+			L"			\"help\": \"Frame signature is grid x grid cell means\",			"
+			L"			\"default_value\": 16,											"
+			L"			\"possible_values\": [[4,64]]									"
+			L"		},																	"
+			L"		\"freeze_threshold\": {												"
+			L"			\"description\": \"Freeze threshold\",							"
+			L"			\"help\": \"Frame is frozen if no cell mean changes more, part of the range\","
+			L"			\"default_value\": 0.002,										"
+			L"			\"possible_values\": [[0.0,0.1]]								"
+			L"		},																	"
+			L"		\"drop_ratio\": {													"
+			L"			\"description\": \"Drop ratio\",								"
+			L"			\"help\": \"Frame is dropped before a frame with this times bigger activity than neighbours\","
+			L"			\"default_value\": 1.7,											"
+			L"			\"possible_values\": [[1.2,4.0]]								"
+			L"		},																	"
+			L"		\"threads\": {														"
+			L"			\"description\": \"Threads\",									"
+			L"			\"help\": \"Number of threads, 0 - number of cores\",			"
+			L"			\"default_value\": 0,											"
+			L"			\"possible_values\": [[0,64]]									"
+			L"		}																	"
+			L"	}																		"
+		};
+		return obj;
+	}
+
+	bool SetConfigParams(const std::wstring& json)  override {
+		try {
+			YUVsoft::JSON res = YUVsoft::ParseWrapper::parse(YUVsoft::utf16_to_utf8(json));
+			//all values are checked before any of them is applied
+			int g = signature.Grid(), t = threads;
+			float f = freezeThreshold, r = dropRatio;
+			if (res.in("grid")) {
+				g = (int)res["grid"].asInteger();
+				if (g < 4 || g > 64) return false;
+			}
+			if (res.in("freeze_threshold")) {
+				f = (float)res["freeze_threshold"].asFloat();
+				if (!(f >= 0 && f <= 0.1f)) return false;
+			}
+			if (res.in("drop_ratio")) {
+				r = (float)res["drop_ratio"].asFloat();
+				if (!(r >= 1.2f && r <= 4.f)) return false;
+			}
+			if (res.in("threads")) {
+				t = (int)res["threads"].asInteger();
+				if (t < 0 || t > 64) return false;
+			}
+
+			signature.SetGrid(g);
+			this->freezeThreshold = f;
+			this->dropRatio = r;
+			if (t != threads && pool) pool = std::make_unique<CThreadPool>(t);
+			this->threads = t;
+			return true;
+		}
+		catch (...) {}
+
+		return false;
+	}
+
+	std::wstring GetConfigSummary() override {
+		std::wstringstream out;
+		out << "Grid: " << signature.Grid() << ", freeze threshold: " << freezeThreshold
+			<< ", drop ratio: " << dropRatio << ", threads: " << threads;
+		return out.str();
+	}
+
+private:
+	//scalars of one frame, in 8-bit units
+	struct FrameSummary {
+		double mean = 0;
+		float activity = 0;		//!< mean change of cells since the previous frame
+		bool frozen = false;
+		bool valid = false;
+	};
+
+	void Reset() {
+		for (double& s : sums) s = 0;
+		for (FrameSummary& s : history) s = FrameSummary();
+		current = 0;
+		frame = 0;
+		decided = 0;
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> > Process(const IMetricImage* image) {
+		PlaneView plane = PlaneView::FromImage(image, colorComp, width, height);
+		const RangeSpecification* ranges = image->GetRanges();
+		float min = ranges ? ranges[colorComp].min : 0.f;
+		float scale = 255.f / GetPeak(image);
+
+		current ^= 1;
+		FrameSummary s;
+		s.mean = (signature.Compute(plane, cells[current], pool.get()) - min) * scale;
+		s.valid = true;
+		float lumaDelta = 0;
+		if (frame > 0) {
+			SignatureDiff diff = CFrameSignature::Difference(cells[current], cells[current ^ 1]);
+			s.activity = diff.mean * scale;
+			s.frozen = diff.max * scale <= freezeThreshold * 255.f;
+			lumaDelta = float(std::fabs(s.mean - history[2].mean));
+		}
+
+		history[0] = history[1];
+		history[1] = history[2];
+		history[2] = s;
+		if (frame > 0) Decide(frame - 1, true);
+		++frame;
+
+		float values[] = { lumaDelta, s.activity, s.frozen ? 1.f : 0.f };
+		std::vector< std::pair <IMetricPlugin::ID, float> > res;
+		for (int f = 0; f < FEATURE_FLICKER; ++f) {
+			sums[f] += values[f];
+			res.push_back({ start_id + f, values[f] });
+		}
+		return res;
+	}
+
+	/**
+	**************************************************************************
+	* \brief Flicker and drop of frame n from its neighbours, sends them to the sink
+	* \param hasNext	[IN] - history[2] is frame n + 1, otherwise frame n is the last one
+	*					   and it is in history[2]
+	*/
+	void Decide(int n, bool hasNext) {
+		const FrameSummary& prev = hasNext ? history[0] : history[1];
+		const FrameSummary& cur = hasNext ? history[1] : history[2];
+		FrameSummary none;
+		const FrameSummary& next = hasNext ? history[2] : none;
+
+		//flicker: luma goes up and down (or down and up), energy of the smaller swing
+		float flicker = 0;
+		if (prev.valid && next.valid) {
+			double d1 = cur.mean - prev.mean, d2 = next.mean - cur.mean;
+			if (d1 * d2 < 0) {
+				double e = std::min(std::fabs(d1), std::fabs(d2));
+				flicker = float(e * e);
+			}
+		}
+
+		//drop before frame n: its activity is a multiple of activity of moving neighbours;
+		//much bigger multiples are scene changes
+		float dropped = 0;
+		if (prev.valid && n > 1 && !cur.frozen && cur.activity > minActivity) {
+			double sum = 0;
+			int count = 0;
+			if (!prev.frozen) {
+				sum += prev.activity;
+				count++;
+			}
+			if (next.valid && !next.frozen) {
+				sum += next.activity;
+				count++;
+			}
+			if (count) {
+				double ratio = cur.activity / std::max(sum / count, 1e-3);
+				dropped = ratio >= dropRatio && ratio <= sceneChangeRatio ? 1.f : 0.f;
+			}
+		}
+
+		sums[FEATURE_FLICKER] += flicker;
+		sums[FEATURE_DROPPED] += dropped;
+		decided = n + 1;
+		if (sink) {
+			int ids[] = { start_id + FEATURE_FLICKER, start_id + FEATURE_DROPPED };
+			float values[] = { flicker, dropped };
+			sink->onValue(n, ids, values, sizeof(ids) / sizeof(*ids));
+		}
+	}
+
+	float GetPeak(const IMetricImage* image) const {
+		const RangeSpecification* ranges = image->GetRanges();
+		if (ranges && ranges[colorComp].max > ranges[colorComp].min) {
+			return ranges[colorComp].max - ranges[colorComp].min;
+		}
+		return 255.f;
+	}
+
+private:
+	//activity below this (8-bit units) is noise, not motion
+	static constexpr float minActivity = 0.5f;
+	static constexpr float sceneChangeRatio = 4.f;
+
+	CFrameSignature signature{ 16 };
+	float freezeThreshold = 0.002f;
+	float dropRatio = 1.7f;
+	int threads = 0;
+
+	std::unique_ptr<CThreadPool> pool;
+
+	int width = 0;
+	int height = 0;
+
+	int start_id = 0;
+
+	//signatures of the current and previous frames
+	std::vector<float> cells[2];
+	int current = 0;
+	//frames n - 2, n - 1, n
+	FrameSummary history[3];
+	int frame = 0;
+	int decided = 0;
+
+	double sums[FEATURE_COUNT] = {};
+
+	IMetricValueSink* sink = nullptr;
+
+	IMetricImage::ColorComponent colorComp = IMetricImage::YYUV;
+};
@@ -0,0 +1,200 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+#pragma once
+
+#include "../PluginBase/ICustomPlugin.h"
+#include "../PluginBase/json.h"
+#include "../PluginBase/ImagePlane.h"
+#include "../PluginBase/ThreadPool.h"
+#include "../PluginBase/VIF.h"
+
+#include <memory>
+#include <cmath>
+
+/*
+*	VIF plugin
+*	Pixel-domain visual information fidelity over 4 scales.
+*	Besides combined value, VIF of every scale is reported.
+*/
+class VQMTvifPlugin : public ICustomPlugin
+{
+public:
+	static const int scales = VIFResult::maxScales;
+
+	void Init(IMetricImage::ColorComponent colorComp, int width, int height, int start_id, IMetricValueSink* sink) override {
+		this->width = width;
+		this->height = height;
+		this->output_id = start_id;
+		this->colorComp = colorComp;
+		this->sink = sink;
+
+		pool = std::make_unique<CThreadPool>(threads);
+		frames = 0;
+		sum = 0;
+		std::fill(sumScale, sumScale + scales, 0.);
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	Measure(std::vector<IMetricImage*> &images) override {
+		PlaneView ref = PlaneView::FromImage(images[0], colorComp, width, height);
+		PlaneView dist = PlaneView::FromImage(images[1], colorComp, width, height);
+
+		VIFResult vif = kernel.Compute(ref, dist, GetPeak(images[0]), pool.get());
+
+		std::vector< std::pair <IMetricPlugin::ID, float> > res = { { output_id, float(vif.Score()) } };
+		sum += vif.Score();
+		for (int s = 0; s < scales; ++s) {
+			res.push_back({ output_id + 1 + s, float(vif.Scale(s)) });
+			sumScale[s] += vif.Scale(s);
+		}
+		++frames;
+		return res;
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	MeasureAndVisualize(std::vector<IMetricImage*>&images, unsigned char *vis, int vis_pitch) override {
+		auto res = Measure(images);
+
+		// absolute difference, saturates at 1/8 of peak value
+		PlaneView ref = PlaneView::FromImage(images[0], colorComp, width, height);
+		PlaneView dist = PlaneView::FromImage(images[1], colorComp, width, height);
+		int w = std::min(ref.width, dist.width);
+		int h = std::min(ref.height, dist.height);
+		float scale = 255.f * 8.f / GetPeak(images[0]);
+		for (int y = 0; y < h; ++y) {
+			const float* a = ref.Row(y);
+			const float* b = dist.Row(y);
+			unsigned char* out = vis + (size_t)y * vis_pitch;
+			for (int x = 0; x < w; ++x) {
+				unsigned char v = (unsigned char)(std::min(255.f, std::fabs(a[x] - b[x]) * scale) + 0.5f);
+				out[x * 3 + 0] = v;
+				out[x * 3 + 1] = v;
+				out[x * 3 + 2] = v;
+			}
+		}
+
+		return res;
+	}
+
+	std::vector<IDinfo>	MapIDToFrame(bool visualize) override {
+		std::vector<IDinfo> res = { { output_id, L"VIF" } };
+		for (int s = 0; s < scales; ++s) {
+			res.push_back({ output_id + 1 + s, L"scale " + std::to_wstring(s + 1) });
+		}
+		return res;
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> > CalculateAverage(bool visualize) override {
+		if (!frames) return {};
+		std::vector< std::pair <IMetricPlugin::ID, float> > res = { { output_id, float(sum / frames) } };
+		for (int s = 0; s < scales; ++s) {
+			res.push_back({ output_id + 1 + s, float(sumScale[s] / frames) });
+		}
+		return res;
+	}
+
+	int GetVideoNum(bool) override {
+		return 2;
+	}
+
+	std::vector <IMetricImage::ColorComponent> GetSupportedColorcomponents() override {
+		return {
+			IMetricImage::YYUV, IMetricImage::UYUV, IMetricImage::VYUV, IMetricImage::LLUV,
+			IMetricImage::RRGB, IMetricImage::GRGB, IMetricImage::BRGB
+		};
+	}
+
+	std::wstring GetName() override {
+		return L"vif_sdk";
+	}
+	std::wstring GetInterfaceName() override {
+		return L"VIF (SDK)";
+	}
+	std::wstring GetLongName() override {
+		return L"Visual information fidelity, pixel domain";
+	}
+
+	std::wstring GetMetrInfoURL() override {
+		return L"http://compression.ru/video/";
+	}
+	std::wstring GetUnit() override {
+		return L"";
+	}
+
+	bool GetMetrIncline() override {
+		return true;
+	}
+
+	const std::wstring& GetConfigJSON() override {
+		static const std::wstring obj =
+		{
+			L"	{																		"
+			L"		\"threads\": {														"
+			L"			\"description\": \"Threads\",									"
+			L"			\"help\": \"Number of threads, 0 - number of cores\",			"
+			L"			\"default_value\": 0,											"
+			L"			\"possible_values\": [[0,64]]									"
+			L"		}																	"
+			L"	}																		"
+		};
+		return obj;
+	}
+
+	bool SetConfigParams(const std::wstring& json)  override {
+		try {
+			YUVsoft::JSON res = YUVsoft::ParseWrapper::parse(YUVsoft::utf16_to_utf8(json));
+			if (res.in("threads")) {
+				int t = (int)res["threads"].asInteger();
+				if (t < 0 || t > 64) return false;
+				if (t != threads && pool) pool = std::make_unique<CThreadPool>(t);
+				this->threads = t;
+			}
+
+			return true;
+		}
+		catch (...) {}
+
+		return false;
+	}
+
+	std::wstring GetConfigSummary() override {
+		std::wstringstream out;
+		out << "Threads: " << threads;
+		return out.str();
+	}
+
+private:
+	float GetPeak(const IMetricImage* image) const {
+		const RangeSpecification* ranges = image->GetRanges();
+		if (ranges && ranges[colorComp].max > ranges[colorComp].min) {
+			return ranges[colorComp].max - ranges[colorComp].min;
+		}
+		return 255.f;
+	}
+
+private:
+	CVIF kernel;
+	int threads = 0;
+
+	std::unique_ptr<CThreadPool> pool;
+
+	int width = 0;
+	int height = 0;
+	int output_id = 0;
+
+	double sum = 0;
+	double sumScale[scales] = {};
+	int frames = 0;
+
+	IMetricValueSink* sink = nullptr;
+
+	IMetricImage::ColorComponent colorComp = IMetricImage::YYUV;
+};
@@ -0,0 +1,296 @@
+/*
+********************************************************************
+(c) MSU Video Group, http://compression.ru/video/
+This source code is property of MSU Graphics and Media Lab
+
+This code may be distributed under LGPL
+(see http://www.gnu.org/licenses/lgpl.html for more details).
+
+E-mail: video-measure@compression.ru
+********************************************************************
+*/
+
+#pragma once
+
+#include "../PluginBase/ICustomPlugin.h"
+#include "../PluginBase/json.h"
+#include "../PluginBase/ImagePlane.h"
+#include "../PluginBase/ThreadPool.h"
+#include "../PluginBase/ColorConversion.h"
+#include "../PluginBase/ADM.h"
+#include "../PluginBase/VIF.h"
+
+#include <memory>
+#include <cmath>
+#include <cstring>
+
+/*
+*	VMAF features plugin
+*	Elementary features of VMAF model: detail loss (ADM) with its scales, VIF of 4 scales
+*	and temporal motion of the reference. Features are not fused into a score.
+*	Luma of both frames is converted to [0, 255] once and shared by all features,
+*	motion uses blurred luma of the previous reference kept by the plugin.
+*/
+class VQMTvmafFeaturesPlugin : public ICustomPlugin
+{
+public:
+	enum FeatureID {
+		FEATURE_ADM = 0,
+		FEATURE_ADM_SCALE0 = 1,
+		FEATURE_VIF_SCALE0 = FEATURE_ADM_SCALE0 + ADMResult::maxScales,
+		FEATURE_MOTION = FEATURE_VIF_SCALE0 + VIFResult::maxScales,
+		FEATURE_COUNT
+	};
+
+	void Init(IMetricImage::ColorComponent colorComp, int width, int height, int start_id, IMetricValueSink* sink) override {
+		this->width = width;
+		this->height = height;
+		this->start_id = start_id;
+		this->colorComp = colorComp;
+		this->sink = sink;
+
+		pool = std::make_unique<CThreadPool>(threads);
+		std::fill(sums, sums + FEATURE_COUNT, 0.);
+		frames = 0;
+		hasPrevious = false;
+		rangesValid[0] = rangesValid[1] = false;
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	Measure(std::vector<IMetricImage*> &images) override {
+		PlaneView ref = ToLuma(0, images[0]);
+		PlaneView dist = ToLuma(1, images[1]);
+
+		double features[FEATURE_COUNT] = {};
+		if (!ref.Empty() && !dist.Empty()) {
+			ADMResult adm = admKernel.Compute(ref, dist, pool.get());
+			features[FEATURE_ADM] = adm.Score();
+			for (int s = 0; s < ADMResult::maxScales; ++s) features[FEATURE_ADM_SCALE0 + s] = adm.Scale(s);
+
+			VIFResult vif = vifKernel.Compute(ref, dist, 255.f, pool.get());
+			for (int s = 0; s < VIFResult::maxScales; ++s) features[FEATURE_VIF_SCALE0 + s] = vif.Scale(s);
+
+			features[FEATURE_MOTION] = Motion(ref);
+		}
+
+		std::vector< std::pair <IMetricPlugin::ID, float> > res;
+		for (int i = 0; i < FEATURE_COUNT; ++i) {
+			sums[i] += features[i];
+			res.push_back({ start_id + i, float(features[i]) });
+		}
+		++frames;
+		return res;
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> >	MeasureAndVisualize(std::vector<IMetricImage*>&images, unsigned char *vis, int vis_pitch) override {
+		auto res = Measure(images);
+
+		// blurred luma difference between current and previous reference (motion feature)
+		const CPlaneBuffer& cur = blurred[current];
+		const CPlaneBuffer& prev = blurred[1 - current];
+		int w = std::min(width, images[0]->GetWidth());
+		int h = std::min(height, images[0]->GetHeight());
+		bool compare = hasPrevious && prev.Width() == cur.Width() && prev.Height() == cur.Height();
+		for (int y = 0; y < h; ++y) {
+			unsigned char* out = vis + (size_t)y * vis_pitch;
+			for (int x = 0; x < w; ++x) {
+				float d = 0;
+				if (compare && y < cur.Height() && x < cur.Width()) d = std::fabs(cur.Row(y)[x] - prev.Row(y)[x]) * 4.f;
+				unsigned char v = (unsigned char)(std::min(255.f, d) + 0.5f);
+				out[x * 3 + 0] = v;
+				out[x * 3 + 1] = v;
+				out[x * 3 + 2] = v;
+			}
+		}
+
+		return res;
+	}
+
+	std::vector<IDinfo>	MapIDToFrame(bool visualize) override {
+		std::vector<IDinfo> res = { { start_id + FEATURE_ADM, L"adm2" } };
+		for (int s = 0; s < ADMResult::maxScales; ++s) {
+			res.push_back({ start_id + FEATURE_ADM_SCALE0 + s, L"adm_scale" + std::to_wstring(s) });
+		}
+		for (int s = 0; s < VIFResult::maxScales; ++s) {
+			res.push_back({ start_id + FEATURE_VIF_SCALE0 + s, L"vif_scale" + std::to_wstring(s) });
+		}
+		res.push_back({ start_id + FEATURE_MOTION, L"motion" });
+		return res;
+	}
+
+	std::vector< std::pair <IMetricPlugin::ID, float> > CalculateAverage(bool visualize) override {
+		if (!frames) return {};
+		std::vector< std::pair <IMetricPlugin::ID, float> > res;
+		for (int i = 0; i < FEATURE_COUNT; ++i) {
+			res.push_back({ start_id + i, float(sums[i] / frames) });
+		}
+		return res;
+	}
+
+	int GetVideoNum(bool) override {
+		return 2;
+	}
+
+	std::vector <IMetricImage::ColorComponent> GetSupportedColorcomponents() override {
+		return { IMetricImage::YYUV };
+	}
+
+	std::wstring GetName() override {
+		return L"vmaf_features_sdk";
+	}
+	std::wstring GetInterfaceName() override {
+		return L"VMAF features (SDK)";
+	}
+	std::wstring GetLongName() override {
+		return L"VMAF elementary features: ADM, VIF scales, motion";
+	}
+
+	std::wstring GetMetrInfoURL() override {
+		return L"http://compression.ru/video/";
+	}
+	std::wstring GetUnit() override {
+		return L"";
+	}
+
+	bool GetMetrIncline() override {
+		return true;
+	}
+
+	const std::wstring& GetConfigJSON() override {
+		static const std::wstring obj =
+		{
+			L"	{																		"
+			L"		\"threads\": {														"
+			L"			\"description\": \"Threads\",									"
+			L"			\"help\": \"Number of threads, 0 - number of cores\",			"
+			L"			\"default_value\": 0,											"
+			L"			\"possible_values\": [[0,64]]									"
+			L"		}																	"
+			L"	}																		"
+		};
+		return obj;
+	}
+
+	bool SetConfigParams(const std::wstring& json)  override {
+		try {
+			YUVsoft::JSON res = YUVsoft::ParseWrapper::parse(YUVsoft::utf16_to_utf8(json));
+			if (res.in("threads")) {
+				int t = (int)res["threads"].asInteger();
+				if (t < 0 || t > 64) return false;
+				if (t != threads && pool) pool = std::make_unique<CThreadPool>(t);
+				this->threads = t;
+			}
+
+			return true;
+		}
+		catch (...) {}
+
+		return false;
+	}
+
+	std::wstring GetConfigSummary() override {
+		std::wstringstream out;
+		out << "Threads: " << threads;
+		return out.str();
+	}
+
+private:
+	//luma of the image in [0, 255], converted from RGB if the image has no Y plane
+	PlaneView ToLuma(int i, const IMetricImage* image) {
+		const RangeSpecification* ranges = image->GetRanges();
+		UpdateConverter(i, ranges);
+		PlaneView src = converter[i].ConvertComponent(image, IMetricImage::YYUV, width, height, converted);
+		if (src.Empty()) return PlaneView();
+
+		float min = 0, max = 255;
+		if (ranges && ranges[IMetricImage::YYUV].max > ranges[IMetricImage::YYUV].min) {
+			min = ranges[IMetricImage::YYUV].min;
+			max = ranges[IMetricImage::YYUV].max;
+		}
+		float scale = 255.f / (max - min);
+		CPlaneBuffer& dst = luma[i];
+		dst.Resize(src.width, src.height);
+		pool->ParallelFor(src.height, [&](int y) {
+			const float* in = src.Row(y);
+			float* out = dst.Row(y);
+			for (int x = 0; x < src.width; ++x) out[x] = (in[x] - min) * scale;
+		});
+		return dst.View();
+	}
+
+	//lookup table of the converter depends on ranges, it is rebuilt only when they change
+	void UpdateConverter(int i, const RangeSpecification* r) {
+		RangeSpecification current[IMetricImage::CC_LAST];
+		for (int c = 0; c < IMetricImage::CC_LAST; ++c) current[c] = r ? r[c] : RangeSpecification(0.f, 255.f);
+		if (rangesValid[i] && !std::memcmp(current, convertedRanges[i], sizeof(current))) return;
+		std::memcpy(convertedRanges[i], current, sizeof(current));
+		converter[i].Init(YUV_BT709, current);
+		rangesValid[i] = true;
+	}
+
+	//mean absolute difference of blurred luma of current and previous reference
+	double Motion(const PlaneView& ref) {
+		static const float filter[5] = { 0.054488685f, 0.244201342f, 0.402619947f, 0.244201342f, 0.054488685f };
+
+		current = 1 - current;
+		CPlaneBuffer& cur = blurred[current];
+		const CPlaneBuffer& prev = blurred[1 - current];
+		cur.Resize(ref.width, ref.height);
+
+		std::vector<double> sadRows(ref.height, 0.);
+		bool compare = hasPrevious && prev.Width() == ref.width && prev.Height() == ref.height;
+		pool->ParallelFor(ref.height, [&](int y) {
+			std::vector<float> tmp(ref.width);
+			const float* r[5];
+			for (int k = 0; k < 5; ++k) r[k] = ref.Row(VQMTsimd::Reflect(y - 2 + k, ref.height));
+			for (int x = 0; x < ref.width; ++x) {
+				tmp[x] = filter[0] * r[0][x] + filter[1] * r[1][x] + filter[2] * r[2][x] + filter[3] * r[3][x] + filter[4] * r[4][x];
+			}
+			float* out = cur.Row(y);
+			for (int x = 0; x < ref.width; ++x) {
+				float acc = 0;
+				for (int k = 0; k < 5; ++k) acc += filter[k] * tmp[VQMTsimd::Reflect(x - 2 + k, ref.width)];
+				out[x] = acc;
+			}
+			if (compare) {
+				const float* p = prev.Row(y);
+				double sad = 0;
+				for (int x = 0; x < ref.width; ++x) sad += std::fabs(out[x] - p[x]);
+				sadRows[y] = sad;
+			}
+		});
+
+		hasPrevious = true;
+		if (!compare) return 0.;
+
+		double sad = 0;
+		for (double v : sadRows) sad += v;
+		return sad / (double(ref.width) * ref.height);
+	}
+
+private:
+	int threads = 0;
+
+	std::unique_ptr<CThreadPool> pool;
+	CColorConverter converter[2];
+	RangeSpecification convertedRanges[2][IMetricImage::CC_LAST];
+	bool rangesValid[2] = { false, false };
+	CADM admKernel;
+	CVIF vifKernel;
+
+	CPlaneBuffer converted;
+	CPlaneBuffer luma[2];
+	CPlaneBuffer blurred[2];
+	int current = 0;
+	bool hasPrevious = false;
+
+	int width = 0;
+	int height = 0;
+	int start_id = 0;
+
+	double sums[FEATURE_COUNT] = {};
+	int frames = 0;
+
+	IMetricValueSink* sink = nullptr;
+
+	IMetricImage::ColorComponent colorComp = IMetricImage::YYUV;
+};